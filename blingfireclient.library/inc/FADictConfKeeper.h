@@ -8,6 +8,7 @@
 #define _FA_DICTCONFKEEPER_H_
 
 #include "FAConfig.h"
+#include "FAGetIWs_pack_triv.h"
 
 namespace BlingFire
 {
@@ -25,6 +26,7 @@ class FAArrayCA;
 class FAMultiMapCA;
 class FAState2OwCA;
 class FAMultiMap_pack_fixed;
+class FAGetIWsCA;
 
 ///
 /// Keeps dictionary object configuration and common containers.
@@ -49,6 +51,8 @@ public:
 public:
     const int GetFsmType () const;
     const FARSDfaCA * GetRsDfa () const;
+    /// returns NULL, if the alphabet of the automaton is remapped
+    const FAGetIWsCA * GetIws () const;
     const FAMealyDfaCA * GetMphMealy () const;
     const FAState2OwCA * GetState2Ow () const;
     const FAArrayCA * GetK2I () const;
@@ -68,6 +72,9 @@ private:
     // W2K: Mealy-based MPH or Moore
     int m_FsmType;
     FARSDfa_pack_triv * m_pRsDfa;
+    // Iws of the states of m_pRsDfa, valid if m_hasIws is true
+    FAGetIWs_pack_triv m_Iws;
+    bool m_hasIws;
     FAMealyDfa_pack_triv * m_pMealy;
     FAState2Ow_pack_triv * m_pState2Ow;
     // K2I: packed array
@@ -95,6 +102,9 @@ public:
     // this is rather an exception, to let the users change the behaviour of the model
     // Note: it is the best to use the mode the same way it was trained / compiled leave this value to what it was set via ldb.conf.small file
     void SetNoDummyPrefix(bool fNoDummyPrefix);
+    // allows to switch between the runtime algorithms which use the same data,
+    // e.g. TOKENIZE_BPE_OPT_WITH_MERGES and TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL
+    void SetTokAlgo(const int TokAlgo);
 
 };
 
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_FASTMOD_H_
+#define _FA_FASTMOD_H_
+
+#include "FAConfig.h"
+
+#include <stdint.h>
+
+#if defined(_MSC_VER) && !defined(__SIZEOF_INT128__) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+namespace BlingFire
+{
+
+///
+/// Computes N / D and N % D for 64-bit N and a fixed divisor D without the
+/// division instruction: the quotient is taken from the high half of the
+/// product of N and a precomputed "magic" number (the round-up method, as
+/// in Granlund and Montgomery, "Division by invariant integers using
+/// multiplication"). The results are exactly the same as of / and %.
+///
+/// Usage:
+///
+///   FAFastMod Mod (Bucket);
+///   for (...) { Out [i] = Mod.Mod (Hash [i]); }
+///
+/// Note: D should be in [1, 2^32).
+///
+
+class FAFastMod {
+
+public:
+    FAFastMod ();
+    FAFastMod (const uint64_t D);
+
+public:
+    /// sets up the divisor
+    void SetDivisor (const uint64_t D);
+    /// returns N / D
+    inline const uint64_t Div (const uint64_t N) const;
+    /// returns N % D
+    inline const uint64_t Mod (const uint64_t N) const;
+
+private:
+    /// returns the high 64 bits of the 128-bit product
+    static inline const uint64_t MulHi (const uint64_t A, const uint64_t B);
+
+private:
+    // the divisor
+    uint64_t m_D;
+    // the magic multiplier, 0 if D is a power of 2
+    uint64_t m_Magic;
+    // the final shift
+    int m_Shift;
+    // true if the 65-bit magic number is used
+    bool m_fAdd;
+};
+
+
+inline FAFastMod::FAFastMod ()
+{
+    FAFastMod::SetDivisor (1);
+}
+
+
+inline FAFastMod::FAFastMod (const uint64_t D)
+{
+    FAFastMod::SetDivisor (D);
+}
+
+
+inline void FAFastMod::SetDivisor (const uint64_t D)
+{
+    LogAssert (0 < D && D <= 0xFFFFFFFFULL);
+
+    m_D = D;
+    m_Magic = 0;
+    m_Shift = 0;
+    m_fAdd = false;
+
+    // floor (log2 (D))
+    int Log2 = 0;
+    while ((D >> (Log2 + 1)) != 0) {
+        Log2++;
+    }
+
+    // a power of 2, the quotient is a shift
+    if (0 == (D & (D - 1))) {
+        m_Shift = Log2;
+        return;
+    }
+
+    // floor (2^(64 + Log2) / D), computed in 32-bit digits, 2^Log2 < D
+    uint64_t Rem = 1ULL << Log2;
+    uint64_t Num = Rem << 32;
+    const uint64_t Q1 = Num / D;
+    Rem = Num % D;
+    Num = Rem << 32;
+    const uint64_t Q0 = Num / D;
+    Rem = Num % D;
+
+    uint64_t Magic = (Q1 << 32) | Q0;
+
+    if (D - Rem < (1ULL << Log2)) {
+        // 2^(64 + Log2) / D fits
+        m_fAdd = false;
+    } else {
+        // the magic number needs 65 bits, its top bit is added separately
+        Magic += Magic;
+        const uint64_t TwiceRem = Rem + Rem;
+        if (TwiceRem >= D || TwiceRem < Rem) {
+            Magic += 1;
+        }
+        m_fAdd = true;
+    }
+
+    m_Magic = Magic + 1;
+    m_Shift = Log2;
+}
+
+
+inline const uint64_t FAFastMod::MulHi (const uint64_t A, const uint64_t B)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t) (((unsigned __int128) A * B) >> 64);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    return __umulh (A, B);
+#else
+    const uint64_t ALo = A & 0xFFFFFFFFULL;
+    const uint64_t AHi = A >> 32;
+    const uint64_t BLo = B & 0xFFFFFFFFULL;
+    const uint64_t BHi = B >> 32;
+
+    const uint64_t LoLo = ALo * BLo;
+    const uint64_t HiLo = AHi * BLo;
+    const uint64_t LoHi = ALo * BHi;
+    const uint64_t HiHi = AHi * BHi;
+
+    const uint64_t Mid = (LoLo >> 32) + (HiLo & 0xFFFFFFFFULL) + LoHi;
+    return HiHi + (HiLo >> 32) + (Mid >> 32);
+#endif
+}
+
+
+inline const uint64_t FAFastMod::Div (const uint64_t N) const
+{
+    if (0 == m_Magic) {
+        return N >> m_Shift;
+    }
+
+    const uint64_t Q = MulHi (m_Magic, N);
+
+    if (m_fAdd) {
+        return (((N - Q) >> 1) + Q) >> m_Shift;
+    } else {
+        return Q >> m_Shift;
+    }
+}
+
+
+inline const uint64_t FAFastMod::Mod (const uint64_t N) const
+{
+    return N - (Div (N) * m_D);
+}
+
+}
+
+#endif
@@ -411,6 +411,11 @@ public:
         TOKENIZE_BPE_OPT_WITH_MERGES = 5, // optimized version of the BPE, prefers a single token match over
                                           // subtoken, assumes tokens are delimited with U+x2581 uses scores 
                                           // as merge ranks
+        TOKENIZE_BPE_OPT_LOCAL = 6, // the same results as TOKENIZE_BPE_OPT, but the matches are sorted and
+                                    // merged in groups of overlapping matches, faster on long inputs
+
+        TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL = 7, // the same results as TOKENIZE_BPE_OPT_WITH_MERGES, but the
+                                                // matches are merged in groups of overlapping matches
         TOKENIZE_COUNT,
     };
 
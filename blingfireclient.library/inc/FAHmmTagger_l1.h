@@ -16,6 +16,8 @@
 namespace BlingFire
 {
 
+class FAThreadPool;
+
 ///
 /// 1-best first order HMM POS tagger.
 ///
@@ -27,9 +29,46 @@ namespace BlingFire
 /// [4. pTagger->Clear (); // free the memory]
 /// [5. Repeat Steps 1-4.]
 ///
+/// The model data are never modified after Initialize, all the per-sequence
+/// decoding state is kept in FAContext objects. The methods taking an
+/// FAContext are const and can be called concurrently as long as each
+/// thread uses its own context, AddWord / Process without a context use
+/// the object's own one and are not thread-safe.
+///
 
 class FAHmmTagger_l1
 {
+public:
+    /// per-sequence decoding state (the lattice)
+    class FAContext {
+
+    friend class FAHmmTagger_l1;
+
+    public:
+        FAContext ();
+
+    public:
+        /// sets up the memory manager, should be called before the first use
+        void SetAllocator (FAAllocatorA * pMemMgr);
+        /// frees memory from the internal arrays
+        void Clear ();
+
+    private:
+        /// all tags of all words
+        FAArray_cont_t < int > m_tags;
+        /// all lexical probabilities of all words, it is prallel to m_tags
+        /// during the forward iteration of the viterbi algorithm the array
+        /// contains the best probability for the path ending at this tag
+        FAArray_cont_t < float > m_probs;
+        /// for each the tag idx (from m_tags) keeps track of the best 
+        /// previous tag index (from m_tags), this array is prallel to m_tags
+        FAArray_cont_t < int > m_prev_best_idx;
+        /// how many tags/probs, up to the i-th word there are in the m_tags
+        FAArray_cont_t < int > m_counts;
+        /// actual word count + 2 for BOS and EOS, 0 if BOS is not added yet
+        int m_WordCount;
+    };
+
 public:
     FAHmmTagger_l1 ();
 
@@ -57,9 +96,39 @@ public:
     //   frees memory from the internal arrays
     void Clear ();
 
+    /// AddWord and Process working with the given decoding context
+    void AddWord (
+            FAContext * pCtx,
+            const int * pWord,
+            const int WordLen
+        ) const;
+    const int Process (
+            FAContext * pCtx,
+            int * pOut,
+            const int MaxOutSize
+        ) const;
+
+    /// Tags SentCount sentences in parallel using upto ThreadCount threads
+    /// of the pool, if ThreadCount <= 0 then all hardware threads are used.
+    /// The words of all the sentences go one after another in the
+    /// ppWords / pWordLens arrays, pSentEnds [i] is the index of the word
+    /// following the last word of the i-th sentence. pOut receives one tag
+    /// per word and should be at least pSentEnds [SentCount - 1] long.
+    void TagSentences (
+            const int * const * ppWords,
+            const int * pWordLens,
+            const int * pSentEnds,
+            const int SentCount,
+            int * pOut,
+            FAThreadPool * pPool,
+            const int ThreadCount
+        ) const;
+
 private:
+    /// adds a special BOS word at the beginning, if not added yet
+    inline void AddBosWord (FAContext * pCtx) const;
     /// adds a special EOS word at the end
-    void AddEosWord ();
+    void AddEosWord (FAContext * pCtx) const;
 
 private:
     /// true if the processor has been initialized
@@ -80,23 +149,8 @@ private:
     /// end of sequence, beginning of sequence tag
     int m_EosTag;
 
-    /// all tags of all words
-    FAArray_cont_t < int > m_tags;
-
-    /// all lexical probabilities of all words, it is prallel to m_tags
-    /// during the forward iteration of the viterbi algorithm the array
-    /// contains the best probability for the path ending at this tag
-    FAArray_cont_t < float > m_probs;
-
-    /// for each the tag idx (from m_tags) keeps track of the best 
-    /// previous tag index (from m_tags), this array is prallel to m_tags
-    FAArray_cont_t < int > m_prev_best_idx;
-
-    /// how many tags/probs, up to the i-th word there are in the m_tags
-    FAArray_cont_t < int > m_counts;
-
-    // actual word count + 2 for BOS and EOS
-    int m_WordCount;
+    /// the decoding context of the non-reentrant AddWord / Process
+    FAContext m_ctx;
 
     enum {
         // if there is not enough space in the m_counts array,
@@ -106,6 +160,9 @@ private:
         // if there is not enough space in the m_tags/m_probs arrays,
         // then TAGS_PROBS_DELTA more will be allocated in the arrays
         TAGS_PROBS_DELTA = 1024,
+
+        // TagSentences makes upto this many jobs per thread
+        JOBS_PER_THREAD = 4,
     };
 };
 
@@ -23,12 +23,21 @@ public:
     ~FAImageDump ();
 
 public:
-    // loads image dump from file, entire file is used as single image
-    void Load (const char * pFileName, const bool fUseMemMapping = false);
+    // loads image dump from file, entire file is used as single image,
+    // if fUseMemMapping is true then the file is mapped read-only and shared
+    // between processes, if fPrefetch is true then the OS is asked to read
+    // the mapped file ahead
+    void Load (
+            const char * pFileName,
+            const bool fUseMemMapping = false,
+            const bool fPrefetch = false
+        );
     // sets up image dump from the external pointer
     void SetImageDump (const unsigned char * pImageDump);
     // returns pointer to the image dump
     const unsigned char * GetImageDump () const;
+    // returns the size of the image dump, 0 if it is set from the external pointer
+    const size_t GetImageSize () const;
 
 private:
     // load file into the heap
@@ -36,7 +45,7 @@ private:
     // frees heap memory
     void FAFreeHeap ();
     // load file via memory mapped files
-    void FALoadMm (const char * pFileName);
+    void FALoadMm (const char * pFileName, const bool fPrefetch);
     // returns all memory map related resources back
     void FAFreeMm ();
 
@@ -49,6 +58,10 @@ private:
     HANDLE m_hFileMapping;
     /// true if the memory should be unmapped
     bool m_MustUnmap;
+    /// size of the mapped memory, used by munmap
+    size_t m_MmSize;
+    /// size of the loaded image
+    size_t m_ImageSize;
 };
 
 }
@@ -27,6 +27,15 @@ public:
 
 public:
     void SetImage (const unsigned char * pImgDump);
+    // the same as above, the image size makes the size of the last dump known
+    void SetImage (const unsigned char * pImgDump, const size_t ImgSize);
+    // sets up the LDB from separate dumps, the dumps are not required to be
+    // adjacent in memory, e.g. some of them can be shared between the LDBs
+    void SetDumps (
+            const unsigned char ** ppDumps,
+            const size_t * pSizes,
+            const int Count
+        );
 
 public:
     // returns configuration multi map, it contain runtime initialization
@@ -39,6 +48,10 @@ public:
     // returns pointer to the image dump memory by its index
     const unsigned char * GetDump (const int Num) const;
 
+    // returns the size of the image dump by its index, the size of the last
+    // dump is 0 if the LDB was set up without the image size
+    const size_t GetDumpSize (const int Num) const;
+
     // returns true if the parameter found, false otherwise
     // *pValue will contain parameter's value from the given section
     // it will be 1 if the parameter is boolean
@@ -57,8 +70,10 @@ protected:
     // keeps the array of resource dumps
     const unsigned char * m_Dumps [FALimits::MaxLdbDumpCount];
 
-    // and array of offsets where the dumps start
-    unsigned int m_Offsets [FALimits::MaxLdbDumpCount];
+    // and array of offsets where the dumps start, the last one is the end
+    // of the last dump (the dumps are laid out contiguously if they are set
+    // up with SetDumps)
+    unsigned int m_Offsets [FALimits::MaxLdbDumpCount + 1];
 
     // number of dumps
     int m_DumpCount;
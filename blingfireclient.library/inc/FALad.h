@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_LAD_H_
+#define _FA_LAD_H_
+
+#include "FAConfig.h"
+#include "FAWordGuesser_prob_t.h"
+#include "FASummTagScores.h"
+
+namespace BlingFire
+{
+
+class FALadLDB;
+
+///
+/// Word/N-gram based LAD
+///
+/// The model data are never modified after Initialize, all the per-text
+/// state is kept in FAContext objects. The methods taking an FAContext are
+/// const and can be called concurrently as long as each thread uses its
+/// own context, Process / GetScores without a context use the object's own
+/// one and are not thread-safe.
+///
+
+class FALad {
+
+public:
+    /// per-text scoring state, it is set up by the first call and should
+    /// not be used after the model is re-initialized
+    class FAContext {
+
+    friend class FALad;
+
+    public:
+        FAContext ();
+        ~FAContext ();
+
+    public:
+        /// frees memory
+        void Clear ();
+
+    private:
+        enum {
+            MaxNgramOrder = 4,
+            MaxTokenLen = 1024,
+        };
+
+        /// the model the context is set up for
+        const FALad * m_pLad;
+
+        /// temporary token buffer
+        int m_Token [MaxTokenLen + 2];
+        /// token length
+        int m_TokenLen;
+
+        /// word / n-gram scorers output buffers
+        int * m_pOws;
+        float * m_pProbs;
+        int m_MaxOwCount;
+
+        /// scorers agregators
+        FASummTagScores m_WordsScores;
+        int m_WordCount;
+        int m_BestWordTag;
+        /// scorers agregators
+        FASummTagScores m_NgramScores [MaxNgramOrder];
+        int m_NgramCount [MaxNgramOrder];
+        int m_BestTag [MaxNgramOrder];
+
+        /// script --> count map
+        int * m_pScript2Count;
+
+        /// languages of the major script
+        const int * m_pLangs;
+        int m_LangCount;
+
+        /// the solution vector
+        const int * m_pCounts;
+        const float * m_pScores;
+    };
+
+public:
+    FALad ();
+    ~FALad ();
+
+public:
+    /// initialization should be done once prior to any Process calls
+    void Initialize (const FALadLDB * pLDB);
+    /// returns the best language id or -1 in case of an error
+    const int Process (const char * pText, size_t TextSize);
+    /// returns two arrays one is a mapping Language --> Score and
+    /// the other (parallel) is a mapping Language --> Count
+    /// Note: the Process () should be called before this function can be used
+    const int GetScores (const float ** ppScores, const int ** ppCounts) const;
+    /// returns object into initial state
+    void Clear ();
+
+    /// Process and GetScores working with the given context
+    const int Process (
+            FAContext * pCtx,
+            const char * pText,
+            size_t TextSize
+        ) const;
+    const int GetScores (
+            const FAContext * pCtx,
+            const float ** ppScores,
+            const int ** ppCounts
+        ) const;
+
+    /// Returns upto MaxCount languages of the text with their scores, the
+    /// best language (as returned by Process) goes first and the others
+    /// of the same script follow in the order of their scores, returns 0
+    /// if the language is unknown.
+    const int GetLanguages (
+            FAContext * pCtx,
+            const char * pText,
+            size_t TextSize,
+            int * pLangs,
+            float * pScores,
+            const int MaxCount
+        ) const;
+
+    /// returns the unknown language tag value
+    const int GetUnkTag () const;
+
+private:
+    /// sets up the context for this model, if it is not yet
+    void InitContext (FAContext * pCtx) const;
+    /// returns the tag (other than m_UnkTag) with the best score and with
+    /// the count no smaller than the MinCount
+    /// returns -1 if such tag does not exist
+    inline const int GetBestTag (
+            const float * pScores,
+            const int * pCounts,
+            const int MinCount,
+            const int * pLangs,
+            const int LangCount
+        ) const;
+    /// this function breaks the text into tokens (close to words) and
+    /// feeds each of them to the ScoreNextToken for scoring
+    void ScoreText (FAContext * pCtx, const char * pText, size_t TextSize) const;
+    /// this functions scores the token and updates scores in different accumulators
+    void ScoreNextToken (FAContext * pCtx) const;
+    /// returns true if the UTF-32 buffer has junk symbols
+    inline const bool HasJunk (const int * pIn, const int Size) const;
+    /// returns true if the UTF-32 buffer has upper case letters
+    inline const bool HasUpper (const int * pIn, const int Size) const;
+    /// resets all the scores
+    inline void ResetScores (FAContext * pCtx) const;
+    /// finds best scores for each scorer
+    inline void FindBestScores (
+            FAContext * pCtx,
+            const int * pLangs,
+            const int LangCount
+        ) const;
+    /// finds the best script
+    const int GetBestScript (const FAContext * pCtx) const;
+
+private:
+    enum {
+        MaxNgramOrder = FAContext::MaxNgramOrder,
+        MaxTokenLen = FAContext::MaxTokenLen,
+        DefJunkSymbol = 0x21,
+    };
+
+    /// maximum tag value
+    int m_MaxTag;
+    /// Unknown language tag value
+    int m_UnkTag;
+    // n-gram order
+    int m_Order;
+    // n-gram min backoff order
+    int m_MinOrder;
+    // maximum amount of n-grams to use
+    int m_MaxCount;
+    /// percent of n-grams should match
+    int m_MinMatchRatio;
+    /// percent of words should match
+    int m_MinWordMatchRatio;
+
+    /// word --> log p(L|W) mapping
+    FAWordGuesser_prob_t < int > m_WordScorer;
+    /// n-gram --> log p(L|ngram) mapping
+    FAWordGuesser_prob_t < int > m_NgrScorer;
+    /// maximum output size of the scorers
+    int m_MaxOwCount;
+
+    /// charmap
+    const FAMultiMapCA * m_pCharMap;
+
+    /// char --> script map
+    const FAMultiMapCA * m_pC2SMap;
+    /// script --> lang map
+    const FAMultiMapCA * m_pS2LMap;
+    /// script tag boundaries
+    int m_MinScriptTag;
+    int m_MaxScriptTag;
+
+    /// indicates which scorers can be used
+    bool m_fUseNgrams;
+    bool m_fUseWords;
+
+    /// the context of the non-reentrant Process / GetScores
+    FAContext m_ctx;
+};
+
+}
+
+#endif
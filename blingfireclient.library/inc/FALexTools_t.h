@@ -17,6 +17,8 @@
 #include "FALimits.h"
 #include "FASecurity.h"
 
+#include <vector>
+
 namespace BlingFire
 {
 
@@ -47,6 +49,18 @@ namespace BlingFire
 ///  the values can be predefined (and frozen) in the tagset.txt file of the
 ///  the corresponding grammar.
 ///
+/// 3. Every start position is scanned for the longest match, if the scans
+///  get long (e.g. long runs of punctuation for which the rules look for the
+///  end of a sentence) the runtime starts remembering which state each scan
+///  had at each position, a later scan which comes to the same position in
+///  the same state takes the rest of the result from the earlier scan, this
+///  makes the processing time linear in the input size and does not change
+///  the results. SetLinearScan (false) turns this off.
+///
+/// 4. A long text can be processed in parts with ProcessPart, the scans
+///  which may need the input past the end of a part are left for the next
+///  part, so the results are the same as of the whole text processing.
+///
 
 template < class Ty >
 class FALexTools_t {
@@ -57,6 +71,8 @@ public:
 public:
     /// sets up the data containers
     void SetConf (const FAWbdConfKeeper * pWbdConf);
+    /// enables / disables the memoization of the long scans, enabled by default
+    void SetLinearScan (const bool LinearScan);
 
     /// makes a processing
     const int Process (
@@ -75,6 +91,26 @@ public:
             const int MaxOutSize
         ) const;
 
+    /// makes a processing of a part of a longer text, fBegin / fEnd indicate
+    /// whether the part starts / ends the text, if fEnd is false then the
+    /// processing stops at the first start position, which scans may read
+    /// past the end of the part, this position is returned in *pNextPos and
+    /// the next part should start from it (if *pNextPos is -1 the next part
+    /// is still the beginning of the text), output positions are relative
+    /// to pIn
+    const int ProcessPart (
+            const Ty * pIn,
+            const int InSize,
+            const bool fBegin,
+            const bool fEnd,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            int * pNextPos
+        ) const;
+
+    /// returns the maximum token length, the scans do not go any further
+    const int GetMaxTokenLength () const;
+
 private:
     /// validates consitensy between data structures
     inline void Validate () const;
@@ -88,7 +124,10 @@ private:
             __out_ecount(MaxOutSize) int * pOut,
             const int MaxOutSize,
             const int RecDepth,
-            const bool fOnce = false
+            const bool fOnce = false,
+            const bool fBegin = true,
+            const bool fEnd = true,
+            int * pNextPos = NULL
         ) const;
 
 private:
@@ -103,11 +142,17 @@ private:
     unsigned int m_Fn2IniSize;
     /// maximum token length
     int m_MaxTokenLength;
+    /// indicates whether the long scans are memoized
+    bool m_LinearScan;
     /// constants
     enum {
         DefMaxDepth = 2,
         MinActSize = 3,
         DefSubIw = FAFsmConst::IW_EPSILON,
+        // the scans are checked once per this many start positions
+        MemoBlockSize = 64,
+        // the memoization starts if a position costs more steps on average
+        MemoStepRatio = 8,
     };
 };
 
@@ -121,7 +166,8 @@ FALexTools_t< Ty >::FALexTools_t () :
     m_MaxDepth (DefMaxDepth),
     m_pFn2Ini (NULL),
     m_Fn2IniSize (0),
-    m_MaxTokenLength (FALimits::MaxWordLen)
+    m_MaxTokenLength (FALimits::MaxWordLen),
+    m_LinearScan (true)
 {}
 
 
@@ -154,6 +200,13 @@ void FALexTools_t< Ty >::SetConf (const FAWbdConfKeeper * pWbdConf)
 }
 
 
+template < class Ty >
+void FALexTools_t< Ty >::SetLinearScan (const bool LinearScan)
+{
+    m_LinearScan = LinearScan;
+}
+
+
 template < class Ty >
 inline void FALexTools_t< Ty >::Validate () const
 {
@@ -212,7 +265,10 @@ const int FALexTools_t< Ty >::
             __out_ecount(MaxOutSize) int * pOut,
             const int MaxOutSize,
             const int RecDepth,
-            const bool fOnce
+            const bool fOnce,
+            const bool fBegin,
+            const bool fEnd,
+            int * pNextPos
         ) const
 {
     int OutSize = 0;
@@ -225,12 +281,56 @@ const int FALexTools_t< Ty >::
 
     const int MaxTokenLength = m_MaxTokenLength;
 
+    // the memoization data, allocated only when the scans get long:
+    //  for a position j: j, the state a scan had at j, the scan id
+    //  for a scan id: end position, end state or -1, final position, final state
+    std::vector < int > Memo;
+    std::vector < int > Scans;
+    int * pMemo = NULL;
+    int * pScans = NULL;
+    int Mask = 0;
+
+    // the number of steps made since BlockFrom position
+    int Steps = 0;
+    int BlockFrom = -1;
+
+    int FromPos = fBegin ? -1 : 0;
+
     /// iterate thru all possible start positions
-    for (int FromPos = -1; FromPos < InSize; ++FromPos) {
+    for (; FromPos < InSize; ++FromPos) {
+
+        // see whether the scan may need the input past the end of the part
+        if (!fEnd && InSize <= FromPos + MaxTokenLength) {
+            break;
+        }
+
+        // see whether the scans got too long
+        if (!pMemo && m_LinearScan && MemoBlockSize <= FromPos - BlockFrom) {
+
+            if (MemoStepRatio * (FromPos - BlockFrom) < Steps) {
+
+                // a scan may use the data of the scans started upto
+                // MaxTokenLength + 1 positions before
+                const int MaxSpan = (MaxTokenLength < InSize ? MaxTokenLength : InSize) + 2;
+                int Size = 1;
+                while (Size < MaxSpan) {
+                    Size <<= 1;
+                }
+                Mask = Size - 1;
+                Memo.assign (3 * Size, -1);
+                Scans.assign (4 * Size, -1);
+                pMemo = Memo.data ();
+                pScans = Scans.data ();
+            }
+
+            Steps = 0;
+            BlockFrom = FromPos;
+        }
 
         int State = Initial;
         int FinalState = -1;
         int FinalPos = -1;
+        bool fDead = false;
 
         int j = FromPos;
 
@@ -252,7 +352,39 @@ const int FALexTools_t< Ty >::
         }
 
         /// feed the letters
-        for (; j < LengthBound; ++j) {
+        while (j < LengthBound) {
+
+            if (pMemo) {
+
+                int * pEntry = pMemo + (3 * (j & Mask));
+
+                if (j == pEntry [0] && State == pEntry [1]) {
+
+                    // an earlier scan had the same state at this position,
+                    // the rest of its scan is the same as the rest of this one
+                    const int * pScan = pScans + (4 * (pEntry [2] & Mask));
+                    // this scan goes at least as far, so the next scans
+                    // which come here will take the result from it
+                    pEntry [2] = FromPos + 1;
+
+                    if (j <= pScan [2]) {
+                        FinalPos = pScan [2];
+                        FinalState = pScan [3];
+                    }
+                    j = pScan [0];
+                    if (-1 == pScan [1]) {
+                        fDead = true;
+                        break;
+                    }
+                    // continue from where the earlier scan was stopped
+                    State = pScan [1];
+                    continue;
+                }
+
+                pEntry [0] = j;
+                pEntry [1] = State;
+                pEntry [2] = FromPos + 1;
+            }
 
             Iw = pIn [j];
             // prevent regular input weights to match control input weights
@@ -265,16 +397,19 @@ const int FALexTools_t< Ty >::
             Dst = m_pDfa->GetDest (State, Iw);
             if (-1 == Dst) {
                 Dst = m_pDfa->GetDest (State, FAFsmConst::IW_ANY);
-                if (-1 == Dst)
+                if (-1 == Dst) {
+                    fDead = true;
                     break;
+                }
             }
             if (m_pDfa->IsFinal (Dst)) {
                 FinalState = Dst;
                 FinalPos = j;
             }
             State = Dst;
+            ++j;
 
-        } // of for (; j < InSize; ...
+        } // of while (j < LengthBound) ...
 
         /// feed the right anchor, if appropriate
         if (InSize == j) {
@@ -289,6 +424,17 @@ const int FALexTools_t< Ty >::
             }
         }
 
+        // remember how this scan has ended
+        if (pMemo) {
+            int * pScan = pScans + (4 * ((FromPos + 1) & Mask));
+            pScan [0] = j;
+            pScan [1] = fDead ? -1 : State;
+            pScan [2] = FinalPos;
+            pScan [3] = FinalState;
+        } else {
+            Steps += (j - FromPos);
+        }
+
         // use the FinalState and the deepest FinalPos(ition)
         if (-1 != FinalPos) {
             DebugLogAssert (-1 != FinalState);
@@ -336,6 +482,9 @@ const int FALexTools_t< Ty >::
                     pOut [OutSize++] = ToPos2 + Offset;
                 } else {
                     // stop processing, the output buffer is not enough
+                    if (pNextPos) {
+                        *pNextPos = FromPos;
+                    }
                     return OutSize;
                 }
                 FnIdx = MinActSize + 1;
@@ -396,6 +545,10 @@ const int FALexTools_t< Ty >::
 
     } // of for (FromPos = 0;
 
+    if (pNextPos) {
+        *pNextPos = FromPos < InSize ? FromPos : InSize;
+    }
+
     return OutSize;
 }
 
@@ -457,6 +610,40 @@ const int FALexTools_t< Ty >::
     return -1;
 }
 
+
+template < class Ty >
+const int FALexTools_t< Ty >::
+    ProcessPart (
+            const Ty * pIn,
+            const int InSize,
+            const bool fBegin,
+            const bool fEnd,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            int * pNextPos
+        ) const
+{
+    DebugLogAssert (pNextPos);
+
+    if (!m_pActs || !m_pDfa || !m_pState2Ow) {
+        return -1;
+    }
+
+    const int Initial = m_pDfa->GetInitial ();
+
+    const int OutSize = Process_int (Initial, 0, pIn, InSize, pOut, \
+        MaxOutSize, 1, false, fBegin, fEnd, pNextPos);
+
+    return OutSize;
+}
+
+
+template < class Ty >
+const int FALexTools_t< Ty >::GetMaxTokenLength () const
+{
+    return m_MaxTokenLength;
+}
+
 }
 
 #endif
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_MULTIMAP_DENSE_H_
+#define _FA_MULTIMAP_DENSE_H_
+
+#include "FAConfig.h"
+#include "FAMultiMapCA.h"
+
+#include <vector>
+
+namespace BlingFire
+{
+
+///
+/// A flat copy of another multi-map (usually a character normalization
+/// map) for the keys in [0, MaxKey]. The keys are split into pages of
+/// 2^PageBits keys, only the pages with at least one key in the map are
+/// stored. A key with one value is kept in the page itself, the values of
+/// the other keys are kept in a separate array. The keys which are out of
+/// the [0, MaxKey] range are looked up in the underlying map.
+///
+/// Notes:
+///
+/// 1. The table is built at load time, Get (Key, ppValues) takes two array
+///    reads and no virtual calls for the keys in the range.
+/// 2. The underlying map should stay valid while this object is used.
+///
+
+class FAMultiMap_dense : public FAMultiMapCA {
+
+public:
+    FAMultiMap_dense ();
+
+public:
+    /// builds the table for the keys [0, MaxKey] of the pMap
+    void Build (const FAMultiMapCA * pMap, const int MaxKey);
+    /// returns the memory used by the table in bytes
+    const size_t GetMemorySize () const;
+    /// returns object into the initial state
+    void Clear ();
+
+/// read interface
+public:
+    const int Get (
+            const int Key,
+            const int ** ppValues
+        ) const;
+    const int Get (
+            const int Key,
+            __out_ecount_opt(MaxCount) int * pValues,
+            const int MaxCount
+        ) const;
+    const int GetMaxCount () const;
+
+public:
+    enum {
+        PageBits = 8,
+        PageSize = 1 << PageBits,
+        PageMask = PageSize - 1,
+        // the maximum number of stored pages
+        MaxPageCount = 0xFFFF,
+    };
+
+private:
+    // the underlying map
+    const FAMultiMapCA * m_pMap;
+    // maps Key >> PageBits into 1-based page index, 0 if the page is empty
+    std::vector < unsigned short > m_Key2Page;
+    const unsigned short * m_pKey2Page;
+    unsigned int m_Key2PageSize;
+    // page entries: a value (>= 0), -1 if the key is not in the map,
+    // or -(2 + i), where i is the index of the count and the values in m_Values
+    std::vector < int > m_Pages;
+    const int * m_pPages;
+    std::vector < int > m_Values;
+    const int * m_pValues;
+};
+
+
+inline const int FAMultiMap_dense::Get (
+        const int Key,
+        const int ** ppValues
+    ) const
+{
+    if ((unsigned int) (Key >> PageBits) < m_Key2PageSize) {
+
+        const unsigned int Page = m_pKey2Page [Key >> PageBits];
+        if (0 == Page) {
+            return -1;
+        }
+
+        const int * pEntry = m_pPages + (((Page - 1) << PageBits) | (Key & PageMask));
+        const int Entry = *pEntry;
+
+        if (0 <= Entry) {
+            if (ppValues) {
+                *ppValues = pEntry;
+            }
+            return 1;
+        } else if (-1 == Entry) {
+            return -1;
+        } else {
+            const int * pCount = m_pValues + (-Entry - 2);
+            if (ppValues) {
+                *ppValues = pCount + 1;
+            }
+            return *pCount;
+        }
+    }
+
+    return m_pMap ? m_pMap->Get (Key, ppValues) : -1;
+}
+
+}
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_RSDFA_DENSE_H_
+#define _FA_RSDFA_DENSE_H_
+
+#include "FAConfig.h"
+#include "FARSDfaCA.h"
+
+#include <vector>
+
+namespace BlingFire
+{
+
+///
+/// A flat transition table built on top of another RS Dfa (usually the
+/// packed one) for the states reachable from the initial state first and
+/// for the low (Iw < 256) alphabet. Each table row is cache-aligned and is
+/// addressed by the original state id, so the state ids, finality and the
+/// State2Ow data stay the same; transitions which are not in the table
+/// are looked up in the underlying automaton.
+///
+/// Notes:
+///
+/// 1. The table is built at load time, the amount of memory it takes is
+///    bounded by the MaxMemory parameter, the number of rows is reduced
+///    until the table fits.
+/// 2. The underlying automaton should stay valid while this object is used.
+///
+
+class FARSDfa_dense : public FARSDfaCA {
+
+public:
+    FARSDfa_dense ();
+
+public:
+    /// builds the table for the pDfa, using at most MaxMemory bytes,
+    /// returns the number of states in the table (it can be 0)
+    const int Build (const FARSDfaCA * pDfa, const size_t MaxMemory);
+    /// returns the memory used by the table in bytes
+    const size_t GetMemorySize () const;
+    /// returns object into the initial state
+    void Clear ();
+
+/// read interface
+public:
+    const int GetInitial () const;
+    const int GetIWs (
+            __out_ecount_opt (MaxIwCount) int * pIws, 
+            const int MaxIwCount
+        ) const;
+    const bool IsFinal (const int State) const;
+    const int GetDest (const int State, const int Iw) const;
+
+public:
+    enum {
+        // the table alphabet is [0, DenseIwCount)
+        DenseIwCount = 256,
+        // maximum number of rows in the table
+        MaxRowCount = 0xFFFF,
+        // row alignment, in ints
+        RowAlign = 64 / sizeof (int),
+    };
+
+private:
+    // the underlying automaton
+    const FARSDfaCA * m_pDfa;
+    // the table rows, m_pRows [0] is the first aligned int of m_Rows
+    std::vector < int > m_Rows;
+    const int * m_pRows;
+    // maps State into 1-based row index, 0 if the state has no row
+    std::vector < unsigned short > m_State2Row;
+    const unsigned short * m_pState2Row;
+    unsigned int m_State2RowSize;
+};
+
+
+inline const int FARSDfa_dense::GetDest (const int State, const int Iw) const
+{
+    if ((unsigned int) Iw < DenseIwCount && \
+        (unsigned int) State < m_State2RowSize) {
+
+        const unsigned int Row = m_pState2Row [State];
+
+        if (0 != Row) {
+            return m_pRows [((Row - 1) * DenseIwCount) + Iw];
+        }
+    }
+
+    return m_pDfa->GetDest (State, Iw);
+}
+
+}
+
+#endif
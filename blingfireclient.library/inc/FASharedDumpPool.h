@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_SHAREDDUMPPOOL_H_
+#define _FA_SHAREDDUMPPOOL_H_
+
+#include "FAConfig.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace BlingFire
+{
+
+///
+/// A pool of immutable, reference-counted memory dumps. The dumps with the
+/// same content are kept once, so the models loaded from different LDB
+/// files share their identical sections (charmaps, lexers, i2w tables).
+///
+/// Usage:
+///
+/// 1. Add (pDump, Size) returns a pointer to the pool's copy of the data,
+///    the data are copied only if there is no such dump in the pool yet.
+/// 2. Release (pDump) is called once for every Add, the memory is freed
+///    when the last reference is released.
+///
+/// Notes:
+///
+/// 1. All the methods are thread-safe.
+/// 2. The dumps are looked up by CRC32 and size and then compared byte by
+///    byte, so the hash collisions do not lead to sharing different data.
+///
+
+class FASharedDumpPool {
+
+public:
+    FASharedDumpPool ();
+    ~FASharedDumpPool ();
+
+public:
+    /// returns the pool's copy of the dump and adds a reference to it
+    const unsigned char * Add (const unsigned char * pDump, const size_t Size);
+    /// releases a reference returned by Add
+    void Release (const unsigned char * pDump);
+    /// returns the number of unique dumps and their total size in bytes
+    void GetStats (size_t * pDumpCount, size_t * pByteCount) const;
+
+private:
+    struct FAEntry {
+        unsigned char * m_pData;
+        size_t m_Size;
+        unsigned int m_Crc;
+        int m_RefCount;
+    };
+
+private:
+    // CRC32 --> entries with this CRC32
+    std::unordered_multimap < unsigned int, FAEntry * > m_crc2entry;
+    // data pointer --> entry
+    std::unordered_map < const unsigned char *, FAEntry * > m_ptr2entry;
+    // total size of the unique dumps
+    size_t m_ByteCount;
+    // guards all of the above
+    mutable std::mutex m_lock;
+};
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_THREADPOOL_H_
+#define _FA_THREADPOOL_H_
+
+#include "FAConfig.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace BlingFire
+{
+
+///
+/// A reusable pool of worker threads with a work-stealing parallel-for.
+///
+/// The index range of each ParallelFor call is split into one slice per
+/// participating thread, a thread which has finished its own slice keeps
+/// taking indices from the other slices until all of them are done. The
+/// calling thread always participates, so the call makes progress even if
+/// all the workers are busy with the jobs of other callers.
+///
+/// Notes:
+///
+/// 1. Worker threads are created on demand and are kept for reuse.
+/// 2. The object is thread-safe, ParallelFor can be called concurrently.
+///
+
+class FAThreadPool {
+
+public:
+    FAThreadPool ();
+    ~FAThreadPool ();
+
+public:
+    /// calls Fn (i) for every i in [0, Count) using upto ThreadCount threads,
+    /// if ThreadCount <= 0 then the number of hardware threads is used;
+    /// returns when all calls are done, re-throws the first exception if any
+    void ParallelFor (
+            const int Count,
+            const int ThreadCount,
+            const std::function < void (const int) > & Fn
+        );
+
+    /// returns the number of hardware threads, at least 1
+    static const int GetHardwareThreadCount ();
+
+private:
+    struct _TSlice {
+        std::atomic < int > m_Next;
+        int m_End;
+    };
+
+    struct _TJob {
+        const std::function < void (const int) > * m_pFn;
+        _TSlice * m_pSlices;
+        int m_SliceCount;
+        // the next slice to give to a helper, guarded by m_Lock
+        int m_NextSlice;
+        // number of helpers still running, guarded by m_Lock
+        int m_Running;
+        // set if any call has failed
+        std::atomic < bool > m_Failed;
+        // the first failure, guarded by m_Lock
+        std::exception_ptr m_Error;
+    };
+
+private:
+    // makes sure at least WorkerCount workers exist, called under m_Lock
+    void EnsureWorkers (const int WorkerCount);
+    // worker thread main loop
+    void WorkerProc ();
+    // processes all slices of the job starting from the FirstSlice
+    static void RunSlices (_TJob * pJob, const int FirstSlice);
+
+private:
+    std::mutex m_Lock;
+    // signaled when a new job is queued or the pool stops
+    std::condition_variable m_Wake;
+    // signaled when a helper finishes its part of a job
+    std::condition_variable m_Done;
+    // jobs which still have unassigned slices
+    std::deque < _TJob * > m_Jobs;
+    std::vector < std::thread > m_Workers;
+    bool m_Stop;
+
+    enum {
+        MaxWorkerCount = 256,
+    };
+};
+
+}
+
+#endif
@@ -11,6 +11,20 @@
 namespace BlingFire
 {
 
+///
+/// Intermediate data of a tokenization algorithm which the caller can keep
+///   between the calls, so the algorithm does not allocate memory every time.
+///
+/// Note: each algorithm derives its own type of the scratch data.
+///
+
+class FATokenSegmentationScratchA {
+
+public:
+    virtual ~FATokenSegmentationScratchA () {}
+};
+
+
 ///
 /// This is a common interface for different tokenization algorithms
 ///   to avoid having a many if/then/else at runtime.
@@ -27,6 +41,19 @@ public:
             const int MaxOutSize,
             const int UnkId
         ) const = 0;
+
+    /// The same as above, but keeps the intermediate data in *ppScratch.
+    /// If *ppScratch is NULL or was created by a different algorithm then
+    /// a new object is created and returned in *ppScratch, the caller owns
+    /// the object and should delete it when it is not needed.
+    virtual const int Process (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            FATokenSegmentationScratchA ** ppScratch
+        ) const = 0;
 };
 
 }
@@ -0,0 +1,417 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+#ifndef _FA_TOKENSEGMENTATIONTOOLS_1BEST_BPE_LOCAL_T_H_
+#define _FA_TOKENSEGMENTATIONTOOLS_1BEST_BPE_LOCAL_T_H_
+
+#include "FAConfig.h"
+#include "FARSDfaCA.h"
+#include "FAMealyDfaCA.h"
+#include "FAArrayCA.h"
+#include "FAMultiMapCA.h"
+#include "FADictConfKeeper.h"
+#include "FALimits.h"
+#include "FASecurity.h"
+#include "FATokenSegmentationToolsCA_t.h"
+#include <algorithm>
+#include <vector>
+
+namespace BlingFire
+{
+
+///
+/// Splits input sequence into segments using BPE algorithm.
+///
+/// This algorithm returns the same segments as the optimized versions of 
+///  FATokenSegmentationTools_1best_bpe_t (TOKENIZE_BPE_OPT_LOCAL) and 
+///  FATokenSegmentationTools_1best_bpe_with_merges_t 
+///  (TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL), but instead of sorting all the 
+///  segments found in the text it splits them into groups of overlapping
+///  segments. A merge can only be blocked by a segment which overlaps it,
+///  so each group is sorted and merged independently, for the text of n
+///  words this takes O(n) sorts of word-size groups instead of one sort 
+///  of all the segments.
+///
+/// Input:  sequence of characters
+/// Output: array of tuples <TokenId, From, To>
+///
+
+template < class Ty >
+class FATokenSegmentationTools_1best_bpe_local_t : public FATokenSegmentationToolsCA_t <Ty> {
+
+public:
+    FATokenSegmentationTools_1best_bpe_local_t ();
+
+public:
+    /// initializes from the valid configuration object
+    void SetConf (const FADictConfKeeper * pConf);
+
+    /// writes an array of tuples <TokenId, From, To> into pOut
+    /// returns the actual / needed size of the array to fit all the tuples or
+    ///  -1 in case of an error
+    const int Process (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId
+        ) const;
+
+    /// the same as above, but keeps the intermediate data in *ppScratch
+    /// between the calls, see FATokenSegmentationToolsCA_t for details
+    const int Process (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            FATokenSegmentationScratchA ** ppScratch
+        ) const;
+
+private:
+    // Mealy DFA keeping a map from a known segment to idx and
+    // and MultiMap keeping a realtion between idx and <ID, Score> pair
+    const FARSDfaCA * m_pDfa;
+    const FAMealyDfaCA * m_pMealy;
+    const FAArrayCA * m_pK2I;     // note this is an identify since we don't have duplicate ID's
+    const FAMultiMapCA * m_pI2Info;
+    // true if the merge ranks are stored after the IDs, otherwise the IDs are the ranks
+    bool m_fUseRanks;
+
+    // to keep track of arc data
+    struct _TArc {
+
+        int _Start;   // the begging position of the segment
+        int _End;     // the ending position of the segment
+        int _Id;      // ID of a segment from the vocab
+        float _Rank;  // merge order/rank, 0 if the ID is the rank
+
+    public:
+        _TArc ():
+            _Start(0),
+            _End(0),
+            _Id(0),
+            _Rank(0.0f)
+        {}
+
+        _TArc (int b, int e, int id, float rank):
+            _Start(b),
+            _End(e),
+            _Id(id),
+            _Rank(rank)
+        {}
+
+    };
+
+    // returns true if the arc A is merged before the arc B, the order is
+    // the same as the one used by the sorting based algorithms
+    struct _TArcBefore {
+
+        inline const bool operator () (const _TArc & A, const _TArc & B) const
+        {
+            // bigger ranks first, since we made them negative in the pos-dict
+            if (A._Rank != B._Rank) {
+                return A._Rank > B._Rank;
+            }
+            // smaller ids first
+            if (A._Id != B._Id) {
+                return A._Id < B._Id;
+            }
+            // if ids are the same left-most first
+            return A._Start < B._Start;
+        }
+    };
+
+    // intermediate data of the Process method
+    struct _TScratch : public FATokenSegmentationScratchA {
+        std::vector <_TArc> m_Arcs;
+        std::vector <int> m_TosIds;
+    };
+
+    // does the processing using the given intermediate data
+    const int Process_int (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            _TScratch * pScratch
+        ) const;
+
+};
+
+
+template < class Ty >
+FATokenSegmentationTools_1best_bpe_local_t < Ty >::
+    FATokenSegmentationTools_1best_bpe_local_t () :
+        m_pDfa (NULL),
+        m_pMealy (NULL),
+        m_pK2I (NULL),
+        m_pI2Info (NULL),
+        m_fUseRanks (false)
+{}
+
+
+template < class Ty >
+void FATokenSegmentationTools_1best_bpe_local_t < Ty >::
+    SetConf (const FADictConfKeeper * pConf)
+{
+    LogAssert (pConf);
+    LogAssert(FAFsmConst::TYPE_MEALY_DFA == pConf->GetFsmType());
+
+    const int TokAlgo = pConf->GetTokAlgo ();
+    LogAssert (FAFsmConst::TOKENIZE_BPE_OPT_LOCAL == TokAlgo || \
+        FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL == TokAlgo);
+
+    m_fUseRanks = FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL == TokAlgo;
+
+    m_pDfa = pConf->GetRsDfa ();
+    m_pMealy = pConf->GetMphMealy ();
+    m_pK2I = pConf->GetK2I ();
+    m_pI2Info = pConf->GetI2Info ();
+
+    LogAssert(0 < m_pK2I->GetCount ());
+}
+
+// SENTENCE PIECE DELIMITER
+#define __FASpDelimiter__ 0x2581
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_bpe_local_t < Ty >::
+    Process (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId
+    ) const
+{
+    _TScratch Scratch;
+    return Process_int (pIn, InSize, pOut, MaxOutSize, UnkId, &Scratch);
+}
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_bpe_local_t < Ty >::
+    Process (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        FATokenSegmentationScratchA ** ppScratch
+    ) const
+{
+    LogAssert (ppScratch);
+
+    // reuse the scratch data if it was created by this type of algorithm
+    _TScratch * pScratch = dynamic_cast < _TScratch * > (*ppScratch);
+
+    if (NULL == pScratch) {
+        delete *ppScratch;
+        *ppScratch = NULL;
+        pScratch = NEW _TScratch;
+        LogAssert (pScratch);
+        *ppScratch = pScratch;
+    }
+
+    return Process_int (pIn, InSize, pOut, MaxOutSize, UnkId, pScratch);
+}
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_bpe_local_t < Ty >::
+    Process_int (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        _TScratch * pScratch
+    ) const
+{
+    DebugLogAssert (m_pDfa && m_pMealy && m_pK2I && m_pI2Info);
+
+    if (0 >= InSize) {
+        return 0;
+    }
+
+    LogAssert (pIn && InSize <= FALimits::MaxArrSize);
+
+    // reset storage for all segments found in the text
+    std::vector <_TArc> & arcs = pScratch->m_Arcs;
+    arcs.clear();
+    arcs.reserve(InSize);
+
+    // get the initial state
+    const int InitialState = m_pDfa->GetInitial ();
+
+    // populate the arcs, the arcs of each start position are kept together
+    for (int start = 0; start < InSize; ++start) {
+
+        int State = InitialState;
+        int SumOw = 0;
+        int Ow = 0;
+        bool TokenUnknown = true;
+
+        const bool fTokenStart = __FASpDelimiter__ == pIn [start];
+        const size_t ArcCountAtStart = arcs.size ();
+        int startFastForward = start;
+
+        // go as deep as we can from the start position
+        for (int i = start; i < InSize; ++i) {
+
+            const Ty Iw = pIn [i];
+            State = m_pMealy->GetDestOw (State, Iw, &Ow);
+
+            // see if the does not have a transition
+            if (-1 == State) {
+                break;
+            }
+
+            SumOw += Ow;
+            DebugLogAssert (0 <= Ow);
+
+            // see if the destination state is a final state
+            if (m_pDfa->IsFinal (State)) {
+
+                // look up the id of the segment
+                const int * pValues = NULL;
+                const int Count = m_pI2Info->Get (SumOw, &pValues);
+                LogAssert (1 <= Count && NULL != pValues);
+
+                // get the ID and the rank
+                const int id = pValues [0];
+                const float rank = m_fUseRanks ? *(float*)(pValues + 1) : 0.0f;
+
+                // see if the optimization should be applied
+                const bool fApplyOpt = fTokenStart && \
+                        ((i < InSize - 1) ? __FASpDelimiter__ == pIn [i + 1] : true) && \
+                        ArcCountAtStart < arcs.size ();
+
+                if (!fApplyOpt)
+                {
+                    // add the arc
+                    arcs.push_back(_TArc(start, i, id, rank));
+
+                } else {
+
+                    // remove all intermediate arcs, if the whole token arc is found
+                    //  Note: this does not prevent to have arcs *larger* than one token
+                    arcs [ArcCountAtStart] = _TArc(start, i, id, rank); 
+                    arcs.resize (ArcCountAtStart + 1); // resize deletes elements from the end
+                    startFastForward = i;
+                }
+
+                // the token is not an unknown
+                TokenUnknown = false;
+            }
+
+        } // of for(int i = start; i < InSize; ++start) ...
+
+        if (TokenUnknown) {
+            // if we are here then nothing matched from the start
+
+            // check if the prevous arc is also unknown
+            const int ArcCount = (int) arcs.size();
+            if (0 < ArcCount && UnkId == arcs [ArcCount - 1]._Id) {
+                // modify previous arc (make unknown segment longer)
+                arcs [ArcCount - 1]._End = start;
+            } else {
+                // add a new unknown arc
+                arcs.push_back(_TArc(start, start, UnkId, 0.0f));
+            }
+        }
+
+        start = startFastForward; // and +1 will be added by the for loop
+
+    } // for(int start = 0; start < InSize; ++start) ...
+
+    _TArc * pArcs = arcs.data();
+    const int ArcCount = (int) arcs.size();
+
+    // keep track of the from --> to, from --> id and intermediate positions
+    std::vector <int> & tos_ids = pScratch->m_TosIds;
+    tos_ids.assign (InSize * 3, 0);
+
+    // all 0's
+    int * pTos = tos_ids.data ();
+
+    // all UnkId's
+    int * pIds = pTos + InSize;
+    for(int i = 0; i < InSize; ++i) {
+        pIds [i] = UnkId;
+    }
+
+    // point to the third array of ints and cast it to the array of bytes
+    // Note: all of the values are set to 0
+    unsigned char * pIntermediate = (unsigned char *)(pTos + (InSize * 2));
+
+    // find the groups of overlapping arcs, the arcs are sorted by the start
+    for (int b = 0; b < ArcCount;) {
+
+        int MaxEnd = pArcs [b]._End;
+        int e = b + 1;
+
+        while (e < ArcCount && pArcs [e]._Start <= MaxEnd) {
+            if (MaxEnd < pArcs [e]._End) {
+                MaxEnd = pArcs [e]._End;
+            }
+            e++;
+        }
+
+        // sort the arcs of the group
+        if (1 < e - b) {
+            std::sort (pArcs + b, pArcs + e, _TArcBefore ());
+        }
+
+        // go over the arcs of the group in order
+        for (int i = b; i < e; ++i) {
+
+            const _TArc * pA = pArcs + i;
+            const int Start = pA->_Start;
+            const int End = pA->_End;
+
+            // see start/end are avaible for the merge
+            if(0 == pIntermediate [Start] && 
+               (End + 1 == InSize || 0 == pIntermediate [End + 1])) {
+
+                pTos [Start] = End;
+                pIds [Start] = pA->_Id;
+
+                const int IntermediateCount = End - Start;
+                if (0 < IntermediateCount) {
+                    memset (pIntermediate + Start + 1, 1, IntermediateCount);
+                }
+            }
+        }
+
+        b = e;
+    }
+
+    // copy the results
+    int ActualOutSize = 0;
+    for (int start = 0; start < InSize; start++) {
+
+        const int end = pTos [start];
+        const int id = pIds [start];
+
+        if (ActualOutSize + 3 <= MaxOutSize) {
+            pOut [ActualOutSize] = id;
+            pOut [ActualOutSize + 1] = start;
+            pOut [ActualOutSize + 2] = end;
+        }
+        ActualOutSize += 3;
+
+        start = end; // and +1 will be added by the for loop
+    }
+
+    return ActualOutSize;
+}
+
+}
+
+#endif
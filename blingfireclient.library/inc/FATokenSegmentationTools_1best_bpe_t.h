@@ -54,6 +54,17 @@ public:
             const int UnkId
         ) const;
 
+    /// the same as above, but keeps the intermediate data in *ppScratch
+    /// between the calls, see FATokenSegmentationToolsCA_t for details
+    const int Process (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            FATokenSegmentationScratchA ** ppScratch
+        ) const;
+
 private:
     // Mealy DFA keeping a map from a known segment to idx and
     // and MultiMap keeping a realtion between idx and <ID, Score> pair
@@ -85,6 +96,22 @@ private:
 
     };
 
+    // intermediate data of the Process method
+    struct _TScratch : public FATokenSegmentationScratchA {
+        std::vector <_TArc> m_Arcs;
+        std::vector <int> m_TosIds;
+    };
+
+    // does the processing using the given intermediate data
+    const int Process_int (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            _TScratch * pScratch
+        ) const;
+
 };
 
 
@@ -131,6 +158,50 @@ const int FATokenSegmentationTools_1best_bpe_t < Ty >::
         const int MaxOutSize,
         const int UnkId
     ) const
+{
+    _TScratch Scratch;
+    return Process_int (pIn, InSize, pOut, MaxOutSize, UnkId, &Scratch);
+}
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_bpe_t < Ty >::
+    Process (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        FATokenSegmentationScratchA ** ppScratch
+    ) const
+{
+    LogAssert (ppScratch);
+
+    // reuse the scratch data if it was created by this type of algorithm
+    _TScratch * pScratch = dynamic_cast < _TScratch * > (*ppScratch);
+
+    if (NULL == pScratch) {
+        delete *ppScratch;
+        *ppScratch = NULL;
+        pScratch = NEW _TScratch;
+        LogAssert (pScratch);
+        *ppScratch = pScratch;
+    }
+
+    return Process_int (pIn, InSize, pOut, MaxOutSize, UnkId, pScratch);
+}
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_bpe_t < Ty >::
+    Process_int (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        _TScratch * pScratch
+    ) const
 {
     DebugLogAssert (m_pDfa && m_pMealy && m_pK2I && m_pI2Info);
 
@@ -140,8 +211,9 @@ const int FATokenSegmentationTools_1best_bpe_t < Ty >::
 
     LogAssert (pIn && InSize <= FALimits::MaxArrSize);
 
-    // allocate storage for all segments found in the text
-    std::vector <_TArc> arcs;
+    // reset storage for all segments found in the text
+    std::vector <_TArc> & arcs = pScratch->m_Arcs;
+    arcs.clear();
     arcs.reserve(InSize);
 
     // get the initial state
@@ -255,7 +327,8 @@ const int FATokenSegmentationTools_1best_bpe_t < Ty >::
     });
 
     // keep track of the from --> to, from --> id and intermediate positions
-    std::vector <int> tos_ids (InSize * 3, 0);
+    std::vector <int> & tos_ids = pScratch->m_TosIds;
+    tos_ids.assign (InSize * 3, 0);
 
     // all 0's
     int * pTos = tos_ids.data ();
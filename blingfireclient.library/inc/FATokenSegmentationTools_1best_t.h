@@ -53,6 +53,17 @@ public:
             const int UnkId
         ) const;
 
+    /// the same as above, but keeps the intermediate data in *ppScratch
+    /// between the calls, see FATokenSegmentationToolsCA_t for details
+    const int Process (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            FATokenSegmentationScratchA ** ppScratch
+        ) const;
+
 private:
     // Mealy DFA keeping a map from a known segment to idx and
     // and MultiMap keeping a realtion between idx and <ID, Score> pair
@@ -84,6 +95,21 @@ private:
 
     // a helper method to add an arc if a token is not known
     inline void AddUnknownArc (_TArc * pArcs, int start) const;
+
+    // intermediate data of the Process method
+    struct _TScratch : public FATokenSegmentationScratchA {
+        std::vector <_TArc> m_End2BestArc;
+    };
+
+    // does the processing using the given intermediate data
+    const int Process_int (
+            const Ty * pIn,
+            const int InSize,
+            __out_ecount(MaxOutSize) int * pOut,
+            const int MaxOutSize,
+            const int UnkId,
+            _TScratch * pScratch
+        ) const;
 };
 
 
@@ -180,6 +206,50 @@ const int FATokenSegmentationTools_1best_t < Ty >::
         const int MaxOutSize,
         const int UnkId
     ) const
+{
+    _TScratch Scratch;
+    return Process_int (pIn, InSize, pOut, MaxOutSize, UnkId, &Scratch);
+}
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_t < Ty >::
+    Process (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        FATokenSegmentationScratchA ** ppScratch
+    ) const
+{
+    LogAssert (ppScratch);
+
+    // reuse the scratch data if it was created by this type of algorithm
+    _TScratch * pScratch = dynamic_cast < _TScratch * > (*ppScratch);
+
+    if (NULL == pScratch) {
+        delete *ppScratch;
+        *ppScratch = NULL;
+        pScratch = NEW _TScratch;
+        LogAssert (pScratch);
+        *ppScratch = pScratch;
+    }
+
+    return Process_int (pIn, InSize, pOut, MaxOutSize, UnkId, pScratch);
+}
+
+
+template < class Ty >
+const int FATokenSegmentationTools_1best_t < Ty >::
+    Process_int (
+        const Ty * pIn, 
+        const int InSize, 
+        __out_ecount(MaxOutSize) int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        _TScratch * pScratch
+    ) const
 {
     DebugLogAssert (m_pDfa && m_pMealy && m_pK2I && m_pI2Info);
 
@@ -189,8 +259,9 @@ const int FATokenSegmentationTools_1best_t < Ty >::
 
     LogAssert (pIn && InSize <= FALimits::MaxArrSize);
 
-    // allocate storage for best arcs for each ending position
-    std::vector <_TArc> End2BestArc (InSize);
+    // reset storage for best arcs for each ending position
+    std::vector <_TArc> & End2BestArc = pScratch->m_End2BestArc;
+    End2BestArc.assign (InSize, _TArc ());
     DebugLogAssert(InSize == End2BestArc.size ());
     _TArc * pArcs = End2BestArc.data ();
 
@@ -55,6 +55,8 @@ const int FAStrUtf8ToArray (
 /// Converts UTF8 string of specified length to the array of ints.
 /// Returns the number of used elements in the array.
 /// Returns -1 if the input sequence is invalid.
+/// Note: runs of ASCII characters are converted with SIMD instructions, if
+///  available, elements past the returned count may be overwritten.
 const int FAStrUtf8ToArray (
         const char * pStr, 
         const int Len, 
@@ -66,6 +68,7 @@ const int FAStrUtf8ToArray (
 /// for each UTF-32 character returns its offset in the pStr.
 /// Returns the number of used elements in the array.
 /// Returns -1 if the input sequence is invalid.
+/// Note: elements past the returned count may be overwritten.
 const int FAStrUtf8ToArray (
         const char * pStr,
         const int Len,
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_WORDCACHE_H_
+#define _FA_WORDCACHE_H_
+
+#include "FAConfig.h"
+#include "FASecurity.h"
+
+#include <atomic>
+#include <vector>
+
+namespace BlingFire
+{
+
+///
+/// A bounded cache of the tokenization results of the words. The key is
+/// the word (a sequence of ints) and a tag (any int which affects the
+/// results, e.g. the id of the unknown token), the value is a sequence of
+/// the <id, from, to> triplets with the positions relative to the word.
+///
+/// The cache is split into small sets of entries, a word can only be kept
+/// in the set selected by its hash. Each set is guarded by a sequence lock:
+///
+/// 1. Get never blocks, it reads the entry and then checks that the set was
+///    not modified meanwhile, if it was then Get reports a miss.
+/// 2. Put takes the set only if no other thread has it, otherwise the word
+///    is not added. The entry to replace is selected by the "clock"
+///    algorithm (an approximation of LRU) within the set.
+///
+/// Notes:
+///
+/// 1. Get, Put, Reset, AddCounts and GetCounts can be called concurrently.
+/// 2. Create and Clear should not be called concurrently with the other
+///    methods.
+/// 3. Words longer than MaxWordLength are not cached.
+///
+
+class FAWordCache {
+
+public:
+    FAWordCache ();
+
+public:
+    /// allocates the cache of upto MaxMemory bytes, returns the number of
+    /// words it can keep, if it is 0 then the cache is not allocated
+    const int Create (const size_t MaxMemory);
+    /// returns the memory used by the cache in bytes
+    const size_t GetMemorySize () const;
+    /// returns true if the cache is allocated
+    const bool IsEnabled () const;
+    /// frees the memory, returns object into the initial state
+    void Clear ();
+    /// removes all the words and resets the counters, keeps the memory
+    void Reset ();
+
+public:
+    /// copies the results for the word into the pOut, returns the number
+    /// of ints copied (3 per token) or -1 if the word is not in the cache
+    const int Get (
+            const int * pWord,
+            const int WordLen,
+            const int Tag,
+            __out_ecount (MaxOutSize) int * pOut,
+            const int MaxOutSize
+        );
+    /// adds the results for the word, the pRes is an array of ResSize / 3
+    /// <id, from, to> triplets, the words which do not fit are ignored
+    void Put (
+            const int * pWord,
+            const int WordLen,
+            const int Tag,
+            const int * pRes,
+            const int ResSize
+        );
+    /// adds the hits and misses to the counters
+    void AddCounts (const int HitCount, const int MissCount);
+    /// returns the counters
+    void GetCounts (long long * pHitCount, long long * pMissCount) const;
+
+public:
+    enum {
+        // the longest word to be cached
+        MaxWordLength = 24,
+        // number of entries in a set
+        WayCount = 8,
+        // entry layout: word length, tag, token count, word, tokens
+        EntryWordLen = 0,
+        EntryTag = 1,
+        EntryTokenCount = 2,
+        EntryWord = 3,
+        // each token takes two ints: the id and the packed from / to offsets
+        EntryTokens = EntryWord + MaxWordLength,
+        EntrySize = EntryTokens + (2 * MaxWordLength),
+        // set layout: sequence number, clock hand, reference bits, hashes
+        // of the words (so a lookup reads one entry at most), entries
+        SetSeq = 0,
+        SetHand = 1,
+        SetRefs = 2,
+        SetHashes = SetRefs + WayCount,
+        SetEntries = SetHashes + WayCount,
+        SetSize = SetEntries + (WayCount * EntrySize),
+        // the maximum number of sets
+        MaxSetCount = 0x100000,
+    };
+
+private:
+    // returns the hash value of the word and the tag
+    static const unsigned int GetHash (
+            const int * pWord,
+            const int WordLen,
+            const int Tag
+        );
+    // returns the set of the word with the Hash
+    inline const unsigned int GetSet (const unsigned int Hash) const;
+
+private:
+    // the sets, all values are accessed atomically
+    std::vector < std::atomic < int > > m_Data;
+    // number of sets
+    unsigned int m_SetCount;
+    // counters
+    std::atomic < long long > m_HitCount;
+    std::atomic < long long > m_MissCount;
+};
+
+
+inline const unsigned int FAWordCache::GetSet (const unsigned int Hash) const
+{
+    // maps the Hash into [0, m_SetCount) without a division
+    return (unsigned int) (((unsigned long long) Hash * m_SetCount) >> 32);
+}
+
+}
+
+#endif
@@ -18,6 +18,10 @@ namespace BlingFire
 /// Word -> TAG/PROB guesser; for the given word returns an array of 
 /// possible tags and an array of tag probabilities given the word, i.e. P(T|W)
 ///
+/// Note: the Process methods returning pointers use the object's own output
+/// buffers and are not thread-safe, the const Process method writes into the
+/// caller's buffers and can be called concurrently on a shared object.
+///
 
 template < class Ty >
 class FAWordGuesser_prob_t : public FAWordGuesser_t < Ty > {
@@ -58,6 +62,7 @@ public:
     /// b) ignore the output, or c) LogAssert.
     /// The maximum necessary size for the pTags/pProbs is:
     ///   pConf->GetState2Ows()->GetMaxOwsCount();
+    /// This method is reentrant.
     const int Process (
             const Ty * pWordStr,   // input word
             const int WordLen,     // inpur word length
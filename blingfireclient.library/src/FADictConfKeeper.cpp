@@ -24,6 +24,7 @@ FADictConfKeeper::FADictConfKeeper () :
     m_pLDB (NULL),
     m_FsmType (FAFsmConst::TYPE_MEALY_DFA),
     m_pRsDfa (NULL),
+    m_hasIws (false),
     m_pMealy (NULL),
     m_pState2Ow (NULL),
     m_pK2I (NULL),
@@ -143,6 +144,13 @@ void FADictConfKeeper::Init (const int * pValues, const int Size)
             }
             m_pRsDfa->SetImage (pDump);
 
+            // the Iws of a state are only available if they are not remapped,
+            // the 0x80000000 bit of the alphabet size indicates the remapping
+            if (0 == (0x80000000 & ((const unsigned int *) pDump) [2])) {
+                m_Iws.SetImage (pDump);
+                m_hasIws = true;
+            }
+
             if (FAFsmConst::TYPE_MEALY_DFA == m_FsmType) {
 
                 if (!m_pMealy) {
@@ -234,6 +242,7 @@ void FADictConfKeeper::Clear ()
         delete m_pRsDfa;
         m_pRsDfa = NULL;
     }
+    m_hasIws = false;
     if (m_pMealy) {
         delete m_pMealy;
         m_pMealy = NULL;
@@ -287,6 +296,12 @@ const FARSDfaCA * FADictConfKeeper::GetRsDfa () const
 }
 
 
+const FAGetIWsCA * FADictConfKeeper::GetIws () const
+{
+    return m_hasIws ? &m_Iws : NULL;
+}
+
+
 const FAMealyDfaCA * FADictConfKeeper::GetMphMealy () const
 {
     return m_pMealy;
@@ -363,4 +378,11 @@ void FADictConfKeeper::SetNoDummyPrefix(bool fNoDummyPrefix)
     m_fNoDummyPrefix = fNoDummyPrefix;
 }
 
+void FADictConfKeeper::SetTokAlgo(const int TokAlgo)
+{
+    LogAssert (FAFsmConst::TOKENIZE_DEFAULT <= TokAlgo && \
+            FAFsmConst::TOKENIZE_COUNT > TokAlgo);
+    m_TokAlgo = TokAlgo;
+}
+
 }
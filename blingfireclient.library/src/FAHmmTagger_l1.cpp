@@ -8,36 +8,52 @@
 #include "FAConfig.h"
 #include "FAHmmTagger_l1.h"
 #include "FAFsmConst.h"
+#include "FAAllocator.h"
+#include "FAThreadPool.h"
 
 namespace BlingFire
 {
 
-FAHmmTagger_l1::FAHmmTagger_l1 ():
-    m_fInitialized (false),
-    m_pW2TP (NULL),
-    m_pPT (NULL),
-    m_pPTT (NULL),
-    m_MaxTags (0),
-    m_EosTag (0),
+FAHmmTagger_l1::FAContext::FAContext () :
     m_WordCount (0)
 {
 }
 
 
-void FAHmmTagger_l1::Clear ()
+void FAHmmTagger_l1::FAContext::SetAllocator (FAAllocatorA * pMemMgr)
+{
+    m_tags.SetAllocator (pMemMgr);
+    m_probs.SetAllocator (pMemMgr);
+    m_counts.SetAllocator (pMemMgr);
+    m_prev_best_idx.SetAllocator (pMemMgr);
+}
+
+
+void FAHmmTagger_l1::FAContext::Clear ()
 {
-    // initialize the arrays
     m_tags.Clear ();
     m_probs.Clear ();
     m_counts.Clear ();
     m_prev_best_idx.Clear ();
 
-    // add the beginning of the sequence word (BOS)
-    m_tags.push_back (m_EosTag);
-    m_probs.push_back (0);
-    m_counts.push_back (1);
+    m_WordCount = 0;
+}
+
+
+FAHmmTagger_l1::FAHmmTagger_l1 ():
+    m_fInitialized (false),
+    m_pW2TP (NULL),
+    m_pPT (NULL),
+    m_pPTT (NULL),
+    m_MaxTags (0),
+    m_EosTag (0)
+{
+}
+
 
-    m_WordCount = 1;
+void FAHmmTagger_l1::Clear ()
+{
+    m_ctx.Clear ();
 }
 
 
@@ -62,72 +78,98 @@ void FAHmmTagger_l1::
     LogAssert (TAGS_PROBS_DELTA >= m_MaxTags);
 
     // initialize the arrays
-    m_tags.SetAllocator (pMemMgr);
-    m_tags.Clear ();
-    m_probs.SetAllocator(pMemMgr);
-    m_probs.Clear();
-    m_counts.SetAllocator(pMemMgr);
-    m_counts.Clear();
-    m_prev_best_idx.SetAllocator(pMemMgr);
-    m_prev_best_idx.Clear();
-
-    // add the beginning of the sequence word (BOS)
-    m_tags.push_back (EosTag);
-    m_probs.push_back (0);
-    m_counts.push_back (1);
-    
-    m_WordCount = 1;
+    m_ctx.Clear ();
+    m_ctx.SetAllocator (pMemMgr);
 
     m_fInitialized = true;
 }
 
 
+inline void FAHmmTagger_l1::AddBosWord (FAContext * pCtx) const
+{
+    DebugLogAssert (pCtx);
+
+    if (0 == pCtx->m_WordCount) {
+
+        DebugLogAssert (pCtx->m_tags.empty () && pCtx->m_counts.empty ());
+
+        // add the beginning of the sequence word (BOS)
+        pCtx->m_tags.resize (1);
+        pCtx->m_tags [0] = m_EosTag;
+        pCtx->m_probs.resize (1);
+        pCtx->m_probs [0] = 0;
+        pCtx->m_counts.resize (1);
+        pCtx->m_counts [0] = 1;
+
+        pCtx->m_WordCount = 1;
+    }
+}
+
+
 void FAHmmTagger_l1::AddWord (const int * pWord, const int WordLen)
 {
-    LogAssert (m_fInitialized);
+    FAHmmTagger_l1::AddWord (&m_ctx, pWord, WordLen);
+}
+
+
+const int FAHmmTagger_l1::Process (int * pOut, const int MaxOutSize)
+{
+    return FAHmmTagger_l1::Process (&m_ctx, pOut, MaxOutSize);
+}
 
-    DebugLogAssert (m_tags.size () == m_probs.size());
-    DebugLogAssert (0 < m_WordCount);
-    DebugLogAssert (m_WordCount <= m_tags.size());
-    DebugLogAssert (m_WordCount <= m_counts.size());
+
+void FAHmmTagger_l1::AddWord (
+        FAContext * pCtx,
+        const int * pWord,
+        const int WordLen
+    ) const
+{
+    LogAssert (m_fInitialized && pCtx);
+
+    AddBosWord (pCtx);
+
+    DebugLogAssert (pCtx->m_tags.size () == pCtx->m_probs.size());
+    DebugLogAssert (0 < pCtx->m_WordCount);
+    DebugLogAssert (pCtx->m_WordCount <= pCtx->m_tags.size());
+    DebugLogAssert (pCtx->m_WordCount <= pCtx->m_counts.size());
 
     // invalid parameters
     LogAssert (NULL != pWord || 0 == WordLen);
 
-    int * pAllCounts = m_counts.begin ();
+    int * pAllCounts = pCtx->m_counts.begin ();
     DebugLogAssert (pAllCounts);
 
     // get current amount of tags so far
-    const int TotalTagCount = pAllCounts [m_WordCount - 1];
+    const int TotalTagCount = pAllCounts [pCtx->m_WordCount - 1];
 
     // get output pointers
-    int * pCount = pAllCounts + m_WordCount;
-    int * pTags = m_tags.begin () + TotalTagCount;
-    float * pProbs = m_probs.begin () + TotalTagCount;
+    int * pCount = pAllCounts + pCtx->m_WordCount;
+    int * pTags = pCtx->m_tags.begin () + TotalTagCount;
+    float * pProbs = pCtx->m_probs.begin () + TotalTagCount;
 
-    const int UnusedElements = m_tags.size () - TotalTagCount;
+    const int UnusedElements = pCtx->m_tags.size () - TotalTagCount;
 
-    // see how much space is left in the m_tags and m_probs
+    // see how much space is left in the pCtx->m_tags and pCtx->m_probs
     if (m_MaxTags > UnusedElements)
     {
         // allocate TAGS_PROBS_DELTA more elements
-        const int MtagsOldSize = m_tags.size ();
-        m_tags.resize (MtagsOldSize + TAGS_PROBS_DELTA);
-        pTags = m_tags.begin () + MtagsOldSize;
-        const int MprobsOldSize = m_probs.size ();
-        m_probs.resize(MprobsOldSize + TAGS_PROBS_DELTA);
-        pProbs = m_probs.begin () + MprobsOldSize;
+        const int MtagsOldSize = pCtx->m_tags.size ();
+        pCtx->m_tags.resize (MtagsOldSize + TAGS_PROBS_DELTA);
+        pTags = pCtx->m_tags.begin () + MtagsOldSize;
+        const int MprobsOldSize = pCtx->m_probs.size ();
+        pCtx->m_probs.resize(MprobsOldSize + TAGS_PROBS_DELTA);
+        pProbs = pCtx->m_probs.begin () + MprobsOldSize;
         LogAssert (pTags && pProbs);
         // adjust the pointers to point to the next available element
         pTags -= UnusedElements;
         pProbs -= UnusedElements;
     }
-    // see how much space is left in the m_counts
-    if (0 >= m_counts.size () - m_WordCount)
+    // see how much space is left in the pCtx->m_counts
+    if (0 >= pCtx->m_counts.size () - pCtx->m_WordCount)
     {
-        const int McountsOldSize = m_counts.size ();
-        m_counts.resize (McountsOldSize + WORD_COUNT_DELTA);
-        pCount = m_counts.begin () + McountsOldSize;
+        const int McountsOldSize = pCtx->m_counts.size ();
+        pCtx->m_counts.resize (McountsOldSize + WORD_COUNT_DELTA);
+        pCount = pCtx->m_counts.begin () + McountsOldSize;
         LogAssert (pCount);
     }
 
@@ -149,45 +191,46 @@ void FAHmmTagger_l1::AddWord (const int * pWord, const int WordLen)
     *pCount = TagCount + TotalTagCount;
 
     // increment the word count
-    m_WordCount++;
+    pCtx->m_WordCount++;
 }
 
 
-void FAHmmTagger_l1::AddEosWord ()
+void FAHmmTagger_l1::AddEosWord (FAContext * pCtx) const
 {
-    DebugLogAssert (m_tags.size () == m_probs.size ());
-    DebugLogAssert (0 < m_WordCount);
-    DebugLogAssert (m_WordCount <= m_tags.size ());
-    DebugLogAssert (m_WordCount <= m_counts.size ());
+    DebugLogAssert (pCtx);
+    DebugLogAssert (pCtx->m_tags.size () == pCtx->m_probs.size ());
+    DebugLogAssert (0 < pCtx->m_WordCount);
+    DebugLogAssert (pCtx->m_WordCount <= pCtx->m_tags.size ());
+    DebugLogAssert (pCtx->m_WordCount <= pCtx->m_counts.size ());
 
-    int * pAllCounts = m_counts.begin ();
+    int * pAllCounts = pCtx->m_counts.begin ();
     DebugLogAssert (pAllCounts);
 
     // get current amount of tags so far
-    const int TotalTagCount = pAllCounts [m_WordCount - 1];
+    const int TotalTagCount = pAllCounts [pCtx->m_WordCount - 1];
 
     // get output pointers
-    int * pCount = pAllCounts + m_WordCount;
-    int * pTags = m_tags.begin () + TotalTagCount;
-    float * pProbs = m_probs.begin () + TotalTagCount;
+    int * pCount = pAllCounts + pCtx->m_WordCount;
+    int * pTags = pCtx->m_tags.begin () + TotalTagCount;
+    float * pProbs = pCtx->m_probs.begin () + TotalTagCount;
 
-    // see how much space is left in the m_tags and m_probs
-    if (0 >= m_tags.size () - TotalTagCount)
+    // see how much space is left in the pCtx->m_tags and pCtx->m_probs
+    if (0 >= pCtx->m_tags.size () - TotalTagCount)
     {
-        const int MtagsOldSize = m_tags.size ();
-        m_tags.resize (MtagsOldSize + 1);
-        pTags = m_tags.begin () + MtagsOldSize;
-        const int MprobsOldSize = m_probs.size ();
-        m_probs.resize (MprobsOldSize + 1);
-        pProbs = m_probs.begin () + MprobsOldSize;
+        const int MtagsOldSize = pCtx->m_tags.size ();
+        pCtx->m_tags.resize (MtagsOldSize + 1);
+        pTags = pCtx->m_tags.begin () + MtagsOldSize;
+        const int MprobsOldSize = pCtx->m_probs.size ();
+        pCtx->m_probs.resize (MprobsOldSize + 1);
+        pProbs = pCtx->m_probs.begin () + MprobsOldSize;
         LogAssert (pTags && pProbs);
     }
-    // see how much space is left in the m_counts
-    if (0 >= m_counts.size () - m_WordCount)
+    // see how much space is left in the pCtx->m_counts
+    if (0 >= pCtx->m_counts.size () - pCtx->m_WordCount)
     {
-        const int McountsOldSize = m_counts.size ();
-        m_counts.resize (McountsOldSize + 1);
-        pCount = m_counts.begin () + McountsOldSize;
+        const int McountsOldSize = pCtx->m_counts.size ();
+        pCtx->m_counts.resize (McountsOldSize + 1);
+        pCount = pCtx->m_counts.begin () + McountsOldSize;
         LogAssert (pCount);
     }
 
@@ -197,47 +240,50 @@ void FAHmmTagger_l1::AddEosWord ()
     *pCount = 1 + TotalTagCount;
 
     // increment the word count
-    m_WordCount++;
+    pCtx->m_WordCount++;
 }
 
 
-const int FAHmmTagger_l1::Process (int * pOut, const int MaxOutSize)
+const int FAHmmTagger_l1::Process (
+        FAContext * pCtx,
+        int * pOut,
+        const int MaxOutSize
+    ) const
 {
-    LogAssert (m_fInitialized);
+    LogAssert (m_fInitialized && pCtx);
 
     // see if the sentence is empty
-    if (1 >= m_WordCount)
+    if (1 >= pCtx->m_WordCount)
     {
         return 0;
     }
 
     // add the end of the sequence: EOS
-    AddEosWord ();
+    AddEosWord (pCtx);
 
     // the output sequence size
-    const int OutSize = m_WordCount - 2;
+    const int OutSize = pCtx->m_WordCount - 2;
 
-    // the output buffer should be at least m_WordCount long
+    // the output buffer should be at least pCtx->m_WordCount long
     LogAssert (MaxOutSize >= OutSize && pOut);
 
     // get tags of all words
-    const int * pTags = m_tags.begin ();
+    const int * pTags = pCtx->m_tags.begin ();
     DebugLogAssert (pTags);
 
     // all word idx --> cumulative count mapping
-    const int * pCounts = m_counts.begin ();
+    const int * pCounts = pCtx->m_counts.begin ();
     DebugLogAssert (pCounts);
 
     // get probabilities of all words, this will become an array of costs
     // during the forward iteration step of the algorithm
-    float * pProbs = m_probs.begin ();
+    float * pProbs = pCtx->m_probs.begin ();
     DebugLogAssert (pProbs);
 
     /// allocate array to keep back references
-    const int TotalTagCount = pCounts [m_WordCount - 1];
-    const int MprevOldSize = m_prev_best_idx.size ();
-    m_prev_best_idx.resize (MprevOldSize + TotalTagCount);
-    int * pBackRefIdxs = m_prev_best_idx.begin () + MprevOldSize;
+    const int TotalTagCount = pCounts [pCtx->m_WordCount - 1];
+    pCtx->m_prev_best_idx.resize (TotalTagCount);
+    int * pBackRefIdxs = pCtx->m_prev_best_idx.begin ();
     LogAssert (pBackRefIdxs);
     *pBackRefIdxs = -1;
 
@@ -252,7 +298,7 @@ const int FAHmmTagger_l1::Process (int * pOut, const int MaxOutSize)
     ///
     /// forward iteration step
     ///
-    for (int i = 1; i < m_WordCount; ++i)
+    for (int i = 1; i < pCtx->m_WordCount; ++i)
     {
         const int TagsSoFar = pCounts [i];
         const int CurrCount = TagsSoFar - PrevTagsSoFar;
@@ -338,9 +384,67 @@ const int FAHmmTagger_l1::Process (int * pOut, const int MaxOutSize)
     }
 
     // reset the amount of words
-    m_WordCount = 1;
+    pCtx->m_WordCount = 1;
 
     return OutSize;
 }
 
+
+void FAHmmTagger_l1::TagSentences (
+        const int * const * ppWords,
+        const int * pWordLens,
+        const int * pSentEnds,
+        const int SentCount,
+        int * pOut,
+        FAThreadPool * pPool,
+        const int ThreadCount
+    ) const
+{
+    LogAssert (m_fInitialized);
+    LogAssert (0 <= SentCount && pPool);
+
+    if (0 == SentCount) {
+        return;
+    }
+
+    LogAssert (ppWords && pWordLens && pSentEnds && pOut);
+
+    const int Threads = 0 < ThreadCount ?
+        ThreadCount : FAThreadPool::GetHardwareThreadCount ();
+
+    // a few jobs per thread, to even out the sentence lengths
+    int JobCount = Threads * JOBS_PER_THREAD;
+    if (JobCount > SentCount) {
+        JobCount = SentCount;
+    }
+
+    pPool->ParallelFor (JobCount, Threads, [&] (const int Job)
+    {
+        // each job decodes its sentences in a context of its own
+        FAAllocator alloc;
+        FAContext ctx;
+        ctx.SetAllocator (&alloc);
+
+        const int FromSent = int ((((long long) SentCount) * Job) / JobCount);
+        const int ToSent = int ((((long long) SentCount) * (Job + 1)) / JobCount);
+
+        int From = 0 < FromSent ? pSentEnds [FromSent - 1] : 0;
+
+        for (int i = FromSent; i < ToSent; ++i) {
+
+            const int To = pSentEnds [i];
+            LogAssert (From <= To);
+
+            for (int j = From; j < To; ++j) {
+                AddWord (&ctx, ppWords [j], pWordLens [j]);
+            }
+
+            const int OutSize = Process (&ctx, pOut + From, To - From);
+            LogAssert (OutSize == To - From);
+
+            From = To;
+        }
+    });
+}
+
 }
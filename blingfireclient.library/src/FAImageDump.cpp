@@ -8,6 +8,14 @@
 #include "FAConfig.h"
 #include "FAImageDump.h"
 
+#ifdef BLING_FIRE_NOWINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
 namespace BlingFire
 {
 
@@ -15,7 +23,9 @@ FAImageDump::FAImageDump () :
     m_pImageDump (NULL),
     m_MustDelete (false),
     m_hFileMapping (0),
-    m_MustUnmap (false)
+    m_MustUnmap (false),
+    m_MmSize (0),
+    m_ImageSize (0)
 {}
 
 
@@ -55,19 +65,32 @@ void FAImageDump::FAFreeMm ()
 
 #else
 
+    if(m_MustUnmap) {
+        const int Res = ::munmap ((void*) m_pImageDump, m_MmSize);
+        LogAssert (0 == Res, "Cannot unmap the file, errno=%d", errno);
+        m_pImageDump = NULL;
+        m_MmSize = 0;
+        m_MustUnmap = false;
+    }
+
 #endif
 }
 
 
-void FAImageDump::Load (const char * pFileName, const bool fUseMemMapping)
+void FAImageDump::Load (
+        const char * pFileName,
+        const bool fUseMemMapping,
+        const bool fPrefetch
+    )
 {
     LogAssert (pFileName);
 
     // free the memory and resources if there was anything loaded
     FAImageDump::FAFreeHeap ();
     FAImageDump::FAFreeMm ();
+    m_ImageSize = 0;
 
-#ifndef BLING_FIRE_NOWINDOWS
+#ifndef __EMSCRIPTEN__
 
     if (false == fUseMemMapping) {
 
@@ -77,7 +100,7 @@ void FAImageDump::Load (const char * pFileName, const bool fUseMemMapping)
     } else {
 
         // load the file using memory mapping
-        FALoadMm (pFileName);
+        FALoadMm (pFileName, fPrefetch);
     }
 
 #else
@@ -115,10 +138,11 @@ void FAImageDump::FALoadHeap (const char * pFileName)
     fclose (file);
 
     m_MustDelete = true;
+    m_ImageSize = Size;
 }
 
 
-void FAImageDump::FALoadMm (const char * pFileName)
+void FAImageDump::FALoadMm (const char * pFileName, const bool fPrefetch)
 {
 
 #ifndef BLING_FIRE_NOWINDOWS
@@ -130,6 +154,11 @@ void FAImageDump::FALoadMm (const char * pFileName)
     LogAssert (0 != hFile, "Failed to open a file %s for memory mapping, GetLastError()=%lu", 
         pFileName, GetLastError());
 
+    LARGE_INTEGER FileSize;
+    BOOL fRes = ::GetFileSizeEx (hFile, &FileSize);
+    LogAssert (0 != fRes, "Failed to get the size of the file %s, GetLastError()=%lu", 
+        pFileName, GetLastError());
+
     m_hFileMapping = ::CreateFileMapping (hFile, NULL, PAGE_READONLY, 0, 0, NULL);
     LogAssert (0 != m_hFileMapping, "Failed to create a memory mapping for file %s, GetLastError()=%lu", 
         pFileName, GetLastError());
@@ -138,13 +167,53 @@ void FAImageDump::FALoadMm (const char * pFileName)
     LogAssert (NULL != m_pImageDump, "Failed to get a pointer from the memory mapped file %s, GetLastError()=%lu", 
         pFileName, GetLastError());
 
-    BOOL fRes = ::CloseHandle (hFile);
+    fRes = ::CloseHandle (hFile);
     LogAssert (0 != fRes, "Cannot close handle, GetLastError()=%lu", GetLastError());
 
+    m_ImageSize = (size_t) FileSize.QuadPart;
+
+    // fPrefetch is not used, the system cache reads ahead anyways
+    (void) fPrefetch;
+
     m_MustUnmap = true;
 
 #else
 
+    LogAssert (pFileName);
+
+    const int hFile = ::open (pFileName, O_RDONLY);
+    LogAssert (-1 != hFile, "Failed to open a file %s for memory mapping, errno=%d", 
+        pFileName, errno);
+
+    struct stat FileInfo;
+    int Res = ::fstat (hFile, &FileInfo);
+    LogAssert (0 == Res && 0 < FileInfo.st_size, "Failed to get the size of the file %s, errno=%d", 
+        pFileName, errno);
+
+    m_MmSize = (size_t) FileInfo.st_size;
+
+    // the mapping is read-only and shared, so the processes mapping 
+    // the same file use the same physical pages
+    void * pData = ::mmap (NULL, m_MmSize, PROT_READ, MAP_SHARED, hFile, 0);
+    LogAssert (MAP_FAILED != pData, "Failed to memory map the file %s, errno=%d", 
+        pFileName, errno);
+
+    // the mapping stays valid after the file is closed
+    Res = ::close (hFile);
+    LogAssert (0 == Res, "Cannot close the file %s, errno=%d", pFileName, errno);
+
+    m_pImageDump = (unsigned char *) pData;
+    m_MustUnmap = true;
+    m_ImageSize = m_MmSize;
+
+    if (fPrefetch) {
+        // just hints, the errors are ignored
+        ::madvise (pData, m_MmSize, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+        ::madvise (pData, m_MmSize, MADV_HUGEPAGE);
+#endif
+    }
+
 #endif
 }
 
@@ -155,6 +224,13 @@ void FAImageDump::SetImageDump (const unsigned char * pImageDump)
     FAImageDump::FAFreeMm ();
 
     m_pImageDump = (unsigned char *) pImageDump;
+    m_ImageSize = 0;
+}
+
+
+const size_t FAImageDump::GetImageSize () const
+{
+    return m_ImageSize;
 }
 
 
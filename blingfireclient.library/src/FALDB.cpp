@@ -22,6 +22,12 @@ FALDB::~FALDB ()
 {}
 
 void FALDB::SetImage (const unsigned char * pImgDump)
+{
+    FALDB::SetImage (pImgDump, 0);
+}
+
+
+void FALDB::SetImage (const unsigned char * pImgDump, const size_t ImgSize)
 {
     m_DumpCount = 0;
 
@@ -59,6 +65,48 @@ void FALDB::SetImage (const unsigned char * pImgDump)
         m_Offsets [i] = Offset;
     }
 
+    // the end of the last dump, if known
+    m_Offsets [Count] = 0 < Count ? m_Offsets [Count - 1] : 0;
+    if (0 < Count && m_Offsets [Count] < ImgSize) {
+        m_Offsets [Count] = (unsigned int) ImgSize;
+    }
+
+    const bool fIsValid = IsValidBinary ();
+    LogAssert (fIsValid, "Invalid LDB binary file detected.");
+}
+
+
+void FALDB::
+    SetDumps (
+        const unsigned char ** ppDumps,
+        const size_t * pSizes,
+        const int Count
+    )
+{
+    m_DumpCount = 0;
+
+    LogAssert (0 < Count && Count <= FALimits::MaxLdbDumpCount);
+    LogAssert (ppDumps && pSizes);
+
+    // setup configuration image-dump, it is 0-th
+    m_Conf.SetImage (ppDumps [0]);
+
+    // store the count
+    m_DumpCount = Count;
+
+    // the offsets are computed as if the dumps were adjacent
+    unsigned int Offset = 0;
+
+    for (int i = 0; i < Count; ++i) {
+
+        m_Dumps [i] = ppDumps [i];
+        m_Offsets [i] = Offset;
+
+        Offset += (unsigned int) pSizes [i];
+    }
+
+    m_Offsets [Count] = Offset;
+
     const bool fIsValid = IsValidBinary ();
     LogAssert (fIsValid, "Invalid LDB binary file detected.");
 }
@@ -133,6 +181,12 @@ const unsigned char * FALDB::GetDump (const int Num) const
     return pDump;
 }
 
+const size_t FALDB::GetDumpSize (const int Num) const
+{
+    LogAssert (0 <= Num && Num < m_DumpCount);
+    return m_Offsets [Num + 1] - m_Offsets [Num];
+}
+
 inline const bool FALDB::IsBooleanParam (const int Parameter)
 {
     return Parameter == FAFsmConst::PARAM_REVERSE ||
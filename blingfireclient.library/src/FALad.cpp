@@ -4,7 +4,7 @@
  */
 
 
-#include "blingfire-compile_src_pch.h"
+#include "blingfire-client_src_pch.h"
 #include "FAConfig.h"
 #include "FALad.h"
 #include "FALadLDB.h"
@@ -15,6 +15,55 @@ namespace BlingFire
 {
 
 
+FALad::FAContext::FAContext () :
+    m_pLad (NULL),
+    m_TokenLen (0),
+    m_pOws (NULL),
+    m_pProbs (NULL),
+    m_MaxOwCount (0),
+    m_WordCount (0),
+    m_BestWordTag (-1),
+    m_pScript2Count (NULL),
+    m_pLangs (NULL),
+    m_LangCount (0),
+    m_pCounts (NULL),
+    m_pScores (NULL)
+{
+    m_Token [0] = 0x20;
+
+    for (int i = 0; i < MaxNgramOrder; ++i) {
+        m_NgramCount [i] = 0;
+        m_BestTag [i] = -1;
+    }
+}
+
+
+FALad::FAContext::~FAContext ()
+{
+    FALad::FAContext::Clear ();
+}
+
+
+void FALad::FAContext::Clear ()
+{
+    if (m_pScript2Count) {
+        delete [] m_pScript2Count;
+        m_pScript2Count = NULL;
+    }
+    if (m_pOws) {
+        delete [] m_pOws;
+        m_pOws = NULL;
+    }
+    if (m_pProbs) {
+        delete [] m_pProbs;
+        m_pProbs = NULL;
+    }
+
+    m_MaxOwCount = 0;
+    m_pLad = NULL;
+}
+
+
 FALad::FALad () :
     m_MaxTag (0),
     m_UnkTag (0),
@@ -23,27 +72,15 @@ FALad::FALad () :
     m_MaxCount (0),
     m_MinMatchRatio (0),
     m_MinWordMatchRatio (0),
-    m_TokenLen (0),
-    m_WordCount (0),
-    m_BestWordTag (-1),
+    m_MaxOwCount (0),
     m_pCharMap (NULL),
     m_pC2SMap (NULL),
     m_pS2LMap (NULL),
     m_MinScriptTag (0),
     m_MaxScriptTag (0),
-    m_pScript2Count (NULL),
-    m_pCounts (NULL),
-    m_pScores (NULL),
     m_fUseNgrams (false),
     m_fUseWords (false)
-{
-    m_Token [0] = 0x20;
-
-    for (int i = 0; i < MaxNgramOrder; ++i) {
-        m_NgramCount [i] = 0;
-        m_BestTag [i] = -1;
-    }
-}
+{}
 
 
 FALad::~FALad ()
@@ -54,11 +91,9 @@ FALad::~FALad ()
 
 void FALad::Clear ()
 {
-    if (m_pScript2Count) {
-        delete [] m_pScript2Count;
-        m_pScript2Count = NULL;
-    }
+    m_ctx.Clear ();
 
+    m_MaxOwCount = 0;
     m_fUseNgrams = false;
     m_fUseWords = false;
 }
@@ -83,17 +118,9 @@ void FALad::Initialize (const FALadLDB * pLDB)
     m_MinWordMatchRatio = pLadConf->GetMinWordMatchRatio ();
     m_pCharMap = pLadConf->GetCharMap ();
 
-    m_WordsScores.SetUnkScore (FAFsmConst::MIN_LOG_PROB * 2);
-    m_WordsScores.SetMaxTag (m_MaxTag);
-
     LogAssert (m_Order >= m_MinOrder && 
         1 <= m_MinOrder && MaxNgramOrder >= m_Order);
 
-    for (int i = m_MinOrder; i <= m_Order; ++i) {
-        m_NgramScores [i - 1].SetUnkScore (FAFsmConst::MIN_LOG_PROB * 2);
-        m_NgramScores [i - 1].SetMaxTag (m_MaxTag);
-    }
-
     // language/script maps initialization
     m_pC2SMap = pLadConf->GetC2SMap ();
     m_pS2LMap = pLadConf->GetS2LMap ();
@@ -104,12 +131,6 @@ void FALad::Initialize (const FALadLDB * pLDB)
     LogAssert (m_MinScriptTag <= m_MaxScriptTag);
     LogAssert (m_MinScriptTag > m_MaxTag);
 
-    const int ScriptCount = m_MaxScriptTag - m_MinScriptTag + 1;
-
-    DebugLogAssert (!m_pScript2Count);
-    m_pScript2Count = NEW int [ScriptCount];
-    LogAssert (m_pScript2Count);
-
     // see if the n-gram scorer should be used
     const FAWgConfKeeper * pN2TPConf = pLDB->GetN2TPConf ();
 
@@ -120,6 +141,11 @@ void FALad::Initialize (const FALadLDB * pLDB)
 
         m_NgrScorer.Initialize (pN2TPConf, NULL);
         m_fUseNgrams = true;
+
+        const int MaxOwCount = pN2TPConf->GetState2Ows ()->GetMaxOwsCount ();
+        if (m_MaxOwCount < MaxOwCount) {
+            m_MaxOwCount = MaxOwCount;
+        }
     }
 
     // see if the word scorer should be used
@@ -131,7 +157,47 @@ void FALad::Initialize (const FALadLDB * pLDB)
 
         m_WordScorer.Initialize (pW2TPConf, NULL);
         m_fUseWords = true;
+
+        const int MaxOwCount = pW2TPConf->GetState2Ows ()->GetMaxOwsCount ();
+        if (m_MaxOwCount < MaxOwCount) {
+            m_MaxOwCount = MaxOwCount;
+        }
+    }
+}
+
+
+void FALad::InitContext (FAContext * pCtx) const
+{
+    DebugLogAssert (pCtx);
+
+    if (this == pCtx->m_pLad) {
+        return;
+    }
+
+    pCtx->Clear ();
+
+    pCtx->m_WordsScores.SetUnkScore (FAFsmConst::MIN_LOG_PROB * 2);
+    pCtx->m_WordsScores.SetMaxTag (m_MaxTag);
+
+    for (int i = m_MinOrder; i <= m_Order; ++i) {
+        pCtx->m_NgramScores [i - 1].SetUnkScore (FAFsmConst::MIN_LOG_PROB * 2);
+        pCtx->m_NgramScores [i - 1].SetMaxTag (m_MaxTag);
     }
+
+    const int ScriptCount = m_MaxScriptTag - m_MinScriptTag + 1;
+
+    pCtx->m_pScript2Count = NEW int [ScriptCount];
+    LogAssert (pCtx->m_pScript2Count);
+
+    // the default tag is returned if there are no output weights
+    const int MaxOwCount = 0 < m_MaxOwCount ? m_MaxOwCount : 1;
+
+    pCtx->m_pOws = NEW int [MaxOwCount];
+    pCtx->m_pProbs = NEW float [MaxOwCount];
+    LogAssert (pCtx->m_pOws && pCtx->m_pProbs);
+    pCtx->m_MaxOwCount = MaxOwCount;
+
+    pCtx->m_pLad = this;
 }
 
 
@@ -189,7 +255,7 @@ inline const int FALad::
 }
 
 
-void FALad::ScoreText (const char * pText, size_t TextSize)
+void FALad::ScoreText (FAContext * pCtx, const char * pText, size_t TextSize) const
 {
     const char * pBegin = pText;
     const char * pEnd = pText + TextSize;
@@ -198,7 +264,7 @@ void FALad::ScoreText (const char * pText, size_t TextSize)
     int CharCount = 0;
 
     // the first letter of each token is a space
-    int * const pTokenBuff = m_Token + 1;
+    int * const pTokenBuff = pCtx->m_Token + 1;
 
     // fill in the first ngram
     while (pBegin < pEnd && CharCount++ <= m_MaxCount) {
@@ -220,35 +286,35 @@ void FALad::ScoreText (const char * pText, size_t TextSize)
             int S;
             if (1 == m_pC2SMap->Get (C, &S, 1)) {
                 DebugLogAssert (m_MinScriptTag <= S && m_MaxScriptTag >= S);
-                m_pScript2Count [S - m_MinScriptTag]++;
+                pCtx->m_pScript2Count [S - m_MinScriptTag]++;
             }
         }
 
         // see if we found a breaking symbol, or the buffer is full
-        if (0x20 >= C || MaxTokenLen == m_TokenLen) {
+        if (0x20 >= C || MaxTokenLen == pCtx->m_TokenLen) {
             // process if it not empty
-            if (0 < m_TokenLen) {
+            if (0 < pCtx->m_TokenLen) {
                 // score the token (m_Token, m_TokenLen)
-                ScoreNextToken ();
+                ScoreNextToken (pCtx);
                 // forget it
-                m_TokenLen = 0;
+                pCtx->m_TokenLen = 0;
             }
         }
         // append next letter to the token
         if (0x20 < C) {
             // add character in the buffer, if the buffer allows
-            if (m_TokenLen < MaxTokenLen) {
-                pTokenBuff [m_TokenLen] = C;
+            if (pCtx->m_TokenLen < MaxTokenLen) {
+                pTokenBuff [pCtx->m_TokenLen] = C;
             }
-            m_TokenLen++;
+            pCtx->m_TokenLen++;
         }
 
     } // while (pBegin < pEnd) ...
 
     // process the last token, if any
-    if (0 < m_TokenLen) {
+    if (0 < pCtx->m_TokenLen) {
         // score the token (m_Token, m_TokenLen)
-        ScoreNextToken ();
+        ScoreNextToken (pCtx);
     }
 }
 
@@ -275,86 +341,98 @@ inline const bool FALad::HasUpper (const int * pIn, const int Size) const
 }
 
 
-void FALad::ScoreNextToken ()
+void FALad::ScoreNextToken (FAContext * pCtx) const
 {
-    DebugLogAssert (m_TokenLen <= MaxTokenLen);
+    const int TokenLen = pCtx->m_TokenLen;
+    int * const pToken = pCtx->m_Token;
 
-    if (HasJunk (m_Token + 1, m_TokenLen)) {
+    DebugLogAssert (TokenLen <= MaxTokenLen);
+
+    if (HasJunk (pToken + 1, TokenLen)) {
         return;
     }
-    if (HasUpper (m_Token + 1, m_TokenLen)) {
+    if (HasUpper (pToken + 1, TokenLen)) {
         return;
     }
 
-    m_Token [m_TokenLen + 1] = 0x20;
+    pToken [TokenLen + 1] = 0x20;
 
-    const int * pTags;
-    const float * pScores;
+    int * const pTags = pCtx->m_pOws;
+    float * const pScores = pCtx->m_pProbs;
+    const int MaxOwCount = pCtx->m_MaxOwCount;
 
     // score a word
     if (m_fUseWords) {
 
         // update the word count
-        m_WordCount++;
+        pCtx->m_WordCount++;
 
         // look up the word scores
-        const int Count = m_WordScorer.Process (m_Token + 1, m_TokenLen, &pTags, &pScores);
-        m_WordsScores.AddScores (pTags, pScores, Count);
+        const int Count = m_WordScorer.Process (pToken + 1, TokenLen, pTags, pScores, MaxOwCount);
+        pCtx->m_WordsScores.AddScores (pTags, pScores, Count);
 
     } // of if (m_fUseWords) ...
 
     // score word's ngrams
     if (m_fUseNgrams) {
 
-        for (int i = 0; i < m_TokenLen; ++i) {
+        for (int i = 0; i < TokenLen; ++i) {
 
             for (int Order = m_Order; Order >= m_MinOrder; --Order) {
 
                 // see if the ngram can not be extracted
-                if (i + Order > m_TokenLen + 2) {
+                if (i + Order > TokenLen + 2) {
                     break;
                 }
 
                 // update the ngram count
-                m_NgramCount [Order - 1]++;
+                pCtx->m_NgramCount [Order - 1]++;
 
                 // look up the ngram score 
-                const int Count = m_NgrScorer.Process (m_Token + i, Order, &pTags, &pScores);
-                m_NgramScores [Order - 1].AddScores (pTags, pScores, Count);
+                const int Count = m_NgrScorer.Process (pToken + i, Order, pTags, pScores, MaxOwCount);
+                pCtx->m_NgramScores [Order - 1].AddScores (pTags, pScores, Count);
             }
         }
     } // of if (m_fUseNgrams) ...
 }
 
 
-inline void FALad::ResetScores ()
+inline void FALad::ResetScores (FAContext * pCtx) const
 {
     // clear the counters
     if (m_fUseWords) {
-        m_WordsScores.Clear ();
-        m_WordCount = 0;
-        m_BestWordTag = -1;
+        pCtx->m_WordsScores.Clear ();
+        pCtx->m_WordCount = 0;
+        pCtx->m_BestWordTag = -1;
     }
     if (m_fUseNgrams) {
         for (int i = m_MinOrder; i <= m_Order; ++i) {
-            m_NgramScores [i - 1].Clear ();
-            m_NgramCount [i - 1] = 0;
-            m_BestTag [i - 1] = -1;
+            pCtx->m_NgramScores [i - 1].Clear ();
+            pCtx->m_NgramCount [i - 1] = 0;
+            pCtx->m_BestTag [i - 1] = -1;
         }
     }
     if (m_fUseWords || m_fUseNgrams) {
         const int ScriptCount = m_MaxScriptTag - m_MinScriptTag + 1;
         for (int Script = 0; Script < ScriptCount; ++Script) {
-            m_pScript2Count [Script] = 0;
+            pCtx->m_pScript2Count [Script] = 0;
         }
     }
 
-    m_pCounts = NULL;
-    m_pScores = NULL;
+    pCtx->m_TokenLen = 0;
+    pCtx->m_pLangs = NULL;
+    pCtx->m_LangCount = 0;
+    pCtx->m_pCounts = NULL;
+    pCtx->m_pScores = NULL;
 }
 
 
-inline void FALad::FindBestScores (const int * pLangs, const int LangCount)
+inline void FALad::
+    FindBestScores (
+        FAContext * pCtx,
+        const int * pLangs,
+        const int LangCount
+    ) const
 {
     const int * pCounts;
     const float * pScores;
@@ -362,24 +440,24 @@ inline void FALad::FindBestScores (const int * pLangs, const int LangCount)
     // finalize the scores
     if (m_fUseWords) {
 
-        m_WordsScores.Process ();
+        pCtx->m_WordsScores.Process ();
 
         /// get an array of scores
 #ifndef NDEBUG
         const int Size = 
 #endif
-            m_WordsScores.GetScores (&pScores, &pCounts);
+            pCtx->m_WordsScores.GetScores (&pScores, &pCounts);
         DebugLogAssert (Size == m_MaxTag + 1 && pScores && pCounts);
 
         /// calculate the minimum accepatable count
-        const int MinCount = (m_MinWordMatchRatio * m_WordCount) / 100;
+        const int MinCount = (m_MinWordMatchRatio * pCtx->m_WordCount) / 100;
 
         // get the best tag
         const int BestTag = GetBestTag (pScores, pCounts, MinCount, pLangs, LangCount);
         DebugLogAssert (-1 == BestTag || 0 <= BestTag && BestTag <= m_MaxTag);
         DebugLogAssert (m_UnkTag != BestTag);
 
-        m_BestWordTag = BestTag;
+        pCtx->m_BestWordTag = BestTag;
 
     } // of if (m_fUseWords) ...
 
@@ -387,7 +465,7 @@ inline void FALad::FindBestScores (const int * pLangs, const int LangCount)
 
         for (int i = m_MinOrder; i <= m_Order; ++i) {
 
-            FASummTagScores * pScorer = & m_NgramScores [i - 1];
+            FASummTagScores * pScorer = & pCtx->m_NgramScores [i - 1];
 
             pScorer->Process ();
 
@@ -399,28 +477,28 @@ inline void FALad::FindBestScores (const int * pLangs, const int LangCount)
             DebugLogAssert (Size == m_MaxTag + 1 && pScores && pCounts);
 
             /// calculate the minimum accepatable count
-            const int MinCount = (m_MinMatchRatio * m_NgramCount [i - 1]) / 100;
+            const int MinCount = (m_MinMatchRatio * pCtx->m_NgramCount [i - 1]) / 100;
 
             // get the best tag
             const int BestTag = GetBestTag (pScores, pCounts, MinCount, pLangs, LangCount);
             DebugLogAssert (-1 == BestTag || 0 <= BestTag && BestTag <= m_MaxTag);
             DebugLogAssert (m_UnkTag != BestTag);
 
-            m_BestTag [i - 1] = BestTag;
+            pCtx->m_BestTag [i - 1] = BestTag;
         }
     } // of if (m_fUseNgrams) ...
 
 }
 
 
-const int FALad::GetBestScript () const
+const int FALad::GetBestScript (const FAContext * pCtx) const
 {
     int BestScript = -1;
     int BestCount = 0;
 
     for (int Script = m_MinScriptTag; Script <= m_MaxScriptTag; ++Script) {
 
-        const int Count = m_pScript2Count [Script - m_MinScriptTag];
+        const int Count = pCtx->m_pScript2Count [Script - m_MinScriptTag];
 
         if (0 == Count) {
             continue;
@@ -436,17 +514,38 @@ const int FALad::GetBestScript () const
 
 
 const int FALad::Process (const char * pText, size_t TextSize)
+{
+    return FALad::Process (&m_ctx, pText, TextSize);
+}
+
+
+const int FALad::GetScores (const float ** ppScores, const int ** ppCounts) const
+{
+    return FALad::GetScores (&m_ctx, ppScores, ppCounts);
+}
+
+
+const int FALad::
+    Process (
+        FAContext * pCtx,
+        const char * pText,
+        size_t TextSize
+    ) const
 {
     LogAssert (m_fUseWords || m_fUseNgrams);
+    LogAssert (pCtx);
+
+    // set up the context, if needed
+    InitContext (pCtx);
 
     // reset scores
-    ResetScores ();
+    ResetScores (pCtx);
 
     // feed the text
-    ScoreText (pText, TextSize);
+    ScoreText (pCtx, pText, TextSize);
 
     // get the major script of the page
-    const int Script = GetBestScript ();
+    const int Script = GetBestScript (pCtx);
     if (-1 == Script) {
         return m_UnkTag;
     }
@@ -460,21 +559,24 @@ const int FALad::Process (const char * pText, size_t TextSize)
         return *pLangs;
     }
 
+    pCtx->m_pLangs = pLangs;
+    pCtx->m_LangCount = LangCount;
+
     // find best scores
-    FindBestScores (pLangs, LangCount);
+    FindBestScores (pCtx, pLangs, LangCount);
 
     // combine scores together
     if (m_fUseWords) {
-        if (-1 != m_BestWordTag) {
-            m_WordsScores.GetScores (&m_pScores, &m_pCounts);
-            return m_BestWordTag;
+        if (-1 != pCtx->m_BestWordTag) {
+            pCtx->m_WordsScores.GetScores (&pCtx->m_pScores, &pCtx->m_pCounts);
+            return pCtx->m_BestWordTag;
         }
     }
     if (m_fUseNgrams) {
         for (int Order = m_Order; Order >= m_MinOrder; --Order) {
-            const int BestTag = m_BestTag [Order - 1];
+            const int BestTag = pCtx->m_BestTag [Order - 1];
             if (-1 != BestTag) {
-                m_NgramScores [Order - 1].GetScores (&m_pScores, &m_pCounts);
+                pCtx->m_NgramScores [Order - 1].GetScores (&pCtx->m_pScores, &pCtx->m_pCounts);
                 return BestTag;
             }
         }
@@ -484,11 +586,90 @@ const int FALad::Process (const char * pText, size_t TextSize)
 }
 
 
-const int FALad::GetScores (const float ** ppScores, const int ** ppCounts) const
+const int FALad::
+    GetScores (
+        const FAContext * pCtx,
+        const float ** ppScores,
+        const int ** ppCounts
+    ) const
 {
-    *ppCounts = m_pCounts;
-    *ppScores = m_pScores;
+    DebugLogAssert (pCtx);
+
+    *ppCounts = pCtx->m_pCounts;
+    *ppScores = pCtx->m_pScores;
     return m_MaxTag + 1;
 }
 
+
+const int FALad::
+    GetLanguages (
+        FAContext * pCtx,
+        const char * pText,
+        size_t TextSize,
+        int * pLangs,
+        float * pScores,
+        const int MaxCount
+    ) const
+{
+    LogAssert (pLangs && pScores && 0 < MaxCount);
+
+    const int BestLang = FALad::Process (pCtx, pText, TextSize);
+
+    if (m_UnkTag == BestLang || 0 > BestLang) {
+        return 0;
+    }
+
+    const float * pAllScores = pCtx->m_pScores;
+    const int * pAllCounts = pCtx->m_pCounts;
+
+    // a single language of the script has no scores
+    pLangs [0] = BestLang;
+    pScores [0] = pAllScores ? pAllScores [BestLang] : 0;
+    int Count = 1;
+
+    if (NULL == pAllScores) {
+        return Count;
+    }
+
+    // add the other languages of the script, best scores first
+    for (int i = 0; i < pCtx->m_LangCount; ++i) {
+
+        const int Lang = pCtx->m_pLangs [i];
+
+        if (Lang == BestLang || Lang == m_UnkTag || 0 > Lang || \
+            m_MaxTag < Lang || 0 == pAllCounts [Lang]) {
+            continue;
+        }
+
+        const float Score = pAllScores [Lang];
+
+        // find the position, the best language stays first
+        int Pos = Count;
+        while (1 < Pos && pScores [Pos - 1] < Score) {
+            Pos--;
+        }
+        if (Pos >= MaxCount) {
+            continue;
+        }
+        if (Count < MaxCount) {
+            Count++;
+        }
+        for (int j = Count - 1; j > Pos; --j) {
+            pLangs [j] = pLangs [j - 1];
+            pScores [j] = pScores [j - 1];
+        }
+
+        pLangs [Pos] = Lang;
+        pScores [Pos] = Score;
+    }
+
+    return Count;
+}
+
+
+const int FALad::GetUnkTag () const
+{
+    return m_UnkTag;
+}
+
 }
@@ -4,7 +4,7 @@
  */
 
 
-#include "blingfire-compile_src_pch.h"
+#include "blingfire-client_src_pch.h"
 #include "FAConfig.h"
 #include "FALadConfKeeper.h"
 #include "FAFsmConst.h"
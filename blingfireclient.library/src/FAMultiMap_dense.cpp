@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "blingfire-client_src_pch.h"
+#include "FAConfig.h"
+#include "FAMultiMap_dense.h"
+
+namespace BlingFire
+{
+
+FAMultiMap_dense::FAMultiMap_dense () :
+    m_pMap (NULL),
+    m_pKey2Page (NULL),
+    m_Key2PageSize (0),
+    m_pPages (NULL),
+    m_pValues (NULL)
+{}
+
+
+void FAMultiMap_dense::Clear ()
+{
+    m_pMap = NULL;
+    m_Key2Page.clear ();
+    m_pKey2Page = NULL;
+    m_Key2PageSize = 0;
+    m_Pages.clear ();
+    m_pPages = NULL;
+    m_Values.clear ();
+    m_pValues = NULL;
+}
+
+
+void FAMultiMap_dense::Build (const FAMultiMapCA * pMap, const int MaxKey)
+{
+    LogAssert (pMap && 0 <= MaxKey);
+
+    Clear ();
+
+    m_pMap = pMap;
+
+    const int MaxCount = pMap->GetMaxCount ();
+    LogAssert (0 <= MaxCount);
+
+    std::vector < int > Values (MaxCount + 1);
+    std::vector < int > Page (PageSize);
+
+    const int Key2PageSize = (MaxKey >> PageBits) + 1;
+    m_Key2Page.assign (Key2PageSize, 0);
+
+    int PageCount = 0;
+    int i = 0;
+
+    for (; i < Key2PageSize; ++i) {
+
+        bool fEmpty = true;
+
+        for (int j = 0; j < PageSize; ++j) {
+
+            const int Key = (i << PageBits) | j;
+            const int Count = pMap->Get (Key, Values.data (), MaxCount);
+
+            if (-1 == Count || MaxCount < Count) {
+                Page [j] = -1;
+                continue;
+            }
+
+            fEmpty = false;
+
+            if (1 == Count && 0 <= Values [0]) {
+                Page [j] = Values [0];
+            } else {
+                Page [j] = -2 - (int) m_Values.size ();
+                m_Values.push_back (Count);
+                m_Values.insert (m_Values.end (), Values.begin (), Values.begin () + Count);
+            }
+        }
+
+        if (!fEmpty) {
+            // the keys from this page on are looked up in the pMap
+            if (MaxPageCount <= PageCount) {
+                break;
+            }
+            m_Pages.insert (m_Pages.end (), Page.begin (), Page.end ());
+            m_Key2Page [i] = (unsigned short) ++PageCount;
+        }
+    }
+
+    m_Key2Page.resize (i);
+
+    m_pKey2Page = m_Key2Page.data ();
+    m_Key2PageSize = (unsigned int) m_Key2Page.size ();
+    m_pPages = m_Pages.data ();
+    m_pValues = m_Values.data ();
+}
+
+
+const size_t FAMultiMap_dense::GetMemorySize () const
+{
+    return (m_Key2Page.size () * sizeof (unsigned short)) + \
+        (m_Pages.size () * sizeof (int)) + (m_Values.size () * sizeof (int));
+}
+
+
+const int FAMultiMap_dense::Get (
+        const int Key,
+        __out_ecount_opt(MaxCount) int * pValues,
+        const int MaxCount
+    ) const
+{
+    const int * pMapValues = NULL;
+    const int Count = Get (Key, &pMapValues);
+
+    if (NULL != pMapValues) {
+        if (NULL != pValues && 0 < Count && Count <= MaxCount) {
+            for (int i = 0; i < Count; ++i) {
+                pValues [i] = pMapValues [i];
+            }
+        }
+        return Count;
+    }
+
+    return m_pMap ? m_pMap->Get (Key, pValues, MaxCount) : -1;
+}
+
+
+const int FAMultiMap_dense::GetMaxCount () const
+{
+    return m_pMap ? m_pMap->GetMaxCount () : 0;
+}
+
+}
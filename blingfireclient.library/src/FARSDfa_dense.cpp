@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "blingfire-client_src_pch.h"
+#include "FAConfig.h"
+#include "FARSDfa_dense.h"
+#include "FAUtils_cl.h"
+
+#include <deque>
+
+namespace BlingFire
+{
+
+FARSDfa_dense::FARSDfa_dense () :
+    m_pDfa (NULL),
+    m_pRows (NULL),
+    m_pState2Row (NULL),
+    m_State2RowSize (0)
+{}
+
+
+void FARSDfa_dense::Clear ()
+{
+    m_pDfa = NULL;
+    m_Rows.clear ();
+    m_pRows = NULL;
+    m_State2Row.clear ();
+    m_pState2Row = NULL;
+    m_State2RowSize = 0;
+}
+
+
+const int FARSDfa_dense::Build (const FARSDfaCA * pDfa, const size_t MaxMemory)
+{
+    LogAssert (pDfa);
+
+    Clear ();
+
+    m_pDfa = pDfa;
+
+    const int Initial = pDfa->GetInitial ();
+    if (0 > Initial) {
+        return 0;
+    }
+
+    // collect the states in the breadth-first order, the states which are
+    // closer to the initial state are visited more often
+    std::vector < int > States;
+    std::vector < bool > Seen;
+    std::deque < int > Queue;
+
+    Queue.push_back (Initial);
+
+    while (!Queue.empty () && (size_t) MaxRowCount > States.size ()) {
+
+        const int State = Queue.front ();
+        Queue.pop_front ();
+
+        if ((size_t) State < Seen.size () && Seen [State]) {
+            continue;
+        }
+        if ((size_t) State >= Seen.size ()) {
+            Seen.resize (State + 1, false);
+        }
+        Seen [State] = true;
+        States.push_back (State);
+
+        for (int Iw = 0; Iw < DenseIwCount; ++Iw) {
+            const int Dst = pDfa->GetDest (State, Iw);
+            if (0 <= Dst && ((size_t) Dst >= Seen.size () || !Seen [Dst])) {
+                Queue.push_back (Dst);
+            }
+        }
+    }
+
+    // see how many rows fit into the memory budget
+    size_t RowCount = States.size ();
+    unsigned int MapSize = 0;
+
+    while (0 < RowCount) {
+
+        MapSize = 0;
+        for (size_t i = 0; i < RowCount; ++i) {
+            if ((unsigned int) States [i] >= MapSize) {
+                MapSize = States [i] + 1;
+            }
+        }
+
+        const size_t Size = (RowCount * DenseIwCount * sizeof (int)) + \
+            (MapSize * sizeof (unsigned short));
+
+        if (Size <= MaxMemory) {
+            break;
+        }
+
+        RowCount /= 2;
+    }
+
+    if (0 == RowCount) {
+        return 0;
+    }
+
+    // allocate the rows with an extra space for the alignment
+    m_Rows.resize ((RowCount * DenseIwCount) + RowAlign);
+    int * pRows = m_Rows.data ();
+    const size_t Misalign = ((size_t) pRows) % (RowAlign * sizeof (int));
+    if (0 != Misalign) {
+        pRows += (((RowAlign * sizeof (int)) - Misalign) / sizeof (int));
+    }
+
+    m_State2Row.assign (MapSize, 0);
+
+    for (size_t i = 0; i < RowCount; ++i) {
+
+        const int State = States [i];
+        int * pRow = pRows + (i * DenseIwCount);
+
+        for (int Iw = 0; Iw < DenseIwCount; ++Iw) {
+            pRow [Iw] = pDfa->GetDest (State, Iw);
+        }
+
+        m_State2Row [State] = (unsigned short) (i + 1);
+    }
+
+    m_pRows = pRows;
+    m_pState2Row = m_State2Row.data ();
+    m_State2RowSize = MapSize;
+
+    return (int) RowCount;
+}
+
+
+const size_t FARSDfa_dense::GetMemorySize () const
+{
+    return (m_Rows.size () * sizeof (int)) + \
+        (m_State2Row.size () * sizeof (unsigned short));
+}
+
+
+const int FARSDfa_dense::GetInitial () const
+{
+    DebugLogAssert (m_pDfa);
+    return m_pDfa->GetInitial ();
+}
+
+
+const int FARSDfa_dense::GetIWs (
+            __out_ecount_opt (MaxIwCount) int * pIws, 
+            const int MaxIwCount
+        ) const
+{
+    DebugLogAssert (m_pDfa);
+    return m_pDfa->GetIWs (pIws, MaxIwCount);
+}
+
+
+const bool FARSDfa_dense::IsFinal (const int State) const
+{
+    DebugLogAssert (m_pDfa);
+    return m_pDfa->IsFinal (State);
+}
+
+}
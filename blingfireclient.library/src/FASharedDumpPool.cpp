@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "blingfire-client_src_pch.h"
+#include "FAConfig.h"
+#include "FASharedDumpPool.h"
+#include "FAUtils_cl.h"
+
+#include <string.h>
+
+namespace BlingFire
+{
+
+
+FASharedDumpPool::FASharedDumpPool () :
+    m_ByteCount (0)
+{}
+
+
+FASharedDumpPool::~FASharedDumpPool ()
+{
+    std::unordered_map < const unsigned char *, FAEntry * >::iterator I =
+        m_ptr2entry.begin ();
+
+    for (; I != m_ptr2entry.end (); ++I) {
+        FAEntry * pEntry = I->second;
+        delete [] pEntry->m_pData;
+        delete pEntry;
+    }
+}
+
+
+const unsigned char * FASharedDumpPool::
+    Add (const unsigned char * pDump, const size_t Size)
+{
+    LogAssert (pDump || 0 == Size);
+
+    // the hash is computed outside of the lock
+    const unsigned int Crc = FAGetCrc32 (pDump, Size);
+
+    std::lock_guard < std::mutex > guard (m_lock);
+
+    typedef std::unordered_multimap < unsigned int, FAEntry * >::iterator TIter;
+    std::pair < TIter, TIter > Range = m_crc2entry.equal_range (Crc);
+
+    for (TIter I = Range.first; I != Range.second; ++I) {
+
+        FAEntry * pEntry = I->second;
+
+        if (pEntry->m_Size == Size && \
+            0 == memcmp (pEntry->m_pData, pDump, Size)) {
+            pEntry->m_RefCount++;
+            return pEntry->m_pData;
+        }
+    }
+
+    // the data are copied, so the caller's memory can be freed
+    FAEntry * pEntry = NEW FAEntry;
+    LogAssert (pEntry);
+
+    pEntry->m_pData = NEW unsigned char [0 < Size ? Size : 1];
+    LogAssert (pEntry->m_pData);
+    memcpy (pEntry->m_pData, pDump, Size);
+
+    pEntry->m_Size = Size;
+    pEntry->m_Crc = Crc;
+    pEntry->m_RefCount = 1;
+
+    m_crc2entry.insert (std::make_pair (Crc, pEntry));
+    m_ptr2entry [pEntry->m_pData] = pEntry;
+    m_ByteCount += Size;
+
+    return pEntry->m_pData;
+}
+
+
+void FASharedDumpPool::Release (const unsigned char * pDump)
+{
+    if (NULL == pDump) {
+        return;
+    }
+
+    std::lock_guard < std::mutex > guard (m_lock);
+
+    std::unordered_map < const unsigned char *, FAEntry * >::iterator I =
+        m_ptr2entry.find (pDump);
+    LogAssert (I != m_ptr2entry.end ());
+
+    FAEntry * pEntry = I->second;
+    DebugLogAssert (0 < pEntry->m_RefCount);
+
+    if (0 < --pEntry->m_RefCount) {
+        return;
+    }
+
+    typedef std::unordered_multimap < unsigned int, FAEntry * >::iterator TIter;
+    std::pair < TIter, TIter > Range = m_crc2entry.equal_range (pEntry->m_Crc);
+
+    for (TIter J = Range.first; J != Range.second; ++J) {
+        if (pEntry == J->second) {
+            m_crc2entry.erase (J);
+            break;
+        }
+    }
+
+    m_ptr2entry.erase (I);
+    m_ByteCount -= pEntry->m_Size;
+
+    delete [] pEntry->m_pData;
+    delete pEntry;
+}
+
+
+void FASharedDumpPool::
+    GetStats (size_t * pDumpCount, size_t * pByteCount) const
+{
+    std::lock_guard < std::mutex > guard (m_lock);
+
+    if (pDumpCount) {
+        *pDumpCount = m_ptr2entry.size ();
+    }
+    if (pByteCount) {
+        *pByteCount = m_ByteCount;
+    }
+}
+
+}
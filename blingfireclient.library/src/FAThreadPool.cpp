@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "blingfire-client_src_pch.h"
+#include "FAConfig.h"
+#include "FAThreadPool.h"
+
+namespace BlingFire
+{
+
+FAThreadPool::FAThreadPool () :
+    m_Stop (false)
+{}
+
+
+FAThreadPool::~FAThreadPool ()
+{
+    {
+        std::lock_guard < std::mutex > Guard (m_Lock);
+        m_Stop = true;
+    }
+    m_Wake.notify_all ();
+
+    for (size_t i = 0; i < m_Workers.size (); ++i) {
+        if (m_Workers [i].joinable ()) {
+            m_Workers [i].join ();
+        }
+    }
+}
+
+
+const int FAThreadPool::GetHardwareThreadCount ()
+{
+    const int Count = (int) std::thread::hardware_concurrency ();
+    return 0 < Count ? Count : 1;
+}
+
+
+void FAThreadPool::EnsureWorkers (const int WorkerCount)
+{
+    while ((int) m_Workers.size () < WorkerCount) {
+        m_Workers.push_back (std::thread (&FAThreadPool::WorkerProc, this));
+    }
+}
+
+
+void FAThreadPool::RunSlices (_TJob * pJob, const int FirstSlice)
+{
+    DebugLogAssert (pJob && 0 <= FirstSlice && FirstSlice < pJob->m_SliceCount);
+
+    const int SliceCount = pJob->m_SliceCount;
+
+    // start from the own slice, then help the others
+    for (int k = 0; k < SliceCount; ++k) {
+
+        _TSlice * pSlice = pJob->m_pSlices + ((FirstSlice + k) % SliceCount);
+
+        while (false == pJob->m_Failed.load (std::memory_order_relaxed)) {
+
+            const int i = pSlice->m_Next.fetch_add (1);
+            if (i >= pSlice->m_End) {
+                break;
+            }
+
+            (*(pJob->m_pFn)) (i);
+        }
+    }
+}
+
+
+void FAThreadPool::WorkerProc ()
+{
+    std::unique_lock < std::mutex > Lock (m_Lock);
+
+    while (true) {
+
+        while (false == m_Stop && m_Jobs.empty ()) {
+            m_Wake.wait (Lock);
+        }
+        if (m_Stop) {
+            return;
+        }
+
+        // take the next slice of the oldest job
+        _TJob * pJob = m_Jobs.front ();
+        const int Slice = pJob->m_NextSlice++;
+        if (pJob->m_NextSlice >= pJob->m_SliceCount) {
+            m_Jobs.pop_front ();
+        }
+        pJob->m_Running++;
+
+        Lock.unlock ();
+
+        std::exception_ptr Error;
+        try {
+            RunSlices (pJob, Slice);
+        } catch (...) {
+            Error = std::current_exception ();
+            pJob->m_Failed = true;
+        }
+
+        Lock.lock ();
+
+        if (Error && !pJob->m_Error) {
+            pJob->m_Error = Error;
+        }
+        if (0 == --pJob->m_Running) {
+            m_Done.notify_all ();
+        }
+    }
+}
+
+
+void FAThreadPool::ParallelFor (
+        const int Count,
+        const int ThreadCount,
+        const std::function < void (const int) > & Fn
+    )
+{
+    if (0 >= Count) {
+        return;
+    }
+
+    int SliceCount = 0 < ThreadCount ? ThreadCount : GetHardwareThreadCount ();
+    if (SliceCount > Count) {
+        SliceCount = Count;
+    }
+    if (SliceCount > MaxWorkerCount + 1) {
+        SliceCount = MaxWorkerCount + 1;
+    }
+
+    // nothing to share, do everything in the calling thread
+    if (1 == SliceCount) {
+        for (int i = 0; i < Count; ++i) {
+            Fn (i);
+        }
+        return;
+    }
+
+    // split [0, Count) into nearly equal slices
+    std::vector < _TSlice > Slices (SliceCount);
+    for (int s = 0; s < SliceCount; ++s) {
+        Slices [s].m_Next = (int) (((long long) Count * s) / SliceCount);
+        Slices [s].m_End = (int) (((long long) Count * (s + 1)) / SliceCount);
+    }
+
+    _TJob Job;
+    Job.m_pFn = &Fn;
+    Job.m_pSlices = Slices.data ();
+    Job.m_SliceCount = SliceCount;
+    Job.m_NextSlice = 1; // slice 0 belongs to the calling thread
+    Job.m_Running = 0;
+    Job.m_Failed = false;
+
+    {
+        std::lock_guard < std::mutex > Guard (m_Lock);
+        EnsureWorkers (SliceCount - 1);
+        m_Jobs.push_back (&Job);
+    }
+    m_Wake.notify_all ();
+
+    std::exception_ptr Error;
+    try {
+        RunSlices (&Job, 0);
+    } catch (...) {
+        Error = std::current_exception ();
+        Job.m_Failed = true;
+    }
+
+    {
+        std::unique_lock < std::mutex > Lock (m_Lock);
+
+        // the work is done, don't let more helpers join
+        for (std::deque < _TJob * >::iterator it = m_Jobs.begin (); it != m_Jobs.end (); ++it) {
+            if (*it == &Job) {
+                m_Jobs.erase (it);
+                break;
+            }
+        }
+        // wait for the helpers which are still running
+        while (0 < Job.m_Running) {
+            m_Done.wait (Lock);
+        }
+        if (!Error) {
+            Error = Job.m_Error;
+        }
+    }
+
+    if (Error) {
+        std::rethrow_exception (Error);
+    }
+}
+
+}
@@ -9,6 +9,8 @@
 #include "FAFsmConst.h"
 #include "FAUtf8Utils.h"
 
+#include <algorithm>
+
 #ifndef SIZE_OPTIMIZATION
 #include "FANormalizeDiacriticsMapPreserve.cxx"
 #include "FANormalizeDiacriticsMapProd.cxx"
@@ -17,9 +19,255 @@
 
 #define FAIsSurrogate(S) (0x0000D800 == (0xFFFFF800 & S))
 
+// x64 always has SSE2, AVX2 is detected at runtime
+#if !defined(SIZE_OPTIMIZATION) && (defined(__x86_64__) || defined(_M_X64))
+#define FA_UTF8_SIMD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FA_TARGET_AVX2
+#else
+#define FA_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
+#endif
+
 namespace BlingFire
 {
 
+///
+/// Byte widening kernels, copy bytes of pStr into pArray as ints and, if
+/// pOffsets is not NULL, store Offset + i for each copied byte i. Stop after
+/// Count bytes or, if fAsciiOnly is true, at the first non-ASCII byte.
+/// Return the number of copied bytes.
+///
+
+typedef const int (*_TFAWidenBytes) (
+        const unsigned char * pStr,
+        const int Count,
+        int * pArray,
+        int * pOffsets,
+        const int Offset,
+        const bool fAsciiOnly
+    );
+
+static const int FAWidenBytes_scalar (
+        const unsigned char * pStr,
+        const int Count,
+        int * pArray,
+        int * pOffsets,
+        const int Offset,
+        const bool fAsciiOnly
+    )
+{
+    int i = 0;
+
+    for (; i < Count; ++i) {
+
+        const int C = pStr [i];
+        if (fAsciiOnly && 0x80 <= C) {
+            break;
+        }
+        pArray [i] = C;
+        if (pOffsets) {
+            pOffsets [i] = Offset + i;
+        }
+    }
+
+    return i;
+}
+
+#ifdef FA_UTF8_SIMD
+
+static const int FAWidenBytes_sse2 (
+        const unsigned char * pStr,
+        const int Count,
+        int * pArray,
+        int * pOffsets,
+        const int Offset,
+        const bool fAsciiOnly
+    )
+{
+    const __m128i Zero = _mm_setzero_si128 ();
+    const __m128i Seq = _mm_setr_epi32 (0, 1, 2, 3);
+    const __m128i Four = _mm_set1_epi32 (4);
+
+    int i = 0;
+
+    for (; i + 16 <= Count; i += 16) {
+
+        const __m128i Bytes = _mm_loadu_si128 ((const __m128i *) (pStr + i));
+        if (fAsciiOnly && 0 != _mm_movemask_epi8 (Bytes)) {
+            break;
+        }
+
+        const __m128i Lo = _mm_unpacklo_epi8 (Bytes, Zero);
+        const __m128i Hi = _mm_unpackhi_epi8 (Bytes, Zero);
+
+        __m128i * pOut = (__m128i *) (pArray + i);
+        _mm_storeu_si128 (pOut, _mm_unpacklo_epi16 (Lo, Zero));
+        _mm_storeu_si128 (pOut + 1, _mm_unpackhi_epi16 (Lo, Zero));
+        _mm_storeu_si128 (pOut + 2, _mm_unpacklo_epi16 (Hi, Zero));
+        _mm_storeu_si128 (pOut + 3, _mm_unpackhi_epi16 (Hi, Zero));
+
+        if (pOffsets) {
+            __m128i * pOutOffsets = (__m128i *) (pOffsets + i);
+            __m128i Offsets = _mm_add_epi32 (_mm_set1_epi32 (Offset + i), Seq);
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_si128 (pOutOffsets + k, Offsets);
+                Offsets = _mm_add_epi32 (Offsets, Four);
+            }
+        }
+    }
+
+    return i + FAWidenBytes_scalar (pStr + i, Count - i, pArray + i,
+        pOffsets ? pOffsets + i : NULL, Offset + i, fAsciiOnly);
+}
+
+
+FA_TARGET_AVX2
+static const int FAWidenBytes_avx2 (
+        const unsigned char * pStr,
+        const int Count,
+        int * pArray,
+        int * pOffsets,
+        const int Offset,
+        const bool fAsciiOnly
+    )
+{
+    const __m256i Seq = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i Eight = _mm256_set1_epi32 (8);
+
+    int i = 0;
+
+    for (; i + 32 <= Count; i += 32) {
+
+        const __m256i Bytes = _mm256_loadu_si256 ((const __m256i *) (pStr + i));
+        if (fAsciiOnly && 0 != _mm256_movemask_epi8 (Bytes)) {
+            break;
+        }
+
+        const __m128i Lo = _mm256_castsi256_si128 (Bytes);
+        const __m128i Hi = _mm256_extracti128_si256 (Bytes, 1);
+
+        __m256i * pOut = (__m256i *) (pArray + i);
+        _mm256_storeu_si256 (pOut, _mm256_cvtepu8_epi32 (Lo));
+        _mm256_storeu_si256 (pOut + 1, _mm256_cvtepu8_epi32 (_mm_srli_si128 (Lo, 8)));
+        _mm256_storeu_si256 (pOut + 2, _mm256_cvtepu8_epi32 (Hi));
+        _mm256_storeu_si256 (pOut + 3, _mm256_cvtepu8_epi32 (_mm_srli_si128 (Hi, 8)));
+
+        if (pOffsets) {
+            __m256i * pOutOffsets = (__m256i *) (pOffsets + i);
+            __m256i Offsets = _mm256_add_epi32 (_mm256_set1_epi32 (Offset + i), Seq);
+            for (int k = 0; k < 4; ++k) {
+                _mm256_storeu_si256 (pOutOffsets + k, Offsets);
+                Offsets = _mm256_add_epi32 (Offsets, Eight);
+            }
+        }
+    }
+
+    return i + FAWidenBytes_sse2 (pStr + i, Count - i, pArray + i,
+        pOffsets ? pOffsets + i : NULL, Offset + i, fAsciiOnly);
+}
+
+
+static const bool FAHasAvx2 ()
+{
+#if defined(_MSC_VER)
+    int Info [4];
+    __cpuid (Info, 0);
+    if (7 > Info [0]) {
+        return false;
+    }
+    // the CPU and the OS should support AVX (OSXSAVE, AVX, YMM state enabled)
+    __cpuid (Info, 1);
+    if ((3 << 27) != (Info [2] & (3 << 27)) || 6 != (_xgetbv (0) & 6)) {
+        return false;
+    }
+    __cpuidex (Info, 7, 0);
+    return 0 != (Info [1] & (1 << 5));
+#else
+    __builtin_cpu_init ();
+    return 0 != __builtin_cpu_supports ("avx2");
+#endif
+}
+
+#endif // of FA_UTF8_SIMD
+
+
+/// returns the best byte widening kernel for this CPU
+static inline _TFAWidenBytes FAGetWidenBytes ()
+{
+#ifdef FA_UTF8_SIMD
+    static const _TFAWidenBytes pFn = FAHasAvx2 () ? FAWidenBytes_avx2 : FAWidenBytes_sse2;
+    return pFn;
+#else
+    return FAWidenBytes_scalar;
+#endif
+}
+
+
+/// copies the run of ASCII characters at pStr, upto MaxCount, 
+/// returns the length of the run
+///
+/// Note: if MaxCount >= 16 all 16 elements of pArray and pOffsets may be
+///   written even if the run is shorter.
+///
+static inline const int FACopyAscii (
+        const unsigned char * pStr,
+        const int MaxCount,
+        int * pArray,
+        int * pOffsets,
+        const int Offset
+    )
+{
+#ifdef FA_UTF8_SIMD
+    // runs between non-ASCII characters are often short, look at the
+    // next 16 bytes before making an indirect call
+    if (16 <= MaxCount) {
+
+        const __m128i Bytes = _mm_loadu_si128 ((const __m128i *) pStr);
+        const unsigned int Mask = _mm_movemask_epi8 (Bytes);
+
+        if (0 == Mask) {
+            // a long run, use the best kernel
+            return (*FAGetWidenBytes ()) (pStr, MaxCount, pArray, pOffsets, Offset, true);
+        }
+
+        // the run ends within these 16 bytes, widen all of them anyways
+        const __m128i Zero = _mm_setzero_si128 ();
+        const __m128i Lo = _mm_unpacklo_epi8 (Bytes, Zero);
+        const __m128i Hi = _mm_unpackhi_epi8 (Bytes, Zero);
+
+        __m128i * pOut = (__m128i *) pArray;
+        _mm_storeu_si128 (pOut, _mm_unpacklo_epi16 (Lo, Zero));
+        _mm_storeu_si128 (pOut + 1, _mm_unpackhi_epi16 (Lo, Zero));
+        _mm_storeu_si128 (pOut + 2, _mm_unpacklo_epi16 (Hi, Zero));
+        _mm_storeu_si128 (pOut + 3, _mm_unpackhi_epi16 (Hi, Zero));
+
+        if (pOffsets) {
+            const __m128i Four = _mm_set1_epi32 (4);
+            __m128i * pOutOffsets = (__m128i *) pOffsets;
+            __m128i Offsets = _mm_add_epi32 (_mm_set1_epi32 (Offset), _mm_setr_epi32 (0, 1, 2, 3));
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_si128 (pOutOffsets + k, Offsets);
+                Offsets = _mm_add_epi32 (Offsets, Four);
+            }
+        }
+
+#if defined(_MSC_VER)
+        unsigned long Count;
+        _BitScanForward (&Count, Mask);
+        return (int) Count;
+#else
+        return __builtin_ctz (Mask);
+#endif
+    }
+#endif
+
+    return FAWidenBytes_scalar (pStr, MaxCount, pArray, pOffsets, Offset, true);
+}
+
+
 const int FAUtf8Size (const char * ptr)
 {
     DebugLogAssert (ptr);
@@ -196,6 +444,44 @@ const char * FAUtf8ToInt (const char * pBegin, const char * pEnd, int * pResult)
 }
 
 
+/// the same as FAUtf8ToInt but with inlined 2 and 3 byte sequences,
+/// which are the most common non-ASCII characters
+static inline const char * FAUtf8ToInt_inl (
+        const char * pBegin,
+        const char * pEnd,
+        int * pResult
+    )
+{
+    const unsigned char * p = (const unsigned char *) pBegin;
+    const int C0 = p [0];
+
+    if (0xC2 <= C0 && 0xDF >= C0 && 2 <= pEnd - pBegin) {
+
+        const int C1 = p [1];
+        if (0x80 == (0xC0 & C1)) {
+            *pResult = ((C0 & 0x1F) << 6) | (C1 & 0x3F);
+            return pBegin + 2;
+        }
+
+    } else if (0xE0 == (0xF0 & C0) && 3 <= pEnd - pBegin) {
+
+        const int C1 = p [1];
+        const int C2 = p [2];
+        if (0x80 == (0xC0 & C1) && 0x80 == (0xC0 & C2)) {
+            const int Symbol = ((C0 & 0x0F) << 12) | ((C1 & 0x3F) << 6) | (C2 & 0x3F);
+            // must be the shortest form and not a surrogate
+            if (0x800 <= Symbol && !FAIsSurrogate (Symbol)) {
+                *pResult = Symbol;
+                return pBegin + 3;
+            }
+        }
+    }
+
+    // everything else including the errors
+    return FAUtf8ToInt (pBegin, pEnd, pResult);
+}
+
+
 const int FAStrUtf8ToArray (
         const char * pStr,
         __out_ecount(MaxSize) int * pArray,
@@ -255,7 +541,20 @@ const int FAStrUtf8ToArray (
     int i = 0;
     while (pStr < pEnd && pArray < pArrayEnd) {
 
-        pStr = FAUtf8ToInt (pStr, pEnd, pArray);
+        // copy a run of ASCII characters, if any
+        if (0x80 > (unsigned char) *pStr) {
+
+            const int MaxCount = (int) std::min (pEnd - pStr, pArrayEnd - pArray);
+            const int Count = FACopyAscii ((const unsigned char *) pStr,
+                MaxCount, pArray, NULL, 0);
+
+            pStr += Count;
+            pArray += Count;
+            i += Count;
+            continue;
+        }
+
+        pStr = FAUtf8ToInt_inl (pStr, pEnd, pArray);
 
         if (NULL == pStr) {
             // invalid input sequence
@@ -298,7 +597,21 @@ const int FAStrUtf8ToArray (
     while (pStr < pEnd && pArray < pArrayEnd) {
 
         const int Offset = (int) (pStr - pBegin);
-        pStr = FAUtf8ToInt (pStr, pEnd, pArray);
+
+        // copy a run of ASCII characters, if any
+        if (0x80 > (unsigned char) *pStr) {
+
+            const int MaxCount = (int) std::min (pEnd - pStr, pArrayEnd - pArray);
+            const int Count = FACopyAscii ((const unsigned char *) pStr,
+                MaxCount, pArray, pOffsets + i, Offset);
+
+            pStr += Count;
+            pArray += Count;
+            i += Count;
+            continue;
+        }
+
+        pStr = FAUtf8ToInt_inl (pStr, pEnd, pArray);
 
         if (NULL == pStr) {
             // invalid input sequence
@@ -334,14 +647,14 @@ const int FAStrUtf8AsBytesToArray (
             pStr += 3;
     }
 
-    // process symbol sequence
-    int i = 0;
-    while (pStr < pEnd && pArray < pArrayEnd) {
-        *pArray++ = (unsigned char) *pStr++;
-        i++;
+    // copy all the bytes
+    const int Count = (int) std::min (pEnd - pStr, pArrayEnd - pArray);
+    if (0 >= Count) {
+        return 0;
     }
 
-    return i;
+    return (*FAGetWidenBytes ()) ((const unsigned char *) pStr, Count,
+        pArray, NULL, 0, false);
 }
 
 
@@ -368,16 +681,14 @@ const int FAStrUtf8AsBytesToArray (
             pStr += 3;
     }
 
-    // process symbol sequence
-    int i = 0;
-    while (pStr < pEnd && pArray < pArrayEnd) {
-
-        const int Offset = (int) (pStr - pBegin);
-        *pArray++ = (unsigned char) *pStr++;
-        pOffsets [i++] = Offset;
+    // copy all the bytes
+    const int Count = (int) std::min (pEnd - pStr, pArrayEnd - pArray);
+    if (0 >= Count) {
+        return 0;
     }
 
-    return i;
+    return (*FAGetWidenBytes ()) ((const unsigned char *) pStr, Count,
+        pArray, pOffsets, (int) (pStr - pBegin), false);
 }
 
 
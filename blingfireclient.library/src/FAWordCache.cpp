@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "blingfire-client_src_pch.h"
+#include "FAConfig.h"
+#include "FAWordCache.h"
+
+#include <thread>
+
+namespace BlingFire
+{
+
+FAWordCache::FAWordCache () :
+    m_SetCount (0),
+    m_HitCount (0),
+    m_MissCount (0)
+{}
+
+
+const int FAWordCache::Create (const size_t MaxMemory)
+{
+    Clear ();
+
+    const size_t SetMemory = SetSize * sizeof (int);
+
+    const size_t SetCount = MaxMemory / SetMemory < MaxSetCount ? \
+        MaxMemory / SetMemory : MaxSetCount;
+    if (0 == SetCount) {
+        return 0;
+    }
+
+    // all values are zero-initialized, so all entries are empty
+    std::vector < std::atomic < int > > (SetCount * SetSize).swap (m_Data);
+    m_SetCount = (unsigned int) SetCount;
+
+    return m_SetCount * WayCount;
+}
+
+
+const size_t FAWordCache::GetMemorySize () const
+{
+    return m_Data.size () * sizeof (int);
+}
+
+
+const bool FAWordCache::IsEnabled () const
+{
+    return 0 != m_SetCount;
+}
+
+
+void FAWordCache::Clear ()
+{
+    std::vector < std::atomic < int > > ().swap (m_Data);
+    m_SetCount = 0;
+    m_HitCount = 0;
+    m_MissCount = 0;
+}
+
+
+void FAWordCache::Reset ()
+{
+    for (unsigned int i = 0; i < m_SetCount; ++i) {
+
+        std::atomic < int > * pSet = m_Data.data () + (i * SetSize);
+
+        // take the set, wait if some other thread has it
+        int Seq = pSet [SetSeq].load (std::memory_order_relaxed);
+        while (0 != (Seq & 1) || \
+               !pSet [SetSeq].compare_exchange_weak (Seq, (int) ((unsigned int) Seq + 1), std::memory_order_acquire)) {
+            std::this_thread::yield ();
+            Seq = pSet [SetSeq].load (std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence (std::memory_order_release);
+
+        for (int w = 0; w < WayCount; ++w) {
+            pSet [SetRefs + w].store (0, std::memory_order_relaxed);
+            pSet [SetHashes + w].store (0, std::memory_order_relaxed);
+            pSet [SetEntries + (w * EntrySize) + EntryWordLen].store (0, std::memory_order_relaxed);
+        }
+
+        pSet [SetSeq].store ((int) ((unsigned int) Seq + 2), std::memory_order_release);
+    }
+
+    m_HitCount = 0;
+    m_MissCount = 0;
+}
+
+
+const unsigned int FAWordCache::GetHash (
+        const int * pWord,
+        const int WordLen,
+        const int Tag
+    )
+{
+    unsigned int Hash = 2166136261U ^ (unsigned int) Tag;
+
+    for (int i = 0; i < WordLen; ++i) {
+        Hash = (Hash ^ (unsigned int) pWord [i]) * 16777619U;
+    }
+
+    // mix the bits, the high bits select the set
+    Hash ^= Hash >> 15;
+    Hash *= 0x2C1B3C6DU;
+    Hash ^= Hash >> 12;
+
+    return Hash;
+}
+
+
+const int FAWordCache::Get (
+        const int * pWord,
+        const int WordLen,
+        const int Tag,
+        __out_ecount (MaxOutSize) int * pOut,
+        const int MaxOutSize
+    )
+{
+    if (0 == m_SetCount || 0 >= WordLen || MaxWordLength < WordLen) {
+        return -1;
+    }
+
+    const unsigned int Hash = GetHash (pWord, WordLen, Tag);
+    std::atomic < int > * pSet = m_Data.data () + (GetSet (Hash) * SetSize);
+
+    const int Seq = pSet [SetSeq].load (std::memory_order_acquire);
+    if (0 != (Seq & 1)) {
+        return -1;
+    }
+
+    for (int w = 0; w < WayCount; ++w) {
+
+        if ((int) Hash != pSet [SetHashes + w].load (std::memory_order_relaxed)) {
+            continue;
+        }
+
+        std::atomic < int > * pEntry = pSet + SetEntries + (w * EntrySize);
+
+        if (WordLen != pEntry [EntryWordLen].load (std::memory_order_relaxed) || \
+            Tag != pEntry [EntryTag].load (std::memory_order_relaxed)) {
+            continue;
+        }
+
+        int i = 0;
+        for (; i < WordLen; ++i) {
+            if (pWord [i] != pEntry [EntryWord + i].load (std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        if (i < WordLen) {
+            continue;
+        }
+
+        const int TokenCount = pEntry [EntryTokenCount].load (std::memory_order_relaxed);
+        if (0 > TokenCount || MaxWordLength < TokenCount || (3 * TokenCount) > MaxOutSize) {
+            return -1;
+        }
+
+        for (int j = 0; j < TokenCount; ++j) {
+            const int FromTo = pEntry [EntryTokens + (2 * j) + 1].load (std::memory_order_relaxed);
+            pOut [(3 * j)] = pEntry [EntryTokens + (2 * j)].load (std::memory_order_relaxed);
+            pOut [(3 * j) + 1] = FromTo & 0xFF;
+            pOut [(3 * j) + 2] = FromTo >> 8;
+        }
+
+        // make sure the set was not modified while it was read
+        std::atomic_thread_fence (std::memory_order_acquire);
+        if (Seq != pSet [SetSeq].load (std::memory_order_relaxed)) {
+            return -1;
+        }
+
+        // mark the entry as recently used, avoid writing if it is marked
+        if (0 == pSet [SetRefs + w].load (std::memory_order_relaxed)) {
+            pSet [SetRefs + w].store (1, std::memory_order_relaxed);
+        }
+
+        return 3 * TokenCount;
+    }
+
+    return -1;
+}
+
+
+void FAWordCache::Put (
+        const int * pWord,
+        const int WordLen,
+        const int Tag,
+        const int * pRes,
+        const int ResSize
+    )
+{
+    if (0 == m_SetCount || 0 >= WordLen || MaxWordLength < WordLen || \
+        0 > ResSize || 0 != ResSize % 3 || (3 * MaxWordLength) < ResSize) {
+        return;
+    }
+
+    // check the positions fit the packed representation
+    for (int i = 0; i < ResSize; i += 3) {
+        if ((unsigned int) pRes [i + 1] >= (unsigned int) WordLen || \
+            (unsigned int) pRes [i + 2] >= (unsigned int) WordLen) {
+            return;
+        }
+    }
+
+    const unsigned int Hash = GetHash (pWord, WordLen, Tag);
+    std::atomic < int > * pSet = m_Data.data () + (GetSet (Hash) * SetSize);
+
+    // take the set, give up if some other thread has it
+    int Seq = pSet [SetSeq].load (std::memory_order_relaxed);
+    if (0 != (Seq & 1) || \
+        !pSet [SetSeq].compare_exchange_strong (Seq, (int) ((unsigned int) Seq + 1), std::memory_order_acquire)) {
+        return;
+    }
+    std::atomic_thread_fence (std::memory_order_release);
+
+    // select the entry: an empty one or the first not recently used one
+    int Way = -1;
+
+    for (int w = 0; w < WayCount; ++w) {
+        if (0 == pSet [SetEntries + (w * EntrySize) + EntryWordLen].load (std::memory_order_relaxed)) {
+            Way = w;
+            break;
+        }
+    }
+    if (-1 == Way) {
+        int Hand = pSet [SetHand].load (std::memory_order_relaxed);
+        while (0 != pSet [SetRefs + Hand].load (std::memory_order_relaxed)) {
+            pSet [SetRefs + Hand].store (0, std::memory_order_relaxed);
+            Hand = (Hand + 1) % WayCount;
+        }
+        Way = Hand;
+        pSet [SetHand].store ((Hand + 1) % WayCount, std::memory_order_relaxed);
+    }
+
+    std::atomic < int > * pEntry = pSet + SetEntries + (Way * EntrySize);
+
+    pSet [SetHashes + Way].store ((int) Hash, std::memory_order_relaxed);
+    pEntry [EntryWordLen].store (WordLen, std::memory_order_relaxed);
+    pEntry [EntryTag].store (Tag, std::memory_order_relaxed);
+    pEntry [EntryTokenCount].store (ResSize / 3, std::memory_order_relaxed);
+
+    for (int i = 0; i < WordLen; ++i) {
+        pEntry [EntryWord + i].store (pWord [i], std::memory_order_relaxed);
+    }
+    for (int i = 0; i < ResSize; i += 3) {
+        const int j = EntryTokens + (2 * (i / 3));
+        pEntry [j].store (pRes [i], std::memory_order_relaxed);
+        pEntry [j + 1].store (pRes [i + 1] | (pRes [i + 2] << 8), std::memory_order_relaxed);
+    }
+
+    pSet [SetRefs + Way].store (0, std::memory_order_relaxed);
+
+    // release the set
+    pSet [SetSeq].store ((int) ((unsigned int) Seq + 2), std::memory_order_release);
+}
+
+
+void FAWordCache::AddCounts (const int HitCount, const int MissCount)
+{
+    if (0 != HitCount) {
+        m_HitCount.fetch_add (HitCount, std::memory_order_relaxed);
+    }
+    if (0 != MissCount) {
+        m_MissCount.fetch_add (MissCount, std::memory_order_relaxed);
+    }
+}
+
+
+void FAWordCache::GetCounts (long long * pHitCount, long long * pMissCount) const
+{
+    if (pHitCount) {
+        *pHitCount = m_HitCount.load (std::memory_order_relaxed);
+    }
+    if (pMissCount) {
+        *pMissCount = m_MissCount.load (std::memory_order_relaxed);
+    }
+}
+
+}
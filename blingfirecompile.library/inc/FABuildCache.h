@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#ifndef _FA_BUILDCACHE_H_
+#define _FA_BUILDCACHE_H_
+
+#include "FAConfig.h"
+
+#include <string>
+#include <vector>
+
+namespace BlingFire
+{
+
+///
+/// Content-addressed cache of the build stage outputs. The key of a stage
+/// is a 64-bit FNV-1a hash of its command line and of the contents of its
+/// input files, the outputs are kept in the cache directory as <key>.<i>
+/// files.
+///
+/// Usage:
+///
+/// 1. AddKey / AddKeyFile for the command line and for every input file
+/// 2. AddOutput for every output file
+/// 3. if Restore () returns false, run the stage and call Store ()
+///
+/// Notes:
+///
+/// 1. The entries are written under a temporary name and renamed, so the
+///    concurrent builds sharing the cache see either a complete entry or
+///    none at all.
+/// 2. The key covers only the data added with AddKey / AddKeyFile, e.g. if
+///    a stage is a script the programs it runs should be added explicitly.
+///
+
+class FABuildCache {
+
+public:
+    FABuildCache ();
+
+public:
+    /// sets up the cache directory, should exist
+    void SetCacheDir (const char * pDir);
+    /// adds a string (e.g. a command line argument) to the key
+    void AddKey (const char * pStr, const size_t Size);
+    /// adds the contents of the file to the key
+    void AddKeyFile (const char * pFileName);
+    /// adds an output file of the stage
+    void AddOutput (const char * pFileName);
+    /// returns the key of the stage
+    const unsigned long long GetKey () const;
+    /// copies the outputs from the cache, returns false if there is no entry
+    const bool Restore () const;
+    /// copies the outputs into the cache
+    void Store () const;
+    /// returns object into the initial state (the cache directory is kept)
+    void Clear ();
+
+private:
+    // updates the key with the data
+    inline void UpdateKey (const unsigned char * pData, const size_t Size);
+    // returns the entry file name of the i-th output
+    const std::string GetEntryName (const int i) const;
+    // copies the file, returns false if pFrom cannot be read
+    static const bool CopyFile (const char * pFrom, const char * pTo);
+
+private:
+    // the cache directory
+    std::string m_dir;
+    // the key
+    unsigned long long m_Key;
+    // the output files
+    std::vector < std::string > m_outputs;
+
+    enum {
+        BufferSize = 65536,
+    };
+};
+
+}
+
+#endif
@@ -9,9 +9,7 @@
 
 #include "FAConfig.h"
 #include "FAChain2NumA.h"
-#include "FAMap_judy.h"
 #include "FAArray_t.h"
-#include "FAArray_cont_t.h"
 #include "FAHeap_t.h"
 
 namespace BlingFire
@@ -19,6 +17,21 @@ namespace BlingFire
 
 class FAAllocatorA;
 
+///
+/// Chain -> Value map, the chains are numbered in the order they are added
+/// (the indices of the removed chains are reused, the smallest first).
+///
+/// Implementation notes:
+///
+/// 1. The chains are kept in a flat open-addressing table of < Hash, Idx >
+///    slots with the linear probing, the 64-bit hash of each chain is
+///    computed once, so the table grows without touching the chains and
+///    the chains are compared only if the hashes are equal.
+/// 2. The chains are copied into big memory blocks, the copies never move,
+///    so the pointers returned by GetChain stay valid until the chain is
+///    removed. The memory of the removed chains is reused for the chains
+///    of the same size.
+///
 
 class FAChain2Num_hash : public FAChain2NumA {
 
@@ -50,36 +63,65 @@ public:
 
 private:
     // generates hash-key for a given chain
-    inline static const int Chain2Key (const int * pChain, const int Size);
+    inline static const unsigned long long Chain2Hash (
+            const int * pChain,
+            const int Size
+        );
     // identifies whether chains are equal
     inline static const bool Equal (
             const int * pChain1,
             const int * pChain2,
             const int Size
         );
+    // returns the slot of the chain or of the first empty slot after it,
+    // if the chain is not in the map
+    inline const unsigned int Chain2Slot (
+            const int * pChain,
+            const int Size,
+            const unsigned long long Hash
+        ) const;
     // finds index by the given chains or returns -1
     inline const int Chain2Idx (const int * pChain, const int Size) const;
     // associates < chain, value > pair with a new idx, returns new idx
     inline const int AddNewChain (
-            const int * pChain, 
-            const int Size, 
+            const int * pChain,
+            const int Size,
             const int Value
         );
-    // adds new collition set with two initial values
-    inline const int AddNewCSet (const int i1, const int i2);
+    // returns memory for a chain copy of Size + 1 ints
+    inline int * AllocChain (const int Size);
+    // returns the memory of the chain copy for reuse
+    inline void FreeChain (int * pChainCopy);
+    // makes a table of SlotCount slots and moves all the chains into it
+    void Rehash (const unsigned int SlotCount);
 
 private:
-    // Hash key to index mapping:
-    // if idx > 0 then 
-    //   i = idx - 1;
-    // else if idx < 0 then
-    //   j = (-idx) - 1;
-    // else
-    //   DebugLogAssert (0);
-    FAMap_judy m_key2idx;
-    // Storage of collision sets:
-    // j --> { i_0, i_2, ... , i_n }
-    FAArray_t < FAArray_cont_t < int > > m_csets;
+    // the table slot
+    struct FASlot {
+        unsigned long long m_Hash;
+        int m_Idx;
+    };
+
+    enum {
+        // slot indices
+        EmptyIdx = -1,
+        DeletedIdx = -2,
+        // the smallest table size
+        MinSlotCount = 16,
+        // the size of the memory block in ints
+        BlockSize = 65536,
+        // the chains of this or bigger size get a block of their own
+        MaxBlockChainSize = BlockSize / 8,
+        // the removed chains shorter than this are reused
+        MaxFreeChainSize = 32,
+    };
+
+    // the hash table, the number of slots is a power of 2
+    FASlot * m_pSlots;
+    unsigned int m_SlotCount;
+    // number of the slots with chains and with deleted chains
+    unsigned int m_UsedCount;
+    unsigned int m_DeletedCount;
     // Two parallel arrays (chains and coresponding values):
     // i --> chain, array of the following format: [ N, a_1, a_2, ..., a_N ]
     FAArray_t < int * > m_i2chain;
@@ -87,13 +129,44 @@ private:
     FAArray_t < int > m_i2value;
     // tracks empty deleted i-s due to deleted chains
     FAHeap_t < int > m_i_gaps;
-    // tracks empty deleted j-s due to deleted collision sets
-    FAHeap_t < int > m_j_gaps;
+    // memory blocks the chain copies are kept in
+    FAArray_t < int * > m_blocks;
+    // free space of the last block
+    int * m_pBlockPos;
+    int m_BlockLeft;
+    // lists of the removed chain copies by size, a pointer to the next
+    // copy is kept in place of the copy
+    int * m_pFree [MaxFreeChainSize];
     // allocator
     FAAllocatorA * m_pAlloc;
 
 };
 
+
+inline const int FAChain2Num_hash::
+    GetChain (const int Idx, const int ** ppChain) const
+{
+    DebugLogAssert (ppChain);
+    DebugLogAssert (m_i2chain.size () == m_i2value.size ());
+    DebugLogAssert (0 <= Idx && (unsigned int) Idx < m_i2chain.size ());
+
+    const int * pStoredChain = m_i2chain [Idx];
+
+    // see whether chain was not deleted and we are not in the "gap"
+    if (pStoredChain) {
+
+        const int Size = *pStoredChain++;
+        *ppChain = pStoredChain;
+
+        return Size;
+
+    } else {
+
+        *ppChain = NULL;
+        return -1;
+    }
+}
+
 }
 
 #endif
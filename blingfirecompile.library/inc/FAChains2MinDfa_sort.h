@@ -61,12 +61,10 @@ public:
         __out_ecount_opt (MaxIwCount) int * pIws, 
         const int MaxIwCount
     ) const;
+  const int GetIWs (const int State, const int ** ppIws) const;
   const bool IsFinal (const int State) const;
   const int GetDest (const int State, const int Iw) const;
 
-  // additional
-  const int GetIWs (const int State, const int ** ppIws) const;
-
 private:
 
   /// the following methods are not implemented
@@ -40,6 +40,9 @@ public:
 public:
     /// sets up key's output stream, can be NULL (no output in this case)
     void SetKeyOs (std::ostream * pOs);
+    /// sets up key's output array, can be NULL (no output in this case),
+    /// each key is appended as [N, a_1, ..., a_N] (with InfoId, if NoK2I)
+    void SetKeyArray (FAArray_cont_t < int > * pKeys);
     /// sets up output base (16 by default)
     void SetBase (const int Base);
     /// sets up number of characters per value (4 by default)
@@ -95,6 +98,8 @@ private:
     int m_NumSize;
     // output stream for keys
     std::ostream * m_pOs;
+    // output array for keys
+    FAArray_cont_t < int > * m_pKeys;
     // helpers
     int m_Freq;
     FAArray_cont_t < int > m_Set;
@@ -70,9 +70,6 @@ private:
     FAArray_cont_t < int > m_ows;
 	// temporary storage for final states
     FAArray_cont_t < int > m_finals;
-    // alphabet
-    const int * m_pAlphabet;
-    int m_AlphabetSize;
 };
 
 }
@@ -40,6 +40,11 @@ public:
             __out_ecount_opt (MaxIwCount) int * pIws,
             const int MaxIwCount
         ) const = 0;
+  /// returns the Iws of the outgoing transitions of the State (some of them
+  /// may still have no destination), returns -1 if the container does not
+  /// keep them per state, the whole alphabet should be checked in this case
+  /// (see FAGetStateIws)
+  virtual const int GetIWs (const int State, const int ** ppIws) const = 0;
 
 /// write interface
 public:
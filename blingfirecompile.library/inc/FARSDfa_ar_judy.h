@@ -38,6 +38,7 @@ class FARSDfa_ar_judy : public FARSDfaA {
         __out_ecount_opt (MaxIwCount) int * pIws, 
         const int MaxIwCount
     ) const;
+  const int GetIWs (const int State, const int ** ppIws) const;
   const bool IsFinal (const int State) const;
   const int GetDest (const int State, const int Iw) const;
 
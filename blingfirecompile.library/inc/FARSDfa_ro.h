@@ -36,6 +36,7 @@ public:
             __out_ecount_opt (MaxIwCount) int * pIws, 
             const int MaxIwCount
         ) const;
+    const int GetIWs (const int State, const int ** ppIws) const;
     const int GetMaxState () const;
     const int GetMaxIw () const;
     const int GetFinals (const int ** ppStates) const;
@@ -61,13 +62,18 @@ public:
     void Prepare ();
     void Clear ();
 
+private:
+    // sorts and uniques the alphabet
+    inline void MergeIws () const;
+
 private:
     /// State --> <IwsSetId1, DstsSetId2>
     FAArray_cont_t < int > m_State2Sets;
     /// keeps SetId <--> Set mapping
     FAChain2Num_hash m_Sets;
-    /// keeps alphabet
-    FAArray_cont_t < int > m_iws;
+    /// keeps alphabet, the first m_SortedIwCount Iws are sorted and uniqued
+    /// the new Iws are appended and merged in once there are enough of them
+    mutable FAArray_cont_t < int > m_iws;
     /// set of final states
     FAArray_cont_t < int > m_finals;
     /// the initial state
@@ -75,6 +81,8 @@ private:
     /// Max State/Iw
     int m_MaxState;
     int m_MaxIw;
+    /// the number of sorted Iws in m_iws
+    mutable int m_SortedIwCount;
 
     /// temporary containers
 
@@ -45,6 +45,7 @@ public:
             __out_ecount_opt (MaxIwCount) int * pIws, 
             const int MaxIwCount
         ) const;
+    const int GetIWs (const int State, const int ** ppIws) const;
     const int GetMaxState () const;
     const int GetMaxIw () const;
     const int GetFinals (const int ** ppStates) const;
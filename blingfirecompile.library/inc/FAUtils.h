@@ -100,6 +100,20 @@ void FACopyDfa2Nfa (FARSNfaA * pDstNfa, const FARSDfaA * pSrcDfa);
 /// makes an NFA -> DFA copy, possible only if FAIsDfa(pNfa) is true
 void FACopyNfa2Dfa (FARSDfaA * pDstDfa, const FARSNfaA * pSrcNfa);
 
+/// returns sorted Iws to check the outgoing transitions of the State with,
+/// these are the State's own Iws if pDfa keeps them sorted per state or the
+/// whole alphabet otherwise
+const int FAGetStateIws (
+        const FARSDfaA * pDfa,
+        const int State,
+        const int ** ppIws
+    );
+
+/// makes a DFA -> DFA copy, the calls are made in the same order as if
+/// the pSrcDfa was printed and read back with the FAAutIOTools, the final
+/// states of the pSrcDfa should be sorted
+void FACopyDfa (FARSDfaA * pDstDfa, const FARSDfaA * pSrcDfa);
+
 
 /// returns true if FAMultiMapA is empty
 const bool FAIsEmpty (const FAMultiMapA * pMMap);
@@ -352,9 +352,12 @@ void FAAutIOTools::
   // print out the transitions
   for (int i = 0; i <= MaxState; ++i) {
 
-    for (int iw_idx = 0; iw_idx < IwCount; ++iw_idx) {
+    const int * pStateIws = NULL;
+    const int StateIwCount = FAGetStateIws (pDFA, i, &pStateIws);
+
+    for (int iw_idx = 0; iw_idx < StateIwCount; ++iw_idx) {
 
-      const int Iw = pIws [iw_idx];
+      const int Iw = pStateIws [iw_idx];
 
       // get outgoing arcs for the Iw
       const int DstState = pDFA->GetDest (i, Iw);
@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "blingfire-compile_src_pch.h"
+#include "FAConfig.h"
+#include "FABuildCache.h"
+#include "FAException.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace BlingFire
+{
+
+// FNV-1a 64-bit parameters
+static const unsigned long long FnvOffset = 14695981039346656037ULL;
+static const unsigned long long FnvPrime = 1099511628211ULL;
+
+
+FABuildCache::FABuildCache () :
+    m_Key (FnvOffset)
+{}
+
+
+void FABuildCache::SetCacheDir (const char * pDir)
+{
+    DebugLogAssert (pDir);
+
+    m_dir = pDir;
+
+    if (!m_dir.empty () && '/' != m_dir [m_dir.size () - 1]) {
+        m_dir += '/';
+    }
+}
+
+
+inline void FABuildCache::
+    UpdateKey (const unsigned char * pData, const size_t Size)
+{
+    DebugLogAssert (pData || 0 == Size);
+
+    unsigned long long Key = m_Key;
+
+    for (size_t i = 0; i < Size; ++i) {
+        Key ^= pData [i];
+        Key *= FnvPrime;
+    }
+
+    m_Key = Key;
+}
+
+
+void FABuildCache::AddKey (const char * pStr, const size_t Size)
+{
+    // the size makes the boundaries between the strings unambiguous
+    const unsigned long long Size64 = Size;
+    UpdateKey ((const unsigned char *) &Size64, sizeof (Size64));
+    UpdateKey ((const unsigned char *) pStr, Size);
+}
+
+
+void FABuildCache::AddKeyFile (const char * pFileName)
+{
+    DebugLogAssert (pFileName);
+
+    FILE * file = NULL;
+    int res = fopen_s (&file, pFileName, "rb");
+
+    if (0 != res || NULL == file) {
+        throw FAException (FAMsg::ReadError, __FILE__, __LINE__);
+    }
+
+    std::vector < unsigned char > buff (BufferSize);
+    unsigned long long FileSize = 0;
+
+    while (true) {
+
+        const size_t ActSize = fread (buff.data (), 1, BufferSize, file);
+        UpdateKey (buff.data (), ActSize);
+        FileSize += ActSize;
+
+        if (BufferSize != ActSize) {
+            break;
+        }
+    }
+
+    const bool fError = 0 != ferror (file);
+    fclose (file);
+
+    if (fError) {
+        throw FAException (FAMsg::ReadError, __FILE__, __LINE__);
+    }
+
+    UpdateKey ((const unsigned char *) &FileSize, sizeof (FileSize));
+}
+
+
+void FABuildCache::AddOutput (const char * pFileName)
+{
+    DebugLogAssert (pFileName);
+    m_outputs.push_back (pFileName);
+}
+
+
+const unsigned long long FABuildCache::GetKey () const
+{
+    return m_Key;
+}
+
+
+const std::string FABuildCache::GetEntryName (const int i) const
+{
+    char Buff [64];
+    snprintf (Buff, sizeof (Buff), "%016llx.%d", m_Key, i);
+
+    return m_dir + Buff;
+}
+
+
+const bool FABuildCache::CopyFile (const char * pFrom, const char * pTo)
+{
+    DebugLogAssert (pFrom && pTo);
+
+    FILE * in_file = NULL;
+    int res = fopen_s (&in_file, pFrom, "rb");
+
+    if (0 != res || NULL == in_file) {
+        return false;
+    }
+
+    FILE * out_file = NULL;
+    res = fopen_s (&out_file, pTo, "wb");
+
+    if (0 != res || NULL == out_file) {
+        fclose (in_file);
+        throw FAException (FAMsg::WriteError, __FILE__, __LINE__);
+    }
+
+    std::vector < unsigned char > buff (BufferSize);
+    bool fError = false;
+
+    while (true) {
+
+        const size_t ActSize = fread (buff.data (), 1, BufferSize, in_file);
+
+        if (ActSize != fwrite (buff.data (), 1, ActSize, out_file)) {
+            fError = true;
+            break;
+        }
+        if (BufferSize != ActSize) {
+            fError = 0 != ferror (in_file);
+            break;
+        }
+    }
+
+    fclose (in_file);
+
+    if (0 != fclose (out_file) || fError) {
+        remove (pTo);
+        throw FAException (FAMsg::IOError, __FILE__, __LINE__);
+    }
+
+    return true;
+}
+
+
+const bool FABuildCache::Restore () const
+{
+    const int Count = (int) m_outputs.size ();
+
+    // see whether the entry is complete
+    for (int i = 0; i < Count; ++i) {
+
+        FILE * file = NULL;
+        const std::string Entry = GetEntryName (i);
+        const int res = fopen_s (&file, Entry.c_str (), "rb");
+
+        if (0 != res || NULL == file) {
+            return false;
+        }
+
+        fclose (file);
+    }
+
+    for (int i = 0; i < Count; ++i) {
+
+        const std::string Entry = GetEntryName (i);
+
+        if (!CopyFile (Entry.c_str (), m_outputs [i].c_str ())) {
+            throw FAException (FAMsg::ReadError, __FILE__, __LINE__);
+        }
+    }
+
+    return true;
+}
+
+
+void FABuildCache::Store () const
+{
+    const int Count = (int) m_outputs.size ();
+
+    // a name no other writer uses
+    const unsigned long long Unique = (unsigned long long)
+        std::chrono::steady_clock::now ().time_since_epoch ().count () ^
+        (unsigned long long) std::hash < std::thread::id > () (std::this_thread::get_id ()) ^
+        (unsigned long long) (size_t) this;
+
+    char Suffix [64];
+    snprintf (Suffix, sizeof (Suffix), ".tmp.%016llx", Unique);
+
+    for (int i = 0; i < Count; ++i) {
+
+        const std::string Entry = GetEntryName (i);
+        const std::string TmpEntry = Entry + Suffix;
+
+        if (!CopyFile (m_outputs [i].c_str (), TmpEntry.c_str ())) {
+            throw FAException (FAMsg::ReadError, __FILE__, __LINE__);
+        }
+
+        // a concurrent writer may have stored the same entry already
+        if (0 != rename (TmpEntry.c_str (), Entry.c_str ())) {
+            remove (TmpEntry.c_str ());
+        }
+    }
+}
+
+
+void FABuildCache::Clear ()
+{
+    m_Key = FnvOffset;
+    m_outputs.clear ();
+}
+
+}
@@ -16,8 +16,18 @@ namespace BlingFire
 
 
 FAChain2Num_hash::FAChain2Num_hash () :
+  m_pSlots (NULL),
+  m_SlotCount (0),
+  m_UsedCount (0),
+  m_DeletedCount (0),
+  m_pBlockPos (NULL),
+  m_BlockLeft (0),
   m_pAlloc (NULL)
-{}
+{
+  for (int i = 0; i < MaxFreeChainSize; ++i) {
+    m_pFree [i] = NULL;
+  }
+}
 
 
 FAChain2Num_hash::~FAChain2Num_hash ()
@@ -40,17 +50,16 @@ void FAChain2Num_hash::SetAllocator (FAAllocatorA * pAlloc)
 
   if (pAlloc) {
 
-    m_csets.SetAllocator (pAlloc);
-    m_csets.Create ();
-
     m_i2chain.SetAllocator (pAlloc);
     m_i2chain.Create ();
-  
+
     m_i2value.SetAllocator (pAlloc);
     m_i2value.Create ();
 
     m_i_gaps.Create (pAlloc);
-    m_j_gaps.Create (pAlloc);
+
+    m_blocks.SetAllocator (pAlloc);
+    m_blocks.Create ();
   }
 }
 
@@ -60,51 +69,63 @@ void FAChain2Num_hash::Clear ()
     /// TODO: remove this, make all objects created in constructor
     if (m_pAlloc) {
 
-        m_key2idx.Clear ();
+        if (m_pSlots) {
+            FAFree (m_pAlloc, m_pSlots);
+            m_pSlots = NULL;
+        }
+        m_SlotCount = 0;
+        m_UsedCount = 0;
+        m_DeletedCount = 0;
+
         m_i2value.resize (0);
+        m_i2chain.resize (0);
         m_i_gaps.clear ();
-        m_j_gaps.clear ();
 
-        int i;
+        const int BlockCount = m_blocks.size ();
 
-        const int ChainCount = m_i2chain.size ();
-
-        for (i = 0; i < ChainCount; ++i) {
-
-            int * pChain = m_i2chain [i];
-
-            if (pChain) {
-                FAFree (m_pAlloc, pChain);
-            }
+        for (int i = 0; i < BlockCount; ++i) {
+            FAFree (m_pAlloc, m_blocks [i]);
         }
-        m_i2chain.resize (0);
+        m_blocks.resize (0);
 
-        const int ColisionCount = m_csets.size ();
+        m_pBlockPos = NULL;
+        m_BlockLeft = 0;
 
-        for (i = 0; i < ColisionCount; ++i) {
-
-            FAArray_cont_t < int > * pSet = &(m_csets [i]);
-            DebugLogAssert (pSet);
-            pSet->Clear ();
+        for (int i = 0; i < MaxFreeChainSize; ++i) {
+            m_pFree [i] = NULL;
         }
-        m_csets.resize (0);
     }
 }
 
 
-const int FAChain2Num_hash::Chain2Key (const int * pChain, int Size)
+const unsigned long long FAChain2Num_hash::
+    Chain2Hash (const int * pChain, const int Size)
 {
     DebugLogAssert (pChain);
     DebugLogAssert (0 < Size);
 
-    unsigned long Key = 0;
+    unsigned long long Hash = (unsigned long long) Size;
+
+    // two elements at a time
+    int i = 0;
+    for (; i + 1 < Size; i += 2) {
 
-    while (Size--) {
+        const unsigned long long Pair = (unsigned int) pChain [i] | \
+            ((unsigned long long) (unsigned int) pChain [i + 1] << 32);
+
+        Hash = (Hash ^ Pair) * 0x9E3779B97F4A7C15ULL;
+        Hash ^= Hash >> 29;
+    }
+    if (i < Size) {
 
-        Key = Key * 33 + *pChain++;
+        Hash = (Hash ^ (unsigned int) pChain [i]) * 0x9E3779B97F4A7C15ULL;
+        Hash ^= Hash >> 29;
     }
 
-    return int (Key);
+    // mix the high bits into the low ones, the low bits select the slot
+    Hash ^= Hash >> 32;
+
+    return Hash;
 }
 
 
@@ -112,38 +133,31 @@ const bool FAChain2Num_hash::Equal (const int * pChain1,
                                     const int * pChain2,
                                     const int Size)
 {
-  int i = 0;
-
-  while (i < Size) {
-
-    if (*pChain1 != *pChain2)
-      return false;
-
-    pChain1++;
-    pChain2++;
-    i++;
-  }
-
-  return true;
+    return 0 == memcmp (pChain1, pChain2, sizeof (int) * Size);
 }
 
 
-inline const int FAChain2Num_hash::
-    Chain2Idx (const int * pChain, const int Size) const
+inline const unsigned int FAChain2Num_hash::
+    Chain2Slot (const int * pChain,
+                const int Size,
+                const unsigned long long Hash) const
 {
-    DebugLogAssert (pChain && 0 < Size);
+    DebugLogAssert (m_pSlots && 0 < m_SlotCount);
+    DebugLogAssert (m_UsedCount + m_DeletedCount < m_SlotCount);
 
-    const int Key = Chain2Key (pChain, Size);
-    const int * pIdx = m_key2idx.Get (Key);
+    const unsigned int Mask = m_SlotCount - 1;
+    unsigned int s = (unsigned int) Hash & Mask;
 
-    if (pIdx) {
+    while (true) {
 
-        const int Idx = *pIdx;
-        DebugLogAssert (0 != Idx);
+        const FASlot * pSlot = m_pSlots + s;
+        const int i = pSlot->m_Idx;
 
-        if (0 < Idx) {
+        if (EmptyIdx == i) {
+            return s;
+        }
 
-            const int i = Idx - 1;
+        if (Hash == pSlot->m_Hash && 0 <= i) {
 
             // keeps chains in the following format:  [N, a_1, a_2, ..., a_N]
             const int * pStoredChain = m_i2chain [i];
@@ -152,41 +166,28 @@ inline const int FAChain2Num_hash::
 
             if (StoredSize == Size && \
                 true == Equal (pStoredChain, pChain, Size)) {
-                return i;
+                return s;
             }
+        }
 
-        } else {
-
-            const int j = (-Idx) - 1;
-            DebugLogAssert (0 <= j && (unsigned int) j < m_csets.size ());
-
-            const FAArray_cont_t < int > * pCSet = &(m_csets [j]);
-            DebugLogAssert (pCSet);
-
-            const int SetSize = pCSet->size ();
-            const int * pSetBuff = pCSet->begin ();
-            DebugLogAssert (0 < SetSize && pSetBuff);
-
-            for (int k = 0; k < SetSize; ++k) {
-
-                const int i = pSetBuff [k];
-
-                const int * pStoredChain = m_i2chain [i];
-                DebugLogAssert (pStoredChain);
-                const int StoredSize = *pStoredChain++;
+        s = (s + 1) & Mask;
+    }
+}
 
-                if (StoredSize == Size && \
-                    true == Equal (pStoredChain, pChain, Size)) {
-                  return i;
-                }
 
-            } // of for (int k = 0; ...
+inline const int FAChain2Num_hash::
+    Chain2Idx (const int * pChain, const int Size) const
+{
+    DebugLogAssert (pChain && 0 < Size);
 
-        } // of if (0 < Idx) ...
+    if (0 == m_UsedCount) {
+        return -1;
+    }
 
-    } // of if (pIdx) ...
+    const unsigned long long Hash = Chain2Hash (pChain, Size);
+    const unsigned int s = Chain2Slot (pChain, Size, Hash);
 
-    return -1;
+    return m_pSlots [s].m_Idx;
 }
 
 
@@ -210,9 +211,63 @@ const int * FAChain2Num_hash::
 }
 
 
+inline int * FAChain2Num_hash::AllocChain (const int Size)
+{
+    DebugLogAssert (0 < Size);
+
+    // see if there is a removed chain of the same size
+    if (Size < MaxFreeChainSize && NULL != m_pFree [Size]) {
+
+        int * pChainCopy = m_pFree [Size];
+        memcpy (&(m_pFree [Size]), pChainCopy, sizeof (int *));
+
+        return pChainCopy;
+    }
+
+    const int ChainSize = Size + 1;
+
+    // big chains get a block of their own
+    if (MaxBlockChainSize <= ChainSize) {
+
+        int * pBlock = (int *) FAAlloc (m_pAlloc, sizeof (int) * ChainSize);
+        m_blocks.push_back (pBlock);
+
+        return pBlock;
+    }
+
+    if (m_BlockLeft < ChainSize) {
+
+        m_pBlockPos = (int *) FAAlloc (m_pAlloc, sizeof (int) * BlockSize);
+        m_BlockLeft = BlockSize;
+        m_blocks.push_back (m_pBlockPos);
+    }
+
+    int * pChainCopy = m_pBlockPos;
+    m_pBlockPos += ChainSize;
+    m_BlockLeft -= ChainSize;
+
+    return pChainCopy;
+}
+
+
+inline void FAChain2Num_hash::FreeChain (int * pChainCopy)
+{
+    DebugLogAssert (pChainCopy);
+
+    const int Size = *pChainCopy;
+
+    // the Size + 1 ints are enough for a pointer
+    if (Size < MaxFreeChainSize && sizeof (int *) <= sizeof (int) * (Size + 1)) {
+
+        memcpy (pChainCopy, &(m_pFree [Size]), sizeof (int *));
+        m_pFree [Size] = pChainCopy;
+    }
+}
+
+
 inline const int FAChain2Num_hash::
-    AddNewChain (const int * pChain, 
-                 const int Size, 
+    AddNewChain (const int * pChain,
+                 const int Size,
                  const int Value)
 {
     DebugLogAssert (0 < Size && pChain);
@@ -223,8 +278,8 @@ inline const int FAChain2Num_hash::
         throw FAException (FAMsg::LimitIsExceeded, __FILE__, __LINE__);
     }
 
-    // allocate memory for a chain copy
-    int * pChainCopy = (int *) FAAlloc (m_pAlloc, sizeof (int) * (Size + 1));
+    // get memory for a chain copy
+    int * pChainCopy = AllocChain (Size);
     // copy chain
     *pChainCopy = Size;
     memcpy (pChainCopy + 1, pChain, sizeof (int) * Size);
@@ -255,45 +310,49 @@ inline const int FAChain2Num_hash::
 }
 
 
-inline const int FAChain2Num_hash::
-    AddNewCSet (const int i1, const int i2)
+void FAChain2Num_hash::Rehash (const unsigned int SlotCount)
 {
-    int NewJ;
-    FAArray_cont_t < int > * pCSet;
+    DebugLogAssert (0 == (SlotCount & (SlotCount - 1)));
+    DebugLogAssert (m_UsedCount < SlotCount);
 
-    // see if there are no unused collision sets
-    if (m_j_gaps.empty ()) {
+    /// overflow check: sizeof (FASlot) * SlotCount
+    if ((unsigned int) (INT_MAX / sizeof (FASlot)) < SlotCount) {
+        throw FAException (FAMsg::LimitIsExceeded, __FILE__, __LINE__);
+    }
 
-        NewJ = m_csets.size ();
-        m_csets.resize (NewJ + 1);
+    FASlot * pOldSlots = m_pSlots;
+    const unsigned int OldSlotCount = m_SlotCount;
 
-        pCSet = &(m_csets [NewJ]);
-        DebugLogAssert (pCSet);
+    m_pSlots = (FASlot *) FAAlloc (m_pAlloc, sizeof (FASlot) * SlotCount);
+    m_SlotCount = SlotCount;
+    m_DeletedCount = 0;
 
-        pCSet->SetAllocator (m_pAlloc);
-        pCSet->Create (2);
-        pCSet->resize (2);
+    for (unsigned int s = 0; s < SlotCount; ++s) {
+        m_pSlots [s].m_Idx = EmptyIdx;
+    }
 
-    } else {
+    const unsigned int Mask = SlotCount - 1;
 
-        const int * pNewJ = m_j_gaps.top ();
-        DebugLogAssert (pNewJ);
+    // the chains are all different, so only the empty slot is looked up
+    for (unsigned int s = 0; s < OldSlotCount; ++s) {
 
-        NewJ = *pNewJ;
-        m_j_gaps.pop ();
+        const FASlot * pOldSlot = pOldSlots + s;
 
-        pCSet = &(m_csets [NewJ]);
-        DebugLogAssert (pCSet);
+        if (0 <= pOldSlot->m_Idx) {
 
-        pCSet->resize (2);
-    }
+            unsigned int NewS = (unsigned int) pOldSlot->m_Hash & Mask;
 
-    int * pCSetValues = pCSet->begin ();
+            while (EmptyIdx != m_pSlots [NewS].m_Idx) {
+                NewS = (NewS + 1) & Mask;
+            }
 
-    pCSetValues [0] = i1;
-    pCSetValues [1] = i2;
+            m_pSlots [NewS] = *pOldSlot;
+        }
+    }
 
-    return NewJ;
+    if (pOldSlots) {
+        FAFree (m_pAlloc, pOldSlots);
+    }
 }
 
 
@@ -303,7 +362,21 @@ const int FAChain2Num_hash::
     DebugLogAssert (pChain && 0 < Size);
     DebugLogAssert (m_i2chain.size () == m_i2value.size ());
 
-    const int i = Chain2Idx (pChain, Size);
+    // keep at least a quarter of the slots empty
+    if (4 * (m_UsedCount + m_DeletedCount + 1) > 3 * m_SlotCount) {
+
+        unsigned int NewSlotCount = MinSlotCount;
+        while (2 * (m_UsedCount + 1) > NewSlotCount) {
+            NewSlotCount <<= 1;
+        }
+        Rehash (NewSlotCount);
+    }
+
+    const unsigned long long Hash = Chain2Hash (pChain, Size);
+    const unsigned int s = Chain2Slot (pChain, Size, Hash);
+
+    FASlot * pSlot = m_pSlots + s;
+    const int i = pSlot->m_Idx;
 
     // see whether such chain does not exist
     if (-1 == i) {
@@ -311,42 +384,9 @@ const int FAChain2Num_hash::
         // add new <chain, value> pair
         const int NewI = AddNewChain (pChain, Size, Value);
 
-        // generate the Key, 
-        // TODO: fix: Chain2Idx has already made these two look-ups
-        const int Key = Chain2Key (pChain, Size);
-        const int * pIdx = m_key2idx.Get (Key);
-
-        // see whether Key does not exist
-        if (!pIdx) {
-
-            m_key2idx.Set (Key, NewI + 1);
-
-        } else {
-
-            const int Idx = *pIdx;
-
-            // see whether there is collition set
-            if (0 > Idx) {
-
-                const int j = (-Idx) - 1;
-                DebugLogAssert (0 <= j && (unsigned int) j < m_csets.size ());
-
-                FAArray_cont_t < int > * pCSet = &(m_csets [j]);
-                DebugLogAssert (pCSet);
-
-                pCSet->push_back (NewI, 2);
-
-            } else {
-
-                const int OldI = Idx - 1;
-                DebugLogAssert (0 <= OldI);
-
-                const int NewJ = AddNewCSet (OldI, NewI);
-                m_key2idx.Set (Key, - (NewJ + 1));
-
-            } // of if (0 > Idx)
-
-        } // of if (!pIdx) ...
+        pSlot->m_Hash = Hash;
+        pSlot->m_Idx = NewI;
+        m_UsedCount++;
 
         return NewI;
 
@@ -367,30 +407,6 @@ const int FAChain2Num_hash::GetChainCount () const
 }
 
 
-const int FAChain2Num_hash::
-    GetChain (const int Idx, const int ** ppChain) const
-{
-    DebugLogAssert (ppChain);
-    DebugLogAssert (m_i2chain.size () == m_i2value.size ());
-    DebugLogAssert (0 <= Idx && (unsigned int) Idx < m_i2chain.size ());
-
-    const int * pStoredChain = m_i2chain [Idx];
-
-    // see whether chain was not deleted and we are not in the "gap"
-    if (pStoredChain) {
-
-        const int Size = *pStoredChain++;
-        *ppChain = pStoredChain;
-
-        return Size;
-
-    } else {
-
-        return -1;
-    }
-}
-
-
 const int FAChain2Num_hash::GetValue (const int Idx) const
 {
     DebugLogAssert (m_i2chain.size () == m_i2value.size ());
@@ -414,99 +430,32 @@ void FAChain2Num_hash::Remove (const int * pChain, const int Size)
 {
     DebugLogAssert (pChain && 0 < Size);
 
-    const int Key = Chain2Key (pChain, Size);
-    const int * pIdx = m_key2idx.Get (Key);
-
     // have nothing to do
-    if (NULL == pIdx) {
+    if (0 == m_UsedCount) {
         return;
     }
 
-    const int Idx = *pIdx;
-    DebugLogAssert (0 != Idx);
-
-    // see if there are no collisions for this Key
-    if (0 < Idx) {
-
-        const int i = Idx - 1;
-
-        // keeps chains in the followinf format:  [N, a_1, a_2, ..., a_N]
-        int * pStoredChain = m_i2chain [i];
-        DebugLogAssert (pStoredChain);
-        const int StoredSize = *pStoredChain;
-
-        // Make sure stored chain and pChain equal, otherwise we have nothing
-        // to do here.
-        if (StoredSize == Size && \
-            true == Equal (pStoredChain + 1, pChain, Size)) {
-
-            // remove the Key
-            m_key2idx.Remove (Key);
-            // free Stored Chain memory
-            FAFree (m_pAlloc, pStoredChain);
-            m_i2chain [i] = NULL;
-            // put i into deleted indices
-            m_i_gaps.push (i);
-        }
-
-    } else {
-
-        const int j = (-Idx) - 1;
-        DebugLogAssert (0 <= j && (unsigned int) j < m_csets.size ());
-
-        FAArray_cont_t < int > * pCSet = &(m_csets [j]);
-        DebugLogAssert (pCSet);
+    const unsigned long long Hash = Chain2Hash (pChain, Size);
+    const unsigned int s = Chain2Slot (pChain, Size, Hash);
 
-        const int SetSize = pCSet->size ();
-        int * pSetBuff = pCSet->begin ();
-        DebugLogAssert (0 < SetSize && pSetBuff);
+    FASlot * pSlot = m_pSlots + s;
+    const int i = pSlot->m_Idx;
 
-        int k;
-
-        for (k = 0; k < SetSize; ++k) {
-
-            const int i = pSetBuff [k];
-
-            int * pStoredChain = m_i2chain [i];
-            DebugLogAssert (pStoredChain);
-            const int StoredSize = *pStoredChain;
-
-            if (StoredSize == Size && \
-                true == Equal (pStoredChain + 1, pChain, Size)) {
-
-                // free Stored Chain memory
-                FAFree (m_pAlloc, pStoredChain);
-                m_i2chain [i] = NULL;
-                // put i into deleted indices
-                m_i_gaps.push (i);
-                // stop searching, k is the index of matched chain in the set
-                break;
-            }
-
-        } // of for (int k = 0; ...
-
-        // see whether something was deleted
-        if (k < SetSize) {
-
-            // move left all CSet values after k
-            for (; k < SetSize - 1; ++k) {
-                pSetBuff [k] = pSetBuff [k + 1];
-            }
-            pCSet->pop_back ();
-
-            // see whether pCSet contained only 2 elements
-            // (one have been deleted and now there are no collisions)
-            if (2 == SetSize) {
-
-                const int i = (*pCSet) [0];
-                m_key2idx.Set (Key, i + 1);
+    // have nothing to do
+    if (-1 == i) {
+        return;
+    }
 
-                pCSet->resize (0);
-                m_j_gaps.push (j);
-            }
-        } // of if (k < SetSize) ...
+    // keep the slot so the probing does not stop at it
+    pSlot->m_Idx = DeletedIdx;
+    m_UsedCount--;
+    m_DeletedCount++;
 
-    } // of if (0 < Idx) ...
+    // free Stored Chain memory
+    FreeChain (m_i2chain [i]);
+    m_i2chain [i] = NULL;
+    // put i into deleted indices
+    m_i_gaps.push (i);
 }
 
 }
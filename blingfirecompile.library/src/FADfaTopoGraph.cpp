@@ -50,7 +50,7 @@ const int FADfaTopoGraph::GetDstNodes (
     tmp_dst_nodes.resize (0);
 
     const int * pIws;
-    const int IwCount = m_pInDfa->GetIWs (&pIws);
+    const int IwCount = FAGetStateIws (m_pInDfa, Node, &pIws);
 
     for (int iw_idx = 0; iw_idx < IwCount; ++iw_idx) {
 
@@ -27,6 +27,7 @@ FADictSplit::FADictSplit (FAAllocatorA * pAlloc) :
     m_Base (16),
     m_NumSize (4),
     m_pOs (NULL),
+    m_pKeys (NULL),
     m_Freq (0),
     m_Mode (FAFsmConst::DM_TAGS),
     m_NoK2I (false),
@@ -60,6 +61,23 @@ inline void FADictSplit::
 {
     DebugLogAssert (0 < KeySize && pKey);
 
+    // copy the Key into the output array, if needed
+    if (m_pKeys) {
+
+        const int KeyCount = m_NoK2I ? KeySize + 1 : KeySize;
+        const int Offset = m_pKeys->size ();
+
+        m_pKeys->resize (Offset + KeyCount + 1);
+        int * pOut = m_pKeys->begin () + Offset;
+
+        *pOut++ = KeyCount;
+        memcpy (pOut, pKey, sizeof (int) * KeySize);
+
+        if (m_NoK2I) {
+            pOut [KeySize] = SetId + m_InfoBase;
+        }
+    }
+
     // see whether no Key stream output is needed
     if (!m_pOs) {
         return;
@@ -428,6 +446,12 @@ void FADictSplit::SetKeyOs (std::ostream * pOs)
 }
 
 
+void FADictSplit::SetKeyArray (FAArray_cont_t < int > * pKeys)
+{
+    m_pKeys = pKeys;
+}
+
+
 void FADictSplit::SetBase (const int Base)
 {
     m_Base = Base;
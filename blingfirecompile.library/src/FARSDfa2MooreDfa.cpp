@@ -24,9 +24,7 @@ FARSDfa2MooreDfa::FARSDfa2MooreDfa (FAAllocatorA * pAlloc) :
     m_pState2Ows (NULL),
     m_BaseOw (0),
     m_MaxOw (0),
-    m_KeepOws (false),
-    m_pAlphabet (NULL),
-    m_AlphabetSize (0)
+    m_KeepOws (false)
 {
     m_ows.SetAllocator (pAlloc);
     m_ows.Create ();
@@ -87,13 +85,16 @@ void FARSDfa2MooreDfa::ProcessState (const int State)
 {
     DebugLogAssert (m_pInDfa);
     DebugLogAssert (m_pOutDfa && (m_pState2Ows || m_pState2Ow));
-    DebugLogAssert (m_pAlphabet);
 
     m_ows.resize (0);
 
-    for (int iw_idx = 0; iw_idx < m_AlphabetSize; ++iw_idx) {
+    // get the Iws to check
+    const int * pIws;
+    const int IwCount = FAGetStateIws (m_pInDfa, State, &pIws);
+
+    for (int iw_idx = 0; iw_idx < IwCount; ++iw_idx) {
 
-        const int Iw = m_pAlphabet [iw_idx];
+        const int Iw = pIws [iw_idx];
         const int DstState = m_pInDfa->GetDest (State, Iw);
 
         if (-1 == DstState)
@@ -186,10 +187,6 @@ void FARSDfa2MooreDfa::Process ()
     m_pOutDfa->SetMaxIw (MaxIw);
     m_pOutDfa->Create ();
 
-    // get alphabet
-    m_AlphabetSize = m_pInDfa->GetIWs (&m_pAlphabet);
-    DebugLogAssert (0 < m_AlphabetSize && m_pAlphabet);
-
     // setup initial state
     const int InitialState = m_pInDfa->GetInitial ();
     m_pOutDfa->SetInitial (InitialState);
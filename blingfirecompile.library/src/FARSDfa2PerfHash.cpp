@@ -84,12 +84,6 @@ void FARSDfa2PerfHash::CalcCds ()
 
     int Cd;
 
-    // get the alphabet
-    const int * pIws;
-    const int IwCount = m_pDfa->GetIWs (&pIws);
-    DebugLogAssert (0 < IwCount && pIws);
-    DebugLogAssert (FAIsSortUniqed (pIws, IwCount));
-
     // traverse states in the reverse topological order
     const int * pOrder;
     const int StateCount = m_sorter.GetTopoOrder (&pOrder);
@@ -107,6 +101,11 @@ void FARSDfa2PerfHash::CalcCds ()
             Cd = 1;
         }
 
+        // get the sorted Iws to check
+        const int * pIws;
+        const int IwCount = FAGetStateIws (m_pDfa, State, &pIws);
+        DebugLogAssert (FAIsSortUniqed (pIws, IwCount));
+
         for (int iw_idx = 0; iw_idx < IwCount; ++iw_idx) {
 
             const int Iw = pIws [iw_idx];
@@ -8,6 +8,7 @@
 #include "FAConfig.h"
 #include "FARSDfaRenum_remove_gaps.h"
 #include "FARSDfaA.h"
+#include "FAUtils.h"
 
 namespace BlingFire
 {
@@ -85,7 +86,7 @@ const bool FARSDfaRenum_remove_gaps::IsUsed (const int State) const
         return true;
 
     const int * pIws;
-    const int IwsCount = m_pDfa->GetIWs (&pIws);
+    const int IwsCount = FAGetStateIws (m_pDfa, State, &pIws);
 
     for (int i = 0; i < IwsCount; ++i) {
 
@@ -315,6 +315,13 @@ const int FARSDfa_ar_judy::
 }
 
 
+const int FARSDfa_ar_judy::GetIWs (const int, const int **) const
+{
+    // the Iws are not kept per state
+    return -1;
+}
+
+
 const int FARSDfa_ar_judy::GetDest (const int State, const int Iw) const
 {
     if (FAFsmConst::DFA_DEAD_STATE == State) {
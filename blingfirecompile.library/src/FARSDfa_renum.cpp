@@ -152,6 +152,20 @@ const int FARSDfa_renum::
 }
 
 
+const int FARSDfa_renum::GetIWs (const int State, const int ** ppIws) const
+{
+    DebugLogAssert (m_pDfa);
+
+    if (FAFsmConst::DFA_DEAD_STATE == State) {
+        return 0;
+    }
+
+    // the Iws are the same, only the destination states are renumbered
+    const int OldState = m_new2old [State];
+    return m_pDfa->GetIWs (OldState, ppIws);
+}
+
+
 const bool FARSDfa_renum::IsFinal (const int State) const
 {
     DebugLogAssert (m_pDfa);
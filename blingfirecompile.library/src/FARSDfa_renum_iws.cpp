@@ -127,6 +127,13 @@ const int FARSDfa_renum_iws::
 }
 
 
+const int FARSDfa_renum_iws::GetIWs (const int, const int **) const
+{
+    // the new Iws are not kept per state
+    return -1;
+}
+
+
 const bool FARSDfa_renum_iws::IsFinal (const int State) const
 {
     DebugLogAssert (m_pDfa);
@@ -19,6 +19,7 @@ FARSDfa_ro::FARSDfa_ro (FAAllocatorA * pAlloc) :
     m_Initial (-1),
     m_MaxState (-1),
     m_MaxIw (-1),
+    m_SortedIwCount (0),
     m_TmpState (-1)
 {
     m_State2Sets.SetAllocator (pAlloc);
@@ -137,19 +138,31 @@ void FARSDfa_ro::
 
     /// update alphabet
 
-    const int OldIwsSize = m_iws.size ();
-
     for (int i = 0; i < Count; ++i) {
         const int Iw = pIws [i];
-        if (-1 == FAFind_log (m_iws.begin (), OldIwsSize, Iw)) {
+        if (-1 == FAFind_log (m_iws.begin (), m_SortedIwCount, Iw)) {
             m_iws.push_back (Iw);
         }
     }
 
-    const int NewIwsSize = m_iws.size ();
+    // sorting the alphabet on each new Iw is quadratic for big alphabets
+    const int NewIwsCount = m_iws.size () - m_SortedIwCount;
+
+    if (NewIwsCount > m_SortedIwCount) {
+        MergeIws ();
+    }
+}
+
+
+inline void FARSDfa_ro::MergeIws () const
+{
+    int * pIws = m_iws.begin ();
+    const int OldCount = m_iws.size ();
 
-    if (NewIwsSize != OldIwsSize) {
-        std::sort (m_iws.begin (), m_iws.end ());
+    if (m_SortedIwCount != OldCount) {
+        const int NewCount = FASortUniq (pIws, pIws + OldCount);
+        m_iws.resize (NewCount);
+        m_SortedIwCount = NewCount;
     }
 }
 
@@ -199,6 +212,8 @@ void FARSDfa_ro::Prepare ()
         m_tmp_dsts.Create ();
     }
 
+    MergeIws ();
+
     int * pFinals = m_finals.begin ();
     const int OldCount = m_finals.size ();
 
@@ -214,6 +229,7 @@ void FARSDfa_ro::Clear ()
     m_Initial = -1;
     m_MaxState = -1;
     m_MaxIw = -1;
+    m_SortedIwCount = 0;
     m_TmpState = -1;
 
     m_finals.Clear ();
@@ -247,6 +263,8 @@ const int FARSDfa_ro::GetIWs (const int ** ppIws) const
 {
     DebugLogAssert (ppIws);
 
+    MergeIws ();
+
     *ppIws = m_iws.begin ();
     const int IwsCount = m_iws.size ();
 
@@ -268,6 +286,25 @@ const int FARSDfa_ro::
 }
 
 
+const int FARSDfa_ro::GetIWs (const int State, const int ** ppIws) const
+{
+    DebugLogAssert (ppIws);
+
+    const int I = State << 1;
+
+    if (0 <= State && (unsigned int) I < m_State2Sets.size ()) {
+
+        const int Idx1 = m_State2Sets [I];
+
+        if (-1 != Idx1) {
+            return m_Sets.GetChain (Idx1, ppIws);
+        }
+    }
+
+    return 0;
+}
+
+
 const int FARSDfa_ro::GetDest (const int State, const int Iw) const
 {
     DebugLogAssert (0 <= State);
@@ -298,7 +335,7 @@ const int FARSDfa_ro::GetDest (const int State, const int Iw) const
 
             DebugLogAssert (DstIdx < Count);
 
-            const int * pDsts;
+            const int * pDsts = NULL;
 #ifndef NDEBUG
             const int Count2 = 
 #endif
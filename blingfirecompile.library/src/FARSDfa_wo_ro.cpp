@@ -267,6 +267,13 @@ const int FARSDfa_wo_ro::
 }
 
 
+const int FARSDfa_wo_ro::GetIWs (const int State, const int ** ppIws) const
+{
+    DebugLogAssert (!m_IsWo);
+    return m_ro_dfa.GetIWs (State, ppIws);
+}
+
+
 const int FARSDfa_wo_ro::GetDest (const int State, const int Iw) const
 {
     DebugLogAssert (!m_IsWo);
@@ -491,6 +491,67 @@ void FACopyNfa2Dfa (FARSDfaA * pDstDfa, const FARSNfaA * pSrcNfa)
 }
 
 
+const int FAGetStateIws (
+        const FARSDfaA * pDfa,
+        const int State,
+        const int ** ppIws
+    )
+{
+    DebugLogAssert (pDfa && ppIws);
+
+    const int IwCount = pDfa->GetIWs (State, ppIws);
+
+    if (0 <= IwCount && FAIsSortUniqed (*ppIws, IwCount)) {
+        return IwCount;
+    }
+
+    return pDfa->GetIWs (ppIws);
+}
+
+
+void FACopyDfa (FARSDfaA * pDstDfa, const FARSDfaA * pSrcDfa)
+{
+    DebugLogAssert (pDstDfa && pSrcDfa);
+    DebugLogAssert (pDstDfa != pSrcDfa);
+
+    pDstDfa->Clear ();
+
+    const int MaxState = pSrcDfa->GetMaxState ();
+    const int MaxIw = pSrcDfa->GetMaxIw ();
+
+    pDstDfa->SetMaxState (MaxState);
+    pDstDfa->SetMaxIw (MaxIw);
+    pDstDfa->Create ();
+
+    pDstDfa->SetInitial (pSrcDfa->GetInitial ());
+
+    for (int State = 0; State <= MaxState; ++State) {
+
+        const int * pIws = NULL;
+        const int IwCount = FAGetStateIws (pSrcDfa, State, &pIws);
+
+        for (int i = 0; i < IwCount; ++i) {
+
+            const int Iw = pIws [i];
+            const int DstState = pSrcDfa->GetDest (State, Iw);
+
+            if (-1 != DstState) {
+                pDstDfa->SetTransition (State, Iw, DstState);
+            }
+        }
+    }
+
+    const int * pFinals = NULL;
+    const int FinalCount = pSrcDfa->GetFinals (&pFinals);
+    LogAssert (0 < FinalCount && pFinals);
+    LogAssert (FAIsSortUniqed (pFinals, FinalCount));
+
+    pDstDfa->SetFinals (pFinals, FinalCount);
+
+    pDstDfa->Prepare ();
+}
+
+
 const bool FAIsEmpty (const FAMultiMapA * pMMap)
 {
     DebugLogAssert (pMMap);
@@ -0,0 +1,880 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FALimits.h"
+#include "FAUtf8Utils.h"
+#include "FAException.h"
+#include "blingfiretokdll.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+const char * g_pLdbDir = "ldbsrc/ldb";
+const char * g_pOutFile = NULL;
+std::vector < std::string > g_InFiles;
+std::vector < int > g_Lengths;
+std::vector < int > g_Threads;
+std::vector < std::string > g_Apis;
+long long g_Bytes = 4000000;
+int g_MinCalls = 5;
+
+
+///
+/// every allocation of the process is counted, so the allocations per call
+/// of the library are known without instrumenting it
+///
+
+std::atomic < unsigned long long > g_AllocCount (0);
+
+void * operator new (size_t Size)
+{
+    g_AllocCount++;
+    void * p = malloc (0 < Size ? Size : 1);
+    if (NULL == p) {
+        throw std::bad_alloc ();
+    }
+    return p;
+}
+
+void * operator new [] (size_t Size)
+{
+    return operator new (Size);
+}
+
+void * operator new (size_t Size, const std::nothrow_t &) noexcept
+{
+    g_AllocCount++;
+    return malloc (0 < Size ? Size : 1);
+}
+
+void * operator new [] (size_t Size, const std::nothrow_t &) noexcept
+{
+    return operator new (Size, std::nothrow);
+}
+
+void operator delete (void * p) noexcept
+{
+    free (p);
+}
+
+void operator delete [] (void * p) noexcept
+{
+    free (p);
+}
+
+void operator delete (void * p, size_t) noexcept
+{
+    free (p);
+}
+
+void operator delete [] (void * p, size_t) noexcept
+{
+    free (p);
+}
+
+
+void usage () {
+
+  std::cout << "\n\
+Usage: bf_bench [OPTIONS]\n\
+\n\
+This program measures the speed of the blingfiretokdll APIs on synthetic\n\
+and bundled texts of several lengths and with several threads and prints\n\
+a JSON report: throughput (MB/s, tokens/s), p50/p99 latency of a call and\n\
+the number of allocations per call. The synthetic texts are the same from\n\
+run to run, so the reports of different builds can be compared.\n\
+\n\
+  --ldb-dir=<dir> - reads the models from the <dir> directory,\n\
+    ldbsrc/ldb is used by default, the APIs which need a missing model\n\
+    are skipped\n\
+\n\
+  --in=<input> - adds the text of the <input> file to the corpora, can be\n\
+    used several times, README.md is used by default if it exists\n\
+\n\
+  --out=<output> - writes the report to the <output> file,\n\
+    stdout is used by default\n\
+\n\
+  --lengths=N1,N2,... - the lengths of the texts in bytes, the corpora are\n\
+    repeated or cut to each length, 100,10000,1000000 is used by default\n\
+\n\
+  --threads=N1,N2,... - the numbers of threads calling the APIs at the same\n\
+    time (the threads of the *_parallel APIs), 1 and the number of hardware\n\
+    threads are used by default\n\
+\n\
+  --bytes=N - processes about N bytes per measurement, 4000000 by default\n\
+\n\
+  --min-calls=N - makes at least N calls per measurement, 5 by default\n\
+\n\
+  --apis=A1,A2,... - measures the listed APIs only, all by default:\n\
+    sentences, words, words_parallel, wp, sp, bpe, hashes, hyphenation,\n\
+    ids_to_text\n\
+";
+
+}
+
+
+// splits the comma separated list
+const std::vector < std::string > Split (const char * pList)
+{
+    std::vector < std::string > Items;
+    std::stringstream ss (pList);
+    std::string Item;
+    while (std::getline (ss, Item, ',')) {
+        if (!Item.empty ()) {
+            Items.push_back (Item);
+        }
+    }
+    return Items;
+}
+
+
+const std::vector < int > SplitInts (const char * pList)
+{
+    const std::vector < std::string > Items = Split (pList);
+    std::vector < int > Ints;
+    for (size_t i = 0; i < Items.size (); ++i) {
+        Ints.push_back (atoi (Items [i].c_str ()));
+    }
+    return Ints;
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+  for (; argc--; ++argv){
+
+    if (!strcmp ("--help", *argv)) {
+        usage ();
+        exit (0);
+    }
+    if (0 == strncmp ("--ldb-dir=", *argv, 10)) {
+        g_pLdbDir = &((*argv) [10]);
+        continue;
+    }
+    if (0 == strncmp ("--in=", *argv, 5)) {
+        g_InFiles.push_back (&((*argv) [5]));
+        continue;
+    }
+    if (0 == strncmp ("--out=", *argv, 6)) {
+        g_pOutFile = &((*argv) [6]);
+        continue;
+    }
+    if (0 == strncmp ("--lengths=", *argv, 10)) {
+        g_Lengths = SplitInts (&((*argv) [10]));
+        continue;
+    }
+    if (0 == strncmp ("--threads=", *argv, 10)) {
+        g_Threads = SplitInts (&((*argv) [10]));
+        continue;
+    }
+    if (0 == strncmp ("--bytes=", *argv, 8)) {
+        g_Bytes = atoll (&((*argv) [8]));
+        continue;
+    }
+    if (0 == strncmp ("--min-calls=", *argv, 12)) {
+        g_MinCalls = atoi (&((*argv) [12]));
+        continue;
+    }
+    if (0 == strncmp ("--apis=", *argv, 7)) {
+        g_Apis = Split (&((*argv) [7]));
+        continue;
+    }
+  }
+}
+
+
+///
+/// deterministic synthetic corpora
+///
+
+class FARandom {
+public:
+    FARandom (const unsigned int Seed) : m_Seed (Seed) {}
+    // returns a pseudo-random number in [0, N)
+    const unsigned int Next (const unsigned int N)
+    {
+        m_Seed = m_Seed * 1103515245 + 12345;
+        return (m_Seed >> 16) % N;
+    }
+private:
+    unsigned int m_Seed;
+};
+
+
+void AppendUtf8 (const int C, std::string * pText)
+{
+    char Buff [8];
+    char * pEnd = ::FAIntToUtf8 (C, Buff, sizeof (Buff));
+    if (pEnd) {
+        pText->append (Buff, pEnd - Buff);
+    }
+}
+
+
+// sentences of English words with punctuation and numbers
+const std::string English (const int Length)
+{
+    const char * Words [] = {
+        "the", "of", "and", "to", "in", "is", "was", "for", "that", "with",
+        "model", "text", "token", "sentence", "word", "language", "fast",
+        "processing", "international", "representation", "algorithm",
+        "between", "however", "people", "government", "information",
+        "can't", "it's", "well-known", "state-of-the-art", "e.g.", "Dr.",
+        "U.S.", "Microsoft", "Seattle", "January", "performance", "results"
+    };
+    const int WordCount = sizeof (Words) / sizeof (Words [0]);
+
+    FARandom Rand (1);
+    std::string Text;
+
+    while ((int) Text.length () < Length) {
+        const int SentLen = 5 + Rand.Next (20);
+        for (int i = 0; i < SentLen; ++i) {
+            std::string Word = Words [Rand.Next (WordCount)];
+            if (0 == i) {
+                Word [0] = (char) toupper (Word [0]);
+            }
+            Text += Word;
+            if (0 == Rand.Next (12)) {
+                Text += " " + std::to_string (Rand.Next (100000));
+            }
+            if (i + 1 < SentLen) {
+                Text += 0 == Rand.Next (10) ? ", " : " ";
+            }
+        }
+        Text += 0 == Rand.Next (8) ? "? " : ". ";
+        if (0 == Rand.Next (10)) {
+            Text += "\n";
+        }
+    }
+    return Text;
+}
+
+
+// CJK text with the ideographic full stops
+const std::string Cjk (const int Length)
+{
+    FARandom Rand (2);
+    std::string Text;
+
+    while ((int) Text.length () < Length) {
+        const int SentLen = 10 + Rand.Next (30);
+        for (int i = 0; i < SentLen; ++i) {
+            AppendUtf8 (0x4E00 + Rand.Next (2000), &Text);
+        }
+        AppendUtf8 (0x3002, &Text);
+    }
+    return Text;
+}
+
+
+// English with URLs, code, accented, Cyrillic and emoji characters
+const std::string Mixed (const int Length)
+{
+    const char * Pieces [] = {
+        "https://www.example.com/path/to/resource?id=12345&token=abcdef#frag",
+        "foo.bar@example.org", "function(a,b){return a.b(c[d]+e)===f?g:h;}",
+        "caf\xC3\xA9", "na\xC3\xAFve", "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82",
+        "\xF0\x9F\x98\x80", "C++", "$1,234.56", "10:30am", "(see above)", "\"quoted\""
+    };
+    const int PieceCount = sizeof (Pieces) / sizeof (Pieces [0]);
+
+    const std::string Words = English (Length);
+
+    FARandom Rand (3);
+    std::string Text;
+    size_t Pos = 0;
+
+    while ((int) Text.length () < Length) {
+        const size_t Next = Words.find (' ', Pos + 1 + Rand.Next (40));
+        if (std::string::npos == Next) {
+            Pos = 0;
+            continue;
+        }
+        Text += Words.substr (Pos, Next - Pos);
+        Text += " ";
+        Text += Pieces [Rand.Next (PieceCount)];
+        Pos = Next;
+    }
+    return Text;
+}
+
+
+// repeats or cuts the text to Length bytes, does not split UTF-8 sequences
+const std::string Resize (const std::string & Text, const int Length)
+{
+    std::string Out;
+    if (Text.empty ()) {
+        return Out;
+    }
+    while ((int) Out.length () < Length) {
+        Out += Text;
+        Out += "\n";
+    }
+    size_t Size = std::min (Out.length (), (size_t) Length);
+    while (0 < Size && 0x80 == (0xC0 & (unsigned char) Out [Size])) {
+        Size--;
+    }
+    Out.resize (Size);
+    return Out;
+}
+
+
+///
+/// measurements
+///
+
+struct FAResult {
+    std::string m_Api;
+    std::string m_Model;
+    std::string m_Corpus;
+    int m_Length;
+    int m_Threads;
+    long long m_Calls;
+    long long m_Bytes;
+    long long m_Tokens;
+    double m_Seconds;
+    double m_P50;
+    double m_P99;
+    double m_AllocsPerCall;
+};
+
+
+// a call of an API, returns the number of tokens or -1 in case of an error,
+// ThreadCount is the number of threads for the *_parallel APIs
+typedef long long (*FACall) (void * pState, const std::string & Text, const int ThreadCount);
+
+
+// the state of an API, per thread
+struct FAApiState {
+    void * m_hModel;
+    void * m_hModel2;
+    std::vector < char > m_Chars;
+    std::vector < int > m_Ints;
+    std::vector < int > m_Ints2;
+    std::vector < int32_t > m_Ids;
+    // the text m_Ids have been computed for, see CallIdsToText
+    const std::string * m_pIdsText;
+    int m_IdCount;
+
+    FAApiState () : m_hModel (NULL), m_hModel2 (NULL), m_pIdsText (NULL), m_IdCount (0) {}
+
+    // makes sure the buffers can keep the results for the text of Size bytes
+    void Reserve (const size_t Size)
+    {
+        const size_t Need = 2 * Size + 16;
+        if (m_Chars.size () < Need) {
+            m_Chars.resize (Need);
+            m_Ints.resize (Need);
+            m_Ints2.resize (Need);
+            m_Ids.resize (Need);
+        }
+    }
+};
+
+
+long long CallSentences (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToSentenceSpansWithModel (Text.c_str (), (int) Text.length (),
+        p->m_Ints.data (), p->m_Ints2.data (), (int) p->m_Ints.size (), p->m_hModel);
+}
+
+long long CallWords (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToWordSpansWithModel (Text.c_str (), (int) Text.length (),
+        p->m_Ints.data (), p->m_Ints2.data (), (int) p->m_Ints.size (), p->m_hModel);
+}
+
+long long CallWordsParallel (void * pState, const std::string & Text, const int ThreadCount)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToWordSpansParallel (Text.c_str (), (int) Text.length (),
+        p->m_Ints.data (), p->m_Ints2.data (), (int) p->m_Ints.size (), p->m_hModel, ThreadCount);
+}
+
+long long CallWp (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToIds_wp (p->m_hModel, Text.c_str (), (int) Text.length (),
+        p->m_Ids.data (), (int) p->m_Ids.size (), 0);
+}
+
+long long CallSp (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToIds_sp (p->m_hModel, Text.c_str (), (int) Text.length (),
+        p->m_Ids.data (), (int) p->m_Ids.size (), 0);
+}
+
+long long CallBpe (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToIds (p->m_hModel, Text.c_str (), (int) Text.length (),
+        p->m_Ids.data (), (int) p->m_Ids.size (), 0);
+}
+
+long long CallHashes (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+    return TextToHashes (Text.c_str (), (int) Text.length (),
+        p->m_Ids.data (), (int) p->m_Ids.size (), 2, 2000000);
+}
+
+// hyphenates each word of the text, the API takes one word at a time
+long long CallHyphenation (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+
+    const int Count = TextToWordSpansWithModel (Text.c_str (), (int) Text.length (),
+        p->m_Ints.data (), p->m_Ints2.data (), (int) p->m_Ints.size (), NULL);
+
+    for (int i = 0; i < Count; ++i) {
+        const int From = p->m_Ints [i];
+        const int Length = p->m_Ints2 [i] - From + 1;
+        // the words longer than the API takes are skipped
+        if (FALimits::MaxWordLen < Length) {
+            continue;
+        }
+        if (0 > WordHyphenationWithModel (Text.c_str () + From, Length,
+                p->m_Chars.data (), (int) p->m_Chars.size (), p->m_hModel, 0x2D)) {
+            return -1;
+        }
+    }
+    return Count;
+}
+
+// decodes the ids of the text, the ids are computed by the sp model once per text
+long long CallIdsToText (void * pState, const std::string & Text, const int)
+{
+    FAApiState * p = (FAApiState *) pState;
+
+    if (&Text != p->m_pIdsText) {
+        p->m_IdCount = TextToIds_sp (p->m_hModel, Text.c_str (), (int) Text.length (),
+            p->m_Ids.data (), (int) p->m_Ids.size (), 0);
+        p->m_pIdsText = &Text;
+    }
+    if (0 >= p->m_IdCount) {
+        return p->m_IdCount;
+    }
+
+    if (0 >= IdsToText (p->m_hModel2, p->m_Ids.data (), p->m_IdCount, p->m_Chars.data (), (int) p->m_Chars.size (), false)) {
+        return -1;
+    }
+    return p->m_IdCount;
+}
+
+
+struct FAApi {
+    const char * m_pName;
+    const char * m_pModel;
+    const char * m_pModel2;
+    FACall m_Call;
+    // the thread count is passed to the call, instead of calling from several threads
+    bool m_fParallel;
+};
+
+const FAApi g_AllApis [] = {
+    { "sentences", NULL, NULL, CallSentences, false },
+    { "words", NULL, NULL, CallWords, false },
+    { "words_parallel", NULL, NULL, CallWordsParallel, true },
+    { "wp", "bert_base_cased_tok.bin", NULL, CallWp, false },
+    { "sp", "xlnet.bin", NULL, CallSp, false },
+    { "bpe", "gpt2.bin", NULL, CallBpe, false },
+    { "hashes", NULL, NULL, CallHashes, false },
+    { "hyphenation", "syllab.bin", NULL, CallHyphenation, false },
+    { "ids_to_text", "xlnet.bin", "xlnet.i2w", CallIdsToText, false },
+};
+
+
+const double Percentile (std::vector < double > & Times, const double P)
+{
+    if (Times.empty ()) {
+        return 0;
+    }
+    const size_t i = std::min (Times.size () - 1, (size_t) (P * Times.size ()));
+    std::nth_element (Times.begin (), Times.begin () + i, Times.end ());
+    return Times [i];
+}
+
+
+// calls the API on the text from ThreadCount threads (or once with ThreadCount threads),
+// returns false in case of an error
+const bool Measure (
+        const FAApi & Api,
+        void * hModel,
+        void * hModel2,
+        const std::string & Text,
+        const int ThreadCount,
+        FAResult * pResult
+    )
+{
+    const int CallerCount = Api.m_fParallel ? 1 : ThreadCount;
+
+    const long long Calls = std::max ((long long) g_MinCalls, \
+        g_Bytes / std::max ((long long) 1, (long long) Text.length ()));
+    const long long CallsPerThread = std::max ((long long) 1, Calls / CallerCount);
+
+    std::vector < FAApiState > States (CallerCount);
+    std::vector < std::vector < double > > Times (CallerCount);
+    std::vector < long long > Tokens (CallerCount, 0);
+    std::atomic < bool > fFailed (false);
+
+    for (int t = 0; t < CallerCount; ++t) {
+        States [t].m_hModel = hModel;
+        States [t].m_hModel2 = hModel2;
+        States [t].Reserve (Text.length ());
+        Times [t].reserve ((size_t) CallsPerThread);
+        // warm up, the lazy initialization is not measured
+        if (0 > Api.m_Call (&States [t], Text, ThreadCount)) {
+            return false;
+        }
+    }
+
+    // the threads start the calls at the same time, after all of them have been created,
+    // so the allocations of the threads themselves are not counted
+    std::atomic < int > ReadyCount (0);
+    std::atomic < bool > fGo (false);
+
+    std::vector < std::thread > Threads;
+
+    for (int t = 0; t < CallerCount; ++t) {
+        Threads.push_back (std::thread ([&, t] () {
+            ReadyCount++;
+            while (!fGo) {
+                std::this_thread::yield ();
+            }
+            for (long long i = 0; i < CallsPerThread && !fFailed; ++i) {
+                const std::chrono::steady_clock::time_point CallStart = std::chrono::steady_clock::now ();
+                const long long Count = Api.m_Call (&States [t], Text, ThreadCount);
+                const std::chrono::steady_clock::time_point CallEnd = std::chrono::steady_clock::now ();
+                if (0 > Count) {
+                    fFailed = true;
+                    break;
+                }
+                Times [t].push_back (std::chrono::duration < double, std::micro > (CallEnd - CallStart).count ());
+                Tokens [t] += Count;
+            }
+        }));
+    }
+    while (CallerCount > ReadyCount) {
+        std::this_thread::yield ();
+    }
+
+    const unsigned long long AllocsBefore = g_AllocCount;
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now ();
+
+    fGo = true;
+    for (int t = 0; t < CallerCount; ++t) {
+        Threads [t].join ();
+    }
+
+    const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now ();
+    const unsigned long long AllocsAfter = g_AllocCount;
+
+    if (fFailed) {
+        return false;
+    }
+
+    std::vector < double > AllTimes;
+    long long AllTokens = 0;
+    for (int t = 0; t < CallerCount; ++t) {
+        AllTimes.insert (AllTimes.end (), Times [t].begin (), Times [t].end ());
+        AllTokens += Tokens [t];
+    }
+
+    const long long AllCalls = (long long) AllTimes.size ();
+
+    const double Seconds = std::chrono::duration < double > (End - Start).count ();
+
+    pResult->m_Threads = ThreadCount;
+    pResult->m_Calls = AllCalls;
+    pResult->m_Bytes = AllCalls * (long long) Text.length ();
+    pResult->m_Tokens = AllTokens;
+    pResult->m_Seconds = Seconds;
+    pResult->m_P50 = Percentile (AllTimes, 0.5);
+    pResult->m_P99 = Percentile (AllTimes, 0.99);
+    pResult->m_AllocsPerCall = 0 < AllCalls ? (double) (AllocsAfter - AllocsBefore) / AllCalls : 0;
+
+    return true;
+}
+
+
+///
+/// JSON output
+///
+
+const std::string JsonStr (const std::string & Str)
+{
+    std::string Out ("\"");
+    for (size_t i = 0; i < Str.length (); ++i) {
+        const unsigned char C = (unsigned char) Str [i];
+        if ('"' == C || '\\' == C) {
+            Out.push_back ('\\');
+            Out.push_back (C);
+        } else if (0x20 > C) {
+            char Buff [8];
+            snprintf (Buff, sizeof (Buff), "\\u%04x", C);
+            Out += Buff;
+        } else {
+            Out.push_back (C);
+        }
+    }
+    Out.push_back ('"');
+    return Out;
+}
+
+
+const std::string JsonNum (const double Value)
+{
+    char Buff [64];
+    snprintf (Buff, sizeof (Buff), "%.6g", Value);
+    return Buff;
+}
+
+
+template < class Ty >
+const std::string JsonList (const std::vector < Ty > & Items)
+{
+    std::ostringstream os;
+    os << "[";
+    for (size_t i = 0; i < Items.size (); ++i) {
+        os << (0 < i ? ", " : "") << Items [i];
+    }
+    os << "]";
+    return os.str ();
+}
+
+
+void PrintReport (
+        std::ostream & os,
+        const std::vector < FAResult > & Results,
+        const std::vector < std::pair < std::string, std::string > > & Skipped
+    )
+{
+    os << "{\n";
+    os << "  \"version\": " << GetBlingFireTokVersion () << ",\n";
+    os << "  \"hardware_threads\": " << std::max (1u, std::thread::hardware_concurrency ()) << ",\n";
+    os << "  \"bytes_per_measurement\": " << g_Bytes << ",\n";
+    os << "  \"lengths\": " << JsonList (g_Lengths) << ",\n";
+    os << "  \"threads\": " << JsonList (g_Threads) << ",\n";
+    os << "  \"results\": [";
+
+    for (size_t i = 0; i < Results.size (); ++i) {
+
+        const FAResult & R = Results [i];
+        const double Seconds = 0 < R.m_Seconds ? R.m_Seconds : 1e-9;
+
+        os << (0 < i ? ",\n" : "\n") << "    {"
+           << "\"api\": " << JsonStr (R.m_Api)
+           << ", \"model\": " << JsonStr (R.m_Model)
+           << ", \"corpus\": " << JsonStr (R.m_Corpus)
+           << ", \"length\": " << R.m_Length
+           << ", \"threads\": " << R.m_Threads
+           << ", \"calls\": " << R.m_Calls
+           << ", \"bytes\": " << R.m_Bytes
+           << ", \"tokens\": " << R.m_Tokens
+           << ", \"seconds\": " << JsonNum (R.m_Seconds)
+           << ", \"mb_per_s\": " << JsonNum (R.m_Bytes / Seconds / 1e6)
+           << ", \"tokens_per_s\": " << JsonNum (R.m_Tokens / Seconds)
+           << ", \"p50_us\": " << JsonNum (R.m_P50)
+           << ", \"p99_us\": " << JsonNum (R.m_P99)
+           << ", \"allocs_per_call\": " << JsonNum (R.m_AllocsPerCall)
+           << "}";
+    }
+
+    os << "\n  ],\n";
+    os << "  \"skipped\": [";
+
+    for (size_t i = 0; i < Skipped.size (); ++i) {
+        os << (0 < i ? ",\n" : "\n") << "    {\"api\": " << JsonStr (Skipped [i].first)
+           << ", \"reason\": " << JsonStr (Skipped [i].second) << "}";
+    }
+
+    os << "\n  ]\n";
+    os << "}\n";
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    process_args (argc, argv);
+
+    try {
+
+        if (g_Lengths.empty ()) {
+            g_Lengths.push_back (100);
+            g_Lengths.push_back (10000);
+            g_Lengths.push_back (1000000);
+        }
+        if (g_Threads.empty ()) {
+            g_Threads.push_back (1);
+            const int HwThreads = (int) std::thread::hardware_concurrency ();
+            if (1 < HwThreads) {
+                g_Threads.push_back (HwThreads);
+            }
+        }
+        for (size_t i = 0; i < g_Lengths.size (); ++i) {
+            LogAssert (0 < g_Lengths [i], "Invalid --lengths value");
+        }
+        for (size_t i = 0; i < g_Threads.size (); ++i) {
+            LogAssert (0 < g_Threads [i], "Invalid --threads value");
+        }
+        LogAssert (0 < g_Bytes && 0 < g_MinCalls);
+
+        ///
+        /// make the corpora, the longest length is generated and then cut
+        ///
+
+        const int MaxLength = *std::max_element (g_Lengths.begin (), g_Lengths.end ());
+
+        std::vector < std::pair < std::string, std::string > > Corpora;
+
+        Corpora.push_back (std::make_pair ("english", English (MaxLength)));
+        Corpora.push_back (std::make_pair ("cjk", Cjk (MaxLength)));
+        Corpora.push_back (std::make_pair ("mixed", Mixed (MaxLength)));
+
+        bool fDefaultIn = false;
+        if (g_InFiles.empty ()) {
+            g_InFiles.push_back ("README.md");
+            fDefaultIn = true;
+        }
+        for (size_t i = 0; i < g_InFiles.size (); ++i) {
+            std::ifstream ifs (g_InFiles [i].c_str (), std::ios::in | std::ios::binary);
+            if (fDefaultIn && !ifs.is_open ()) {
+                continue;
+            }
+            LogAssert (ifs.is_open (), "Cannot open %s", g_InFiles [i].c_str ());
+            const std::string Text ((std::istreambuf_iterator < char > (ifs)), std::istreambuf_iterator < char > ());
+            Corpora.push_back (std::make_pair (g_InFiles [i], Text));
+        }
+
+        ///
+        /// measure each API
+        ///
+
+        std::vector < FAResult > Results;
+        std::vector < std::pair < std::string, std::string > > Skipped;
+
+        const int ApiCount = sizeof (g_AllApis) / sizeof (g_AllApis [0]);
+
+        for (int a = 0; a < ApiCount; ++a) {
+
+            const FAApi & Api = g_AllApis [a];
+
+            if (!g_Apis.empty () && g_Apis.end () == std::find (g_Apis.begin (), g_Apis.end (), Api.m_pName)) {
+                continue;
+            }
+
+            void * hModel = NULL;
+            void * hModel2 = NULL;
+            std::string ModelName = "built-in";
+
+            if (Api.m_pModel) {
+                const std::string Path = std::string (g_pLdbDir) + "/" + Api.m_pModel;
+                hModel = LoadModel (Path.c_str ());
+                if (NULL == hModel) {
+                    Skipped.push_back (std::make_pair (Api.m_pName, "cannot load " + Path));
+                    continue;
+                }
+                ModelName = Api.m_pModel;
+            }
+            if (Api.m_pModel2) {
+                const std::string Path = std::string (g_pLdbDir) + "/" + Api.m_pModel2;
+                hModel2 = LoadModel (Path.c_str ());
+                if (NULL == hModel2) {
+                    Skipped.push_back (std::make_pair (Api.m_pName, "cannot load " + Path));
+                    FreeModel (hModel);
+                    continue;
+                }
+                ModelName = ModelName + "+" + Api.m_pModel2;
+            }
+
+            for (size_t c = 0; c < Corpora.size (); ++c) {
+                for (size_t l = 0; l < g_Lengths.size (); ++l) {
+
+                    const std::string Text = Resize (Corpora [c].second, g_Lengths [l]);
+
+                    for (size_t t = 0; t < g_Threads.size (); ++t) {
+
+                        FAResult Result;
+                        Result.m_Api = Api.m_pName;
+                        Result.m_Model = ModelName;
+                        Result.m_Corpus = Corpora [c].first;
+                        Result.m_Length = (int) Text.length ();
+
+                        std::cerr << Api.m_pName << " " << Corpora [c].first << " " \
+                            << Text.length () << " bytes, " << g_Threads [t] << " threads\n";
+
+                        if (!Measure (Api, hModel, hModel2, Text, g_Threads [t], &Result)) {
+                            Skipped.push_back (std::make_pair (Api.m_pName, "the call failed on " + \
+                                Corpora [c].first + " of " + std::to_string (Text.length ()) + " bytes"));
+                            continue;
+                        }
+                        Results.push_back (Result);
+                    }
+                }
+            }
+
+            if (hModel) {
+                FreeModel (hModel);
+            }
+            if (hModel2) {
+                FreeModel (hModel2);
+            }
+        }
+
+        ///
+        /// print the report
+        ///
+
+        if (g_pOutFile) {
+            std::ofstream ofs (g_pOutFile, std::ios::out);
+            LogAssert (ofs.is_open (), "Cannot open %s", g_pOutFile);
+            PrintReport (ofs, Results, Skipped);
+        } else {
+            PrintReport (std::cout, Results, Skipped);
+        }
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -5,16 +5,39 @@
 #include "FAWbdConfKeeper.h"
 #include "FALDB.h"
 #include "FALexTools_t.h"
+#include "FARSDfa_dense.h"
 #include "FADictConfKeeper.h"
+#include "FAMultiMap_dense.h"
 #include "FATokenSegmentationTools_1best_t.h"
 #include "FATokenSegmentationTools_1best_bpe_t.h"
 #include "FATokenSegmentationTools_1best_bpe_with_merges_t.h"
+#include "FATokenSegmentationTools_1best_bpe_local_t.h"
 #include "FAHyphConfKeeper_packaged.h"
 #include "FAHyphInterpreter_core_t.h"
 #include "FAStringArray_pack.h"
+#include "FAThreadPool.h"
+#include "FAWordCache.h"
+#include "FAGetIWsCA.h"
+#include "FASharedDumpPool.h"
+#include "FAFastMod.h"
+#include "FALadLDB.h"
+#include "FALad.h"
+#include "FAStemmerLDB.h"
+#include "FAStemmerConst_t.h"
+#include "FAAllocator.h"
 
 #include "blingfiretokdll.h"
 
+#ifdef BLING_FIRE_STATS
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
 /*
 This library provides easy interface to sentence and word-breaking functionality
 which can be used in C#, Python, Perl, etc.
@@ -39,13 +62,129 @@ using namespace BlingFire;
 const int WBD_WORD_TAG = 1;
 const int WBD_IGNORE_TAG = 4;
 
+// the largest Unicode character, the UTF-8 decoder does not return larger values
+const int MAX_UNICODE_CHAR = 0x10FFFF;
+
 // flag indicating the one-time initialization is done
 volatile bool g_fInitialized = false;
 std::mutex g_InitializationMutex; // this mutex is used once for default models only
 
+// returns the pool of the dumps shared between the models, the pool is never
+// destroyed since the models can be freed while the library is being unloaded
+static FASharedDumpPool & FAGetDumpPool ()
+{
+    static FASharedDumpPool * g_pDumpPool = new FASharedDumpPool ();
+    return *g_pDumpPool;
+}
+
+// references to the shared dumps of a model, see LoadModelShared
+struct FAModelDumpRefs
+{
+    std::vector< const unsigned char * > m_Dumps;
+
+    ~FAModelDumpRefs ()
+    {
+        for (size_t i = 0; i < m_Dumps.size (); ++i) {
+            FAGetDumpPool ().Release (m_Dumps [i]);
+        }
+    }
+};
+
+// the counters of the per model statistics, see GetModelStats
+enum {
+    FA_STAT_CALLS = 0,          // calls of the word, sentence and id functions
+    FA_STAT_BYTES,              // input bytes of these calls
+    FA_STAT_TOKENS,             // words, sentences or ids produced
+    FA_STAT_UNKNOWN_TOKENS,     // ids equal to the unknown token id
+    FA_STAT_SMALL_BUFFER,       // calls with the output buffer too small for the result
+    FA_STAT_DECODE_CYCLES,      // UTF-8 decoding (and the fused normalization of the segmentation models)
+    FA_STAT_NORMALIZE_CYCLES,   // FANormalize
+    FA_STAT_LEX_CYCLES,         // FALexTools_t::Process
+    FA_STAT_SEGMENT_CYCLES,     // unigram LM / BPE segmentation
+    FA_STAT_OUTPUT_CYCLES,      // building of the spans, text and ids
+    FA_STAT_COUNT
+};
+
+// the names of the counters, in the same order
+const char * const g_StatNames [FA_STAT_COUNT] = {
+    "calls",
+    "bytes",
+    "tokens",
+    "unknown_tokens",
+    "small_buffer",
+    "decode_cycles",
+    "normalize_cycles",
+    "lex_cycles",
+    "segment_cycles",
+    "output_cycles"
+};
+
+#ifdef BLING_FIRE_STATS
+
+// returns the time stamp counter, or the steady clock in nanoseconds if there is none
+inline const int64_t FAGetCycles ()
+{
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || defined(__x86_64__) || defined(__i386__)
+    return (int64_t) __rdtsc ();
+#else
+    return (int64_t) std::chrono::duration_cast < std::chrono::nanoseconds > (
+        std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+#endif
+}
+
+// per model statistics, the counters are updated concurrently by all the threads using the model
+struct FAModelStats
+{
+    std::atomic< int64_t > m_Counters [FA_STAT_COUNT];
+
+    FAModelStats ()
+    {
+        Reset ();
+    }
+
+    void Reset ()
+    {
+        for (int i = 0; i < FA_STAT_COUNT; ++i) {
+            m_Counters [i].store (0, std::memory_order_relaxed);
+        }
+    }
+
+    inline void Add (const int Counter, const int64_t Value)
+    {
+        m_Counters [Counter].fetch_add (Value, std::memory_order_relaxed);
+    }
+
+    // adds the cycles since Timer to the Counter and restarts the Timer
+    inline void Lap (const int Counter, int64_t & Timer)
+    {
+        const int64_t Now = FAGetCycles ();
+        Add (Counter, Now - Timer);
+        Timer = Now;
+    }
+};
+
+// the statistics are collected only if the library is built with BLING_FIRE_STATS,
+// otherwise these macros expand to nothing and their arguments are not evaluated
+#define FAStatsAdd(pModel, Counter, Value) (pModel)->m_Stats.Add (Counter, Value)
+#define FAStatsStart(Timer) int64_t Timer = FAGetCycles ()
+#define FAStatsLap(pModel, Counter, Timer) (pModel)->m_Stats.Lap (Counter, Timer)
+
+#else
+
+#define FAStatsAdd(pModel, Counter, Value)
+#define FAStatsStart(Timer)
+#define FAStatsLap(pModel, Counter, Timer)
+
+#endif
+
 // keep model data together
 struct FAModelData
 {
+    // shared dumps, if any, they are released after all the other members
+    FAModelDumpRefs m_SharedDumps;
+    // the number of references to the model, see FreeModel and AcquireModel
+    std::atomic< int > m_RefCount;
+
     // image of the loaded file
     FAImageDump m_Img;
     FALDB m_Ldb;
@@ -54,6 +193,10 @@ struct FAModelData
     FAWbdConfKeeper m_Conf;
     FALexTools_t < int > m_Engine;
     bool m_hasWbd;
+    // optional flat transition table for the lexer, see SetDenseDfa
+    FARSDfa_dense m_DenseDfa;
+    // the automaton from the LDB, NULL until the table is built
+    const FARSDfaCA * m_pPackedDfa;
 
     // data and const processor for tokenization
     FADictConfKeeper m_DictConf;
@@ -66,10 +209,18 @@ struct FAModelData
     FATokenSegmentationTools_1best_bpe_t < int > m_SegEngineBpe;
     // BPE (with separate merge ranks) runtime
     FATokenSegmentationTools_1best_bpe_with_merges_t < int > m_SegEngineBpeWithMerges;
+    // BPE (either of the above data) runtime which merges the overlapping matches separately
+    FATokenSegmentationTools_1best_bpe_local_t < int > m_SegEngineBpeLocal;
     // one selected algorithm for this bin file
     const FATokenSegmentationToolsCA_t < int > * m_pAlgo;
     // indicates wether characters are bytes of the UTF-8 rather than the Unicode symbols
     bool m_useRawBytes;
+    // flat copy of the character normalization map, if the model has one
+    FAMultiMap_dense m_CharMap;
+    bool m_hasCharMap;
+    // optional cache of the segmentation results of the words, see SetWordCache,
+    // the cache is thread-safe so it is updated by the functions taking a const model
+    mutable FAWordCache m_WordCache;
 
     // Hyphenation / Syllabification data
     bool m_hasHy;
@@ -81,17 +232,40 @@ struct FAModelData
     FAStringArray_pack m_i2w;
     int m_min_token_id; // min regular token id, needed to separate special tokens
     int m_max_token_id; // max regular token id, needed to separate special tokens
+    // ids of the i2w strings in the order of the strings, built by the first TokenToId call
+    mutable std::once_flag m_i2wIndexOnce;
+    mutable std::vector< int > m_i2wIndex;
+
+    // the runtime settings applied to the model after it was loaded, SwapModelSlot applies
+    // them to the new model of the slot, -1 / 0 mean not set (see SetNoDummyPrefix,
+    // SetTokAlgo, SetDenseDfa and SetWordCache)
+    int m_NoDummyPrefix;
+    int m_TokAlgo;
+    int m_DenseDfaBytes;
+    int m_WordCacheBytes;
+
+#ifdef BLING_FIRE_STATS
+    // hot path counters, see GetModelStats
+    mutable FAModelStats m_Stats;
+#endif
 
 
     FAModelData ():
+        m_RefCount (1),
         m_hasWbd (false),
+        m_pPackedDfa (NULL),
         m_hasSeg (false),
         m_pAlgo (NULL),
         m_useRawBytes (false),
+        m_hasCharMap (false),
         m_hasHy (false),
         m_hasI2w (false),
         m_min_token_id (0),
-        m_max_token_id (FALimits::MaxArrSize)
+        m_max_token_id (FALimits::MaxArrSize),
+        m_NoDummyPrefix (-1),
+        m_TokAlgo (0),
+        m_DenseDfaBytes (0),
+        m_WordCacheBytes (0)
     {}
 };
 
@@ -101,6 +275,106 @@ FAModelData g_DefaultWbd;
 FAModelData g_DefaultSbd;
 #endif
 
+// returns the model the statistics of a word or sentence breaking call go to, NULL hModel
+// means the built-in model (it is initialized by the time the statistics are updated)
+inline const FAModelData * FAGetStatsModel (const void * hModel, const bool fSbd)
+{
+#ifndef SIZE_OPTIMIZATION
+    if (NULL == hModel) {
+        return fSbd ? &g_DefaultSbd : &g_DefaultWbd;
+    }
+#endif
+    return (const FAModelData *) hModel;
+}
+
+
+// keeps intermediate buffers of the tokenization functions, the buffers only grow
+// so the steady state calls with the same workspace do not allocate memory
+struct FATokWorkspace
+{
+    // UTF-32 input and its offsets
+    std::vector< int > m_Utf32;
+    std::vector< int > m_Offsets;
+    // normalized input and its offsets
+    std::vector< int > m_Norm;
+    std::vector< int > m_NormOffsets;
+    // results of the lexer or the segmentation algorithm
+    std::vector< int > m_Res;
+    // [start, end] byte offsets of words / sentences
+    std::vector< int > m_Spans;
+    // intermediate data of the segmentation algorithm
+    FATokenSegmentationScratchA * m_pSegScratch;
+
+    FATokWorkspace ():
+        m_pSegScratch (NULL)
+    {}
+
+    ~FATokWorkspace ()
+    {
+        delete m_pSegScratch;
+    }
+
+    // frees the buffers which grew bigger than MaxSize elements
+    void Trim (const size_t MaxSize)
+    {
+        bool fTrimmed = false;
+        fTrimmed |= FATrimBuffer (m_Utf32, MaxSize);
+        fTrimmed |= FATrimBuffer (m_Offsets, MaxSize);
+        fTrimmed |= FATrimBuffer (m_Norm, MaxSize);
+        fTrimmed |= FATrimBuffer (m_NormOffsets, MaxSize);
+        fTrimmed |= FATrimBuffer (m_Res, MaxSize);
+        fTrimmed |= FATrimBuffer (m_Spans, MaxSize);
+        // the segmentation data are proportional to the input size, so
+        //  they are big only if some of the buffers above were big as well
+        if (fTrimmed && NULL != m_pSegScratch) {
+            delete m_pSegScratch;
+            m_pSegScratch = NULL;
+        }
+    }
+
+private:
+    template < class T >
+    static bool FATrimBuffer (std::vector< T > & Buff, const size_t MaxSize)
+    {
+        if (Buff.capacity () > MaxSize) {
+            std::vector< T > ().swap (Buff);
+            return true;
+        }
+        return false;
+    }
+};
+
+
+// returns a pointer to at least Size elements of the Buff, grows the buffer if needed
+template < class T >
+inline T * FAGetBuffer (std::vector< T > & Buff, const size_t Size)
+{
+    if (Buff.size () < Size) {
+        Buff.resize (Size);
+    }
+    return Buff.data ();
+}
+
+
+// buffers of the thread-local workspaces bigger than this are freed after each call
+const size_t MAX_THREAD_WORKSPACE_SIZE = 262144;
+
+// returns the workspace of the calling thread, used by the functions without a workspace parameter
+inline FATokWorkspace * FAGetThreadWorkspace ()
+{
+    static thread_local FATokWorkspace g_ThreadWorkspace;
+    return &g_ThreadWorkspace;
+}
+
+// returns the thread pool shared by all batch APIs, the pool is never destroyed
+// to avoid joining threads while the library is being unloaded
+static FAThreadPool & FAGetThreadPool ()
+{
+    static FAThreadPool * g_pThreadPool = new FAThreadPool ();
+    return *g_pThreadPool;
+}
+
+
 //
 // returns the current version of the algo
 //
@@ -135,6 +409,151 @@ void InitializeWbdSbd()
 #endif
 
 
+// the text is processed in parallel only if each thread gets at least this many characters
+const int MIN_PARALLEL_PART_SIZE = 262144;
+// the scans after a cut are checked over this many characters
+const int PARALLEL_OVERLAP_SIZE = 4096;
+
+//
+// Runs the lexer over the scans starting in [From, To), assumes that From is a start position of
+// the sequential processing. Appends the results (with the positions relative to pIn) to Res and
+// returns the first start position after To or -1 in case of an error.
+//
+const int FALexScan(const FALexTools_t< int > & Engine, const int * pIn, const int InSize,
+    const int From, const int To, std::vector< int > & Res)
+{
+    const int MaxTokenLength = Engine.GetMaxTokenLength();
+    const int End = To < InSize - MaxTokenLength ? To + MaxTokenLength : InSize;
+    const int Size = std::max(End - From, 0);
+
+    const size_t ResSize = Res.size();
+    Res.resize(ResSize + ((size_t) Size * 3));
+    int * pRes = Res.data() + ResSize;
+
+    int NextPos = 0;
+    const int OutSize = Engine.ProcessPart(pIn + From, Size, 0 == From, End == InSize, pRes, Size * 3, &NextPos);
+    if (0 > OutSize || OutSize > Size * 3 || 0 != OutSize % 3 || -1 == NextPos) {
+        return -1;
+    }
+
+    for (int i = 0; i < OutSize; i += 3) {
+        pRes[i + 1] += From;
+        pRes[i + 2] += From;
+    }
+    Res.resize(ResSize + OutSize);
+
+    return From + NextPos;
+}
+
+
+//
+// Runs the lexer over the text with upto ThreadCount threads, the results are the same as of the
+// Engine.Process (pIn, InSize, pOut, MaxOutSize).
+//
+// The text is cut into parts at word starts and each part is processed by its own thread, as if the
+// sequential processing started a scan at the cut. The scans before the cut may skip it, so after all
+// the parts are done the text before each cut is scanned again until the first start position past the
+// overlap window: if it is the same position the part's own scans came to, the part's results after it
+// are correct, otherwise the rest of the part is processed again. If the model's maximum token length
+// is bigger than the overlap window, the text is processed by one thread.
+//
+// Returns the size of the results or -1 in case of an error.
+//
+const int FALexParallel(const FALexTools_t< int > & Engine, const int * pIn, const int InSize,
+    int * pOut, const int MaxOutSize, int ThreadCount)
+{
+    if (0 >= ThreadCount) {
+        ThreadCount = FAThreadPool::GetHardwareThreadCount();
+    }
+
+    // the cuts should leave room for the overlap window and the longest scan
+    const int MaxTokenLength = Engine.GetMaxTokenLength();
+    const int MinPartSize = std::max(MIN_PARALLEL_PART_SIZE, 2 * (PARALLEL_OVERLAP_SIZE + MaxTokenLength));
+    const int PartCount = std::min(ThreadCount, InSize / MinPartSize);
+
+    // the scans resynchronize within the overlap window only if no scan is longer than it,
+    // so the models with longer tokens are processed sequentially
+    if (1 >= PartCount || PARALLEL_OVERLAP_SIZE < MaxTokenLength) {
+        return Engine.Process(pIn, InSize, pOut, MaxOutSize);
+    }
+
+    // find the cuts, each one is the first word start after an equal share of the text
+    std::vector< int > Cuts(PartCount + 1);
+    Cuts[0] = 0;
+    Cuts[PartCount] = InSize;
+
+    for (int k = 1; k < PartCount; ++k) {
+
+        int Cut = (int) (((int64_t) InSize * k) / PartCount);
+        const int MaxCut = std::min(Cut + PARALLEL_OVERLAP_SIZE, InSize - MinPartSize);
+
+        while (Cut < MaxCut && !(__FAIsWhiteSpace__(pIn[Cut - 1]) && !__FAIsWhiteSpace__(pIn[Cut]))) {
+            Cut++;
+        }
+        Cuts[k] = Cut;
+    }
+
+    // results of the scans of the overlap window after the cut and of the rest of each part
+    std::vector< std::vector< int > > HeadRes(PartCount);
+    std::vector< std::vector< int > > TailRes(PartCount);
+    // the start positions the scans of each part came to
+    std::vector< int > HeadNext(PartCount);
+    std::vector< int > TailNext(PartCount);
+
+    FAGetThreadPool().ParallelFor(PartCount, PartCount, [&](const int k) {
+
+        int From = Cuts[k];
+        HeadNext[k] = From;
+
+        if (0 < k) {
+            From = FALexScan(Engine, pIn, InSize, From, Cuts[k] + PARALLEL_OVERLAP_SIZE, HeadRes[k]);
+            HeadNext[k] = From;
+        }
+        if (-1 != From) {
+            TailNext[k] = FALexScan(Engine, pIn, InSize, From, Cuts[k + 1], TailRes[k]);
+        }
+    });
+
+    // stitch the results
+    std::vector< int > Res;
+    Res.swap(TailRes[0]);
+    int Next = TailNext[0];
+
+    for (int k = 1; k < PartCount && -1 != Next; ++k) {
+
+        if (-1 == HeadNext[k] || -1 == TailNext[k]) {
+            return -1;
+        }
+
+        if (Next == Cuts[k]) {
+            // the sequential processing starts a scan at the cut
+            Res.insert(Res.end(), HeadRes[k].begin(), HeadRes[k].end());
+            Res.insert(Res.end(), TailRes[k].begin(), TailRes[k].end());
+            Next = TailNext[k];
+            continue;
+        }
+
+        // scan the overlap window again from where the previous part has stopped
+        Next = FALexScan(Engine, pIn, InSize, Next, Cuts[k] + PARALLEL_OVERLAP_SIZE, Res);
+
+        if (Next == HeadNext[k]) {
+            Res.insert(Res.end(), TailRes[k].begin(), TailRes[k].end());
+            Next = TailNext[k];
+        } else if (-1 != Next) {
+            Next = FALexScan(Engine, pIn, InSize, Next, Cuts[k + 1], Res);
+        }
+    }
+
+    if (-1 == Next) {
+        return -1;
+    }
+
+    const int OutSize = (int) std::min(Res.size(), (size_t) MaxOutSize);
+    memcpy(pOut, Res.data(), OutSize * sizeof(int));
+    return OutSize;
+}
+
+
 inline int FAGetFirstNonWhiteSpace(int * pStr, const int StrLen)
 {
     for (int i = 0; i < StrLen; ++i)
@@ -151,21 +570,14 @@ inline int FAGetFirstNonWhiteSpace(int * pStr, const int StrLen)
 
 
 //
-// The same as TextToSentences, but it allows to use a custom model and returns offsets
-// 
-// pStartOffsets is an array of integers (first character of each sentence) with upto MaxOutUtf8StrByteCount elements
-// pEndOffsets is an array of integers (last character of each sentence) with upto MaxOutUtf8StrByteCount elements
-//
-// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
-//  the built in is used.
+// Finds sentences in the input, returns the number of sentences and sets *ppSpans to the array
+// of [start, end] byte offsets of each sentence (end is inclusive), returns -1 in case of an error.
+// The spans are kept in the pWs workspace. If ThreadCount is not 1 then the text is processed in
+// parallel, see FALexParallel.
 //
-
-extern "C"
-const int TextToSentencesWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
-    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
-    void * hModel)
+const int FAGetSentenceSpans(const char * pInUtf8Str, int InUtf8StrByteCount, void * hModel,
+    FATokWorkspace * pWs, const int ** ppSpans, const int ThreadCount = 1)
 {
-
 #ifdef SIZE_OPTIMIZATION
     if (NULL == hModel) {
         return -1;
@@ -202,24 +614,19 @@ const int TextToSentencesWithOffsetsWithModel(const char * pInUtf8Str, int InUtf
         return -1;
     }
 
-    // allocate buffer for UTF-32, sentence breaking results, word-breaking results
-    std::vector< int > utf32input(InUtf8StrByteCount);
-    int * pBuff = utf32input.data();
+    FAStatsAdd(pModel, FA_STAT_CALLS, 1);
+    FAStatsAdd(pModel, FA_STAT_BYTES, InUtf8StrByteCount);
+    FAStatsStart(Timer);
+
+    // get buffers for UTF-32 and sentence breaking results
+    int * pBuff = FAGetBuffer(pWs->m_Utf32, InUtf8StrByteCount);
     if (NULL == pBuff) {
         return -1;
     }
-    std::vector< int > utf32offsets(InUtf8StrByteCount);
-    int * pOffsets = utf32offsets.data();
+    int * pOffsets = FAGetBuffer(pWs->m_Offsets, InUtf8StrByteCount);
     if (NULL == pOffsets) {
         return -1;
     }
-    // make sure there are no uninitialized offsets
-    if (pStartOffsets) {
-        memset(pStartOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
-    }
-    if (pEndOffsets) {
-        memset(pEndOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
-    }
 
     // convert input to UTF-32
     const int MaxBuffSize = ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, pOffsets, InUtf8StrByteCount);
@@ -228,130 +635,182 @@ const int TextToSentencesWithOffsetsWithModel(const char * pInUtf8Str, int InUtf
     }
     // make sure the utf32input does not contain 'U+0000' elements
     std::replace(pBuff, pBuff + MaxBuffSize, 0, 0x20);
-
-    // allocated a buffer for UTF-8 output
-    std::vector< char > utf8output(InUtf8StrByteCount + 1);
-    char * pTmpUtf8 = utf8output.data();
-    if (NULL == pTmpUtf8) {
-        return -1;
-    }
+    FAStatsLap(pModel, FA_STAT_DECODE_CYCLES, Timer);
 
     // keep sentence boundary information here
-    std::vector< int > SbdRes(MaxBuffSize * 3);
-    int * pSbdRes = SbdRes.data();
+    int * pSbdRes = FAGetBuffer(pWs->m_Res, MaxBuffSize * 3);
     if (NULL == pSbdRes) {
         return -1;
     }
 
     // get the sentence breaking results
-    const int SbdOutSize = pModel->m_Engine.Process(pBuff, MaxBuffSize, pSbdRes, MaxBuffSize * 3);
+    const int SbdOutSize = 1 == ThreadCount ?
+        pModel->m_Engine.Process(pBuff, MaxBuffSize, pSbdRes, MaxBuffSize * 3) :
+        FALexParallel(pModel->m_Engine, pBuff, MaxBuffSize, pSbdRes, MaxBuffSize * 3, ThreadCount);
     if (SbdOutSize > MaxBuffSize * 3 || 0 != SbdOutSize % 3) {
         return -1;
     }
+    FAStatsLap(pModel, FA_STAT_LEX_CYCLES, Timer);
+
+    // at most one span per result plus the end of paragraph
+    int * pSpans = FAGetBuffer(pWs->m_Spans, ((SbdOutSize / 3) + 1) * 2);
+    if (NULL == pSpans) {
+        return -1;
+    }
 
     // number of sentences
     int SentCount = 0;
-    // accumulate the output here
-    std::ostringstream Os;
-    // keep track if a sentence was already added
-    bool fAdded = false;
     // set previous sentence end to -1
     int PrevEnd = -1;
 
-    for (int i = 0; i < SbdOutSize; i += 3) {
+    for (int i = 0; i <= SbdOutSize; i += 3) {
 
-        // we don't care about Tag or From for p2s task
+        // we don't care about Tag or From for p2s task, 
+        //  always use the end of paragraph as the end of sentence
         const int From = PrevEnd + 1;
-        const int To = pSbdRes[i + 2];
+        const int To = i < SbdOutSize ? pSbdRes[i + 2] : MaxBuffSize - 1;
         const int Len = To - From + 1;
         PrevEnd = To;
 
+        if (0 >= Len) {
+            continue;
+        }
+
         // adjust sentence start if needed
         const int Delta = FAGetFirstNonWhiteSpace(pBuff + From, Len);
         if (Delta < Len) {
-            // convert buffer to a UTF-8 string, we temporary use pOutUtf8Str, MaxOutUtf8StrByteCount
-            const int StrOutSize = ::FAArrayToStrUtf8(pBuff + From + Delta, Len - Delta, pTmpUtf8, InUtf8StrByteCount);
-            if (pStartOffsets && SentCount < MaxOutUtf8StrByteCount) {
-                pStartOffsets[SentCount] = pOffsets[From + Delta];
-            }
-            if (pEndOffsets && SentCount < MaxOutUtf8StrByteCount) {
-                const int ToCharSize = ::FAUtf8Size(pInUtf8Str + pOffsets[To]);
-                pEndOffsets[SentCount] = pOffsets[To] + (0 < ToCharSize ? ToCharSize - 1 : 0);
-            }
+            // offset of the first character and offset of the last byte of the last character
+            const int ToCharSize = ::FAUtf8Size(pInUtf8Str + pOffsets[To]);
+            pSpans[SentCount * 2] = pOffsets[From + Delta];
+            pSpans[(SentCount * 2) + 1] = pOffsets[To] + (0 < ToCharSize ? ToCharSize - 1 : 0);
             SentCount++;
+        }
+    }
 
-            // check the output size
-            if (0 > StrOutSize || StrOutSize > InUtf8StrByteCount) {
-                // should never happen, but happened :-(
-                return -1;
-            }
-            else {
-                // add a new line separator
-                if (fAdded) {
-                    Os << '\n';
-                }
-                // make sure this buffer does not contain '\n' since it is a delimiter
-                std::replace(pTmpUtf8, pTmpUtf8 + StrOutSize, '\n', ' ');
-                // actually copy the data into the string builder
-                pTmpUtf8[StrOutSize] = 0;
-                Os << pTmpUtf8;
-                fAdded = true;
-            }
+    FAStatsLap(pModel, FA_STAT_OUTPUT_CYCLES, Timer);
+    FAStatsAdd(pModel, FA_STAT_TOKENS, SentCount);
+
+    *ppSpans = pSpans;
+    return SentCount;
+}
+
+
+//
+// Writes the spans of the input text delimited with the Delimiter character and terminated with 0,
+// occurrences of the Delimiter and 0 characters inside of spans are replaced with Replacement.
+// The text is written only if fits into MaxOutUtf8StrByteCount bytes. Copies upto 
+// MaxOutUtf8StrByteCount offsets, if pStartOffsets and pEndOffsets are not NULL.
+// Returns the size of the output text in bytes.
+//
+const int FASpansToText(const char * pInUtf8Str, const int * pSpans, const int SpanCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    const char Delimiter, const char Replacement)
+{
+    // delimiters and the terminating 0
+    int StrLen = 0 < SpanCount ? SpanCount : 1;
+
+    for (int i = 0; i < SpanCount; ++i) {
+
+        const int From = pSpans[i * 2];
+        const int To = pSpans[(i * 2) + 1];
+        StrLen += (To - From + 1);
+
+        if (pStartOffsets && i < MaxOutUtf8StrByteCount) {
+            pStartOffsets[i] = From;
+        }
+        if (pEndOffsets && i < MaxOutUtf8StrByteCount) {
+            pEndOffsets[i] = To;
         }
     }
 
-    // always use the end of paragraph as the end of sentence
-    if (PrevEnd + 1 < MaxBuffSize) {
+    // copy the text directly from the input, if fits
+    if (StrLen <= MaxOutUtf8StrByteCount) {
 
-        const int From = PrevEnd + 1;
-        const int To = MaxBuffSize - 1;
-        const int Len = To - From + 1;
+        char * pOut = pOutUtf8Str;
 
-        // adjust sentence start if needed
-        const int Delta = FAGetFirstNonWhiteSpace(pBuff + From, Len);
-        if (Delta < Len) {
-            // convert buffer to a UTF-8 string, we temporary use pOutUtf8Str, MaxOutUtf8StrByteCount
-            const int StrOutSize = ::FAArrayToStrUtf8(pBuff + From + Delta, Len - Delta, pTmpUtf8, InUtf8StrByteCount);
-            if (pStartOffsets && SentCount < MaxOutUtf8StrByteCount) {
-                pStartOffsets[SentCount] = pOffsets[From + Delta];
-            }
-            if (pEndOffsets && SentCount < MaxOutUtf8StrByteCount) {
-                const int ToCharSize = ::FAUtf8Size(pInUtf8Str + pOffsets[To]);
-                pEndOffsets[SentCount] = pOffsets[To] + (0 < ToCharSize ? ToCharSize - 1 : 0);
-            }
-            SentCount++;
+        for (int i = 0; i < SpanCount; ++i) {
 
-            // check the output size
-            if (0 > StrOutSize || StrOutSize > InUtf8StrByteCount) {
-                // should never happen, but happened :-(
-                return -1;
+            if (0 < i) {
+                *pOut++ = Delimiter;
             }
-            else {
-                // add a new line separator
-                if (fAdded) {
-                    Os << '\n';
+
+            const int From = pSpans[i * 2];
+            const int Len = pSpans[(i * 2) + 1] - From + 1;
+            memcpy(pOut, pInUtf8Str + From, Len);
+
+            // make sure the output does not contain delimiters
+            for (int j = 0; j < Len; ++j) {
+                const char C = pOut[j];
+                if (Delimiter == C || 0 == C) {
+                    pOut[j] = Replacement;
                 }
-                // make sure this buffer does not contain '\n' since it is a delimiter
-                std::replace(pTmpUtf8, pTmpUtf8 + StrOutSize, '\n', ' ');
-                // actually copy the data into the string builder
-                pTmpUtf8[StrOutSize] = 0;
-                Os << pTmpUtf8;
             }
+            pOut += Len;
         }
+
+        // we will include the 0 just in case some scriping languages expect 0-terminated buffers and cannot use the size
+        *pOut = 0;
     }
 
-    // we will include the 0 just in case some scriping languages expect 0-terminated buffers and cannot use the size
-    Os << char(0);
+    return StrLen;
+}
 
-    // get the actual output buffer as one string
-    const std::string & OsStr = Os.str();
-    const char * pStr = OsStr.c_str();
-    const int StrLen = (int)OsStr.length();
 
-    if (StrLen <= MaxOutUtf8StrByteCount) {
-        memcpy(pOutUtf8Str, pStr, StrLen);
+//
+// Implements TextToSentencesWithOffsetsWithModel, keeps all intermediate data in the pWs workspace
+//
+const int TextToSentencesWithOffsetsWithModel_int(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, FATokWorkspace * pWs, const int ThreadCount = 1)
+{
+    // make sure there are no uninitialized offsets
+    if (0 < InUtf8StrByteCount && InUtf8StrByteCount <= FALimits::MaxArrSize && NULL != pInUtf8Str) {
+        if (pStartOffsets) {
+            memset(pStartOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
+        }
+        if (pEndOffsets) {
+            memset(pEndOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
+        }
     }
-    return StrLen;
+
+    const int * pSpans = NULL;
+    const int SentCount = FAGetSentenceSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans, ThreadCount);
+    // an error or an empty input
+    if (0 > SentCount || 0 == InUtf8StrByteCount) {
+        return SentCount;
+    }
+
+    // sentences are delimited with '\n', so the new lines inside of the sentences are replaced with ' '
+    FAStatsStart(Timer);
+    const int OutSize = FASpansToText(pInUtf8Str, pSpans, SentCount, pOutUtf8Str, pStartOffsets, pEndOffsets,
+        MaxOutUtf8StrByteCount, '\n', ' ');
+    FAStatsLap(FAGetStatsModel(hModel, true), FA_STAT_OUTPUT_CYCLES, Timer);
+    if (OutSize > MaxOutUtf8StrByteCount) {
+        FAStatsAdd(FAGetStatsModel(hModel, true), FA_STAT_SMALL_BUFFER, 1);
+    }
+    return OutSize;
+}
+
+
+//
+// The same as TextToSentences, but allows to use a custom model and returns offsets
+// 
+// pStartOffsets is an array of integers (first character of each sentence) with upto MaxOutUtf8StrByteCount elements
+// pEndOffsets is an array of integers (last character of each sentence) with upto MaxOutUtf8StrByteCount elements
+//
+// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
+//  the built in is used.
+//
+extern "C"
+const int TextToSentencesWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel)
+{
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+    const int Res = TextToSentencesWithOffsetsWithModel_int(pInUtf8Str, InUtf8StrByteCount, pOutUtf8Str,
+        pStartOffsets, pEndOffsets, MaxOutUtf8StrByteCount, hModel, pWs);
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Res;
 }
 
 
@@ -403,19 +862,13 @@ const int TextToSentences(const char * pInUtf8Str, int InUtf8StrByteCount, char
 
 
 //
-// Same as TextToWords, but also returns original offsets from the input buffer for each word and allows to use a 
-//  custom model
-//
-// pStartOffsets is an array of integers (first character of each word) with upto MaxOutUtf8StrByteCount elements
-// pEndOffsets is an array of integers (last character of each word) with upto MaxOutUtf8StrByteCount elements
-//
-// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
-//  the built in is used.
+// Finds words in the input, returns the number of words and sets *ppSpans to the array of
+// [start, end] byte offsets of each word (end is inclusive), returns -1 in case of an error.
+// The spans are kept in the pWs workspace. If ThreadCount is not 1 then the text is processed in
+// parallel, see FALexParallel.
 //
-extern "C"
-const int TextToWordsWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
-    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
-    void * hModel)
+const int FAGetWordSpans(const char * pInUtf8Str, int InUtf8StrByteCount, void * hModel,
+    FATokWorkspace * pWs, const int ** ppSpans, const int ThreadCount = 1)
 {
 #ifdef SIZE_OPTIMIZATION
     if (NULL == hModel) {
@@ -453,25 +906,20 @@ const int TextToWordsWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8Str
         return -1;
     }
 
-    // allocate buffer for UTF-32, sentence breaking results, word-breaking results
-    std::vector< int > utf32input(InUtf8StrByteCount);
-    int * pBuff = utf32input.data();
+    FAStatsAdd(pModel, FA_STAT_CALLS, 1);
+    FAStatsAdd(pModel, FA_STAT_BYTES, InUtf8StrByteCount);
+    FAStatsStart(Timer);
+
+    // get buffers for UTF-32 and word-breaking results
+    int * pBuff = FAGetBuffer(pWs->m_Utf32, InUtf8StrByteCount);
     if (NULL == pBuff) {
         return -1;
     }
 
-    std::vector< int > utf32offsets(InUtf8StrByteCount);
-    int * pOffsets = utf32offsets.data();
+    int * pOffsets = FAGetBuffer(pWs->m_Offsets, InUtf8StrByteCount);
     if (NULL == pOffsets) {
         return -1;
     }
-    // make sure there are no uninitialized offsets
-    if (pStartOffsets) {
-        memset(pStartOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
-    }
-    if (pEndOffsets) {
-        memset(pEndOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
-    }
 
     // convert input to UTF-32
     const int MaxBuffSize = ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, pOffsets, InUtf8StrByteCount);
@@ -480,33 +928,30 @@ const int TextToWordsWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8Str
     }
     // make sure the utf32input does not contain 'U+0000' elements
     std::replace(pBuff, pBuff + MaxBuffSize, 0, 0x20);
+    FAStatsLap(pModel, FA_STAT_DECODE_CYCLES, Timer);
 
-    // allocated a buffer for UTF-8 output
-    std::vector< char > utf8output(InUtf8StrByteCount + 1);
-    char * pTmpUtf8 = utf8output.data();
-    if (NULL == pTmpUtf8) {
+    // keep word boundary information here
+    int * pWbdRes = FAGetBuffer(pWs->m_Res, MaxBuffSize * 3);
+    if (NULL == pWbdRes) {
         return -1;
     }
 
-    // keep sentence boundary information here
-    std::vector< int > WbdRes(MaxBuffSize * 3);
-    int * pWbdRes = WbdRes.data();
-    if (NULL == pWbdRes) {
+    // get the word breaking results
+    const int WbdOutSize = 1 == ThreadCount ?
+        pModel->m_Engine.Process(pBuff, MaxBuffSize, pWbdRes, MaxBuffSize * 3) :
+        FALexParallel(pModel->m_Engine, pBuff, MaxBuffSize, pWbdRes, MaxBuffSize * 3, ThreadCount);
+    if (WbdOutSize > MaxBuffSize * 3 || 0 != WbdOutSize % 3) {
         return -1;
     }
+    FAStatsLap(pModel, FA_STAT_LEX_CYCLES, Timer);
 
-    // get the sentence breaking results
-    const int WbdOutSize = pModel->m_Engine.Process(pBuff, MaxBuffSize, pWbdRes, MaxBuffSize * 3);
-    if (WbdOutSize > MaxBuffSize * 3 || 0 != WbdOutSize % 3) {
+    int * pSpans = FAGetBuffer(pWs->m_Spans, ((WbdOutSize / 3) * 2) + 1);
+    if (NULL == pSpans) {
         return -1;
     }
 
     // keep track of the word count
     int WordCount = 0;
-    // accumulate the output here
-    std::ostringstream Os;
-    // keep track if a word was already added
-    bool fAdded = false;
 
     for (int i = 0; i < WbdOutSize; i += 3) {
 
@@ -518,51 +963,78 @@ const int TextToWordsWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8Str
 
         const int From = pWbdRes[i + 1];
         const int To = pWbdRes[i + 2];
-        const int Len = To - From + 1;
 
-        // convert buffer to a UTF-8 string, we temporary use pOutUtf8Str, MaxOutUtf8StrByteCount
-        const int StrOutSize = ::FAArrayToStrUtf8(pBuff + From, Len, pTmpUtf8, InUtf8StrByteCount);
-        if (pStartOffsets && WordCount < MaxOutUtf8StrByteCount) {
-            pStartOffsets[WordCount] = pOffsets[From];
-        }
-        if (pEndOffsets && WordCount < MaxOutUtf8StrByteCount) {
-            // offset of last UTF-32 character plus its length in bytes in the original string - 1
-            const int ToCharSize = ::FAUtf8Size(pInUtf8Str + pOffsets[To]);
-            pEndOffsets[WordCount] = pOffsets[To] + (0 < ToCharSize ? ToCharSize - 1 : 0);
-        }
+        // offset of the first character and offset of the last byte of the last character
+        const int ToCharSize = ::FAUtf8Size(pInUtf8Str + pOffsets[To]);
+        pSpans[WordCount * 2] = pOffsets[From];
+        pSpans[(WordCount * 2) + 1] = pOffsets[To] + (0 < ToCharSize ? ToCharSize - 1 : 0);
         WordCount++;
+    }
 
-        // check the output size
-        if (0 > StrOutSize || StrOutSize > InUtf8StrByteCount) {
-            // should never happen, but happened :-(
-            return -1;
+    FAStatsLap(pModel, FA_STAT_OUTPUT_CYCLES, Timer);
+    FAStatsAdd(pModel, FA_STAT_TOKENS, WordCount);
+
+    *ppSpans = pSpans;
+    return WordCount;
+}
+
+
+//
+// Implements TextToWordsWithOffsetsWithModel, keeps all intermediate data in the pWs workspace
+//
+const int TextToWordsWithOffsetsWithModel_int(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, FATokWorkspace * pWs, const int ThreadCount = 1)
+{
+    // make sure there are no uninitialized offsets
+    if (0 < InUtf8StrByteCount && InUtf8StrByteCount <= FALimits::MaxArrSize && NULL != pInUtf8Str) {
+        if (pStartOffsets) {
+            memset(pStartOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
         }
-        else {
-            // add a new line separator
-            if (fAdded) {
-                Os << ' ';
-            }
-            // make sure this buffer does not contain ' ' since it is a delimiter
-            std::replace(pTmpUtf8, pTmpUtf8 + StrOutSize, ' ', '_');
-            // actually copy the data into the string builder
-            pTmpUtf8[StrOutSize] = 0;
-            Os << pTmpUtf8;
-            fAdded = true;
+        if (pEndOffsets) {
+            memset(pEndOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
         }
     }
 
-    // we will include the 0 just in case some scriping languages expect 0-terminated buffers and cannot use the size
-    Os << char(0);
-
-    // get the actual output buffer as one string
-    const std::string & OsStr = Os.str();
-    const char * pStr = OsStr.c_str();
-    const int StrLen = (int)OsStr.length();
+    const int * pSpans = NULL;
+    const int WordCount = FAGetWordSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans, ThreadCount);
+    // an error or an empty input
+    if (0 > WordCount || 0 == InUtf8StrByteCount) {
+        return WordCount;
+    }
 
-    if (StrLen <= MaxOutUtf8StrByteCount) {
-        memcpy(pOutUtf8Str, pStr, StrLen);
+    // words are delimited with ' ', so the spaces inside of the words are replaced with '_'
+    FAStatsStart(Timer);
+    const int OutSize = FASpansToText(pInUtf8Str, pSpans, WordCount, pOutUtf8Str, pStartOffsets, pEndOffsets,
+        MaxOutUtf8StrByteCount, ' ', '_');
+    FAStatsLap(FAGetStatsModel(hModel, false), FA_STAT_OUTPUT_CYCLES, Timer);
+    if (OutSize > MaxOutUtf8StrByteCount) {
+        FAStatsAdd(FAGetStatsModel(hModel, false), FA_STAT_SMALL_BUFFER, 1);
     }
-    return StrLen;
+    return OutSize;
+}
+
+
+//
+// Same as TextToWords, but also returns original offsets from the input buffer for each word and allows to use a 
+//  custom model
+//
+// pStartOffsets is an array of integers (first character of each word) with upto MaxOutUtf8StrByteCount elements
+// pEndOffsets is an array of integers (last character of each word) with upto MaxOutUtf8StrByteCount elements
+//
+// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
+//  the built in is used.
+//
+extern "C"
+const int TextToWordsWithOffsetsWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel)
+{
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+    const int Res = TextToWordsWithOffsetsWithModel_int(pInUtf8Str, InUtf8StrByteCount, pOutUtf8Str,
+        pStartOffsets, pEndOffsets, MaxOutUtf8StrByteCount, hModel, pWs);
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Res;
 }
 
 
@@ -615,1131 +1087,4333 @@ const int TextToWords(const char * pInUtf8Str, int InUtf8StrByteCount, char * pO
 
 
 //
-// This function is like TextToWords, but it only normalizes consequtive spaces, it is not as flexble
-//  as TextToWords as it cannot take a tokenization and normalization rules, but it does space normalization
-//  and srinking multiple spaces to one faster.
+// Returns [start, end] byte offsets of the words without producing the text of the words,
+//  the offsets are the same as from TextToWordsWithOffsetsWithModel
 //
-// Input:  UTF-8 string of one sentence or paragraph or document
-//         space character to use, default is __FASpDelimiter__ (U+x2581)
-// Output: Size in bytes of the output string and UTF-8 string of ' ' delimited words, if the return size <= MaxOutUtf8StrByteCount
+// pStartOffsets is an array of integers (first byte of each word) with upto MaxSpanCount elements
+// pEndOffsets is an array of integers (last byte of each word) with upto MaxSpanCount elements
+//
+// Returns the number of words, if it is bigger than MaxSpanCount then only the first MaxSpanCount
+//  offsets are returned, returns -1 in case of an error.
+//
+// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
+//  the built in is used.
 //
-// Notes:
-//  The return value is -1 in case of an error (make sure your input is a valid UTF-8, BOM is not required)
-//  
 extern "C"
-const int NormalizeSpaces(const char * pInUtf8Str, int InUtf8StrByteCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, const int uSpace = __FASpDelimiter__)
+const int TextToWordSpansWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel)
 {
-    // we can get weird results if this is not true
-    DebugLogAssert(__FAIsWhiteSpace__(uSpace));
-
-    if (0 == InUtf8StrByteCount) {
+    if (NULL == pStartOffsets || NULL == pEndOffsets || 0 > MaxSpanCount) {
         return -1;
     }
 
-    // allocate buffer for UTF-32, sentence breaking results, word-breaking results
-    std::vector< int > utf32input(InUtf8StrByteCount);
-    int * pBuff = utf32input.data();
-    if (NULL == pBuff) {
-        return -1;
-    }
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
 
-    // convert input to UTF-32
-    int MaxBuffSize = ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, InUtf8StrByteCount);
-    if (MaxBuffSize <= 0 || MaxBuffSize > InUtf8StrByteCount) {
-        return -1;
-    }
+    const int * pSpans = NULL;
+    const int WordCount = FAGetWordSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans);
 
-    int i = 0; // index for reading
-    int j = 0; // index for writing
-    while (i < MaxBuffSize) {
+    for (int i = 0; i < WordCount && i < MaxSpanCount; ++i) {
+        pStartOffsets[i] = pSpans[i * 2];
+        pEndOffsets[i] = pSpans[(i * 2) + 1];
+    }
+    if (WordCount > MaxSpanCount) {
+        FAStatsAdd(FAGetStatsModel(hModel, false), FA_STAT_SMALL_BUFFER, 1);
+    }
 
-        const int Ci = pBuff[i++];
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return WordCount;
+}
 
-        // check if the Ci is not a space
-        if (!__FAIsWhiteSpace__(Ci)) {
-            // copy it
-            pBuff[j++] = Ci;
-        // if Ci is a space, check if the previous character was not a sapce
-        } else if (0 < j && uSpace != pBuff[j - 1]) {
-            // copy normalized space
-            pBuff[j++] = uSpace;
-        }
-    } // of while ...
 
-    // trim the final space if there was no content characters after
-    if (1 < j && pBuff[j - 1] == uSpace) {
-        j--;
+//
+// Returns [start, end] byte offsets of the sentences without producing the text of the sentences,
+//  the offsets are the same as from TextToSentencesWithOffsetsWithModel
+//
+// pStartOffsets is an array of integers (first byte of each sentence) with upto MaxSpanCount elements
+// pEndOffsets is an array of integers (last byte of each sentence) with upto MaxSpanCount elements
+//
+// Returns the number of sentences, if it is bigger than MaxSpanCount then only the first MaxSpanCount
+//  offsets are returned, returns -1 in case of an error.
+//
+// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
+//  the built in is used.
+//
+extern "C"
+const int TextToSentenceSpansWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel)
+{
+    if (NULL == pStartOffsets || NULL == pEndOffsets || 0 > MaxSpanCount) {
+        return -1;
     }
 
-    MaxBuffSize = j;
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
 
-    // convert UTF-32 back to UTF-8
-    const int StrOutSize = ::FAArrayToStrUtf8(pBuff, MaxBuffSize, pOutUtf8Str, MaxOutUtf8StrByteCount);
-    if (0 <= StrOutSize && StrOutSize < MaxOutUtf8StrByteCount) {
-        pOutUtf8Str [StrOutSize] = 0;
+    const int * pSpans = NULL;
+    const int SentCount = FAGetSentenceSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans);
+
+    for (int i = 0; i < SentCount && i < MaxSpanCount; ++i) {
+        pStartOffsets[i] = pSpans[i * 2];
+        pEndOffsets[i] = pSpans[(i * 2) + 1];
+    }
+    if (SentCount > MaxSpanCount) {
+        FAStatsAdd(FAGetStatsModel(hModel, true), FA_STAT_SMALL_BUFFER, 1);
     }
 
-    return StrOutSize;
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return SentCount;
 }
 
 
-// This function implements the fasttext hashing function
-inline const uint32_t GetHash(const char * str, size_t strLen)
+//
+// The same as TextToWordsWithOffsetsWithModel, but processes a big text with upto ThreadCount
+//  threads, the results are exactly the same as of TextToWordsWithOffsetsWithModel.
+//
+// ThreadCount <= 0 means to use all hardware threads. The texts which are too short to be split
+//  into parts of MIN_PARALLEL_PART_SIZE characters for each thread are processed sequentially.
+//  The UTF-8 decoding and the output of the words are always sequential.
+//
+extern "C"
+const int TextToWordsWithOffsetsParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, const int ThreadCount)
 {
-    uint32_t h = 2166136261;
-    for (size_t i = 0; i < strLen; i++) {
-        h = h ^ uint32_t(int8_t(str[i]));
-        h = h * 16777619;
-    }
-    return h;
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+    const int Res = TextToWordsWithOffsetsWithModel_int(pInUtf8Str, InUtf8StrByteCount, pOutUtf8Str,
+        pStartOffsets, pEndOffsets, MaxOutUtf8StrByteCount, hModel, pWs, ThreadCount);
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Res;
 }
 
 
-// EOS symbol
-int32_t EOS_HASH = GetHash("</s>", 4);
-
-const void AddWordNgrams(int32_t * hashArray, int& hashCount, int32_t wordNgrams, int32_t bucket)
+//
+// The same as TextToSentencesWithOffsetsWithModel, but processes a big text with upto ThreadCount
+//  threads, see TextToWordsWithOffsetsParallel.
+//
+extern "C"
+const int TextToSentencesWithOffsetsParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, const int ThreadCount)
 {
-    // hash size
-    const int tokenCount = hashCount;
-    for (int32_t i = 0; i < tokenCount; i++) {
-        uint64_t h = hashArray[i];
-        for (int32_t j = i + 1; j < i + wordNgrams; j++) {
-            uint64_t tempHash = (j < tokenCount) ? hashArray[j] : EOS_HASH;  // for computing ngram, we pad by EOS_HASH to allow each word has ngram which begins at itself.
-            h = h * 116049371 + tempHash;
-            const int ngram_idx = j - i;
-            hashArray[(ngram_idx * tokenCount) + i] = (h % bucket);
-        }
-    }
-    hashCount += (wordNgrams - 1) * tokenCount;
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+    const int Res = TextToSentencesWithOffsetsWithModel_int(pInUtf8Str, InUtf8StrByteCount, pOutUtf8Str,
+        pStartOffsets, pEndOffsets, MaxOutUtf8StrByteCount, hModel, pWs, ThreadCount);
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Res;
 }
 
 
-// Get the tokens count by inspecting the spaces in input buffer
-inline const int GetTokenCount(const char * input, const int bufferSize)
+//
+// The same as TextToWordSpansWithModel, but processes a big text with upto ThreadCount threads,
+//  see TextToWordsWithOffsetsParallel.
+//
+extern "C"
+const int TextToWordSpansParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel, const int ThreadCount)
 {
-    if (bufferSize == 0)
-    {
-        return 0;
-    }
-    else
-    {
-        int spaceCount = 0;
-        for (int i = 0; i < bufferSize; ++i)
-        {
-            if (input[i] == ' ')
-            {
-                spaceCount++;
-            }
-        }
-        return spaceCount + 1;
+    if (NULL == pStartOffsets || NULL == pEndOffsets || 0 > MaxSpanCount) {
+        return -1;
     }
-}
 
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
 
-// Port the fast text getline function with modifications
-// 1. do not have vocab
-// 2. do not compute subwords info
-const int ComputeHashes(const char * input, const int strLen, int32_t * hashArr, int wordNgrams, int bucketSize)
-{
-    int hashCount = 0;
-    const char * pTemp = input;
-    const char * pWordStart = pTemp;
-    size_t wordLength = 0;
+    const int * pSpans = NULL;
+    const int WordCount = FAGetWordSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans,
+        ThreadCount);
 
-    // add unigram hash first while reading the tokens. Unlike fasttext, there's no EOS padding here. 
-    for (int pos = 0; pos <= strLen; pos++)
-    {
-        // check for end of line first otherwise check the character so we don't read past the buffer end
-        if (pos == strLen || pTemp[pos] == ' ')  // if we hit word boundary pushback wordhash or end of sentence
-        {
-            uint32_t wordhash = GetHash(pWordStart, wordLength);
-            hashArr[hashCount] = wordhash;
-            ++hashCount;
-            // move pointer to next word and reset length
-            pWordStart = pTemp + pos + 1;
-            wordLength = 0;
-        }
-        else // otherwise keep moving temp pointer
-        {
-            ++wordLength;
-        }
+    for (int i = 0; i < WordCount && i < MaxSpanCount; ++i) {
+        pStartOffsets[i] = pSpans[i * 2];
+        pEndOffsets[i] = pSpans[(i * 2) + 1];
+    }
+    if (WordCount > MaxSpanCount) {
+        FAStatsAdd(FAGetStatsModel(hModel, false), FA_STAT_SMALL_BUFFER, 1);
     }
 
-    //Add higher order ngrams (bigrams and up), each token has a ngram starting from itself makes the size ngram * ntokens. 
-    AddWordNgrams(hashArr, hashCount, wordNgrams, bucketSize);
-
-    return hashCount;
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return WordCount;
 }
 
 
-// memory cap for stack memory allocation
-const int MAX_ALLOCA_SIZE = 204800;
-
-
-//
-// This function implements the fasttext-like hashing logics. It assumes the input text is already tokenized and 
-//  tokens are merged by a single space.
-//
-// Example: input :  "This is ok ."
-//          output (bigram):  hash(this), hash(is), hash(ok), hash(.), hash(this is), hash(is ok), hash(ok .), hash(. EOS)
 //
-//  This is different from fasttext hashing:
-//     1. no EOS padding by default for unigram.
-//     2. do not take vocab as input, all unigrams are hashed too (we assume later caller repalces unigram hashes
-//          with ids from a vocab file).
+// The same as TextToSentenceSpansWithModel, but processes a big text with upto ThreadCount threads,
+//  see TextToWordsWithOffsetsParallel.
 //
 extern "C"
-const int TextToHashes(const char * pInUtf8Str, int InUtf8StrByteCount, int32_t * pHashArr, const int MaxHashArrLength, int wordNgrams, int bucketSize = 2000000)
+const int TextToSentenceSpansParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel, const int ThreadCount)
 {
-    // must have positive ngram
-    if (wordNgrams <= 0 && InUtf8StrByteCount < 0)
-    {
+    if (NULL == pStartOffsets || NULL == pEndOffsets || 0 > MaxSpanCount) {
         return -1;
     }
 
-    // get token count
-    const int tokenCount = GetTokenCount(pInUtf8Str, InUtf8StrByteCount);
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
 
-    // if memory allocation is not enough for current output, return requested memory amount
-    if (tokenCount * wordNgrams >= MaxHashArrLength)
-    {
-        return InUtf8StrByteCount * wordNgrams;
-    }
+    const int * pSpans = NULL;
+    const int SentCount = FAGetSentenceSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans,
+        ThreadCount);
 
-    // if correctly tokenized and the memory usage is within the limit
-    const int hashArrSize = ComputeHashes(pInUtf8Str, InUtf8StrByteCount, pHashArr, wordNgrams, bucketSize);
-    assert(hashArrSize == wordNgrams * tokenCount);
+    for (int i = 0; i < SentCount && i < MaxSpanCount; ++i) {
+        pStartOffsets[i] = pSpans[i * 2];
+        pEndOffsets[i] = pSpans[(i * 2) + 1];
+    }
+    if (SentCount > MaxSpanCount) {
+        FAStatsAdd(FAGetStatsModel(hModel, true), FA_STAT_SMALL_BUFFER, 1);
+    }
 
-    return hashArrSize;
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return SentCount;
 }
 
 
+// the text coming in chunks is decoded and processed in blocks of this many bytes
+const int STREAM_BLOCK_SIZE = 65536;
+
 //
-// WordHyphenationWithModel - returns a hyphenated string for an input word.
-// 
-// The hModel parameter allows to use a model loaded with LoadModel API, 
-//  NULL is not allowed since there is no built in model for this function
+// Keeps the state of the lexical analysis of a text which comes in chunks. The UTF-8 bytes are
+// decoded (and normalized, if pCharMap is given) into a window of UTF-32 characters, the characters
+// are dropped from the window as soon as no scan of the lexer can read them, so the memory used does
+// not depend on the text size and the results are the same as if the whole text was processed at once.
 //
-extern "C"
-const int WordHyphenationWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
-    char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, void * hModel, const int uHy = __FADefaultHyphen__)
+struct FALexStream
 {
-    // pModel is always initialized here
-    const FAModelData * pModel = (const FAModelData *) hModel; 
-
-    // validate the parameters
-    if (0 == InUtf8StrByteCount) {
-        return 0;
+    // the model, it is not owned
+    const FAModelData * m_pModel;
+    // optional character normalization map
+    const FAMultiMapCA * m_pCharMap;
+    // indicates whether 'U+0000' characters are replaced with spaces
+    bool m_fNoZeros;
+    // the lexer results buffer size per character
+    int m_ResFactor;
+    // the incomplete UTF-8 sequence at the end of the last chunk
+    char m_Tail[4];
+    int m_TailSize;
+    // the number of bytes decoded so far
+    int64_t m_ByteCount;
+    // the window of UTF-32 characters, absolute offsets of the first and the last bytes of
+    // the UTF-8 characters they come from
+    std::vector< int > m_Chars;
+    std::vector< int64_t > m_Offsets;
+    std::vector< int64_t > m_Ends;
+    // absolute position of the first character of the window
+    int64_t m_CharPos;
+    // true until the lexer has processed the beginning of the text
+    bool m_fBegin;
+    // window position the next lexer call starts from
+    int m_NextPos;
+    // results of the last lexer call, the positions are relative to the window
+    std::vector< int > m_Res;
+    // decoder output
+    std::vector< int > m_Utf32;
+    std::vector< int > m_Utf32Offsets;
+
+    FALexStream (const FAModelData * pModel, const FAMultiMapCA * pCharMap,
+            const bool fNoZeros, const int ResFactor):
+        m_pModel (pModel),
+        m_pCharMap (pCharMap),
+        m_fNoZeros (fNoZeros),
+        m_ResFactor (ResFactor)
+    {
+        Reset ();
     }
-    if (0 > InUtf8StrByteCount || InUtf8StrByteCount > FALimits::MaxArrSize) {
-        return -1;
+
+    // prepares for a new text
+    void Reset ()
+    {
+        m_TailSize = 0;
+        m_ByteCount = 0;
+        m_Chars.clear ();
+        m_Offsets.clear ();
+        m_Ends.clear ();
+        m_CharPos = 0;
+        m_fBegin = true;
+        m_NextPos = 0;
     }
-    if (NULL == pInUtf8Str) {
-        return -1;
+
+    // returns true if the window is big enough to be processed
+    const bool IsFull () const
+    {
+        const size_t MaxTokenLength = (size_t) m_pModel->m_Engine.GetMaxTokenLength ();
+        return m_Chars.size () >= MaxTokenLength + STREAM_BLOCK_SIZE;
     }
 
-    // allocate a buffer for UTF-32 representation of a word, also keep it within limits
-    int pBuff [FALimits::MaxWordSize];
+    // appends the character to the window, Offset and End are of its first and last bytes
+    inline void AddChar (const int C, const int64_t Offset, const int64_t End)
+    {
+        if (NULL != m_pCharMap) {
 
-    // convert input to UTF-32
-    const int MaxBuffSize = ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, FALimits::MaxWordSize);
-    if (MaxBuffSize <= 0 || MaxBuffSize > FALimits::MaxWordSize) {
-        return -1;
-    }
-    // make sure the utf32input does not contain 'U+0000' elements
-    std::replace(pBuff, pBuff + MaxBuffSize, 0, 0x20);
+            // the same as FANormalize does
+            const int MaxNormCount = 10;
+            int Norm [MaxNormCount];
 
-    // keep inner hyphenation results here
-    int pHyRes [FALimits::MaxWordSize];
-    // get the sentence breaking results
-    const int Res = pModel->m_HyEngine.Process(pBuff, MaxBuffSize, pHyRes, MaxBuffSize);
-    if (-1 == Res) {
-        return -1;
-    }
+            const int NormCount = m_pCharMap->Get (C, Norm, MaxNormCount);
 
-    // one character buffer
-    const int MaxSize = FAUtf8Const::MAX_CHAR_SIZE + 1;
-    char Utf8Symbol [MaxSize];
+            if (-1 != NormCount) {
+                for (int i = 0; i < NormCount && NormCount <= MaxNormCount; ++i) {
+                    m_Chars.push_back (Norm[i]);
+                    m_Offsets.push_back (Offset);
+                    m_Ends.push_back (End);
+                }
+                return;
+            }
+        }
 
-    // convert UTF-32 hyphen to UTF-8 once to use it later
-    char Utf8HySymbol [MaxSize];
-    char * pHyEnd = FAIntToUtf8 (uHy, Utf8HySymbol, MaxSize);
-    if (NULL == pHyEnd) {
-        return -1;
+        m_Chars.push_back (0 != C || !m_fNoZeros ? C : 0x20);
+        m_Offsets.push_back (Offset);
+        m_Ends.push_back (End);
     }
-    const size_t Utf8HyLen = pHyEnd - Utf8HySymbol;
 
-    // keep track of how many bytes were outputted or needed to get a full output
-    int TotalOutputSizeNeeded = 0;
+    // decodes the bytes into the window, returns false if the input is not a valid UTF-8
+    const bool Add (const char * pBytes, int ByteCount)
+    {
+        // complete the sequence started in the previous chunk
+        if (0 < m_TailSize) {
 
-    for (int i = 0; i < MaxBuffSize; ++i) {
+            const int Size = ::FAUtf8Size (m_Tail);
+            DebugLogAssert (m_TailSize < Size && Size <= 4);
 
-        // output current input symbol
-        const int Symbol = pBuff [i];
-        char * pEnd = FAIntToUtf8 (Symbol, Utf8Symbol, MaxSize);
-        if (NULL == pEnd) {
-            return -1;
+            const int Count = std::min (Size - m_TailSize, ByteCount);
+            memcpy (m_Tail + m_TailSize, pBytes, Count);
+            m_TailSize += Count;
+            pBytes += Count;
+            ByteCount -= Count;
+
+            if (m_TailSize < Size) {
+                return true;
+            }
+
+            int C = 0;
+            if (NULL == ::FAUtf8ToInt (m_Tail, m_Tail + Size, &C)) {
+                return false;
+            }
+            // the Byte-Order-Mark is skipped at the beginning of the text only
+            if (0 != m_ByteCount || 0xFEFF != C) {
+                AddChar (C, m_ByteCount, m_ByteCount + Size - 1);
+            }
+            m_ByteCount += Size;
+            m_TailSize = 0;
         }
-        const size_t Utf8SymbolLen = pEnd - Utf8Symbol;
 
-        if (NULL != pOutUtf8Str && TotalOutputSizeNeeded + ((int) Utf8SymbolLen) <= MaxOutUtf8StrByteCount) {
-            memcpy(pOutUtf8Str + TotalOutputSizeNeeded, Utf8Symbol, Utf8SymbolLen);
+        // keep the incomplete sequence at the end, if any
+        int Len = ByteCount;
+        for (int i = 1; i <= 3 && i <= ByteCount; ++i) {
+            const char * pLast = pBytes + ByteCount - i;
+            if (0x80 != (0xC0 & (unsigned char) *pLast)) {
+                if (i < ::FAUtf8Size (pLast)) {
+                    Len = ByteCount - i;
+                }
+                break;
+            }
         }
-        TotalOutputSizeNeeded += (int) Utf8SymbolLen;
 
-        // get corresponding hyphenation id
-        const int HyphId = pHyRes [i];
+        // FAStrUtf8ToArray skips the Byte-Order-Mark at the beginning of any input
+        while (0 < m_ByteCount && 3 <= Len && 0xEF == (unsigned char) pBytes[0] &&
+            0xBB == (unsigned char) pBytes[1] && 0xBF == (unsigned char) pBytes[2]) {
+            AddChar (0xFEFF, m_ByteCount, m_ByteCount + 2);
+            m_ByteCount += 3;
+            pBytes += 3;
+            Len -= 3;
+            ByteCount -= 3;
+        }
 
-        // output a hyphen, if it is any kind of hyphenation
-        if (FAFsmConst::HYPH_NO_HYPH < HyphId) {
-            if (NULL != pOutUtf8Str && TotalOutputSizeNeeded + ((int) Utf8HyLen) <= MaxOutUtf8StrByteCount) {
-                memcpy(pOutUtf8Str + TotalOutputSizeNeeded, Utf8HySymbol, Utf8HyLen);
+        if (0 < Len) {
+
+            int * pBuff = FAGetBuffer (m_Utf32, Len);
+            int * pOffsets = FAGetBuffer (m_Utf32Offsets, Len);
+
+            const int Count = ::FAStrUtf8ToArray (pBytes, Len, pBuff, pOffsets, Len);
+            if (0 > Count || Count > Len) {
+                return false;
             }
-            TotalOutputSizeNeeded += (int) Utf8HyLen;
+            for (int i = 0; i < Count; ++i) {
+                const int End = (i + 1 < Count ? pOffsets[i + 1] : Len) - 1;
+                AddChar (pBuff[i], m_ByteCount + pOffsets[i], m_ByteCount + End);
+            }
+            m_ByteCount += Len;
         }
 
-    } // for (int i = 0; ...
+        m_TailSize = ByteCount - Len;
+        memcpy (m_Tail, pBytes + Len, m_TailSize);
 
-    // we will include the 0 just in case some scriping languages expect 0-terminated buffers and cannot use the size
-    if (NULL != pOutUtf8Str && TotalOutputSizeNeeded < MaxOutUtf8StrByteCount) {
-        pOutUtf8Str[TotalOutputSizeNeeded] = 0;
-        TotalOutputSizeNeeded++;
+        return true;
     }
 
-    return TotalOutputSizeNeeded;
-}
+    // runs the lexer over the window, returns the size of the results or -1 in case of an error
+    const int Lex (const bool fEnd)
+    {
+        const int Size = (int) m_Chars.size ();
 
+        if (0 == Size) {
+            m_NextPos = 0;
+            return 0;
+        }
 
-//
-// Helper, sets up pNewModelData object with model data from memory
-// Returns 0 in case of an error otherwise initialized pNewModelData object is returned
-//
-extern "C"
-void* SetModelData(FAModelData * pNewModelData, const unsigned char * pImgBytes)
-{
-    if (NULL == pNewModelData) {
-        return NULL;
-    }
-    if (NULL == pImgBytes) {
-        return NULL;
+        const int MaxOutSize = Size * m_ResFactor;
+        int * pRes = FAGetBuffer (m_Res, MaxOutSize);
+        const int OutSize = m_pModel->m_Engine.ProcessPart (m_Chars.data (), Size,
+            m_fBegin, fEnd, pRes, MaxOutSize, &m_NextPos);
+
+        if (0 > OutSize || OutSize > MaxOutSize || 0 != OutSize % 3) {
+            return -1;
+        }
+        return OutSize;
     }
 
-    // create a generic LDB object from bytes
-    pNewModelData->m_Ldb.SetImage (pImgBytes);
+    // drops the characters the lexer is done with
+    void Drop ()
+    {
+        if (-1 == m_NextPos) {
+            return;
+        }
 
-    // get the configuration paramenters for [wbd]
-    const int * pValues = NULL;
-    int iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_WBD, &pValues);
+        m_Chars.erase (m_Chars.begin (), m_Chars.begin () + m_NextPos);
+        m_Offsets.erase (m_Offsets.begin (), m_Offsets.begin () + m_NextPos);
+        m_Ends.erase (m_Ends.begin (), m_Ends.begin () + m_NextPos);
+        m_CharPos += m_NextPos;
+        m_NextPos = 0;
+        m_fBegin = false;
+    }
+};
 
-    // see if the [wbd] section is present
-    if (-1 != iSize) {
 
-        pNewModelData->m_hasWbd = true;
-        // initialize WBD configuration
-        pNewModelData->m_Conf.Initialize (&(pNewModelData->m_Ldb), pValues, iSize);
-        // now initialize the engine
-        pNewModelData->m_Engine.SetConf(&(pNewModelData->m_Conf));
+//
+// Adds the chunk of the text to the stream (FASbdStream or FAWbdStream), the chunk is processed
+// block by block, so the window does not grow with the chunk size. A chunk after the end of the
+// text starts a new text, if all the results have been returned. Returns false in case of an error.
+//
+template < class TStream >
+const bool FAStreamFeed(TStream * pStream, const char * pInUtf8Str, int InUtf8StrByteCount)
+{
+    if (pStream->m_fError) {
+        return false;
     }
 
-    // get the configuration paramenters for [pos-dict]
-    pValues = NULL;
-    iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_POS_DICT, &pValues);
-
-    // see if the [pos-dict] section is present
-    if (-1 != iSize) {
+    if (pStream->m_fFlushed && 0 < InUtf8StrByteCount) {
+        if (!pStream->IsEmpty()) {
+            return false;
+        }
+        pStream->Reset();
+    }
 
-        pNewModelData->m_hasSeg = true;
+    while (0 < InUtf8StrByteCount) {
 
-        // initialize dict configuration
-        pNewModelData->m_DictConf.SetLDB (&(pNewModelData->m_Ldb));
-        pNewModelData->m_DictConf.Init (pValues, iSize);
+        const int BlockSize = std::min(InUtf8StrByteCount, STREAM_BLOCK_SIZE);
 
-        // initialize algorithm based on pNewModelData->m_DictConf.GetTokAlgo()
-        if (FAFsmConst::TOKENIZE_BPE == pNewModelData->m_DictConf.GetTokAlgo() ||
-            FAFsmConst::TOKENIZE_BPE_OPT == pNewModelData->m_DictConf.GetTokAlgo()) {
+        if (!pStream->m_Lex.Add(pInUtf8Str, BlockSize)) {
+            pStream->m_fError = true;
+            return false;
+        }
+        pInUtf8Str += BlockSize;
+        InUtf8StrByteCount -= BlockSize;
 
-            pNewModelData->m_SegEngineBpe.SetConf(&pNewModelData->m_DictConf);
-            pNewModelData->m_pAlgo = &(pNewModelData->m_SegEngineBpe);
+        if (pStream->m_Lex.IsFull() && !pStream->Process(false)) {
+            pStream->m_fError = true;
+            return false;
+        }
+    }
 
-        } else if (FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES == pNewModelData->m_DictConf.GetTokAlgo()) {
+    return true;
+}
 
-            pNewModelData->m_SegEngineBpeWithMerges.SetConf(&pNewModelData->m_DictConf);
-            pNewModelData->m_pAlgo = &(pNewModelData->m_SegEngineBpeWithMerges);
 
-        } else {
+//
+// Processes the rest of the text in the stream, returns false in case of an error
+//
+template < class TStream >
+const bool FAStreamFlush(TStream * pStream)
+{
+    if (pStream->m_fError) {
+        return false;
+    }
 
-            pNewModelData->m_SegEngine.SetConf(&pNewModelData->m_DictConf);
-            pNewModelData->m_pAlgo = &(pNewModelData->m_SegEngine);
+    if (!pStream->m_fFlushed) {
+        // the text should not end in the middle of a UTF-8 sequence
+        if (0 != pStream->m_Lex.m_TailSize || !pStream->Process(true)) {
+            pStream->m_fError = true;
+            return false;
         }
-        
-        // see if we need to treat UTF-8 bytes as input
-        pNewModelData->m_useRawBytes = pNewModelData->m_DictConf.GetUseByteEncoding();
+        pStream->m_fFlushed = true;
     }
 
-    // get the configuration paramenters for hyphenation [w2h]
-    pValues = NULL;
-    iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_W2H, &pValues);
-
-    // see if the [pos-dict] section is present
-    if (-1 != iSize) {
-
-        pNewModelData->m_hasHy = true;
+    return true;
+}
 
-        // initialize hyph configuration
-        pNewModelData->m_HyConf.SetLDB (&(pNewModelData->m_Ldb));
-        pNewModelData->m_HyConf.Init (pValues, iSize);
 
-        // initialize the algo with data
-        pNewModelData->m_HyEngine.SetConf (&pNewModelData->m_HyConf);
+//
+// Keeps the state of the sentence breaking of a text which comes in chunks, see SbdBegin
+//
+struct FASbdStream
+{
+    FALexStream m_Lex;
+    // absolute position of the last character of the last sentence
+    int64_t m_PrevEnd;
+    // characters after m_PrevEnd and before m_StartPos have been checked for the sentence start
+    int64_t m_StartPos;
+    // byte offset of the first non-white-space character after m_PrevEnd, -1 if not found yet
+    int64_t m_StartOffset;
+    // [start, end] byte offsets of the sentences not yet returned
+    std::vector< int64_t > m_Spans;
+    size_t m_SpanPos;
+    // indicates that the end of the text has been processed
+    bool m_fFlushed;
+    // indicates that an error has happened
+    bool m_fError;
+
+    FASbdStream (const FAModelData * pModel):
+        m_Lex (pModel, NULL, true, 3)
+    {
+        Reset ();
     }
 
+    // prepares for a new text
+    void Reset ()
+    {
+        m_Lex.Reset ();
+        m_PrevEnd = -1;
+        m_StartPos = 0;
+        m_StartOffset = -1;
+        m_Spans.clear ();
+        m_SpanPos = 0;
+        m_fFlushed = false;
+        m_fError = false;
+    }
 
-    // get the configuration paramenters for hyphenation [i2w]
-    pNewModelData->m_min_token_id = 0;
-    pNewModelData->m_max_token_id = FALimits::MaxArrSize;
-    pNewModelData->m_hasI2w = false;
-
-    pValues = NULL;
-    iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_I2W, &pValues);
-
-    // see if the [pos-dict] section is present
-    if (-1 != iSize) {
+    // looks for the sentence start among the characters before the absolute position Pos
+    void FindStart (const int64_t Pos)
+    {
+        if (-1 == m_StartOffset) {
+            for (int64_t i = m_StartPos; i < Pos; ++i) {
+                const size_t j = (size_t) (i - m_Lex.m_CharPos);
+                if (!__FAIsWhiteSpace__(m_Lex.m_Chars[j])) {
+                    m_StartOffset = m_Lex.m_Offsets[j];
+                    break;
+                }
+            }
+        }
+        if (m_StartPos < Pos) {
+            m_StartPos = Pos;
+        }
+    }
 
-        for (int i = 0; i < iSize; ++i) {
+    // ends the sentence at the absolute character position To, EndOffset is its last byte
+    void AddEnd (const int64_t To, const int64_t EndOffset)
+    {
+        // the same as FAGetSentenceSpans does
+        if (To > m_PrevEnd) {
+            FindStart (To + 1);
+            if (-1 != m_StartOffset) {
+                m_Spans.push_back (m_StartOffset);
+                m_Spans.push_back (EndOffset);
+            }
+        }
+        m_PrevEnd = To;
+        m_StartPos = To + 1;
+        m_StartOffset = -1;
+    }
 
-            if (pValues [i] == FAFsmConst::PARAM_STRING_ARRAY && i + 1 < iSize) {
+    // runs the sentence breaking over the window, returns false in case of an error
+    const bool Process (const bool fEnd)
+    {
+        const int OutSize = m_Lex.Lex (fEnd);
+        if (0 > OutSize) {
+            return false;
+        }
 
-                const int DumpNum = pValues [++i];
-                const unsigned char * pDump = pNewModelData->m_Ldb.GetDump (DumpNum);
+        const int * pRes = m_Lex.m_Res.data ();
 
-                if (NULL == pDump) {
-                    return NULL;
-                }
+        for (int i = 0; i < OutSize; i += 3) {
+            const int To = pRes[i + 2];
+            AddEnd (m_Lex.m_CharPos + To, m_Lex.m_Ends[To]);
+        }
 
-                pNewModelData->m_i2w.SetImage(pDump);
-                pNewModelData->m_hasI2w = true;
+        const int64_t WindowEnd = m_Lex.m_CharPos + m_Lex.m_Chars.size ();
 
-            } else if (pValues [i] == FAFsmConst::PARAM_TOKENID_MIN && i + 1 < iSize) {
+        if (fEnd) {
+            // always use the end of the text as the end of sentence
+            AddEnd (WindowEnd - 1, m_Lex.m_ByteCount - 1);
+        } else {
+            // the dropped characters have to be checked for the sentence start
+            FindStart (m_Lex.m_CharPos + (-1 != m_Lex.m_NextPos ? m_Lex.m_NextPos : 0));
+            m_Lex.Drop ();
+        }
+        return true;
+    }
 
-                pNewModelData->m_min_token_id = pValues [++i];
+    // returns true if all the spans have been returned
+    const bool IsEmpty () const
+    {
+        return m_Spans.empty ();
+    }
 
-            } else if (pValues [i] == FAFsmConst::PARAM_TOKENID_MAX && i + 1 < iSize) {
+    // copies upto MaxSpanCount spans, returns the number of spans copied
+    const int Pop (int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxSpanCount)
+    {
+        int Count = 0;
 
-                pNewModelData->m_max_token_id = pValues [++i];
-            }
+        for (; Count < MaxSpanCount && m_SpanPos < m_Spans.size (); ++Count) {
+            pStartOffsets[Count] = m_Spans[m_SpanPos++];
+            pEndOffsets[Count] = m_Spans[m_SpanPos++];
         }
+        if (m_SpanPos == m_Spans.size ()) {
+            m_Spans.clear ();
+            m_SpanPos = 0;
+        }
+        return Count;
+    }
+};
 
-        if (1 < iSize && pValues [0] == FAFsmConst::PARAM_STRING_ARRAY) {
-
-            const int DumpNum = pValues [1];
-            const unsigned char * pDump = pNewModelData->m_Ldb.GetDump (DumpNum);
-
-            if (NULL == pDump) {
-                return NULL;
-            }
 
-            pNewModelData->m_i2w.SetImage(pDump);
-            pNewModelData->m_hasI2w = true;
+//
+// Starts the sentence breaking of a text which comes in chunks, returns the stream handle or
+//  NULL in case of an error.
+//
+// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
+//  the built in is used. The model should not be freed before the stream.
+//
+// Usage:
+//
+//  1. SbdFeed is called for each chunk of the text, the chunks may split the UTF-8 sequences,
+//     it returns the sentences which cannot be changed by the rest of the text.
+//  2. SbdFlush is called at the end of the text, it returns the remaining sentences.
+//  3. SbdFree is called to free the stream.
+//
+// The sentences are returned as [start, end] byte offsets from the beginning of the text, they are
+//  the same as the TextToSentenceSpansWithModel returns for the whole text. The stream keeps at
+//  most the model's max token length plus a fixed block of characters, so the text size is not
+//  limited.
+//
+extern "C"
+void* SbdBegin(void * hModel)
+{
+#ifdef SIZE_OPTIMIZATION
+    if (NULL == hModel) {
+        return NULL;
+    }
+#else
+    // check if the initilization is needed
+    if (false == g_fInitialized) {
+        // make sure only one thread can get the mutex
+        std::lock_guard<std::mutex> guard(g_InitializationMutex);
+        // see if the g_fInitialized is still false
+        if (false == g_fInitialized) {
+            InitializeWbdSbd();
+            g_fInitialized = true;
         }
     }
 
-    return (void*) pNewModelData;
+    // use the default model if it was not provided
+    if (NULL == hModel) {
+        hModel = &g_DefaultSbd;
+    }
+#endif
+
+    return new FASbdStream((const FAModelData *) hModel);
 }
 
 
 //
-// Same as LoadModel except a model is created from a memory pointer
-// Returns 0 in case of an error
+// Adds the next chunk of the text, copies upto MaxSpanCount of [start, end] byte offsets of the
+//  sentences found into pStartOffsets and pEndOffsets, returns the number of sentences copied or
+//  -1 in case of an error (e.g. invalid UTF-8).
+//
+// The sentences which do not fit are kept and returned by the next calls, SbdFeed can be called
+//  with an empty chunk to get them. SbdFeed after SbdFlush starts a new text, this is an error if
+//  not all sentences of the previous text have been returned.
 //
 extern "C"
-void* SetModel(const unsigned char * pImgBytes, int ModelByteCount)
+const int SbdFeed(void* StreamPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxSpanCount)
 {
-    FAModelData * pNewModelData = new FAModelData();
-    if (NULL == pNewModelData) {
-        return 0;
+    FASbdStream * pStream = (FASbdStream *) StreamPtr;
+
+    if (NULL == pStream) {
+        return -1;
+    }
+    if (0 > InUtf8StrByteCount || (0 < InUtf8StrByteCount && NULL == pInUtf8Str)) {
+        return -1;
+    }
+    if (0 > MaxSpanCount || (0 < MaxSpanCount && (NULL == pStartOffsets || NULL == pEndOffsets))) {
+        return -1;
     }
 
-    // load the bin file
-    if (NULL == pImgBytes || 0 == ModelByteCount) {
-        return 0;
+    if (!FAStreamFeed(pStream, pInUtf8Str, InUtf8StrByteCount)) {
+        return -1;
     }
 
-    // return the initialized model handle
-    return SetModelData(pNewModelData, pImgBytes);
+    return pStream->Pop(pStartOffsets, pEndOffsets, MaxSpanCount);
 }
 
 
 //
-// Loads a model and return a handle.
-// Returns 0 in case of an error.
+// Ends the text, copies upto MaxSpanCount of the remaining sentences, returns the number of
+//  sentences copied or -1 in case of an error (e.g. the text ends in the middle of a UTF-8
+//  sequence). SbdFlush can be called again to get the sentences which did not fit.
 //
 extern "C"
-void* LoadModel(const char * pszLdbFileName)
+const int SbdFlush(void* StreamPtr, int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxSpanCount)
 {
-    FAModelData * pNewModelData = new FAModelData();
-    if (NULL == pNewModelData) {
-        return 0;
+    FASbdStream * pStream = (FASbdStream *) StreamPtr;
+
+    if (NULL == pStream) {
+        return -1;
+    }
+    if (0 > MaxSpanCount || (0 < MaxSpanCount && (NULL == pStartOffsets || NULL == pEndOffsets))) {
+        return -1;
     }
 
-    // load the bin file
-    pNewModelData->m_Img.Load (pszLdbFileName);
-    const unsigned char * pImgBytes = pNewModelData->m_Img.GetImageDump ();
-    if (NULL == pImgBytes) {
-        return 0;
+    if (!FAStreamFlush(pStream)) {
+        return -1;
     }
 
-    // return the initialized model handle
-    return SetModelData(pNewModelData, pImgBytes);
+    return pStream->Pop(pStartOffsets, pEndOffsets, MaxSpanCount);
 }
 
 
 //
-// Implements a word-piece algorithm. Returns ids of words or sub-words, returns upto MaxIdsArrLength ids,
-// the rest of the array is unchanged, so the array can be set to initial length and fill with 0's for padding.
-// If pStartOffsets and pEndOffsets are not NULL then fills in the start and end offset for each token.
-// Return value is the number of ids copied into the array.
-//
-// Example:
-//  input: Эpple pie.
-//  fa_lex output: эpple/WORD э/WORD_ID_1208 pp/WORD_ID_9397 le/WORD_ID_2571 pie/WORD pie/WORD_ID_11345 ./WORD ./WORD_ID_1012
-//  TextToIds output: [1208, 9397, 2571, 11345, 1012, ... <unchanged>]
+// Frees the stream created by SbdBegin
 //
 extern "C"
-const int TextToIdsWithOffsets_wp(
-        void* ModelPtr,
-        const char * pInUtf8Str,
-        int InUtf8StrByteCount,
-        int32_t * pIdsArr, 
-        int * pStartOffsets, 
-        int * pEndOffsets,
-        const int MaxIdsArrLength,
-        const int UnkId = 0
-)
+int SbdFree(void* StreamPtr)
 {
-    // validate the parameters
-    if (0 >= InUtf8StrByteCount || InUtf8StrByteCount > FALimits::MaxArrSize || NULL == pInUtf8Str || 0 == ModelPtr) {
+    if (NULL == StreamPtr) {
         return 0;
     }
+    delete (FASbdStream *) StreamPtr;
+    return 0;
+}
 
-    // allocate buffer for UTF-8 --> UTF-32 conversion
-    std::vector< int > utf32input(InUtf8StrByteCount);
-    int * pBuff = utf32input.data();
-    if (NULL == pBuff) {
-        return 0;
+
+//
+// Keeps the state of the word breaking of a text which comes in chunks, see WbdBegin
+//
+struct FAWbdStream
+{
+    FALexStream m_Lex;
+    // indicates whether word-piece ids are returned rather than the word tags
+    bool m_fIds;
+    // the id of the words which are not covered by the word-pieces
+    int m_UnkId;
+    // tag (or id), start and end byte offsets of the tokens not yet returned
+    std::vector< int64_t > m_Tokens;
+    size_t m_TokenPos;
+    // indicates that the end of the text has been processed
+    bool m_fFlushed;
+    // indicates that an error has happened
+    bool m_fError;
+
+    // the word-piece models normalize characters and keep 'U+0000', as TextToIdsWithOffsets_wp does
+    FAWbdStream (const FAModelData * pModel, const bool fIds, const int UnkId):
+        m_Lex (pModel, fIds ? pModel->m_Conf.GetCharMap () : NULL, !fIds, fIds ? 6 : 3),
+        m_fIds (fIds),
+        m_UnkId (UnkId)
+    {
+        Reset ();
     }
 
-    // a container for the offsets
-    std::vector< int > utf32offsets;
-    int * pOffsets = NULL;
+    // prepares for a new text
+    void Reset ()
+    {
+        m_Lex.Reset ();
+        m_Tokens.clear ();
+        m_TokenPos = 0;
+        m_fFlushed = false;
+        m_fError = false;
+    }
 
-    // flag to alter the logic in case we don't need the offsets
-    const bool fNeedOffsets = NULL != pStartOffsets && NULL != pEndOffsets;
+    // adds the token, From and To are positions in the window
+    inline void AddToken (const int Tag, const int From, const int To)
+    {
+        m_Tokens.push_back (Tag);
+        m_Tokens.push_back (m_Lex.m_Offsets[From]);
+        m_Tokens.push_back (m_Lex.m_Ends[To]);
+    }
+
+    // runs the word breaking over the window, returns false in case of an error
+    const bool Process (const bool fEnd)
+    {
+        const int OutSize = m_Lex.Lex (fEnd);
+        if (0 > OutSize) {
+            return false;
+        }
+
+        const int * pRes = m_Lex.m_Res.data ();
+
+        for (int i = 0; i < OutSize; i += 3) {
+
+            // ignore tokens with IGNORE tag
+            const int Tag = pRes[i];
+            if (WBD_IGNORE_TAG == Tag) {
+                continue;
+            }
+
+            if (!m_fIds) {
+                AddToken (Tag, pRes[i + 1], pRes[i + 2]);
+                continue;
+            }
+
+            // the same as TextToIdsWithOffsets_wp_int does, the word's sub-tokens follow the word
+            //  and they are used if they cover the word completely, otherwise m_UnkId is used
+            if (WBD_WORD_TAG == Tag) {
+
+                const int TokenFrom = pRes[i + 1];
+                const int TokenTo = pRes[i + 2];
+
+                int j = i + 3;
+                int ExpectedFrom = TokenFrom;
+
+                while (j < OutSize && pRes[j] > WBD_IGNORE_TAG && ExpectedFrom == pRes[j + 1]) {
+                    ExpectedFrom = pRes[j + 2] + 1;
+                    j += 3;
+                }
+
+                if (i + 3 < j && ExpectedFrom - 1 == TokenTo) {
+                    for (int k = i + 3; k < j; k += 3) {
+                        AddToken (pRes[k], pRes[k + 1], pRes[k + 2]);
+                    }
+                } else {
+                    AddToken (m_UnkId, TokenFrom, TokenTo);
+                }
+
+                // skip the sub-tokens
+                i = j - 3;
+            }
+        }
+
+        if (!fEnd) {
+            m_Lex.Drop ();
+        }
+        return true;
+    }
+
+    // returns true if all the tokens have been returned
+    const bool IsEmpty () const
+    {
+        return m_Tokens.empty ();
+    }
+
+    // copies upto MaxTokenCount tokens, returns the number of tokens copied
+    const int Pop (int32_t * pTags, int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxTokenCount)
+    {
+        int Count = 0;
+
+        for (; Count < MaxTokenCount && m_TokenPos < m_Tokens.size (); ++Count) {
+            pTags[Count] = (int32_t) m_Tokens[m_TokenPos++];
+            pStartOffsets[Count] = m_Tokens[m_TokenPos++];
+            pEndOffsets[Count] = m_Tokens[m_TokenPos++];
+        }
+        if (m_TokenPos == m_Tokens.size ()) {
+            m_Tokens.clear ();
+            m_TokenPos = 0;
+        }
+        return Count;
+    }
+};
+
+
+//
+// Starts the word breaking of a text which comes in chunks, returns the stream handle or NULL in
+//  case of an error. The stream returns the words as (tag, start, end) where start and end are the
+//  byte offsets of the first and the last bytes of the word from the beginning of the text, the
+//  words are the same as TextToWordSpansWithModel returns for the whole text.
+//
+// The hModel parameter allows to use a custom model loaded with LoadModel API, if NULL then
+//  the built in is used. The model should not be freed before the stream.
+//
+// Usage is the same as of SbdBegin: WbdFeed is called for each chunk of the text (the chunks may
+//  split the UTF-8 sequences), WbdFlush is called at the end of the text, WbdFree frees the stream.
+//  The stream keeps at most the model's max token length plus a fixed block of characters, so the
+//  memory used does not depend on the text size.
+//
+extern "C"
+void* WbdBegin(void * hModel)
+{
+#ifdef SIZE_OPTIMIZATION
+    if (NULL == hModel) {
+        return NULL;
+    }
+#else
+    // check if the initilization is needed
+    if (false == g_fInitialized) {
+        // make sure only one thread can get the mutex
+        std::lock_guard<std::mutex> guard(g_InitializationMutex);
+        // see if the g_fInitialized is still false
+        if (false == g_fInitialized) {
+            InitializeWbdSbd();
+            g_fInitialized = true;
+        }
+    }
+
+    // use a default model if none was provided
+    if (NULL == hModel) {
+        hModel = &g_DefaultWbd;
+    }
+#endif
+
+    return new FAWbdStream((const FAModelData *) hModel, false, 0);
+}
+
+
+//
+// The same as WbdBegin, but the stream returns the word-piece tokens as (id, start, end), the
+//  tokens are the same as TextToIdsWithOffsets returns for the whole text. The model should be
+//  a word-piece model, the models with segmentation data (sentence piece, BPE) are not supported.
+//
+extern "C"
+void* WbdBeginIds(void * hModel, const int UnkId)
+{
+    const FAModelData * pModel = (const FAModelData *) hModel;
+
+    if (NULL == pModel || pModel->m_hasSeg) {
+        return NULL;
+    }
+
+    return new FAWbdStream(pModel, true, UnkId);
+}
+
+
+//
+// Adds the next chunk of the text, copies upto MaxTokenCount tokens found into pTags (or ids),
+//  pStartOffsets and pEndOffsets, returns the number of tokens copied or -1 in case of an error.
+//
+// The tokens which do not fit are kept and returned by the next calls, WbdFeed can be called with
+//  an empty chunk to get them. WbdFeed after WbdFlush starts a new text, this is an error if not all
+//  tokens of the previous text have been returned.
+//
+extern "C"
+const int WbdFeed(void* StreamPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    int32_t * pTags, int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxTokenCount)
+{
+    FAWbdStream * pStream = (FAWbdStream *) StreamPtr;
+
+    if (NULL == pStream) {
+        return -1;
+    }
+    if (0 > InUtf8StrByteCount || (0 < InUtf8StrByteCount && NULL == pInUtf8Str)) {
+        return -1;
+    }
+    if (0 > MaxTokenCount || (0 < MaxTokenCount && (NULL == pTags || NULL == pStartOffsets || NULL == pEndOffsets))) {
+        return -1;
+    }
+
+    if (!FAStreamFeed(pStream, pInUtf8Str, InUtf8StrByteCount)) {
+        return -1;
+    }
+
+    return pStream->Pop(pTags, pStartOffsets, pEndOffsets, MaxTokenCount);
+}
+
+
+//
+// Ends the text, copies upto MaxTokenCount of the remaining tokens, returns the number of tokens
+//  copied or -1 in case of an error. WbdFlush can be called again to get the tokens which did not fit.
+//
+extern "C"
+const int WbdFlush(void* StreamPtr, int32_t * pTags, int64_t * pStartOffsets, int64_t * pEndOffsets,
+    const int MaxTokenCount)
+{
+    FAWbdStream * pStream = (FAWbdStream *) StreamPtr;
+
+    if (NULL == pStream) {
+        return -1;
+    }
+    if (0 > MaxTokenCount || (0 < MaxTokenCount && (NULL == pTags || NULL == pStartOffsets || NULL == pEndOffsets))) {
+        return -1;
+    }
+
+    if (!FAStreamFlush(pStream)) {
+        return -1;
+    }
+
+    return pStream->Pop(pTags, pStartOffsets, pEndOffsets, MaxTokenCount);
+}
+
+
+//
+// Frees the stream created by WbdBegin or WbdBeginIds
+//
+extern "C"
+int WbdFree(void* StreamPtr)
+{
+    if (NULL == StreamPtr) {
+        return 0;
+    }
+    delete (FAWbdStream *) StreamPtr;
+    return 0;
+}
+
+
+//
+// This function is like TextToWords, but it only normalizes consequtive spaces, it is not as flexble
+//  as TextToWords as it cannot take a tokenization and normalization rules, but it does space normalization
+//  and srinking multiple spaces to one faster.
+//
+// Input:  UTF-8 string of one sentence or paragraph or document
+//         space character to use, default is __FASpDelimiter__ (U+x2581)
+// Output: Size in bytes of the output string and UTF-8 string of ' ' delimited words, if the return size <= MaxOutUtf8StrByteCount
+//
+// Notes:
+//  The return value is -1 in case of an error (make sure your input is a valid UTF-8, BOM is not required)
+//  
+extern "C"
+const int NormalizeSpaces(const char * pInUtf8Str, int InUtf8StrByteCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, const int uSpace = __FASpDelimiter__)
+{
+    // we can get weird results if this is not true
+    DebugLogAssert(__FAIsWhiteSpace__(uSpace));
+
+    if (0 == InUtf8StrByteCount) {
+        return -1;
+    }
+
+    // allocate buffer for UTF-32, sentence breaking results, word-breaking results
+    std::vector< int > utf32input(InUtf8StrByteCount);
+    int * pBuff = utf32input.data();
+    if (NULL == pBuff) {
+        return -1;
+    }
+
+    // convert input to UTF-32
+    int MaxBuffSize = ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, InUtf8StrByteCount);
+    if (MaxBuffSize <= 0 || MaxBuffSize > InUtf8StrByteCount) {
+        return -1;
+    }
+
+    int i = 0; // index for reading
+    int j = 0; // index for writing
+    while (i < MaxBuffSize) {
+
+        const int Ci = pBuff[i++];
+
+        // check if the Ci is not a space
+        if (!__FAIsWhiteSpace__(Ci)) {
+            // copy it
+            pBuff[j++] = Ci;
+        // if Ci is a space, check if the previous character was not a sapce
+        } else if (0 < j && uSpace != pBuff[j - 1]) {
+            // copy normalized space
+            pBuff[j++] = uSpace;
+        }
+    } // of while ...
+
+    // trim the final space if there was no content characters after
+    if (1 < j && pBuff[j - 1] == uSpace) {
+        j--;
+    }
+
+    MaxBuffSize = j;
+
+    // convert UTF-32 back to UTF-8
+    const int StrOutSize = ::FAArrayToStrUtf8(pBuff, MaxBuffSize, pOutUtf8Str, MaxOutUtf8StrByteCount);
+    if (0 <= StrOutSize && StrOutSize < MaxOutUtf8StrByteCount) {
+        pOutUtf8Str [StrOutSize] = 0;
+    }
+
+    return StrOutSize;
+}
+
+
+// This function implements the fasttext hashing function
+inline const uint32_t GetHash(const char * str, size_t strLen)
+{
+    uint32_t h = 2166136261;
+    for (size_t i = 0; i < strLen; i++) {
+        h = h ^ uint32_t(int8_t(str[i]));
+        h = h * 16777619;
+    }
+    return h;
+}
+
+
+// EOS symbol
+int32_t EOS_HASH = GetHash("</s>", 4);
+
+// the multiplier of the ngram hash
+const uint64_t NGRAM_HASH_MULT = 116049371;
+
+// Adds the hashes of the higher order ngrams (bigrams and up) for the tokenCount unigram hashes
+//  in the hashArray, each token has a ngram starting from itself, the ngrams of the order N are
+//  stored at [(N - 1) * tokenCount, N * tokenCount), the ngrams are padded by EOS_HASH
+void AddWordNgrams(int32_t * hashArray, const int tokenCount, const int32_t wordNgrams, const int32_t bucket)
+{
+    if (1 >= wordNgrams || 0 >= tokenCount) {
+        return;
+    }
+
+    // the modulo by a multiplication, bucket is the same for all the ngrams
+    const FAFastMod bucketMod (0 < bucket ? (uint64_t) bucket : 1);
+    const uint64_t eosHash = (uint64_t) (int64_t) EOS_HASH;
+
+    for (int i = 0; i < tokenCount; i++) {
+
+        // the hashes are sign extended as in the fasttext
+        uint64_t h = (uint64_t) (int64_t) hashArray[i];
+        int32_t * pOut = hashArray + tokenCount + i;
+
+        // the tokens of the text
+        const int jMax = (i + wordNgrams < tokenCount) ? i + wordNgrams : tokenCount;
+        int j = i + 1;
+        for (; j < jMax; j++, pOut += tokenCount) {
+            h = h * NGRAM_HASH_MULT + (uint64_t) (int64_t) hashArray[j];
+            *pOut = (int32_t) (0 < bucket ? bucketMod.Mod (h) : h % bucket);
+        }
+        // the padding
+        for (; j < i + wordNgrams; j++, pOut += tokenCount) {
+            h = h * NGRAM_HASH_MULT + eosHash;
+            *pOut = (int32_t) (0 < bucket ? bucketMod.Mod (h) : h % bucket);
+        }
+    }
+}
+
+
+// Port the fast text getline function with modifications
+// 1. do not have vocab
+// 2. do not compute subwords info
+//
+// Computes unigram hashes of the space delimited tokens in one pass, the spaces are found by memchr
+//  (vectorized in the C runtime). Returns the number of tokens or -1 if there are more than maxTokenCount.
+//
+const int ComputeUnigramHashes(const char * input, const int strLen, int32_t * hashArr, const int maxTokenCount)
+{
+    const char * pWordStart = input;
+    const char * pEnd = input + strLen;
+    int hashCount = 0;
+
+    // unlike fasttext, there's no EOS padding here, an empty input has one empty token
+    while (true) {
+
+        const char * pSpace = 0 < pEnd - pWordStart ?
+            (const char *) memchr(pWordStart, ' ', pEnd - pWordStart) : NULL;
+        const char * pWordEnd = (NULL != pSpace) ? pSpace : pEnd;
+
+        if (hashCount >= maxTokenCount) {
+            return -1;
+        }
+        hashArr[hashCount++] = GetHash(pWordStart, pWordEnd - pWordStart);
+
+        if (NULL == pSpace) {
+            break;
+        }
+        pWordStart = pSpace + 1;
+    }
+
+    return hashCount;
+}
+
+
+// returns the maximum token count, so that all the hashes are less than MaxHashArrLength
+inline const int GetMaxTokenCount(const int MaxHashArrLength, const int wordNgrams)
+{
+    if (0 >= MaxHashArrLength) {
+        return 0;
+    }
+    return (MaxHashArrLength - 1) / wordNgrams;
+}
+
+
+// memory cap for stack memory allocation
+const int MAX_ALLOCA_SIZE = 204800;
+
+
+//
+// This function implements the fasttext-like hashing logics. It assumes the input text is already tokenized and 
+//  tokens are merged by a single space.
+//
+// Example: input :  "This is ok ."
+//          output (bigram):  hash(this), hash(is), hash(ok), hash(.), hash(this is), hash(is ok), hash(ok .), hash(. EOS)
+//
+//  This is different from fasttext hashing:
+//     1. no EOS padding by default for unigram.
+//     2. do not take vocab as input, all unigrams are hashed too (we assume later caller repalces unigram hashes
+//          with ids from a vocab file).
+//
+extern "C"
+const int TextToHashes(const char * pInUtf8Str, int InUtf8StrByteCount, int32_t * pHashArr, const int MaxHashArrLength, int wordNgrams, int bucketSize = 2000000)
+{
+    // must have positive ngram
+    if (wordNgrams <= 0 || InUtf8StrByteCount < 0 || 0 == bucketSize)
+    {
+        return -1;
+    }
+    if (0 < InUtf8StrByteCount && NULL == pInUtf8Str)
+    {
+        return -1;
+    }
+
+    // hash the tokens, if the memory allocation is not enough for the output, return requested memory amount
+    const int tokenCount = ComputeUnigramHashes(pInUtf8Str, InUtf8StrByteCount, pHashArr,
+        GetMaxTokenCount(MaxHashArrLength, wordNgrams));
+    if (0 > tokenCount)
+    {
+        return InUtf8StrByteCount * wordNgrams;
+    }
+
+    AddWordNgrams(pHashArr, tokenCount, wordNgrams, bucketSize);
+
+    return tokenCount * wordNgrams;
+}
+
+
+// Returns the hash of the word as it appears in the TextToWords output, where the spaces and 0's
+//  inside of the words are replaced with '_'
+inline const uint32_t GetWordHash(const char * str, size_t strLen)
+{
+    uint32_t h = 2166136261;
+    for (size_t i = 0; i < strLen; i++) {
+        const char C = (' ' == str[i] || 0 == str[i]) ? '_' : str[i];
+        h = h ^ uint32_t(int8_t(C));
+        h = h * 16777619;
+    }
+    return h;
+}
+
+
+//
+// The same as TextToHashes(TextToWordsWithModel(pInUtf8Str)), but the hashes are computed directly
+//  from the word boundaries, without making the space delimited string of words. If hModel is NULL
+//  the default word-breaking model is used. The output is the same as of the two calls, except that
+//  a text without words gives no hashes.
+//
+extern "C"
+const int TextToHashesWithModel(const char * pInUtf8Str, int InUtf8StrByteCount, int32_t * pHashArr, const int MaxHashArrLength,
+    int wordNgrams, int bucketSize, void * hModel)
+{
+    if (wordNgrams <= 0 || InUtf8StrByteCount < 0 || 0 == bucketSize)
+    {
+        return -1;
+    }
+
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+
+    const int * pSpans = NULL;
+    const int tokenCount = FAGetWordSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans);
+
+    int hashCount = tokenCount;
+
+    if (0 < tokenCount && tokenCount > GetMaxTokenCount(MaxHashArrLength, wordNgrams))
+    {
+        // the memory allocation is not enough for the output, return requested memory amount
+        hashCount = InUtf8StrByteCount * wordNgrams;
+    }
+    else if (0 < tokenCount)
+    {
+        for (int i = 0; i < tokenCount; ++i)
+        {
+            const int From = pSpans[i * 2];
+            const int To = pSpans[(i * 2) + 1];
+            pHashArr[i] = GetWordHash(pInUtf8Str + From, To - From + 1);
+        }
+
+        AddWordNgrams(pHashArr, tokenCount, wordNgrams, bucketSize);
+        hashCount = tokenCount * wordNgrams;
+    }
+
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return hashCount;
+}
+
+
+//
+// WordHyphenationWithModel - returns a hyphenated string for an input word.
+// 
+// The hModel parameter allows to use a model loaded with LoadModel API, 
+//  NULL is not allowed since there is no built in model for this function
+//
+extern "C"
+const int WordHyphenationWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, void * hModel, const int uHy = __FADefaultHyphen__)
+{
+    // pModel is always initialized here
+    const FAModelData * pModel = (const FAModelData *) hModel; 
+
+    // validate the parameters
+    if (0 == InUtf8StrByteCount) {
+        return 0;
+    }
+    if (0 > InUtf8StrByteCount || InUtf8StrByteCount > FALimits::MaxArrSize) {
+        return -1;
+    }
+    if (NULL == pInUtf8Str) {
+        return -1;
+    }
+
+    // allocate a buffer for UTF-32 representation of a word, also keep it within limits
+    int pBuff [FALimits::MaxWordSize];
+
+    // convert input to UTF-32
+    const int MaxBuffSize = ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, FALimits::MaxWordSize);
+    if (MaxBuffSize <= 0 || MaxBuffSize > FALimits::MaxWordSize) {
+        return -1;
+    }
+    // make sure the utf32input does not contain 'U+0000' elements
+    std::replace(pBuff, pBuff + MaxBuffSize, 0, 0x20);
+
+    // keep inner hyphenation results here
+    int pHyRes [FALimits::MaxWordSize];
+    // get the sentence breaking results
+    const int Res = pModel->m_HyEngine.Process(pBuff, MaxBuffSize, pHyRes, MaxBuffSize);
+    if (-1 == Res) {
+        return -1;
+    }
+
+    // one character buffer
+    const int MaxSize = FAUtf8Const::MAX_CHAR_SIZE + 1;
+    char Utf8Symbol [MaxSize];
+
+    // convert UTF-32 hyphen to UTF-8 once to use it later
+    char Utf8HySymbol [MaxSize];
+    char * pHyEnd = FAIntToUtf8 (uHy, Utf8HySymbol, MaxSize);
+    if (NULL == pHyEnd) {
+        return -1;
+    }
+    const size_t Utf8HyLen = pHyEnd - Utf8HySymbol;
+
+    // keep track of how many bytes were outputted or needed to get a full output
+    int TotalOutputSizeNeeded = 0;
+
+    for (int i = 0; i < MaxBuffSize; ++i) {
+
+        // output current input symbol
+        const int Symbol = pBuff [i];
+        char * pEnd = FAIntToUtf8 (Symbol, Utf8Symbol, MaxSize);
+        if (NULL == pEnd) {
+            return -1;
+        }
+        const size_t Utf8SymbolLen = pEnd - Utf8Symbol;
+
+        if (NULL != pOutUtf8Str && TotalOutputSizeNeeded + ((int) Utf8SymbolLen) <= MaxOutUtf8StrByteCount) {
+            memcpy(pOutUtf8Str + TotalOutputSizeNeeded, Utf8Symbol, Utf8SymbolLen);
+        }
+        TotalOutputSizeNeeded += (int) Utf8SymbolLen;
+
+        // get corresponding hyphenation id
+        const int HyphId = pHyRes [i];
+
+        // output a hyphen, if it is any kind of hyphenation
+        if (FAFsmConst::HYPH_NO_HYPH < HyphId) {
+            if (NULL != pOutUtf8Str && TotalOutputSizeNeeded + ((int) Utf8HyLen) <= MaxOutUtf8StrByteCount) {
+                memcpy(pOutUtf8Str + TotalOutputSizeNeeded, Utf8HySymbol, Utf8HyLen);
+            }
+            TotalOutputSizeNeeded += (int) Utf8HyLen;
+        }
+
+    } // for (int i = 0; ...
+
+    // we will include the 0 just in case some scriping languages expect 0-terminated buffers and cannot use the size
+    if (NULL != pOutUtf8Str && TotalOutputSizeNeeded < MaxOutUtf8StrByteCount) {
+        pOutUtf8Str[TotalOutputSizeNeeded] = 0;
+        TotalOutputSizeNeeded++;
+    }
+
+    return TotalOutputSizeNeeded;
+}
+
+
+//
+// Helper, selects the segmentation algorithm based on pModelData->m_DictConf.GetTokAlgo()
+//
+void InitSegEngine(FAModelData * pModelData)
+{
+    const int TokAlgo = pModelData->m_DictConf.GetTokAlgo();
+
+    if (FAFsmConst::TOKENIZE_BPE == TokAlgo ||
+        FAFsmConst::TOKENIZE_BPE_OPT == TokAlgo) {
+
+        pModelData->m_SegEngineBpe.SetConf(&pModelData->m_DictConf);
+        pModelData->m_pAlgo = &(pModelData->m_SegEngineBpe);
+
+    } else if (FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES == TokAlgo) {
+
+        pModelData->m_SegEngineBpeWithMerges.SetConf(&pModelData->m_DictConf);
+        pModelData->m_pAlgo = &(pModelData->m_SegEngineBpeWithMerges);
+
+    } else if (FAFsmConst::TOKENIZE_BPE_OPT_LOCAL == TokAlgo ||
+               FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL == TokAlgo) {
+
+        pModelData->m_SegEngineBpeLocal.SetConf(&pModelData->m_DictConf);
+        pModelData->m_pAlgo = &(pModelData->m_SegEngineBpeLocal);
+
+    } else {
+
+        pModelData->m_SegEngine.SetConf(&pModelData->m_DictConf);
+        pModelData->m_pAlgo = &(pModelData->m_SegEngine);
+    }
+}
+
+
+void* InitModelData(FAModelData * pNewModelData);
+
+//
+// Helper, sets up pNewModelData object with model data from memory
+// Returns 0 in case of an error otherwise initialized pNewModelData object is returned
+//
+extern "C"
+void* SetModelData(FAModelData * pNewModelData, const unsigned char * pImgBytes)
+{
+    if (NULL == pNewModelData) {
+        return NULL;
+    }
+    if (NULL == pImgBytes) {
+        return NULL;
+    }
+
+    // create a generic LDB object from bytes
+    pNewModelData->m_Ldb.SetImage (pImgBytes);
+
+    return InitModelData(pNewModelData);
+}
+
+
+//
+// Helper, sets up pNewModelData object with the data of its pNewModelData->m_Ldb
+// Returns 0 in case of an error otherwise initialized pNewModelData object is returned
+//
+void* InitModelData(FAModelData * pNewModelData)
+{
+    // get the configuration paramenters for [wbd]
+    const int * pValues = NULL;
+    int iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_WBD, &pValues);
+
+    // see if the [wbd] section is present
+    if (-1 != iSize) {
+
+        pNewModelData->m_hasWbd = true;
+        // initialize WBD configuration
+        pNewModelData->m_Conf.Initialize (&(pNewModelData->m_Ldb), pValues, iSize);
+        // now initialize the engine
+        pNewModelData->m_Engine.SetConf(&(pNewModelData->m_Conf));
+    }
+
+    // get the configuration paramenters for [pos-dict]
+    pValues = NULL;
+    iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_POS_DICT, &pValues);
+
+    // see if the [pos-dict] section is present
+    if (-1 != iSize) {
+
+        pNewModelData->m_hasSeg = true;
+
+        // initialize dict configuration
+        pNewModelData->m_DictConf.SetLDB (&(pNewModelData->m_Ldb));
+        pNewModelData->m_DictConf.Init (pValues, iSize);
+
+        // initialize algorithm based on pNewModelData->m_DictConf.GetTokAlgo()
+        InitSegEngine(pNewModelData);
+
+        // see if we need to treat UTF-8 bytes as input
+        pNewModelData->m_useRawBytes = pNewModelData->m_DictConf.GetUseByteEncoding();
+
+        // make a flat copy of the normalization map for all the Unicode characters
+        const FAMultiMapCA * pCharMap = pNewModelData->m_DictConf.GetCharMap();
+        if (NULL != pCharMap) {
+            pNewModelData->m_CharMap.Build(pCharMap, MAX_UNICODE_CHAR);
+            pNewModelData->m_hasCharMap = true;
+        }
+    }
+
+    // get the configuration paramenters for hyphenation [w2h]
+    pValues = NULL;
+    iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_W2H, &pValues);
+
+    // see if the [pos-dict] section is present
+    if (-1 != iSize) {
+
+        pNewModelData->m_hasHy = true;
+
+        // initialize hyph configuration
+        pNewModelData->m_HyConf.SetLDB (&(pNewModelData->m_Ldb));
+        pNewModelData->m_HyConf.Init (pValues, iSize);
+
+        // initialize the algo with data
+        pNewModelData->m_HyEngine.SetConf (&pNewModelData->m_HyConf);
+    }
+
+
+    // get the configuration paramenters for hyphenation [i2w]
+    pNewModelData->m_min_token_id = 0;
+    pNewModelData->m_max_token_id = FALimits::MaxArrSize;
+    pNewModelData->m_hasI2w = false;
+
+    pValues = NULL;
+    iSize = pNewModelData->m_Ldb.GetHeader ()->Get (FAFsmConst::FUNC_I2W, &pValues);
+
+    // see if the [pos-dict] section is present
+    if (-1 != iSize) {
+
+        for (int i = 0; i < iSize; ++i) {
+
+            if (pValues [i] == FAFsmConst::PARAM_STRING_ARRAY && i + 1 < iSize) {
+
+                const int DumpNum = pValues [++i];
+                const unsigned char * pDump = pNewModelData->m_Ldb.GetDump (DumpNum);
+
+                if (NULL == pDump) {
+                    return NULL;
+                }
+
+                pNewModelData->m_i2w.SetImage(pDump);
+                pNewModelData->m_hasI2w = true;
+
+            } else if (pValues [i] == FAFsmConst::PARAM_TOKENID_MIN && i + 1 < iSize) {
+
+                pNewModelData->m_min_token_id = pValues [++i];
+
+            } else if (pValues [i] == FAFsmConst::PARAM_TOKENID_MAX && i + 1 < iSize) {
+
+                pNewModelData->m_max_token_id = pValues [++i];
+            }
+        }
+
+        if (1 < iSize && pValues [0] == FAFsmConst::PARAM_STRING_ARRAY) {
+
+            const int DumpNum = pValues [1];
+            const unsigned char * pDump = pNewModelData->m_Ldb.GetDump (DumpNum);
+
+            if (NULL == pDump) {
+                return NULL;
+            }
+
+            pNewModelData->m_i2w.SetImage(pDump);
+            pNewModelData->m_hasI2w = true;
+        }
+    }
+
+    return (void*) pNewModelData;
+}
+
+
+//
+// Same as LoadModel except a model is created from a memory pointer
+// Returns 0 in case of an error
+//
+extern "C"
+void* SetModel(const unsigned char * pImgBytes, int ModelByteCount)
+{
+    FAModelData * pNewModelData = new FAModelData();
+    if (NULL == pNewModelData) {
+        return 0;
+    }
+
+    // load the bin file
+    if (NULL == pImgBytes || 0 == ModelByteCount) {
+        return 0;
+    }
+
+    // return the initialized model handle
+    return SetModelData(pNewModelData, pImgBytes);
+}
+
+
+//
+// Loads a model and return a handle.
+// Returns 0 in case of an error.
+//
+extern "C"
+void* LoadModel(const char * pszLdbFileName)
+{
+    FAModelData * pNewModelData = new FAModelData();
+    if (NULL == pNewModelData) {
+        return 0;
+    }
+
+    // load the bin file
+    pNewModelData->m_Img.Load (pszLdbFileName);
+    const unsigned char * pImgBytes = pNewModelData->m_Img.GetImageDump ();
+    if (NULL == pImgBytes) {
+        return 0;
+    }
+
+    // return the initialized model handle
+    return SetModelData(pNewModelData, pImgBytes);
+}
+
+
+//
+// Same as LoadModel, but the model file is memory mapped read-only instead of being
+// read into the heap, so the processes loading the same file share one physical copy
+// of the model and the start is fast if the file is in the OS cache. If fPrefetch is 
+// true then the OS is asked to read the whole file ahead.
+// Returns 0 in case of an error.
+//
+extern "C"
+void* LoadModelMapped(const char * pszLdbFileName, bool fPrefetch)
+{
+    FAModelData * pNewModelData = new FAModelData();
+    if (NULL == pNewModelData) {
+        return 0;
+    }
+
+    // map the bin file
+    pNewModelData->m_Img.Load (pszLdbFileName, true, fPrefetch);
+    const unsigned char * pImgBytes = pNewModelData->m_Img.GetImageDump ();
+    if (NULL == pImgBytes) {
+        return 0;
+    }
+
+    // return the initialized model handle
+    return SetModelData(pNewModelData, pImgBytes);
+}
+
+
+//
+// Same as LoadModel, but the dumps of the model file (charmaps, automata, i2w tables, etc.)
+// identical to the dumps of the models already loaded this way are shared, so the memory
+// grows with the unique content rather than with the number of models. The dumps are
+// released when the last model using them is freed.
+// Returns 0 in case of an error.
+//
+extern "C"
+void* LoadModelShared(const char * pszLdbFileName)
+{
+    if (NULL == pszLdbFileName) {
+        return 0;
+    }
+
+    FAModelData * pNewModelData = NULL;
+
+    // the errors are reported by exceptions, e.g. a missing or a corrupted file,
+    // they are not passed to the caller, so a failed SwapModelSlot keeps the old model
+    try {
+
+        // the file is only needed until its dumps are in the pool
+        FAImageDump Img;
+        Img.Load (pszLdbFileName);
+        const unsigned char * pImgBytes = Img.GetImageDump ();
+        if (NULL == pImgBytes) {
+            return 0;
+        }
+
+        // split the image into dumps, the image is validated here
+        FALDB Ldb;
+        Ldb.SetImage (pImgBytes, Img.GetImageSize ());
+
+        const int Count = Ldb.GetDumpCount ();
+        if (0 >= Count) {
+            return 0;
+        }
+
+        pNewModelData = new FAModelData();
+
+        std::vector< size_t > Sizes (Count);
+        std::vector< const unsigned char * > & Dumps = pNewModelData->m_SharedDumps.m_Dumps;
+        Dumps.reserve (Count);
+
+        for (int i = 0; i < Count; ++i) {
+            Sizes [i] = Ldb.GetDumpSize (i);
+            Dumps.push_back (FAGetDumpPool ().Add (Ldb.GetDump (i), Sizes [i]));
+        }
+
+        pNewModelData->m_Ldb.SetDumps (Dumps.data (), Sizes.data (), Count);
+
+        if (NULL == InitModelData(pNewModelData)) {
+            delete pNewModelData;
+            return 0;
+        }
+
+    } catch (...) {
+
+        delete pNewModelData;
+        return 0;
+    }
+
+    return pNewModelData;
+}
+
+
+//
+// Returns the number of the unique dumps of the models loaded with LoadModelShared and
+// their total size in bytes.
+//
+extern "C"
+int GetSharedDumpStats(int64_t * pDumpCount, int64_t * pByteCount)
+{
+    size_t DumpCount = 0;
+    size_t ByteCount = 0;
+
+    FAGetDumpPool ().GetStats (&DumpCount, &ByteCount);
+
+    if (NULL != pDumpCount) {
+        *pDumpCount = (int64_t) DumpCount;
+    }
+    if (NULL != pByteCount) {
+        *pByteCount = (int64_t) ByteCount;
+    }
+
+    return 1;
+}
+
+
+//
+// Copies upto MaxCount hot path counters of the model into pStats, the counters go in the order of
+//  the names returned by GetModelStatsNames. The counters are cumulative since the model was loaded
+//  or since ResetModelStats, the *_cycles counters are in the time stamp counter ticks (nanoseconds
+//  on the platforms without it) and include the time of all the threads using the model.
+//
+// Returns the number of counters, 0 if the library is built without BLING_FIRE_STATS, or -1 in
+//  case of an error.
+//
+extern "C"
+int GetModelStats(void* ModelPtr, int64_t * pStats, const int MaxCount)
+{
+    if (NULL == ModelPtr || NULL == pStats || 0 > MaxCount) {
+        return -1;
+    }
+
+#ifdef BLING_FIRE_STATS
+    const FAModelData * pModelData = (const FAModelData *) ModelPtr;
+
+    for (int i = 0; i < FA_STAT_COUNT && i < MaxCount; ++i) {
+        pStats [i] = pModelData->m_Stats.m_Counters [i].load (std::memory_order_relaxed);
+    }
+    return FA_STAT_COUNT;
+#else
+    return 0;
+#endif
+}
+
+
+//
+// Sets all the counters of the model to 0, returns 1 in case of success or if the library is built
+//  without BLING_FIRE_STATS and -1 in case of an error.
+//
+extern "C"
+int ResetModelStats(void* ModelPtr)
+{
+    if (NULL == ModelPtr) {
+        return -1;
+    }
+
+#ifdef BLING_FIRE_STATS
+    ((const FAModelData *) ModelPtr)->m_Stats.Reset ();
+#endif
+    return 1;
+}
+
+
+//
+// Returns the space delimited names of the counters of GetModelStats, the same as other text
+//  functions returns the size of the output and the output is copied if it fits.
+//
+extern "C"
+const int GetModelStatsNames(char * pOutUtf8Str, const int MaxOutUtf8StrByteCount)
+{
+    std::string Names;
+
+    for (int i = 0; i < FA_STAT_COUNT; ++i) {
+        if (0 < i) {
+            Names.push_back(' ');
+        }
+        Names.append(g_StatNames [i]);
+    }
+
+    const int OutSize = (int) Names.size() + 1;
+
+    if (NULL != pOutUtf8Str && OutSize <= MaxOutUtf8StrByteCount) {
+        memcpy(pOutUtf8Str, Names.c_str(), OutSize);
+    }
+    return OutSize;
+}
+
+
+// keeps the current model of a slot, the model can be replaced while it is used
+struct FAModelSlot
+{
+    std::mutex m_Lock;
+    FAModelData * m_pModel;
+
+    FAModelSlot ():
+        m_pModel (NULL)
+    {}
+};
+
+
+//
+// Creates a model slot with the model loaded by LoadModelShared. The slot allows to replace
+// the model (see SwapModelSlot) while other threads are using it: a thread gets the current
+// model with AcquireModel, uses the returned handle with any of the ...WithModel / TextToIds
+// functions and then releases it with FreeModel. The settings of the model (SetTokAlgo,
+// SetWordCache, etc.) should be made through AcquireModel before the slot is shared, the
+// setters must not be called on a model which other threads use, SwapModelSlot keeps them.
+// Returns 0 in case of an error.
+//
+extern "C"
+void* CreateModelSlot(const char * pszLdbFileName)
+{
+    FAModelData * pModel = (FAModelData*) LoadModelShared(pszLdbFileName);
+    if (NULL == pModel) {
+        return 0;
+    }
+
+    FAModelSlot * pSlot = new FAModelSlot();
+    pSlot->m_pModel = pModel;
+
+    return pSlot;
+}
+
+
+//
+// Applies the runtime settings of pFrom (see SetNoDummyPrefix, SetTokAlgo, SetDenseDfa and
+// SetWordCache) to pTo, the settings the new model does not support are skipped the same way
+// the setters skip them.
+//
+void FACopyModelSettings(const FAModelData * pFrom, FAModelData * pTo)
+{
+    if (-1 != pFrom->m_NoDummyPrefix) {
+        SetNoDummyPrefix(pTo, 0 != pFrom->m_NoDummyPrefix);
+    }
+    if (0 != pFrom->m_TokAlgo) {
+        SetTokAlgo(pTo, pFrom->m_TokAlgo);
+    }
+    if (0 < pFrom->m_DenseDfaBytes) {
+        SetDenseDfa(pTo, pFrom->m_DenseDfaBytes);
+    }
+    // after SetTokAlgo, since it resets the cache
+    if (0 < pFrom->m_WordCacheBytes) {
+        SetWordCache(pTo, pFrom->m_WordCacheBytes);
+    }
+}
+
+
+//
+// Loads the model from pszLdbFileName and atomically replaces the current model of the slot.
+// The calls which already acquired the old model continue to use it, the old model is freed
+// when the last of them releases it. If the new model cannot be loaded the slot is unchanged.
+// The runtime settings applied to the old model (SetNoDummyPrefix, SetTokAlgo, SetDenseDfa and
+// SetWordCache) are applied to the new model before it is published, a setting which the new
+// model does not support (e.g. a different algorithm) is skipped. The settings should be made
+// right after CreateModelSlot, before other threads use the slot, since the setters must not
+// be called on a model which other threads obtained with AcquireModel.
+// Returns 1 in case of success, 0 otherwise.
+//
+extern "C"
+int SwapModelSlot(void* SlotPtr, const char * pszLdbFileName)
+{
+    if (NULL == SlotPtr) {
+        return 0;
+    }
+
+    // load the new model outside of the lock, so the readers are not blocked
+    FAModelData * pNewModel = (FAModelData*) LoadModelShared(pszLdbFileName);
+    if (NULL == pNewModel) {
+        return 0;
+    }
+
+    FAModelSlot * pSlot = (FAModelSlot*) SlotPtr;
+
+    // configure the new model while no other thread sees it
+    FAModelData * pCurrModel = (FAModelData*) AcquireModel(pSlot);
+    if (NULL != pCurrModel) {
+        FACopyModelSettings(pCurrModel, pNewModel);
+        FreeModel(pCurrModel);
+    }
+
+    FAModelData * pOldModel = NULL;
+    {
+        std::lock_guard<std::mutex> guard(pSlot->m_Lock);
+        pOldModel = pSlot->m_pModel;
+        pSlot->m_pModel = pNewModel;
+    }
+
+    // release the slot's reference to the old model
+    FreeModel(pOldModel);
+
+    return 1;
+}
+
+
+//
+// Returns the current model of the slot, the model stays valid until it is released with
+// FreeModel, even if the slot gets a new model meanwhile. Returns 0 in case of an error.
+//
+extern "C"
+void* AcquireModel(void* SlotPtr)
+{
+    if (NULL == SlotPtr) {
+        return 0;
+    }
+
+    FAModelSlot * pSlot = (FAModelSlot*) SlotPtr;
+
+    std::lock_guard<std::mutex> guard(pSlot->m_Lock);
+    FAModelData * pModel = pSlot->m_pModel;
+    if (NULL != pModel) {
+        pModel->m_RefCount++;
+    }
+
+    return pModel;
+}
+
+
+//
+// Frees the slot and releases its reference to the current model, the models acquired from
+// the slot are still valid until they are released.
+//
+extern "C"
+int FreeModelSlot(void* SlotPtr)
+{
+    if (NULL == SlotPtr) {
+        return 0;
+    }
+
+    FAModelSlot * pSlot = (FAModelSlot*) SlotPtr;
+    FreeModel(pSlot->m_pModel);
+    delete pSlot;
+
+    return 1;
+}
+
+
+//
+// Implements a word-piece algorithm. Returns ids of words or sub-words, returns upto MaxIdsArrLength ids,
+// the rest of the array is unchanged, so the array can be set to initial length and fill with 0's for padding.
+// If pStartOffsets and pEndOffsets are not NULL then fills in the start and end offset for each token.
+// Return value is the number of ids copied into the array.
+//
+// Example:
+//  input: Эpple pie.
+//  fa_lex output: эpple/WORD э/WORD_ID_1208 pp/WORD_ID_9397 le/WORD_ID_2571 pie/WORD pie/WORD_ID_11345 ./WORD ./WORD_ID_1012
+//  TextToIds output: [1208, 9397, 2571, 11345, 1012, ... <unchanged>]
+//
+const int TextToIdsWithOffsets_wp_int(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets, 
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId,
+        FATokWorkspace * pWs
+)
+{
+    // validate the parameters
+    if (0 >= InUtf8StrByteCount || InUtf8StrByteCount > FALimits::MaxArrSize || NULL == pInUtf8Str || 0 == ModelPtr) {
+        return 0;
+    }
+
+    // get the model data
+    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+
+    FAStatsAdd(pModelData, FA_STAT_CALLS, 1);
+    FAStatsAdd(pModelData, FA_STAT_BYTES, InUtf8StrByteCount);
+    FAStatsStart(Timer);
+
+    // get a buffer for UTF-8 --> UTF-32 conversion
+    int * pBuff = FAGetBuffer(pWs->m_Utf32, InUtf8StrByteCount);
+    if (NULL == pBuff) {
+        return 0;
+    }
+
+    // a container for the offsets
+    int * pOffsets = NULL;
+
+    // flag to alter the logic in case we don't need the offsets
+    const bool fNeedOffsets = NULL != pStartOffsets && NULL != pEndOffsets;
 
     if (fNeedOffsets) {
-        utf32offsets.resize(InUtf8StrByteCount);
-        pOffsets = utf32offsets.data();
+        pOffsets = FAGetBuffer(pWs->m_Offsets, InUtf8StrByteCount);
         if (NULL == pOffsets) {
             return 0;
         }
     }
 
-    // convert input to UTF-32, track offsets if needed
-    int BuffSize = fNeedOffsets ? 
-        ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, pOffsets, InUtf8StrByteCount) :
-        ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, InUtf8StrByteCount);
-    if (BuffSize <= 0 || BuffSize > InUtf8StrByteCount) {
+    // convert input to UTF-32, track offsets if needed
+    int BuffSize = fNeedOffsets ? 
+        ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, pOffsets, InUtf8StrByteCount) :
+        ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff, InUtf8StrByteCount);
+    if (BuffSize <= 0 || BuffSize > InUtf8StrByteCount) {
+        return 0;
+    }
+    FAStatsLap(pModelData, FA_STAT_DECODE_CYCLES, Timer);
+
+    // needed for normalization
+    int * pNormBuff = NULL;
+    int * pNormOffsets = NULL;
+
+    const FAWbdConfKeeper * pConf = &(pModelData->m_Conf);
+    const FAMultiMapCA * pCharMap = pConf->GetCharMap ();
+
+    // do the normalization for the entire input
+    if (pCharMap) {
+
+        pNormBuff = FAGetBuffer(pWs->m_Norm, InUtf8StrByteCount);
+        if (NULL == pNormBuff) {
+            return 0;
+        }
+        if (fNeedOffsets) {
+            pNormOffsets = FAGetBuffer(pWs->m_NormOffsets, InUtf8StrByteCount);
+            if (NULL == pNormOffsets) {
+                return 0;
+            }
+        }
+
+        BuffSize = fNeedOffsets ? 
+            ::FANormalize(pBuff, BuffSize, pNormBuff, pNormOffsets, InUtf8StrByteCount, pCharMap) :
+            ::FANormalize(pBuff, BuffSize, pNormBuff, InUtf8StrByteCount, pCharMap);
+        if (BuffSize <= 0 || BuffSize > InUtf8StrByteCount) {
+            return 0;
+        }
+
+        // use normalized buffer as input
+        pBuff = pNormBuff;
+        FAStatsLap(pModelData, FA_STAT_NORMALIZE_CYCLES, Timer);
+    }
+
+    // keep sentence boundary information here
+    const int WbdResMaxSize = BuffSize * 6;
+    int * pWbdRes = FAGetBuffer(pWs->m_Res, WbdResMaxSize);
+    if (NULL == pWbdRes) {
+        return 0;
+    }
+
+    // compute token and sub-token boundaries
+    const int WbdOutSize = pModelData->m_Engine.Process(pBuff, BuffSize, pWbdRes, WbdResMaxSize);
+    if (WbdOutSize > WbdResMaxSize || 0 != WbdOutSize % 3) {
+        return 0;
+    }
+    FAStatsLap(pModelData, FA_STAT_LEX_CYCLES, Timer);
+
+    int OutCount = 0;
+
+    // iterate over the results
+    for(int i = 0; i < WbdOutSize; i += 3) {
+
+        // ignore tokens with IGNORE tag
+        const int Tag = pWbdRes[i];
+        if (WBD_IGNORE_TAG == Tag) {
+            continue;
+        }
+
+        // For each token with WORD tag copy all subword tags into the output if
+        //  this word is covered completely by the subwords without gaps,
+        //  otherwise copy the UnkId tag (this is how it's done in the original BERT TokenizerFull).
+        if (WBD_WORD_TAG == Tag) {
+
+            const int TokenFrom = pWbdRes[i + 1];
+            const int TokenTo = pWbdRes[i + 2];
+
+            // see if we have subtokens for this token and they cover the token completely
+            int j = i + 3;
+            int numSubTokens = 0;
+            bool subTokensCoveredAll = false;
+
+            if (j < WbdOutSize) {
+
+                int ExpectedFrom = TokenFrom;
+                int SubTokenTag = pWbdRes[j];
+                int SubTokenFrom = pWbdRes[j + 1];
+                int SubTokenTo = pWbdRes[j + 2];
+
+                // '<=' because last subtoken should be included
+                while (j <= WbdOutSize && SubTokenTag > WBD_IGNORE_TAG && ExpectedFrom == SubTokenFrom) {
+
+                    ExpectedFrom = SubTokenTo + 1;
+                    numSubTokens++;
+                    j += 3;
+                    if (j < WbdOutSize) {
+                        SubTokenTag = pWbdRes[j];
+                        SubTokenFrom = pWbdRes[j + 1];
+                        SubTokenTo = pWbdRes[j + 2];
+                    } // else it will break at the while check
+                }
+
+                // if subtoken To is the same as token To then we split the token all the way
+                if (0 < numSubTokens && ExpectedFrom - 1 == TokenTo) {
+                    // output all subtokens tags
+                    for(int k = 0; k < numSubTokens && OutCount < MaxIdsArrLength; ++k) {
+
+                        const int TagIdx = ((k + 1) * 3) + i;
+                        const int SubTokenTag = pWbdRes[TagIdx];
+
+                        if (OutCount < MaxIdsArrLength) {
+
+                            pIdsArr[OutCount] = SubTokenTag;
+
+                            if (fNeedOffsets) {
+
+                                const int SubTokenFrom = pWbdRes[TagIdx + 1];
+                                const int FromOffset = pOffsets[(pCharMap) ? pNormOffsets [SubTokenFrom] : SubTokenFrom];
+                                pStartOffsets[OutCount] = FromOffset;
+
+                                const int SubTokenTo = pWbdRes[TagIdx + 2];
+                                const int ToOffset = pOffsets[(pCharMap) ? pNormOffsets [SubTokenTo] : SubTokenTo];
+                                const int ToCharSize = ::FAUtf8Size(pInUtf8Str + ToOffset);
+                                pEndOffsets[OutCount] = ToOffset + (0 < ToCharSize ? ToCharSize - 1 : 0);
+                            }
+
+                            OutCount++;
+                        }
+                    }
+                    subTokensCoveredAll = true;
+                }
+            }
+
+            if (false == subTokensCoveredAll) {
+                // output an unk tag
+                if (OutCount < MaxIdsArrLength) {
+
+                    pIdsArr[OutCount] = UnkId;
+                    FAStatsAdd(pModelData, FA_STAT_UNKNOWN_TOKENS, 1);
+
+                    // for unknown tokens take offsets from the word
+                    if (fNeedOffsets) {
+
+                        const int FromOffset = pOffsets[(pCharMap) ? pNormOffsets [TokenFrom] : TokenFrom];
+                        pStartOffsets[OutCount] = FromOffset;
+
+                        const int ToOffset = pOffsets[(pCharMap) ? pNormOffsets [TokenTo] : TokenTo];
+                        const int ToCharSize = ::FAUtf8Size(pInUtf8Str + ToOffset);
+                        pEndOffsets[OutCount] = ToOffset + (0 < ToCharSize ? ToCharSize - 1 : 0);
+                    }
+
+                    OutCount++;
+                }
+            }
+
+            // skip i forward if we looped over any subtokens
+            i = (j - 3);
+
+        } // of if (WBD_WORD_TAG == Tag) ...
+
+        if (OutCount >= MaxIdsArrLength) {
+            // the ids did not fit, if more results follow
+            if (i + 3 < WbdOutSize) {
+                FAStatsAdd(pModelData, FA_STAT_SMALL_BUFFER, 1);
+            }
+            break;
+        }
+    }
+
+    FAStatsLap(pModelData, FA_STAT_OUTPUT_CYCLES, Timer);
+    FAStatsAdd(pModelData, FA_STAT_TOKENS, OutCount);
+
+    return OutCount;
+}
+
+
+//
+// Same as TextToIdsWithOffsets_wp_int but uses a thread-local workspace
+//
+extern "C"
+const int TextToIdsWithOffsets_wp(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets, 
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId = 0
+)
+{
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+    const int Res = TextToIdsWithOffsets_wp_int(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr,
+        pStartOffsets, pEndOffsets, MaxIdsArrLength, UnkId, pWs);
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Res;
+}
+
+
+//
+// The same as TextToIdsWithOffsets_wp, except does not return offsets
+//
+extern "C"
+const int TextToIds_wp(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        const int MaxIdsArrLength,
+        const int UnkId = 0
+)
+{
+    return TextToIdsWithOffsets_wp(ModelPtr,pInUtf8Str,InUtf8StrByteCount,pIdsArr,NULL,NULL,MaxIdsArrLength,UnkId);
+}
+
+
+//
+// Tokenizes the words in pBuff [From, To) with one call of the selected algorithm and adds the
+// results of each word to the word cache. The positions in pOut are relative to the pBuff.
+// Returns the number of ints in pOut or -1 in case of an error.
+//
+const int FASegmentNewWords(
+        const FAModelData * pModelData,
+        const int * pBuff,
+        const int From,
+        const int To,
+        int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        FATokWorkspace * pWs
+)
+{
+    const int OutSize = pModelData->m_pAlgo->Process (pBuff + From, To - From, pOut, MaxOutSize, UnkId, &(pWs->m_pSegScratch));
+    if (0 > OutSize || OutSize > MaxOutSize || 0 != OutSize % 3) {
+        return -1;
+    }
+
+    // results of one word with the positions relative to the word
+    int WordRes [3 * FAWordCache::MaxWordLength];
+
+    int i = 0;
+    int WordFrom = From;
+
+    while (WordFrom < To) {
+
+        int WordTo = WordFrom + 1;
+        while (WordTo < To && __FASpDelimiter__ != pBuff[WordTo]) {
+            WordTo++;
+        }
+
+        int WordResSize = 0;
+
+        for (; i < OutSize && pOut [i + 1] + From < WordTo; i += 3) {
+
+            pOut [i + 1] += From;
+            pOut [i + 2] += From;
+
+            if (WordResSize < 3 * FAWordCache::MaxWordLength) {
+                WordRes [WordResSize] = pOut [i];
+                WordRes [WordResSize + 1] = pOut [i + 1] - WordFrom;
+                WordRes [WordResSize + 2] = pOut [i + 2] - WordFrom;
+            }
+            WordResSize += 3;
+        }
+
+        if (WordResSize <= 3 * FAWordCache::MaxWordLength) {
+            pModelData->m_WordCache.Put (pBuff + WordFrom, WordTo - WordFrom, UnkId, WordRes, WordResSize);
+        }
+
+        WordFrom = WordTo;
+    }
+
+    return OutSize;
+}
+
+
+//
+// Tokenizes the input word by word, where each word starts with U+2581, and takes the results of
+// the words seen before from the model's word cache, the consecutive words which are not in the
+// cache are tokenized together. The results are the same as of the m_pAlgo->Process for the entire
+// input, since no token of the model spans over the U+2581 in the middle (see FACanSegmentWords).
+// Returns the number of ints in pOut or -1 in case of an error.
+//
+const int FASegmentWords(
+        const FAModelData * pModelData,
+        const int * pBuff,
+        const int BuffSize,
+        int * pOut,
+        const int MaxOutSize,
+        const int UnkId,
+        FATokWorkspace * pWs
+)
+{
+    FAWordCache * pCache = &(pModelData->m_WordCache);
+
+    int OutSize = 0;
+    int HitCount = 0;
+    int MissCount = 0;
+
+    // the beginning of the words which are not found in the cache yet
+    int NewFrom = 0;
+
+    int From = 0;
+    while (From < BuffSize) {
+
+        // find the end of the word
+        int To = From + 1;
+        while (To < BuffSize && __FASpDelimiter__ != pBuff[To]) {
+            To++;
+        }
+
+        // the cache results are written past the results of the new words
+        const int NewOutSize = 3 * (From - NewFrom);
+        int * pWordOut = pOut + OutSize + NewOutSize;
+        const int MaxWordOutSize = MaxOutSize - OutSize - NewOutSize;
+
+        const int WordOutSize = pCache->Get (pBuff + From, To - From, UnkId, pWordOut, MaxWordOutSize);
+
+        if (0 > WordOutSize) {
+            MissCount++;
+            From = To;
+            continue;
+        }
+
+        HitCount++;
+
+        if (NewFrom < From) {
+            // tokenize the new words, then move the results of this word next to theirs
+            int WordRes [3 * FAWordCache::MaxWordLength];
+            memcpy (WordRes, pWordOut, WordOutSize * sizeof (int));
+
+            const int Size = FASegmentNewWords (pModelData, pBuff, NewFrom, From, pOut + OutSize, MaxOutSize - OutSize, UnkId, pWs);
+            if (0 > Size || OutSize + Size + WordOutSize > MaxOutSize) {
+                return -1;
+            }
+            OutSize += Size;
+
+            memcpy (pOut + OutSize, WordRes, WordOutSize * sizeof (int));
+        }
+
+        // make the positions relative to the entire input
+        int * pRes = pOut + OutSize;
+        for (int i = 0; i < WordOutSize; i += 3) {
+            pRes [i + 1] += From;
+            pRes [i + 2] += From;
+        }
+
+        OutSize += WordOutSize;
+        From = To;
+        NewFrom = To;
+    }
+
+    if (NewFrom < BuffSize) {
+        const int Size = FASegmentNewWords (pModelData, pBuff, NewFrom, BuffSize, pOut + OutSize, MaxOutSize - OutSize, UnkId, pWs);
+        if (0 > Size) {
+            return -1;
+        }
+        OutSize += Size;
+    }
+
+    pCache->AddCounts (HitCount, MissCount);
+
+    return OutSize;
+}
+
+
+//
+// Appends the normalized character C to the output of FAPrepareInput_sp, replaces spaces with one U+2581
+//
+inline void FAAddChar_sp(const int C, const int Offset, int * pOut, int * pOffsets, int & OutSize)
+{
+    if (!__FAIsWhiteSpace__(C)) {
+        pOut[OutSize] = C;
+    } else if (0 == OutSize || __FASpDelimiter__ != pOut[OutSize - 1]) {
+        pOut[OutSize] = __FASpDelimiter__;
+    } else {
+        return;
+    }
+    if (NULL != pOffsets) {
+        pOffsets[OutSize] = Offset;
+    }
+    OutSize++;
+}
+
+
+//
+// Appends the character C to the output of FAPrepareInput_sp, normalizes it first if the model has a
+// character map, returns false if the output would take more than MaxNormSize characters
+//
+inline bool FAAddNormChar_sp(const FAModelData * pModelData, const int C, const int Offset,
+    int * pOut, int * pOffsets, int & OutSize, int & NormSize, const int MaxNormSize)
+{
+    const int MaxNormCount = 10;
+
+    const int * pNorm = NULL;
+    const int NormCount = pModelData->m_hasCharMap ? pModelData->m_CharMap.Get (C, &pNorm) : -1;
+
+    if (-1 == NormCount) {
+        if (++NormSize > MaxNormSize) {
+            return false;
+        }
+        FAAddChar_sp(C, Offset, pOut, pOffsets, OutSize);
+
+    } else if (0 < NormCount && NormCount <= MaxNormCount) {
+        NormSize += NormCount;
+        if (NormSize > MaxNormSize) {
+            return false;
+        }
+        for (int i = 0; i < NormCount; ++i) {
+            FAAddChar_sp(pNorm[i], Offset, pOut, pOffsets, OutSize);
+        }
+    }
+
+    return true;
+}
+
+
+//
+// Makes the input of the segmentation algorithm in one pass: decodes UTF-8 (or takes the bytes),
+// normalizes the characters with the model's character map, if any, and replaces every run of spaces
+// with one U+2581. The results are the same as of FAStrUtf8ToArray, FANormalize and the space
+// replacement done one after another. If pOffsets is not NULL then it gets the UTF-8 offset of each
+// output character, -1 for the added first space. pOut and pOffsets should have MaxOutSize elements,
+// the output takes at most (InUtf8StrByteCount + 1) * 2 characters.
+// Returns the output size or 0 in case of an error.
+//
+const int FAPrepareInput_sp(
+        const FAModelData * pModelData,
+        const char * pInUtf8Str,
+        const int InUtf8StrByteCount,
+        int * pOut,
+        int * pOffsets,
+        const int MaxOutSize
+)
+{
+    const int MaxNormSize = (InUtf8StrByteCount + 1) * 2;
+    if (MaxOutSize < MaxNormSize) {
+        return 0;
+    }
+
+    int OutSize = 0;
+    // the number of characters after the normalization, before the spaces are replaced
+    int NormSize = 0;
+
+    // always add a space in the beginning, SP uses U+2581 as a space mark
+    if (!pModelData->m_DictConf.GetNoDummyPrefix()) {
+        FAAddNormChar_sp(pModelData, __FASpDelimiter__, -1, pOut, pOffsets, OutSize, NormSize, MaxNormSize);
+    }
+
+    const char * pStr = pInUtf8Str;
+    const char * pEnd = pInUtf8Str + InUtf8StrByteCount;
+
+    // skip the Byte-Order-Mark (UTF-8 encoded U+FEFF symbol)
+    if (3 <= InUtf8StrByteCount && 0xEF == (unsigned char) pStr[0] &&
+        0xBB == (unsigned char) pStr[1] && 0xBF == (unsigned char) pStr[2]) {
+        pStr += 3;
+    }
+    if (pStr >= pEnd) {
+        return 0;
+    }
+
+    const bool fUseRawBytes = pModelData->m_useRawBytes;
+
+    while (pStr < pEnd) {
+
+        const int Offset = (int) (pStr - pInUtf8Str);
+        int C = (unsigned char) *pStr;
+
+        if (0x80 > C || fUseRawBytes) {
+            pStr++;
+        } else {
+            pStr = ::FAUtf8ToInt(pStr, pEnd, &C);
+            if (NULL == pStr) {
+                return 0;
+            }
+        }
+
+        if (!FAAddNormChar_sp(pModelData, C, Offset, pOut, pOffsets, OutSize, NormSize, MaxNormSize)) {
+            return 0;
+        }
+    }
+
+    if (0 >= NormSize) {
+        return 0;
+    }
+
+    // trim the final space if there was no content characters after
+    if (1 < OutSize && pOut[OutSize - 1] == __FASpDelimiter__) {
+        OutSize--;
+    }
+
+    return OutSize;
+}
+
+
+//
+// Implements a sentence piece algorithm, returns predictions from FATokenSegmentationTools_1best_t.
+// The input is always prepended with ' ' / '▁' since this seems the case in the sentence piece.
+// Returns upto MaxIdsArrLength ids, the rest of the array is unchanged, so the array can be set to 
+// initial length and fill with 0's for padding. Returns number of ids copied into the array.
+//
+// Example:
+// printf "Sergei Alonichau I saw a girl with a \ttelescope." | spm_encode --model=xlnet/spiece.model 
+// ▁Sergei ▁Al oni chau ▁I ▁saw ▁a ▁girl ▁with ▁a ▁telescope .
+//
+// printf "Sergei Alonichau I saw a girl with a \ttelescope." | spm_encode --model=xlnet/spiece.model --output_format=id
+// 14363 651 7201 25263 35 685 24 1615 33 24 16163 9
+//
+// TextToIds_sp output: 12, [14363 651 7201 25263 35 685 24 1615 33 24 16163 9]
+//
+const int TextToIdsWithOffsets_sp_int(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets, 
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId,
+        FATokWorkspace * pWs
+)
+{
+    // validate the parameters
+    if (0 >= InUtf8StrByteCount || InUtf8StrByteCount > FALimits::MaxArrSize || NULL == pInUtf8Str || 0 == ModelPtr) {
+        return 0;
+    }
+
+    // flag to alter the logic in case we don't need the offsets
+    const bool fNeedOffsets = NULL != pStartOffsets && NULL != pEndOffsets;
+
+    // get the model data
+    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+    const FADictConfKeeper * pConf = &(pModelData->m_DictConf);
+
+    FAStatsAdd(pModelData, FA_STAT_CALLS, 1);
+    FAStatsAdd(pModelData, FA_STAT_BYTES, InUtf8StrByteCount);
+    FAStatsStart(Timer);
+
+    // get the buffers for the characters and their offsets
+    const int MaxBuffSize = (InUtf8StrByteCount + 1) * 2;
+    int * pBuff = FAGetBuffer(pWs->m_Utf32, MaxBuffSize);
+    int * pOffsets = fNeedOffsets ? FAGetBuffer(pWs->m_Offsets, MaxBuffSize) : NULL;
+
+    // decode, normalize and replace every space sequence with U+2581 in one pass
+    const int BuffSize = FAPrepareInput_sp(pModelData, pInUtf8Str, InUtf8StrByteCount, pBuff, pOffsets, MaxBuffSize);
+    if (0 >= BuffSize) {
+        return 0;
+    }
+    FAStatsLap(pModelData, FA_STAT_DECODE_CYCLES, Timer);
+
+    // do the segmentation
+    const int WbdResMaxSize = BuffSize * 3;
+    int * pWbdResults = FAGetBuffer(pWs->m_Res, WbdResMaxSize);
+    if (NULL == pWbdResults) {
+        return 0;
+    }
+
+    // tokenize input with a selected algorithm, reuse the workspace's scratch data
+    const int WbdOutSize = pModelData->m_WordCache.IsEnabled () ?
+        FASegmentWords (pModelData, pBuff, BuffSize, pWbdResults, WbdResMaxSize, UnkId, pWs) :
+        pModelData->m_pAlgo->Process (pBuff, BuffSize, pWbdResults, WbdResMaxSize, UnkId, &(pWs->m_pSegScratch));
+    if (WbdOutSize > WbdResMaxSize || 0 != WbdOutSize % 3) {
+        return 0;
+    }
+    FAStatsLap(pModelData, FA_STAT_SEGMENT_CYCLES, Timer);
+
+    int OutSize = 0;
+    int IdOffset = pConf->GetIdOffset (); // see if we need to shift output IDs by a constant
+    // return the ids only
+    for (int i = 0; i < WbdOutSize && OutSize < MaxIdsArrLength; i += 3) {
+
+        // copy id
+        const int id = pWbdResults [i];
+        pIdsArr [OutSize] = id + IdOffset;
+        if (UnkId == id) {
+            FAStatsAdd(pModelData, FA_STAT_UNKNOWN_TOKENS, 1);
+        }
+
+        // copy offsets if needed
+        if (fNeedOffsets) {
+
+            const int TokenFrom = pWbdResults [i + 1];
+            const int FromOffset = pOffsets[TokenFrom];
+            pStartOffsets[OutSize] = FromOffset;
+
+            const int TokenTo = pWbdResults [i + 2];
+            const int ToOffset = pOffsets[TokenTo];
+            const int ToCharSize = ::FAUtf8Size(pInUtf8Str + ToOffset);
+            pEndOffsets[OutSize] = ToOffset + (0 < ToCharSize ? ToCharSize - 1 : 0);
+        }
+
+        OutSize++;
+    }
+
+    FAStatsLap(pModelData, FA_STAT_OUTPUT_CYCLES, Timer);
+    FAStatsAdd(pModelData, FA_STAT_TOKENS, OutSize);
+    if (WbdOutSize / 3 > MaxIdsArrLength) {
+        FAStatsAdd(pModelData, FA_STAT_SMALL_BUFFER, 1);
+    }
+
+    return OutSize;
+}
+
+
+//
+// Same as TextToIdsWithOffsets_sp_int but uses a thread-local workspace
+//
+extern "C"
+const int TextToIdsWithOffsets_sp(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets, 
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId = 0
+)
+{
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+    const int Res = TextToIdsWithOffsets_sp_int(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr,
+        pStartOffsets, pEndOffsets, MaxIdsArrLength, UnkId, pWs);
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Res;
+}
+
+
+//
+// The same as TextToIdsWithOffsets_sp, except does not return offsets
+//
+extern "C"
+const int TextToIds_sp(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        const int MaxIdsArrLength,
+        const int UnkId = 0
+)
+{
+    return TextToIdsWithOffsets_sp(ModelPtr,pInUtf8Str,InUtf8StrByteCount,pIdsArr,NULL,NULL,MaxIdsArrLength,UnkId);
+}
+
+
+//
+// Implements a word-piece or sentence piece algorithms which is defined by the loaded model. 
+// Returns ids of words or sub-words, returns upto MaxIdsArrLength ids, the rest of the array 
+// is unchanged, so the array can be set to initial length and fill with 0's for padding.
+// Returns number of ids copied into the array.
+//
+
+extern "C"
+const int TextToIdsWithOffsets(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets, 
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId = 0
+)
+{
+    if (0 == ModelPtr) {
+        return 0;
+    }
+
+    // check if loaded model has segmentation data
+    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+
+    if (!pModelData->m_hasSeg)
+    {
+        // call word-piece algorithm
+        return TextToIdsWithOffsets_wp(
+                ModelPtr, 
+                pInUtf8Str, 
+                InUtf8StrByteCount, 
+                pIdsArr, 
+                pStartOffsets, 
+                pEndOffsets, 
+                MaxIdsArrLength, 
+                UnkId
+            );
+    }
+    else
+    {
+        // call sentence-piece algorithm
+        return TextToIdsWithOffsets_sp(
+                ModelPtr, 
+                pInUtf8Str, 
+                InUtf8StrByteCount, 
+                pIdsArr, 
+                pStartOffsets, 
+                pEndOffsets, 
+                MaxIdsArrLength, 
+                UnkId
+            );
+    }
+}
+
+
+//
+// Implements a word-piece or sentence piece algorithms which is defined by the loaded model. 
+// Returns ids of words or sub-words, returns upto MaxIdsArrLength ids, the rest of the array 
+// is unchanged, so the array can be set to initial length and fill with 0's for padding.
+// Returns number of ids copied into the array.
+//
+
+extern "C"
+const int TextToIds(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        const int MaxIdsArrLength,
+        const int UnkId = 0
+)
+{
+    if (0 == ModelPtr) {
+        return 0;
+    }
+
+    // check if loaded model has segmentation data
+    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+
+    if (!pModelData->m_hasSeg)
+    {
+        // call word-piece algorithm
+        return TextToIdsWithOffsets_wp(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr, NULL, NULL, MaxIdsArrLength, UnkId);
+    }
+    else
+    {
+        // call sentence-piece algorithm
+        return TextToIdsWithOffsets_sp(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr, NULL, NULL, MaxIdsArrLength, UnkId);
+    }
+}
+
+
+//
+// Creates a tokenizer workspace, the workspace keeps all intermediate buffers needed by
+// the ...WithWorkspace functions. The buffers only grow and are reused from call to call,
+// so a steady state call does not allocate memory. A workspace should not be used by more
+// than one thread at a time. Returns NULL in case of an error.
+//
+extern "C"
+void* CreateTokenizerWorkspace()
+{
+    FATokWorkspace * pWs = new FATokWorkspace();
+    return pWs;
+}
+
+
+//
+// Frees memory of the workspace created with CreateTokenizerWorkspace
+//
+extern "C"
+int FreeTokenizerWorkspace(void* WorkspacePtr)
+{
+    if (NULL == WorkspacePtr) {
+        return 0;
+    }
+
+    FATokWorkspace * pWs = (FATokWorkspace*)WorkspacePtr;
+    delete pWs;
+
+    return 0;
+}
+
+
+//
+// The same as TextToIdsWithOffsets, but keeps intermediate data in the caller provided workspace
+//
+extern "C"
+const int TextToIdsWithOffsetsWithWorkspace(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets, 
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId,
+        void* WorkspacePtr
+)
+{
+    if (0 == ModelPtr || NULL == WorkspacePtr) {
+        return 0;
+    }
+
+    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+    FATokWorkspace * pWs = (FATokWorkspace*)WorkspacePtr;
+
+    if (!pModelData->m_hasSeg) {
+        return TextToIdsWithOffsets_wp_int(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr,
+            pStartOffsets, pEndOffsets, MaxIdsArrLength, UnkId, pWs);
+    } else {
+        return TextToIdsWithOffsets_sp_int(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr,
+            pStartOffsets, pEndOffsets, MaxIdsArrLength, UnkId, pWs);
+    }
+}
+
+
+//
+// The same as TextToIds, but keeps intermediate data in the caller provided workspace
+//
+extern "C"
+const int TextToIdsWithWorkspace(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        const int MaxIdsArrLength,
+        const int UnkId,
+        void* WorkspacePtr
+)
+{
+    return TextToIdsWithOffsetsWithWorkspace(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr,
+        NULL, NULL, MaxIdsArrLength, UnkId, WorkspacePtr);
+}
+
+
+//
+// The same as TextToWordsWithOffsetsWithModel, but keeps intermediate data in the caller provided workspace
+//
+extern "C"
+const int TextToWordsWithOffsetsWithWorkspace(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, void* WorkspacePtr)
+{
+    if (NULL == WorkspacePtr) {
+        return -1;
+    }
+    return TextToWordsWithOffsetsWithModel_int(pInUtf8Str, InUtf8StrByteCount, pOutUtf8Str,
+        pStartOffsets, pEndOffsets, MaxOutUtf8StrByteCount, hModel, (FATokWorkspace*)WorkspacePtr);
+}
+
+
+//
+// The same as TextToSentencesWithOffsetsWithModel, but keeps intermediate data in the caller provided workspace
+//
+extern "C"
+const int TextToSentencesWithOffsetsWithWorkspace(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, void* WorkspacePtr)
+{
+    if (NULL == WorkspacePtr) {
+        return -1;
+    }
+    return TextToSentencesWithOffsetsWithModel_int(pInUtf8Str, InUtf8StrByteCount, pOutUtf8Str,
+        pStartOffsets, pEndOffsets, MaxOutUtf8StrByteCount, hModel, (FATokWorkspace*)WorkspacePtr);
+}
+
+
+//
+// Frees memory from the model, after this call ModelPtr is no longer valid
+//  Double calls to this function with the same argument will case access violation
+//
+// Note: A model returned by AcquireModel is only freed when the last reference to it
+//  is released, e.g. after the model is replaced with SwapModelSlot.
+//
+extern "C"
+int FreeModel(void* ModelPtr)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    FAModelData * pModel = (FAModelData*) ModelPtr;
+    if (0 == --(pModel->m_RefCount)) {
+        delete pModel;
+    }
+    return 1;
+}
+
+
+//
+// Allows to change the "no-dummy-prefix" (NoDummyPrefix) without the recompilation of the models
+// Note: it is the best to use the mode the same way it was trained / compiled leave this value to what it was set via ldb.conf.small file
+// Note: it must not be called on a model which other threads obtained with AcquireModel
+//
+extern "C"
+int SetNoDummyPrefix(void* ModelPtr, bool fNoDummyPrefix)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    FAModelData* pModel = (FAModelData*) ModelPtr;
+    pModel->m_DictConf.SetNoDummyPrefix(fNoDummyPrefix);
+    pModel->m_NoDummyPrefix = fNoDummyPrefix ? 1 : 0;
+    return 1;
+}
+
+
+//
+// Switches the model to a different segmentation algorithm which uses the same data, e.g.
+// from "bpe-opt-with-merges" (5) to "bpe-opt-with-merges-local" (7) or from "bpe-opt" (4) to
+// "bpe-opt-local" (6), see FAFsmConst::TOKENIZE_* for the values. This allows to use the faster
+// algorithm with the models compiled earlier, the results are the same.
+// Note: this function should be called after the model is loaded and before it is used,
+// it must not be called on a model which other threads obtained with AcquireModel.
+// Returns 1 if the algorithm is changed and 0 if the model does not have compatible data.
+//
+extern "C"
+int SetTokAlgo(void* ModelPtr, int TokAlgo)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    FAModelData* pModel = (FAModelData*) ModelPtr;
+    if (!pModel->m_hasSeg) {
+        return 0;
+    }
+
+    // the algorithms which take the merge ranks from the IDs, "bpe" (3) is not one of them since
+    // it does not take the whole words matched by the vocabulary as tokens and the local one does
+    const int TokAlgo1 = pModel->m_DictConf.GetTokAlgo();
+    const bool fIdRanks1 = FAFsmConst::TOKENIZE_BPE_OPT == TokAlgo1 ||
+        FAFsmConst::TOKENIZE_BPE_OPT_LOCAL == TokAlgo1;
+    const bool fIdRanks2 = FAFsmConst::TOKENIZE_BPE_OPT == TokAlgo ||
+        FAFsmConst::TOKENIZE_BPE_OPT_LOCAL == TokAlgo;
+
+    // the algorithms which take the merge ranks from a separate field
+    const bool fRanks1 = FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES == TokAlgo1 ||
+        FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL == TokAlgo1;
+    const bool fRanks2 = FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES == TokAlgo ||
+        FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL == TokAlgo;
+
+    if (!(fIdRanks1 && fIdRanks2) && !(fRanks1 && fRanks2)) {
+        return 0;
+    }
+
+    pModel->m_DictConf.SetTokAlgo(TokAlgo);
+    InitSegEngine(pModel);
+    pModel->m_WordCache.Reset();
+    pModel->m_TokAlgo = TokAlgo;
+
+    return 1;
+}
+
+
+//
+// Builds a flat transition table for the word / sentence breaking automaton of the model,
+// the table takes at most MaxMemoryBytes and speeds up the lexer for the states close to the
+// initial state and the characters below U+0100, the rest still uses the packed automaton.
+// If MaxMemoryBytes <= 0 then the table is freed and the packed automaton is used alone.
+// Note: this function should be called after the model is loaded and before it is used,
+// it is not safe to call it while other threads use the same model, e.g. a model which other
+// threads obtained with AcquireModel (SwapModelSlot applies the setting to the new model).
+// Returns the number of states in the table or 0 if the model has no word / sentence breaking data.
+//
+extern "C"
+int SetDenseDfa(void* ModelPtr, int MaxMemoryBytes)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    FAModelData* pModel = (FAModelData*) ModelPtr;
+    if (!pModel->m_hasWbd) {
+        return 0;
+    }
+
+    pModel->m_DenseDfaBytes = 0 < MaxMemoryBytes ? MaxMemoryBytes : 0;
+
+    if (NULL == pModel->m_pPackedDfa) {
+        pModel->m_pPackedDfa = pModel->m_Conf.GetRsDfa ();
+    }
+
+    int StateCount = 0;
+
+    if (0 < MaxMemoryBytes) {
+        StateCount = pModel->m_DenseDfa.Build (pModel->m_pPackedDfa, (size_t) MaxMemoryBytes);
+    } else {
+        pModel->m_DenseDfa.Clear ();
+    }
+
+    pModel->m_Conf.SetRsDfa (0 < StateCount ? \
+        (const FARSDfaCA *) &(pModel->m_DenseDfa) : pModel->m_pPackedDfa);
+    pModel->m_Engine.SetConf (&(pModel->m_Conf));
+
+    return StateCount;
+}
+
+
+//
+// Returns true if no token of the model contains U+2581 after the first character and U+2581
+// alone is a token, then the tokens never cross the word boundaries and the words can be
+// tokenized independently. (If U+2581 is not a token, the engines merge it with the unknown
+// characters before it into one unknown token.)
+//
+const bool FACanSegmentWords(const FAModelData * pModel)
+{
+    const FARSDfaCA * pDfa = pModel->m_DictConf.GetRsDfa();
+    const FAGetIWsCA * pStateIws = pModel->m_DictConf.GetIws();
+    if (NULL == pDfa) {
+        return false;
+    }
+
+    // the alphabet is used if the outgoing Iws of the states are not available
+    const int MaxIwCount = pDfa->GetIWs(NULL, 0);
+    if (0 >= MaxIwCount) {
+        return false;
+    }
+    std::vector< int > Iws(MaxIwCount);
+    pDfa->GetIWs(Iws.data(), MaxIwCount);
+    std::vector< int > StateIws(MaxIwCount);
+
+    const int Initial = pDfa->GetInitial();
+
+    // U+2581 should never be a part of an unknown token
+    const int Delim = pDfa->GetDest(Initial, __FASpDelimiter__);
+    if (0 > Delim || !pDfa->IsFinal(Delim)) {
+        return false;
+    }
+
+    // visit all the states reachable from the initial with one or more characters
+    std::vector< int > States;
+    std::vector< bool > Seen;
+
+    States.push_back(Initial);
+
+    for (size_t i = 0; i < States.size(); ++i) {
+
+        const int State = States[i];
+
+        if (Initial != State && -1 != pDfa->GetDest(State, __FASpDelimiter__)) {
+            return false;
+        }
+
+        const int * pIws = Iws.data();
+        int IwCount = MaxIwCount;
+
+        if (NULL != pStateIws) {
+            const int StateIwCount = pStateIws->GetIWs(State, StateIws.data(), MaxIwCount);
+            if (0 <= StateIwCount && StateIwCount <= MaxIwCount) {
+                pIws = StateIws.data();
+                IwCount = StateIwCount;
+            }
+        }
+
+        for (int j = 0; j < IwCount; ++j) {
+
+            const int Dst = pDfa->GetDest(State, pIws[j]);
+
+            if (0 <= Dst) {
+                if ((size_t) Dst >= Seen.size()) {
+                    Seen.resize(Dst + 1, false);
+                }
+                if (!Seen[Dst]) {
+                    Seen[Dst] = true;
+                    States.push_back(Dst);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+
+//
+// Enables the cache of the tokenization results of the words for the TextToIds_sp and
+// TextToIdsWithOffsets_sp functions (and TextToIds, TextToIdsWithOffsets with the unigram-lm
+// or BPE models). The results of a word are computed once and then copied, the results are
+// the same as without the cache. The cache takes at most MaxMemoryBytes, if MaxMemoryBytes <= 0
+// then the cache is freed. Words longer than FAWordCache::MaxWordLength are not cached.
+// Note: this function should be called after the model is loaded and before it is used,
+// it is not safe to call it while other threads use the same model, e.g. a model which other
+// threads obtained with AcquireModel (SwapModelSlot applies the setting to the new model).
+// Returns the number of words the cache can keep or 0 if the cache is not used, e.g. the
+// tokens of the model can span over several words.
+//
+extern "C"
+int SetWordCache(void* ModelPtr, int MaxMemoryBytes)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    FAModelData* pModel = (FAModelData*) ModelPtr;
+    pModel->m_WordCache.Clear();
+    pModel->m_WordCacheBytes = 0 < MaxMemoryBytes ? MaxMemoryBytes : 0;
+
+    if (!pModel->m_hasSeg || NULL == pModel->m_pAlgo || 0 >= MaxMemoryBytes) {
+        return 0;
+    }
+    if (!FACanSegmentWords(pModel)) {
+        return 0;
+    }
+
+    return pModel->m_WordCache.Create((size_t) MaxMemoryBytes);
+}
+
+
+//
+// Removes all the words from the word cache of the model and resets its counters.
+// This function can be called while other threads use the same model.
+// Returns 1 if the model has the word cache enabled and 0 otherwise.
+//
+extern "C"
+int ClearWordCache(void* ModelPtr)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    FAModelData* pModel = (FAModelData*) ModelPtr;
+    if (!pModel->m_WordCache.IsEnabled()) {
+        return 0;
+    }
+
+    pModel->m_WordCache.Reset();
+    return 1;
+}
+
+
+//
+// Returns the number of words found in the word cache (hits) and not found (misses) since the
+// cache was enabled or cleared, any of the pointers can be NULL.
+// Returns 1 if the model has the word cache enabled and 0 otherwise.
+//
+extern "C"
+int GetWordCacheStats(void* ModelPtr, int64_t * pHitCount, int64_t * pMissCount)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    const FAModelData* pModel = (const FAModelData*) ModelPtr;
+    if (!pModel->m_WordCache.IsEnabled()) {
+        return 0;
+    }
+
+    long long HitCount = 0;
+    long long MissCount = 0;
+    pModel->m_WordCache.GetCounts(&HitCount, &MissCount);
+
+    if (NULL != pHitCount) {
+        *pHitCount = HitCount;
+    }
+    if (NULL != pMissCount) {
+        *pMissCount = MissCount;
+    }
+    return 1;
+}
+
+
+//
+// Writes the text of a sequence of ids, the leading space of the text is not written. The text
+// is written only while it fits into MaxOutUtf8StrByteCount bytes. Returns the length of the text
+// or -1 if there is an unknown id and fSkipUnknown is false, the unknown ids are skipped otherwise.
+//
+const int FAIdsToText(const FAModelData * pModel, const int32_t * pIdsArr, const int IdsCount,
+    char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, const bool SkipSpecialTokens, const bool fSkipUnknown)
+{
+    int ActualLength = 0;
+
+    for (int i = 0; i < IdsCount; ++i) {
+
+        // get the next id
+        const int id = pIdsArr [i];
+
+        // skip special tokens, if needed
+        if (SkipSpecialTokens && (id < pModel->m_min_token_id || id > pModel->m_max_token_id)) {
+            continue;
+        }
+
+        // get token text
+        const unsigned char * pToken = NULL;
+        int TokenLength = pModel->m_i2w.GetAt (id, &pToken);
+        if (0 > TokenLength) {
+            if (fSkipUnknown) {
+                continue;
+            }
+            return -1; // unknon id
+        }
+
+        // don't output space in the leading position
+        if (0 == ActualLength && 0 < TokenLength && 0x20 == pToken[0]) {
+            pToken++;
+            TokenLength--;
+        }
+
+        // copy token text into the output buffer
+        if (0 < TokenLength && MaxOutUtf8StrByteCount - ActualLength >= TokenLength) {
+            memcpy(pOutUtf8Str + ActualLength, pToken, TokenLength);
+        }
+
+        ActualLength += TokenLength;
+    }
+
+    return ActualLength;
+}
+
+
+//
+// Returns text string given a sequence of Ids
+//  Note: the model file should contain [i2w] configuration or separate *.i2w model file should be used
+// 
+// return value is the actual string length
+// if the actual string length is more than MaxOutUtf8StrByteCount then pOutUtf8Str content is undefined
+// 
+extern "C"
+int IdsToText (void* ModelPtr, const int32_t * pIdsArr, const int IdsCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, bool SkipSpecialTokens)
+{
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+    if (0 == IdsCount || NULL == pIdsArr) {
+        return 0;
+    }
+
+    const FAModelData* pModel = (FAModelData*) ModelPtr;
+    if (!pModel->m_hasI2w) {
         return 0;
     }
 
-    // needed for normalization
-    std::vector< int > utf32input_norm;
-    int * pNormBuff = NULL;
-    std::vector< int > utf32norm_offsets;
-    int * pNormOffsets = NULL;
+    const int ActualLength = FAIdsToText(pModel, pIdsArr, IdsCount, pOutUtf8Str, MaxOutUtf8StrByteCount, SkipSpecialTokens, false);
+    if (0 > ActualLength) {
+        return 0;
+    }
 
-    // get the model data
-    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
-    const FAWbdConfKeeper * pConf = &(pModelData->m_Conf);
-    const FAMultiMapCA * pCharMap = pConf->GetCharMap ();
+    // add a terminating 0 for some interpreters
+    if (MaxOutUtf8StrByteCount > ActualLength) {
+        pOutUtf8Str [ActualLength] = 0;
+    }
 
-    // do the normalization for the entire input
-    if (pCharMap) {
+    // return the actual length of the output (the minimum length needed to keep entire output)
+    return ActualLength + 1;
+}
 
-        utf32input_norm.resize(InUtf8StrByteCount);
-        pNormBuff = utf32input_norm.data();
-        if (NULL == pNormBuff) {
-            return 0;
+
+// the number of sequences IdsToTextBatch gives to a thread at a time
+const int IDS_TO_TEXT_BLOCK_SIZE = 64;
+
+//
+// Batch version of IdsToText. Converts SeqCount sequences of ids into texts in parallel using upto
+// ThreadCount threads of a shared thread pool, if ThreadCount <= 0 then all hardware threads are used.
+//
+// pIdsArr keeps all the sequences one after another, pIdsCounts is an array of SeqCount lengths
+// pOutSizes is an array of SeqCount elements, receives the size of each text in bytes including
+//  its terminating 0
+//
+// The sizes of the texts are computed first, then if the texts fit into MaxOutUtf8StrByteCount bytes
+//  they are written into pOutUtf8Str one after another, each terminated with 0. So the caller can
+//  call this function with pOutUtf8Str == NULL, allocate the buffer of the returned size and call
+//  it again. Unlike IdsToText the unknown ids are skipped.
+//
+// Returns the total size of the texts or -1 in case of invalid parameters.
+//
+extern "C"
+const int IdsToTextBatch(void* ModelPtr, const int32_t * pIdsArr, const int * pIdsCounts, const int SeqCount,
+    char * pOutUtf8Str, int * pOutSizes, const int MaxOutUtf8StrByteCount, bool SkipSpecialTokens, const int ThreadCount)
+{
+    if (NULL == ModelPtr || 0 > SeqCount || 0 > MaxOutUtf8StrByteCount) {
+        return -1;
+    }
+    if (0 < SeqCount && (NULL == pIdsCounts || NULL == pOutSizes)) {
+        return -1;
+    }
+
+    const FAModelData* pModel = (FAModelData*) ModelPtr;
+    if (!pModel->m_hasI2w) {
+        return -1;
+    }
+
+    // the first id of each sequence
+    std::vector< size_t > IdsOffsets(SeqCount + 1);
+    IdsOffsets[0] = 0;
+    for (int i = 0; i < SeqCount; ++i) {
+        if (0 > pIdsCounts[i]) {
+            return -1;
         }
-        if (fNeedOffsets) {
-            utf32norm_offsets.resize(InUtf8StrByteCount);
-            pNormOffsets = utf32norm_offsets.data();
-            if (NULL == pNormOffsets) {
-                return 0;
+        IdsOffsets[i + 1] = IdsOffsets[i] + pIdsCounts[i];
+    }
+    if (0 < IdsOffsets[SeqCount] && NULL == pIdsArr) {
+        return -1;
+    }
+
+    // the sequences are usually short, so each thread takes a block of them at a time
+    const int BlockCount = (SeqCount + IDS_TO_TEXT_BLOCK_SIZE - 1) / IDS_TO_TEXT_BLOCK_SIZE;
+
+    // compute the size of each text
+    FAGetThreadPool ().ParallelFor (BlockCount, ThreadCount, [&](const int Block) {
+        const int To = std::min(SeqCount, (Block + 1) * IDS_TO_TEXT_BLOCK_SIZE);
+        for (int i = Block * IDS_TO_TEXT_BLOCK_SIZE; i < To; ++i) {
+            pOutSizes [i] = 1 + FAIdsToText(pModel, pIdsArr + IdsOffsets [i], pIdsCounts [i], NULL, 0, SkipSpecialTokens, true);
+        }
+    });
+
+    // the first byte of each text
+    std::vector< size_t > OutOffsets(SeqCount + 1);
+    OutOffsets[0] = 0;
+    for (int i = 0; i < SeqCount; ++i) {
+        OutOffsets[i + 1] = OutOffsets[i] + pOutSizes[i];
+    }
+    if ((size_t) FALimits::MaxArrSize < OutOffsets[SeqCount]) {
+        return -1;
+    }
+    const int OutSize = (int) OutOffsets[SeqCount];
+
+    // write the texts, if fit
+    if (NULL != pOutUtf8Str && OutSize <= MaxOutUtf8StrByteCount) {
+
+        FAGetThreadPool ().ParallelFor (BlockCount, ThreadCount, [&](const int Block) {
+            const int To = std::min(SeqCount, (Block + 1) * IDS_TO_TEXT_BLOCK_SIZE);
+            for (int i = Block * IDS_TO_TEXT_BLOCK_SIZE; i < To; ++i) {
+                char * pOut = pOutUtf8Str + OutOffsets [i];
+                const int Length = pOutSizes [i] - 1;
+                FAIdsToText(pModel, pIdsArr + IdsOffsets [i], pIdsCounts [i], pOut, Length, SkipSpecialTokens, true);
+                pOut [Length] = 0;
+            }
+        });
+    }
+
+    return OutSize;
+}
+
+
+//
+// Returns the id of the token in the segmentation vocabulary of the model or -1 if the token is not
+// there. The token is looked up with the same Mealy DFA with MPH-encoded outputs as used by the
+// segmentation algorithms, the token is normalized with the model's character map, if any, and the
+// spaces in it are treated as U+2581 the way the vocabulary is compiled: every U+0020 for the Unicode
+// models and only the leading one (or a leading U+2581) for the byte-level models, the other bytes of
+// which are kept as is.
+//
+const int FAGetVocabId(const FAModelData * pModel, const char * pToken, const int TokenLength)
+{
+    const FARSDfaCA * pDfa = pModel->m_DictConf.GetRsDfa();
+    const FAMealyDfaCA * pMealy = pModel->m_DictConf.GetMphMealy();
+    const FAMultiMapCA * pI2Info = pModel->m_DictConf.GetI2Info();
+    if (NULL == pDfa || NULL == pMealy || NULL == pI2Info) {
+        return -1;
+    }
+
+    int State = pDfa->GetInitial();
+    int SumOw = 0;
+
+    const char * pStr = pToken;
+    const char * pEnd = pToken + TokenLength;
+
+    const bool fUseRawBytes = pModel->m_useRawBytes;
+
+    while (pStr < pEnd) {
+
+        int C = (unsigned char) *pStr;
+
+        if (fUseRawBytes) {
+            // only the leading space of a byte-level token is stored as U+2581
+            if (pToken == pStr && 3 <= TokenLength && 0 == memcmp(pStr, "\xE2\x96\x81", 3)) {
+                C = __FASpDelimiter__;
+                pStr += 3;
+            } else {
+                if (pToken == pStr && 0x20 == C) {
+                    C = __FASpDelimiter__;
+                }
+                pStr++;
+            }
+        } else if (0x80 > C) {
+            pStr++;
+        } else {
+            pStr = ::FAUtf8ToInt(pStr, pEnd, &C);
+            if (NULL == pStr) {
+                return -1;
             }
         }
+        // normalize the character, if the model has a character map
+        const int * pNorm = &C;
+        int NormCount = pModel->m_hasCharMap ? pModel->m_CharMap.Get (C, &pNorm) : -1;
+        if (-1 == NormCount) {
+            pNorm = &C;
+            NormCount = 1;
+        }
 
-        BuffSize = fNeedOffsets ? 
-            ::FANormalize(pBuff, BuffSize, pNormBuff, pNormOffsets, InUtf8StrByteCount, pCharMap) :
-            ::FANormalize(pBuff, BuffSize, pNormBuff, InUtf8StrByteCount, pCharMap);
-        if (BuffSize <= 0 || BuffSize > InUtf8StrByteCount) {
-            return 0;
+        for (int i = 0; i < NormCount; ++i) {
+
+            const int Iw = (!fUseRawBytes && 0x20 == pNorm[i]) ? __FASpDelimiter__ : pNorm[i];
+
+            int Ow = 0;
+            State = pMealy->GetDestOw(State, Iw, &Ow);
+            if (-1 == State) {
+                return -1;
+            }
+            SumOw += Ow;
         }
+    }
 
-        // use normalized buffer as input
-        pBuff = pNormBuff;
+    if (!pDfa->IsFinal(State)) {
+        return -1;
     }
 
-    // keep sentence boundary information here
-    const int WbdResMaxSize = BuffSize * 6;
-    std::vector< int > WbdRes(WbdResMaxSize);
-    int * pWbdRes = WbdRes.data();
-    if (NULL == pWbdRes) {
-        return 0;
+    // get the id of the token
+    const int * pValues = NULL;
+    const int Count = pI2Info->Get(SumOw, &pValues);
+    if (0 >= Count || NULL == pValues) {
+        return -1;
     }
+    // shift the id the same way the segmentation results are shifted
+    return pValues[0] + pModel->m_DictConf.GetIdOffset();
+}
 
-    // compute token and sub-token boundaries
-    const int WbdOutSize = pModelData->m_Engine.Process(pBuff, BuffSize, pWbdRes, WbdResMaxSize);
-    if (WbdOutSize > WbdResMaxSize || 0 != WbdOutSize % 3) {
-        return 0;
+
+// returns true if the i2w string with Id1 goes before the (pStr2, Length2) string
+inline bool FAI2wLess(const FAStringArray_pack & i2w, const int Id1, const unsigned char * pStr2, const int Length2)
+{
+    const unsigned char * pStr1 = NULL;
+    const int Length1 = i2w.GetAt(Id1, &pStr1);
+
+    const int Cmp = memcmp(pStr1, pStr2, std::min(Length1, Length2));
+    return 0 > Cmp || (0 == Cmp && Length1 < Length2);
+}
+
+
+//
+// Returns the smallest id of the token in the i2w strings of the model or -1 if the token is not
+// there. The strings are looked up with a binary search over the ids sorted by the strings, the
+// ids are sorted by the first call.
+//
+const int FAGetI2wId(const FAModelData * pModel, const char * pToken, const int TokenLength)
+{
+    const FAStringArray_pack & i2w = pModel->m_i2w;
+    std::vector< int > & Index = pModel->m_i2wIndex;
+
+    std::call_once(pModel->m_i2wIndexOnce, [&]() {
+
+        const int Count = i2w.GetCount();
+        Index.resize(Count);
+        for (int i = 0; i < Count; ++i) {
+            Index[i] = i;
+        }
+        // the equal strings keep the order of their ids
+        std::stable_sort(Index.begin(), Index.end(), [&](const int Id1, const int Id2) {
+            const unsigned char * pStr2 = NULL;
+            const int Length2 = i2w.GetAt(Id2, &pStr2);
+            return FAI2wLess(i2w, Id1, pStr2, Length2);
+        });
+    });
+
+    const unsigned char * pStr = (const unsigned char *) pToken;
+
+    std::vector< int >::const_iterator I = std::lower_bound(Index.begin(), Index.end(), 0,
+        [&](const int Id, const int) {
+            return FAI2wLess(i2w, Id, pStr, TokenLength);
+        });
+
+    if (I == Index.end()) {
+        return -1;
     }
 
-    int OutCount = 0;
+    // see if the found string is the token
+    const unsigned char * pFound = NULL;
+    const int FoundLength = i2w.GetAt(*I, &pFound);
+    if (FoundLength != TokenLength || 0 != memcmp(pFound, pStr, TokenLength)) {
+        return -1;
+    }
+    return *I;
+}
 
-    // iterate over the results
-    for(int i = 0; i < WbdOutSize; i += 3) {
 
-        // ignore tokens with IGNORE tag
-        const int Tag = pWbdRes[i];
-        if (WBD_IGNORE_TAG == Tag) {
-            continue;
+//
+// Returns the id of the token or -1 if the model does not have such token. The token is first looked
+// up in the segmentation vocabulary of the model (sentence piece or BPE), the spaces in it are treated
+// as U+2581, so both "\xe2\x96\x81the" and " the" give the same id (for the byte-level BPE models only
+// the leading space is, as in their vocabularies). If it is not found there then the token is looked
+// up in the model's i2w strings, as returned by IdsToText, which also have the special tokens and the
+// tokens of the word-piece models.
+//
+// Note: The byte-level vocabularies do not have the tokens with a 0 byte, such tokens are only found
+//  in the i2w strings. Tokens with the white space characters other than U+0020 (e.g. "\n" or U+00A0)
+//  are found, although the segmentation algorithms never return them since they replace the white
+//  spaces with U+2581.
+//
+// Note: The i2w strings are indexed on the first call, the other calls are thread-safe with it.
+//
+extern "C"
+int TokenToId(void* ModelPtr, const char * pInUtf8Str, int InUtf8StrByteCount)
+{
+    if (NULL == ModelPtr || 0 >= InUtf8StrByteCount || NULL == pInUtf8Str) {
+        return -1;
+    }
+
+    const FAModelData * pModel = (const FAModelData*) ModelPtr;
+
+    int Id = -1;
+
+    if (pModel->m_hasSeg) {
+        Id = FAGetVocabId(pModel, pInUtf8Str, InUtf8StrByteCount);
+    }
+    if (-1 == Id && pModel->m_hasI2w) {
+        Id = FAGetI2wId(pModel, pInUtf8Str, InUtf8StrByteCount);
+    }
+
+    return Id;
+}
+
+
+//
+// Batch version of TokenToId. 
+//
+// ppInUtf8Strs, pInUtf8StrByteCounts are arrays of TokenCount tokens and their lengths
+// pIdsArr is an array of TokenCount elements, receives the id of each token or UnkId if the model
+//  does not have the token
+//
+// Returns the number of tokens found or -1 in case of invalid parameters.
+//
+extern "C"
+const int TokensToIds(void* ModelPtr, const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts,
+    const int TokenCount, int32_t * pIdsArr, const int UnkId)
+{
+    if (NULL == ModelPtr || 0 > TokenCount) {
+        return -1;
+    }
+    if (0 < TokenCount && (NULL == ppInUtf8Strs || NULL == pInUtf8StrByteCounts || NULL == pIdsArr)) {
+        return -1;
+    }
+
+    int FoundCount = 0;
+
+    for (int i = 0; i < TokenCount; ++i) {
+
+        const int Id = TokenToId(ModelPtr, ppInUtf8Strs [i], pInUtf8StrByteCounts [i]);
+
+        if (-1 != Id) {
+            pIdsArr [i] = Id;
+            FoundCount++;
+        } else {
+            pIdsArr [i] = UnkId;
         }
+    }
 
-        // For each token with WORD tag copy all subword tags into the output if
-        //  this word is covered completely by the subwords without gaps,
-        //  otherwise copy the UnkId tag (this is how it's done in the original BERT TokenizerFull).
-        if (WBD_WORD_TAG == Tag) {
+    return FoundCount;
+}
 
-            const int TokenFrom = pWbdRes[i + 1];
-            const int TokenTo = pWbdRes[i + 2];
 
-            // see if we have subtokens for this token and they cover the token completely
-            int j = i + 3;
-            int numSubTokens = 0;
-            bool subTokensCoveredAll = false;
+//
+// Keeps the state of the decoding of a sequence of ids which comes one id at a time, see DecoderBegin
+//
+struct FADecoderStream
+{
+    const FAModelData * m_pModel;
+    bool m_SkipSpecialTokens;
+    // the text bytes not yet returned start from m_Pos
+    std::vector< char > m_Text;
+    size_t m_Pos;
+    // indicates that the text is not empty, so the leading space of a token is kept
+    bool m_fStarted;
+
+    FADecoderStream (const FAModelData * pModel, const bool SkipSpecialTokens):
+        m_pModel (pModel),
+        m_SkipSpecialTokens (SkipSpecialTokens)
+    {
+        Reset ();
+    }
 
-            if (j < WbdOutSize) {
+    // prepares for a new sequence
+    void Reset ()
+    {
+        m_Text.clear ();
+        m_Pos = 0;
+        m_fStarted = false;
+    }
 
-                int ExpectedFrom = TokenFrom;
-                int SubTokenTag = pWbdRes[j];
-                int SubTokenFrom = pWbdRes[j + 1];
-                int SubTokenTo = pWbdRes[j + 2];
+    // adds the text of the id, returns false if the id is unknown
+    bool Push (const int Id)
+    {
+        // skip special tokens, if needed
+        if (m_SkipSpecialTokens && (Id < m_pModel->m_min_token_id || Id > m_pModel->m_max_token_id)) {
+            return true;
+        }
 
-                // '<=' because last subtoken should be included
-                while (j <= WbdOutSize && SubTokenTag > WBD_IGNORE_TAG && ExpectedFrom == SubTokenFrom) {
+        const unsigned char * pToken = NULL;
+        int TokenLength = m_pModel->m_i2w.GetAt (Id, &pToken);
+        if (0 > TokenLength) {
+            return false;
+        }
 
-                    ExpectedFrom = SubTokenTo + 1;
-                    numSubTokens++;
-                    j += 3;
-                    if (j < WbdOutSize) {
-                        SubTokenTag = pWbdRes[j];
-                        SubTokenFrom = pWbdRes[j + 1];
-                        SubTokenTo = pWbdRes[j + 2];
-                    } // else it will break at the while check
-                }
+        // don't output space in the leading position, the same as IdsToText
+        if (!m_fStarted && 0 < TokenLength && 0x20 == pToken[0]) {
+            pToken++;
+            TokenLength--;
+        }
+        if (0 < TokenLength) {
+            m_fStarted = true;
+            m_Text.insert (m_Text.end (), pToken, pToken + TokenLength);
+        }
+        return true;
+    }
 
-                // if subtoken To is the same as token To then we split the token all the way
-                if (0 < numSubTokens && ExpectedFrom - 1 == TokenTo) {
-                    // output all subtokens tags
-                    for(int k = 0; k < numSubTokens && OutCount < MaxIdsArrLength; ++k) {
+    // returns the end of the bytes which can be returned, an incomplete UTF-8 sequence at the end is
+    // kept until the next ids complete it, the invalid sequences are returned as is
+    const size_t GetReadyEnd (const bool fFlush) const
+    {
+        const size_t Size = m_Text.size ();
+        if (fFlush) {
+            return Size;
+        }
+        // look for the first byte of the last sequence
+        const size_t MinPos = std::max (m_Pos, 3 < Size ? Size - 3 : 0);
+        for (size_t i = Size; i > MinPos; --i) {
+            const unsigned char C = (unsigned char) m_Text [i - 1];
+            if (0x80 != (C & 0xC0)) {
+                const size_t Length = 0xC0 == (C & 0xE0) ? 2 : 0xE0 == (C & 0xF0) ? 3 : 0xF0 == (C & 0xF8) ? 4 : 1;
+                return (Size - (i - 1) < Length) ? i - 1 : Size;
+            }
+        }
+        return Size;
+    }
 
-                        const int TagIdx = ((k + 1) * 3) + i;
-                        const int SubTokenTag = pWbdRes[TagIdx];
+    // copies upto MaxOutUtf8StrByteCount of the ready bytes, returns the number of bytes copied
+    const int Pop (char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, const bool fFlush)
+    {
+        const size_t End = GetReadyEnd (fFlush);
+        const int Count = (int) std::min (End - m_Pos, (size_t) MaxOutUtf8StrByteCount);
 
-                        if (OutCount < MaxIdsArrLength) {
+        if (0 < Count) {
+            memcpy (pOutUtf8Str, m_Text.data () + m_Pos, Count);
+            m_Pos += Count;
+        }
+
+        // drop the returned bytes, at most once per the same number of bytes added
+        if (m_Pos == m_Text.size ()) {
+            m_Text.clear ();
+            m_Pos = 0;
+        } else if (m_Pos > m_Text.size () / 2) {
+            m_Text.erase (m_Text.begin (), m_Text.begin () + m_Pos);
+            m_Pos = 0;
+        }
+        return Count;
+    }
+};
+
+
+//
+// Creates a decoder of a sequence of ids which come one at a time, e.g. generated by a model,
+//  returns NULL if the model does not have [i2w] configuration.
+//
+// Usage:
+//
+//  1. DecoderPush is called for each id, it returns the UTF-8 bytes of the text added by this id.
+//  2. DecoderFlush is called at the end of the sequence, it returns the remaining bytes.
+//  3. DecoderFree is called to free the decoder.
+//
+// The bytes returned are the same as IdsToText returns for the whole sequence, but each call takes
+//  the time of the new id only. The bytes of an incomplete UTF-8 sequence (e.g. a character split
+//  into several byte-level BPE tokens) are kept until the sequence is complete. The model should
+//  not be freed before the decoder.
+//
+extern "C"
+void* DecoderBegin(void* ModelPtr, bool SkipSpecialTokens)
+{
+    if (NULL == ModelPtr) {
+        return NULL;
+    }
 
-                            pIdsArr[OutCount] = SubTokenTag;
+    const FAModelData * pModel = (const FAModelData*) ModelPtr;
+    if (!pModel->m_hasI2w) {
+        return NULL;
+    }
 
-                            if (fNeedOffsets) {
+    return new FADecoderStream(pModel, SkipSpecialTokens);
+}
 
-                                const int SubTokenFrom = pWbdRes[TagIdx + 1];
-                                const int FromOffset = pOffsets[(pCharMap) ? pNormOffsets [SubTokenFrom] : SubTokenFrom];
-                                pStartOffsets[OutCount] = FromOffset;
 
-                                const int SubTokenTo = pWbdRes[TagIdx + 2];
-                                const int ToOffset = pOffsets[(pCharMap) ? pNormOffsets [SubTokenTo] : SubTokenTo];
-                                const int ToCharSize = ::FAUtf8Size(pInUtf8Str + ToOffset);
-                                pEndOffsets[OutCount] = ToOffset + (0 < ToCharSize ? ToCharSize - 1 : 0);
-                            }
+//
+// Adds the next id, copies upto MaxOutUtf8StrByteCount bytes of the text into pOutUtf8Str, returns the
+//  number of bytes copied or -1 if the id is unknown, the id is ignored in this case.
+//
+// The bytes which do not fit are kept and returned by the next calls, DecoderPush can be called with
+//  a negative id to get them. The output is not 0-terminated.
+//
+extern "C"
+const int DecoderPush(void* DecoderPtr, const int32_t Id, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount)
+{
+    FADecoderStream * pDecoder = (FADecoderStream *) DecoderPtr;
 
-                            OutCount++;
-                        }
-                    }
-                    subTokensCoveredAll = true;
-                }
-            }
+    if (NULL == pDecoder) {
+        return -1;
+    }
+    if (0 > MaxOutUtf8StrByteCount || (0 < MaxOutUtf8StrByteCount && NULL == pOutUtf8Str)) {
+        return -1;
+    }
 
-            if (false == subTokensCoveredAll) {
-                // output an unk tag
-                if (OutCount < MaxIdsArrLength) {
+    if (0 <= Id && !pDecoder->Push(Id)) {
+        return -1;
+    }
 
-                    pIdsArr[OutCount] = UnkId;
+    return pDecoder->Pop(pOutUtf8Str, MaxOutUtf8StrByteCount, false);
+}
 
-                    // for unknown tokens take offsets from the word
-                    if (fNeedOffsets) {
 
-                        const int FromOffset = pOffsets[(pCharMap) ? pNormOffsets [TokenFrom] : TokenFrom];
-                        pStartOffsets[OutCount] = FromOffset;
+//
+// Ends the sequence, copies upto MaxOutUtf8StrByteCount of the remaining bytes, including an incomplete
+//  UTF-8 sequence at the end, returns the number of bytes copied or -1 in case of an error. The decoder
+//  starts a new sequence once all the bytes have been returned, DecoderFlush can be called again to get
+//  the bytes which did not fit.
+//
+extern "C"
+const int DecoderFlush(void* DecoderPtr, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount)
+{
+    FADecoderStream * pDecoder = (FADecoderStream *) DecoderPtr;
 
-                        const int ToOffset = pOffsets[(pCharMap) ? pNormOffsets [TokenTo] : TokenTo];
-                        const int ToCharSize = ::FAUtf8Size(pInUtf8Str + ToOffset);
-                        pEndOffsets[OutCount] = ToOffset + (0 < ToCharSize ? ToCharSize - 1 : 0);
-                    }
+    if (NULL == pDecoder) {
+        return -1;
+    }
+    if (0 > MaxOutUtf8StrByteCount || (0 < MaxOutUtf8StrByteCount && NULL == pOutUtf8Str)) {
+        return -1;
+    }
 
-                    OutCount++;
-                }
-            }
+    const int Count = pDecoder->Pop(pOutUtf8Str, MaxOutUtf8StrByteCount, true);
 
-            // skip i forward if we looped over any subtokens
-            i = (j - 3);
+    if (pDecoder->m_Text.empty ()) {
+        pDecoder->Reset ();
+    }
+    return Count;
+}
 
-        } // of if (WBD_WORD_TAG == Tag) ...
 
-        if (OutCount >= MaxIdsArrLength) {
-            break;
-        }
+//
+// Frees the decoder created by DecoderBegin
+//
+extern "C"
+int DecoderFree(void* DecoderPtr)
+{
+    if (NULL == DecoderPtr) {
+        return 0;
     }
-
-    return OutCount;
+    delete (FADecoderStream *) DecoderPtr;
+    return 0;
 }
 
 
 //
-// The same as TextToIdsWithOffsets_wp, except does not return offsets
+// Batch version of TextToIds. Tokenizes TextCount strings in parallel using upto ThreadCount 
+// threads of a shared thread pool, if ThreadCount <= 0 then all hardware threads are used.
+//
+// ppInUtf8Strs, pInUtf8StrByteCounts are arrays of TextCount input strings and their lengths
+// pIdsArr is a [TextCount x MaxIdsArrLength] matrix, i-th row receives upto MaxIdsArrLength ids
+//  of the i-th string, the rest of the row is unchanged (so it can be pre-filled for padding)
+// pIdsCounts is an array of TextCount elements, receives number of ids copied into each row
+//
+// Returns TextCount or -1 in case of invalid parameters.
 //
 extern "C"
-const int TextToIds_wp(
+const int TextToIdsBatch(
         void* ModelPtr,
-        const char * pInUtf8Str,
-        int InUtf8StrByteCount,
+        const char ** ppInUtf8Strs,
+        const int * pInUtf8StrByteCounts,
+        const int TextCount,
         int32_t * pIdsArr,
+        int * pIdsCounts,
         const int MaxIdsArrLength,
+        const int ThreadCount,
         const int UnkId = 0
 )
 {
-    return TextToIdsWithOffsets_wp(ModelPtr,pInUtf8Str,InUtf8StrByteCount,pIdsArr,NULL,NULL,MaxIdsArrLength,UnkId);
+    if (0 == ModelPtr || 0 > TextCount || 0 > MaxIdsArrLength) {
+        return -1;
+    }
+    if (0 < TextCount && (NULL == ppInUtf8Strs || NULL == pInUtf8StrByteCounts || NULL == pIdsArr || NULL == pIdsCounts)) {
+        return -1;
+    }
+
+    FAGetThreadPool ().ParallelFor (TextCount, ThreadCount, [&](const int i) {
+        pIdsCounts [i] = TextToIds(ModelPtr, ppInUtf8Strs [i], pInUtf8StrByteCounts [i],
+            pIdsArr + ((size_t) i * MaxIdsArrLength), MaxIdsArrLength, UnkId);
+    });
+
+    return TextCount;
 }
 
 
 //
-// Implements a sentence piece algorithm, returns predictions from FATokenSegmentationTools_1best_t.
-// The input is always prepended with ' ' / '▁' since this seems the case in the sentence piece.
-// Returns upto MaxIdsArrLength ids, the rest of the array is unchanged, so the array can be set to 
-// initial length and fill with 0's for padding. Returns number of ids copied into the array.
+// Batch version of TextToWordsWithModel. Splits TextCount strings into words in parallel using 
+// upto ThreadCount threads of a shared thread pool, if ThreadCount <= 0 then all hardware threads are used.
 //
-// Example:
-// printf "Sergei Alonichau I saw a girl with a \ttelescope." | spm_encode --model=xlnet/spiece.model 
-// ▁Sergei ▁Al oni chau ▁I ▁saw ▁a ▁girl ▁with ▁a ▁telescope .
+// pOutUtf8Str is a [TextCount x MaxOutUtf8StrByteCount] matrix, i-th row receives the output of the i-th string
+// pOutUtf8StrByteCounts receives TextToWordsWithModel return value for each string, if it is bigger than 
+//  MaxOutUtf8StrByteCount then the corresponding row is undefined
 //
-// printf "Sergei Alonichau I saw a girl with a \ttelescope." | spm_encode --model=xlnet/spiece.model --output_format=id
-// 14363 651 7201 25263 35 685 24 1615 33 24 16163 9
+// Returns TextCount or -1 in case of invalid parameters.
 //
-// TextToIds_sp output: 12, [14363 651 7201 25263 35 685 24 1615 33 24 16163 9]
+extern "C"
+const int TextToWordsBatchWithModel(const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts, const int TextCount,
+    char * pOutUtf8Str, int * pOutUtf8StrByteCounts, const int MaxOutUtf8StrByteCount, const int ThreadCount, void * hModel)
+{
+    if (0 > TextCount || 0 > MaxOutUtf8StrByteCount) {
+        return -1;
+    }
+    if (0 < TextCount && (NULL == ppInUtf8Strs || NULL == pInUtf8StrByteCounts || NULL == pOutUtf8Str || NULL == pOutUtf8StrByteCounts)) {
+        return -1;
+    }
+
+    FAGetThreadPool ().ParallelFor (TextCount, ThreadCount, [&](const int i) {
+        pOutUtf8StrByteCounts [i] = TextToWordsWithModel(ppInUtf8Strs [i], pInUtf8StrByteCounts [i],
+            pOutUtf8Str + ((size_t) i * MaxOutUtf8StrByteCount), MaxOutUtf8StrByteCount, hModel);
+    });
+
+    return TextCount;
+}
+
+
+//
+// Batch version of TextToSentencesWithModel, see TextToWordsBatchWithModel for the parameters.
 //
 extern "C"
-const int TextToIdsWithOffsets_sp(
-        void* ModelPtr,
-        const char * pInUtf8Str,
-        int InUtf8StrByteCount,
-        int32_t * pIdsArr,
-        int * pStartOffsets, 
-        int * pEndOffsets,
-        const int MaxIdsArrLength,
-        const int UnkId = 0
-)
+const int TextToSentencesBatchWithModel(const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts, const int TextCount,
+    char * pOutUtf8Str, int * pOutUtf8StrByteCounts, const int MaxOutUtf8StrByteCount, const int ThreadCount, void * hModel)
 {
-    // validate the parameters
-    if (0 >= InUtf8StrByteCount || InUtf8StrByteCount > FALimits::MaxArrSize || NULL == pInUtf8Str || 0 == ModelPtr) {
+    if (0 > TextCount || 0 > MaxOutUtf8StrByteCount) {
+        return -1;
+    }
+    if (0 < TextCount && (NULL == ppInUtf8Strs || NULL == pInUtf8StrByteCounts || NULL == pOutUtf8Str || NULL == pOutUtf8StrByteCounts)) {
+        return -1;
+    }
+
+    FAGetThreadPool ().ParallelFor (TextCount, ThreadCount, [&](const int i) {
+        pOutUtf8StrByteCounts [i] = TextToSentencesWithModel(ppInUtf8Strs [i], pInUtf8StrByteCounts [i],
+            pOutUtf8Str + ((size_t) i * MaxOutUtf8StrByteCount), MaxOutUtf8StrByteCount, hModel);
+    });
+
+    return TextCount;
+}
+
+
+// keeps the language detection model together, the model is immutable and
+// shared by all the threads, the scoring state is kept in the contexts which
+// are borrowed from the pool for the time of a call
+struct FALadModelData
+{
+    // image of the loaded file
+    FAImageDump m_Img;
+    FALadLDB m_Ldb;
+    FALad m_Lad;
+
+    // contexts which are not in use, a steady state call does not allocate memory
+    std::mutex m_Lock;
+    std::vector< FALad::FAContext * > m_FreeContexts;
+
+    ~FALadModelData ()
+    {
+        for (size_t i = 0; i < m_FreeContexts.size (); ++i) {
+            delete m_FreeContexts [i];
+        }
+    }
+
+    // returns a context which is not used by other threads
+    FALad::FAContext * AcquireContext ()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_Lock);
+            if (!m_FreeContexts.empty ()) {
+                FALad::FAContext * pCtx = m_FreeContexts.back ();
+                m_FreeContexts.pop_back ();
+                return pCtx;
+            }
+        }
+        return new FALad::FAContext ();
+    }
+
+    // returns the context back to the pool
+    void ReleaseContext (FALad::FAContext * pCtx)
+    {
+        std::lock_guard<std::mutex> guard(m_Lock);
+        m_FreeContexts.push_back (pCtx);
+    }
+};
+
+// borrows a context of the language detection model for the time of the scope
+class FALadContextGuard
+{
+public:
+    FALadContextGuard (FALadModelData * pModel) :
+        m_pModel (pModel),
+        m_pCtx (pModel->AcquireContext ())
+    {}
+
+    ~FALadContextGuard ()
+    {
+        m_pModel->ReleaseContext (m_pCtx);
+    }
+
+    FALad::FAContext * Get () const
+    {
+        return m_pCtx;
+    }
+
+private:
+    FALadModelData * m_pModel;
+    FALad::FAContext * m_pCtx;
+};
+
+
+//
+// Loads a language detection model and returns a handle, the handle can be used by
+// many threads at the same time. Returns 0 in case of an error.
+//
+extern "C"
+void* LoadLadModel(const char * pszLdbFileName)
+{
+    if (NULL == pszLdbFileName) {
         return 0;
     }
 
-    // allocate buffer for UTF-8 --> UTF-32 conversion
-    std::vector< int > utf32input(InUtf8StrByteCount + 1);
-    int * pBuff = utf32input.data();
-    if (NULL == pBuff) {
+    FALadModelData * pNewModelData = new FALadModelData();
+    if (NULL == pNewModelData) {
         return 0;
     }
-    pBuff[0] = __FASpDelimiter__; // always add a space in the beginning, SP uses U+2581 as a space mark
 
-    // a container for the offsets
-    std::vector< int > utf32offsets;
-    int * pOffsets = NULL;
+    // load the bin file
+    pNewModelData->m_Img.Load (pszLdbFileName);
+    const unsigned char * pImgBytes = pNewModelData->m_Img.GetImageDump ();
+    if (NULL == pImgBytes) {
+        delete pNewModelData;
+        return 0;
+    }
 
-    // flag to alter the logic in case we don't need the offsets
-    const bool fNeedOffsets = NULL != pStartOffsets && NULL != pEndOffsets;
+    pNewModelData->m_Ldb.SetImage (pImgBytes);
 
-    if (fNeedOffsets) {
-        utf32offsets.resize(InUtf8StrByteCount + 1);
-        pOffsets = utf32offsets.data();
-        if (NULL == pOffsets) {
-            return 0;
-        }
-        pOffsets[0] = -1; // an offset of the appended space (it is not a part of the input)
+    // see if the LDB has the language detection data
+    if (NULL == pNewModelData->m_Ldb.GetLadConf ()) {
+        delete pNewModelData;
+        return 0;
     }
 
-    // get the model data
-    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
-    const FADictConfKeeper * pConf = &(pModelData->m_DictConf);
-    const FAMultiMapCA * pCharMap = pConf->GetCharMap ();
+    pNewModelData->m_Lad.Initialize (&(pNewModelData->m_Ldb));
 
-    // see if we need to get a summy space added
-    const int BUFF_DATA_OFFSET = pConf->GetNoDummyPrefix() ? 0 : 1;
+    return pNewModelData;
+}
 
-    // convert input to UTF-32 or bytes (write output past the added first space)
-    int BuffSize;
-    if(false == pModelData->m_useRawBytes) {
-        BuffSize = fNeedOffsets ? 
-            ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff + BUFF_DATA_OFFSET, pOffsets + BUFF_DATA_OFFSET, InUtf8StrByteCount) :
-            ::FAStrUtf8ToArray(pInUtf8Str, InUtf8StrByteCount, pBuff + BUFF_DATA_OFFSET, InUtf8StrByteCount);
-    } else {
-        BuffSize = fNeedOffsets ? 
-            ::FAStrUtf8AsBytesToArray(pInUtf8Str, InUtf8StrByteCount, pBuff + BUFF_DATA_OFFSET, pOffsets + BUFF_DATA_OFFSET, InUtf8StrByteCount) :
-            ::FAStrUtf8AsBytesToArray(pInUtf8Str, InUtf8StrByteCount, pBuff + BUFF_DATA_OFFSET, InUtf8StrByteCount);
+
+//
+// Frees memory from the language detection model, after this call ModelPtr is no longer valid
+//
+extern "C"
+int FreeLadModel(void* ModelPtr)
+{
+    if (NULL == ModelPtr) {
+        return 0;
     }
-    if (BuffSize <= 0 || BuffSize > InUtf8StrByteCount) {
+
+    delete (FALadModelData*) ModelPtr;
+    return 1;
+}
+
+
+//
+// Detects the language of the UTF-8 text. Returns upto MaxCount languages (integer tags
+// of the model) with their scores, the best language goes first and the other languages
+// of the same script follow in the order of their scores. The scores are not defined if
+// the script of the text has only one language.
+//
+// Returns the number of languages copied, 0 if the language is unknown or -1 in case of
+// invalid parameters or an error.
+//
+extern "C"
+const int DetectLanguage(void* ModelPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pLangs, float * pScores, const int MaxCount)
+{
+    if (NULL == ModelPtr || 0 > InUtf8StrByteCount || 0 >= MaxCount || NULL == pLangs || NULL == pScores) {
+        return -1;
+    }
+    if (0 == InUtf8StrByteCount) {
         return 0;
     }
-    BuffSize += BUFF_DATA_OFFSET; // to accomodate the first space
+    if (NULL == pInUtf8Str) {
+        return -1;
+    }
 
-    // needed for normalization
-    std::vector< int > utf32input_norm;
-    int * pNormBuff = NULL;
-    std::vector< int > utf32norm_offsets;
-    int * pNormOffsets = NULL;
+    FALadModelData * pModel = (FALadModelData*) ModelPtr;
 
-    // do normalization, if needed
-    if (NULL != pCharMap) {
+    try {
 
-        const int MaxNormBuffSize = (InUtf8StrByteCount + 1) * 2;
-        utf32input_norm.resize(MaxNormBuffSize);
-        pNormBuff = utf32input_norm.data();
-        if (NULL == pNormBuff) {
-            return 0;
-        }
-        if (fNeedOffsets) {
-            utf32norm_offsets.resize(MaxNormBuffSize);
-            pNormOffsets = utf32norm_offsets.data();
-            if (NULL == pNormOffsets) {
-                return 0;
-            }
-        }
+        FALadContextGuard Ctx (pModel);
+        return pModel->m_Lad.GetLanguages (Ctx.Get (), pInUtf8Str, InUtf8StrByteCount, pLangs, pScores, MaxCount);
 
-        // do the normalization for the entire input
-        const int ActualNormBuffSize = fNeedOffsets ? 
-            ::FANormalize(pBuff, BuffSize, pNormBuff, pNormOffsets, MaxNormBuffSize, pCharMap) :
-            ::FANormalize(pBuff, BuffSize, pNormBuff, MaxNormBuffSize, pCharMap);
+    } catch (...) {
 
-        if (ActualNormBuffSize <= 0 || ActualNormBuffSize > MaxNormBuffSize) {
-            pCharMap = NULL;
-            // don't proceed without normalization, TODO: 99% times it does not change anything... so it is ok to proceed
-            return 0;
-        } else {
-            BuffSize = ActualNormBuffSize;
-            pBuff = pNormBuff;
-        }
+        return -1;
     }
+}
 
-    // Replace every space sequence with U+2581 in-place
-    //
-    // Note: This operation affect offsets. Since the output sequence is always the 
-    //       same length or shorter we can update the offsets in-place.
-    //       If normalization is enbled the offsets are computed as a superposition of
-    //       normalization and utf-32 offsets, then transformation should be applied to 
-    //       normalization offsets, otherwise to utf-32 offsets.
-    //
-    int * pAdjustedOffsets = fNeedOffsets ? (NULL != pCharMap ? pNormOffsets : pOffsets) : NULL;
-
-    int i = 0; // index for reading
-    int j = 0; // index for writing
-    while (i < BuffSize) {
 
-        const int Ci = pBuff[i];
+//
+// Batch version of DetectLanguage. Detects languages of TextCount strings in parallel using
+// upto ThreadCount threads of a shared thread pool, if ThreadCount <= 0 then all hardware
+// threads are used.
+//
+// pLangs, pScores are [TextCount x MaxCount] matrices, i-th row receives the languages
+//  and the scores of the i-th string
+// pCounts is an array of TextCount elements, receives DetectLanguage return value for
+//  each string
+//
+// Returns TextCount or -1 in case of invalid parameters.
+//
+extern "C"
+const int DetectLanguageBatch(void* ModelPtr, const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts,
+    const int TextCount, int * pLangs, float * pScores, int * pCounts, const int MaxCount, const int ThreadCount)
+{
+    if (NULL == ModelPtr || 0 > TextCount || 0 >= MaxCount) {
+        return -1;
+    }
+    if (0 < TextCount && (NULL == ppInUtf8Strs || NULL == pInUtf8StrByteCounts || NULL == pLangs || NULL == pScores || NULL == pCounts)) {
+        return -1;
+    }
 
-        // check if the Ci is not a space
-        if (!__FAIsWhiteSpace__(Ci)) {
-            // copy it
-            pBuff[j] = Ci;
-            if (fNeedOffsets) {
-                pAdjustedOffsets[j] = pAdjustedOffsets[i];
-            }
-            j++;
-        // if Ci is a space, check if the previous character was not a space
-        } else if (0 == j || __FASpDelimiter__ != pBuff[j - 1]) {
-            // copy normalized space
-            pBuff[j] = __FASpDelimiter__;
-            if (fNeedOffsets) {
-                pAdjustedOffsets[j] = pAdjustedOffsets[i];
-            }
-            j++;
-        }
+    try {
 
-        i++;
+        // DetectLanguage does not throw, an error of a string is its -1 in pCounts
+        FAGetThreadPool ().ParallelFor (TextCount, ThreadCount, [&](const int i) {
+            pCounts [i] = DetectLanguage(ModelPtr, ppInUtf8Strs [i], pInUtf8StrByteCounts [i],
+                pLangs + ((size_t) i * MaxCount), pScores + ((size_t) i * MaxCount), MaxCount);
+        });
 
-    } // of while ...
+    } catch (...) {
 
-    // trim the final space if there was no content characters after
-    if (1 < j && pBuff[j - 1] == __FASpDelimiter__) {
-        j--;
+        return -1;
     }
 
-    // adjust the length
-    BuffSize = j;
+    return TextCount;
+}
+
+
+// the memory of the base forms cache of a stemmer model
+const size_t STEMMER_CACHE_SIZE = 4 * 1024 * 1024;
+
+//
+// Keeps a stemmer model, see LoadStemmerModel
+//
+struct FAStemmerModelData
+{
+    // image of the loaded file
+    FAImageDump m_Img;
+    FAStemmerLDB m_Ldb;
+    // the stemmer allocates its temporary memory with it, can be used by many threads
+    FAAllocator m_Alloc;
+    FAStemmerConst_t< int > m_Stemmer;
+    // base forms of the frequent words
+    mutable FAWordCache m_WordCache;
+};
 
-    // do the segmentation
-    const int WbdResMaxSize = BuffSize * 3;
-    std::vector< int > WbdResults(WbdResMaxSize);
-    int * pWbdResults = WbdResults.data ();
 
-    // tokenize input with a selected algorithm
-    const int WbdOutSize = pModelData->m_pAlgo->Process (pBuff, BuffSize, pWbdResults, WbdResMaxSize, UnkId);
-    if (WbdOutSize > WbdResMaxSize || 0 != WbdOutSize % 3) {
+//
+// Loads a stemmer model and returns a handle, the handle can be used by many threads at
+// the same time. Returns 0 in case of an error or if the model does not have the word to
+// base form (w2b) data.
+//
+extern "C"
+void* LoadStemmerModel(const char * pszLdbFileName)
+{
+    if (NULL == pszLdbFileName) {
         return 0;
     }
 
-    int OutSize = 0;
-    int IdOffset = pConf->GetIdOffset (); // see if we need to shift output IDs by a constant
-    // return the ids only
-    for (int i = 0; i < WbdOutSize && OutSize < MaxIdsArrLength; i += 3) {
-
-        // copy id
-        const int id = pWbdResults [i];
-        pIdsArr [OutSize] = id + IdOffset;
-
-        // copy offsets if needed
-        if (fNeedOffsets) {
+    FAStemmerModelData * pNewModelData = new FAStemmerModelData();
+    if (NULL == pNewModelData) {
+        return 0;
+    }
 
-            const int TokenFrom = pWbdResults [i + 1];
-            const int FromOffset = pOffsets[(pCharMap) ? pNormOffsets [TokenFrom] : TokenFrom];
-            pStartOffsets[OutSize] = FromOffset;
+    // load the bin file
+    pNewModelData->m_Img.Load (pszLdbFileName);
+    const unsigned char * pImgBytes = pNewModelData->m_Img.GetImageDump ();
+    if (NULL == pImgBytes) {
+        delete pNewModelData;
+        return 0;
+    }
 
-            const int TokenTo = pWbdResults [i + 2];
-            const int ToOffset = pOffsets[(pCharMap) ? pNormOffsets [TokenTo] : TokenTo];
-            const int ToCharSize = ::FAUtf8Size(pInUtf8Str + ToOffset);
-            pEndOffsets[OutSize] = ToOffset + (0 < ToCharSize ? ToCharSize - 1 : 0);
-        }
+    pNewModelData->m_Ldb.SetImage (pImgBytes);
 
-        OutSize++;
+    // see if the LDB has the stemmer data
+    if (NULL == pNewModelData->m_Ldb.GetW2BConf ()) {
+        delete pNewModelData;
+        return 0;
     }
 
-    return OutSize;
+    pNewModelData->m_Stemmer.Initialize (&(pNewModelData->m_Ldb), &(pNewModelData->m_Alloc));
+    pNewModelData->m_WordCache.Create (STEMMER_CACHE_SIZE);
+
+    return pNewModelData;
 }
 
 
 //
-// The same as TextToIdsWithOffsets_sp, except does not return offsets
+// Frees memory from the stemmer model, after this call ModelPtr is no longer valid
 //
 extern "C"
-const int TextToIds_sp(
-        void* ModelPtr,
-        const char * pInUtf8Str,
-        int InUtf8StrByteCount,
-        int32_t * pIdsArr,
-        const int MaxIdsArrLength,
-        const int UnkId = 0
-)
+int FreeStemmerModel(void* ModelPtr)
 {
-    return TextToIdsWithOffsets_sp(ModelPtr,pInUtf8Str,InUtf8StrByteCount,pIdsArr,NULL,NULL,MaxIdsArrLength,UnkId);
+    if (NULL == ModelPtr) {
+        return 0;
+    }
+
+    delete (FAStemmerModelData*) ModelPtr;
+    return 1;
 }
 
 
 //
-// Implements a word-piece or sentence piece algorithms which is defined by the loaded model. 
-// Returns ids of words or sub-words, returns upto MaxIdsArrLength ids, the rest of the array 
-// is unchanged, so the array can be set to initial length and fill with 0's for padding.
-// Returns number of ids copied into the array.
+// Returns the number of base forms of the words found in the cache of the stemmer model
+// and the number of the words stemmed, returns 0 if ModelPtr is NULL.
 //
-
 extern "C"
-const int TextToIdsWithOffsets(
-        void* ModelPtr,
-        const char * pInUtf8Str,
-        int InUtf8StrByteCount,
-        int32_t * pIdsArr,
-        int * pStartOffsets, 
-        int * pEndOffsets,
-        const int MaxIdsArrLength,
-        const int UnkId = 0
-)
+int GetStemmerCacheStats(void* ModelPtr, int64_t * pHitCount, int64_t * pMissCount)
 {
-    if (0 == ModelPtr) {
+    if (NULL == ModelPtr) {
         return 0;
     }
 
-    // check if loaded model has segmentation data
-    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+    const FAStemmerModelData * pModel = (const FAStemmerModelData*) ModelPtr;
 
-    if (!pModelData->m_hasSeg)
-    {
-        // call word-piece algorithm
-        return TextToIdsWithOffsets_wp(
-                ModelPtr, 
-                pInUtf8Str, 
-                InUtf8StrByteCount, 
-                pIdsArr, 
-                pStartOffsets, 
-                pEndOffsets, 
-                MaxIdsArrLength, 
-                UnkId
-            );
+    long long HitCount = 0;
+    long long MissCount = 0;
+    pModel->m_WordCache.GetCounts(&HitCount, &MissCount);
+
+    if (pHitCount) {
+        *pHitCount = HitCount;
     }
-    else
-    {
-        // call sentence-piece algorithm
-        return TextToIdsWithOffsets_sp(
-                ModelPtr, 
-                pInUtf8Str, 
-                InUtf8StrByteCount, 
-                pIdsArr, 
-                pStartOffsets, 
-                pEndOffsets, 
-                MaxIdsArrLength, 
-                UnkId
-            );
+    if (pMissCount) {
+        *pMissCount = MissCount;
     }
+    return 1;
 }
 
 
 //
-// Implements a word-piece or sentence piece algorithms which is defined by the loaded model. 
-// Returns ids of words or sub-words, returns upto MaxIdsArrLength ids, the rest of the array 
-// is unchanged, so the array can be set to initial length and fill with 0's for padding.
-// Returns number of ids copied into the array.
+// Writes the base forms of the words delimited with ' ' and terminated with 0, the words
+// unknown to the stemmer are written as is. Occurrences of ' ' and 0 inside of the words are
+// replaced with '_'. The output is written only while it fits into MaxOutUtf8StrByteCount
+// bytes, the returned size does not depend on it.
 //
-
-extern "C"
-const int TextToIds(
-        void* ModelPtr,
-        const char * pInUtf8Str,
-        int InUtf8StrByteCount,
-        int32_t * pIdsArr,
-        const int MaxIdsArrLength,
-        const int UnkId = 0
-)
+class FABaseFormWriter
 {
-    if (0 == ModelPtr) {
-        return 0;
+public:
+    FABaseFormWriter(const FAStemmerModelData * pModel, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount) :
+        m_pModel(pModel),
+        m_pOut(pOutUtf8Str),
+        m_MaxOutSize(NULL != pOutUtf8Str ? MaxOutUtf8StrByteCount : 0),
+        m_OutSize(0),
+        m_WordCount(0),
+        m_HitCount(0),
+        m_MissCount(0)
+    {}
+
+    ~FABaseFormWriter()
+    {
+        m_pModel->m_WordCache.AddCounts(m_HitCount, m_MissCount);
     }
 
-    // check if loaded model has segmentation data
-    const FAModelData * pModelData = (const FAModelData *)ModelPtr;
+public:
+    // adds the base form of the word, pWord is the word in UTF-32 and pWordUtf8 is the same word in UTF-8
+    void AddWord(const int * pWord, const int WordLen, const char * pWordUtf8, const int WordUtf8Len)
+    {
+        int Base [FALimits::MaxWordLen];
+        const int BaseLen = GetBaseForm(pWord, WordLen, Base);
 
-    if (!pModelData->m_hasSeg)
+        char BaseUtf8 [FALimits::MaxWordLen * FAUtf8Const::MAX_CHAR_SIZE];
+        const int BaseUtf8Len = 0 < BaseLen ?
+            ::FAArrayToStrUtf8(Base, BaseLen, BaseUtf8, FALimits::MaxWordLen * FAUtf8Const::MAX_CHAR_SIZE) : -1;
+
+        if (0 < BaseUtf8Len) {
+            Write(BaseUtf8, BaseUtf8Len);
+        } else {
+            Write(pWordUtf8, WordUtf8Len);
+        }
+    }
+
+    // returns the size of the output, including the terminating 0
+    const int Finish()
     {
-        // call word-piece algorithm
-        return TextToIdsWithOffsets_wp(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr, NULL, NULL, MaxIdsArrLength, UnkId);
+        const int OutSize = m_OutSize + 1;
+        if (OutSize <= m_MaxOutSize) {
+            m_pOut[m_OutSize] = 0;
+        }
+        return OutSize;
     }
-    else
+
+private:
+    // copies the first base form of the word into pBase, returns its length or -1 if the word is unknown
+    const int GetBaseForm(const int * pWord, const int WordLen, int * pBase)
     {
-        // call sentence-piece algorithm
-        return TextToIdsWithOffsets_sp(ModelPtr, pInUtf8Str, InUtf8StrByteCount, pIdsArr, NULL, NULL, MaxIdsArrLength, UnkId);
+        if (0 >= WordLen || FALimits::MaxWordLen < WordLen) {
+            return -1;
+        }
+
+        // see if the word is in the cache, the characters of the base form are kept as token ids
+        int CacheRes [3 * FAWordCache::MaxWordLength];
+        const int CacheResSize = m_pModel->m_WordCache.Get(pWord, WordLen, 0, CacheRes, 3 * FAWordCache::MaxWordLength);
+
+        if (0 <= CacheResSize) {
+            m_HitCount++;
+            for (int i = 0; i < CacheResSize; i += 3) {
+                pBase[i / 3] = CacheRes[i];
+            }
+            return 0 < CacheResSize ? CacheResSize / 3 : -1;
+        }
+        m_MissCount++;
+
+        // the base forms are delimited with 0, only the first one is used
+        int StemRes [2 * FALimits::MaxWordLen];
+        int * pStemRes = StemRes;
+        int StemResSize = m_pModel->m_Stemmer.ProcessW2B(pWord, WordLen, StemRes, 2 * FALimits::MaxWordLen);
+
+        // the base forms do not fit, get them into a buffer of the returned size
+        std::vector< int > StemBuff;
+        if (2 * FALimits::MaxWordLen < StemResSize) {
+            StemBuff.resize(StemResSize);
+            pStemRes = StemBuff.data();
+            StemResSize = m_pModel->m_Stemmer.ProcessW2B(pWord, WordLen, pStemRes, StemResSize);
+            if ((int) StemBuff.size() < StemResSize) {
+                return -1;
+            }
+        }
+
+        int BaseLen = -1;
+        if (0 < StemResSize) {
+            BaseLen = 0;
+            while (BaseLen < StemResSize && 0 != pStemRes[BaseLen]) {
+                BaseLen++;
+            }
+            if (0 == BaseLen || FALimits::MaxWordLen < BaseLen) {
+                BaseLen = -1;
+            } else {
+                memcpy(pBase, pStemRes, BaseLen * sizeof(int));
+            }
+        }
+
+        // the unknown words are kept with no characters
+        if (BaseLen <= FAWordCache::MaxWordLength) {
+            const int ResSize = 0 < BaseLen ? BaseLen * 3 : 0;
+            for (int i = 0; i < ResSize; i += 3) {
+                CacheRes[i] = pBase[i / 3];
+                CacheRes[i + 1] = 0;
+                CacheRes[i + 2] = 0;
+            }
+            m_pModel->m_WordCache.Put(pWord, WordLen, 0, CacheRes, ResSize);
+        }
+
+        return BaseLen;
     }
-}
 
+    // writes the word preceded by the delimiter, if fits
+    void Write(const char * pWordUtf8, const int WordUtf8Len)
+    {
+        const int Delim = 0 < m_WordCount++ ? 1 : 0;
+
+        if (m_OutSize + Delim + WordUtf8Len <= m_MaxOutSize) {
 
-//
-// Frees memory from the model, after this call ModelPtr is no longer valid
-//  Double calls to this function with the same argument will case access violation
-//
-extern "C"
-int FreeModel(void* ModelPtr)
-{
-    if (NULL == ModelPtr) {
-        return 0;
+            char * pOut = m_pOut + m_OutSize;
+            if (Delim) {
+                *pOut++ = ' ';
+            }
+            memcpy(pOut, pWordUtf8, WordUtf8Len);
+
+            for (int j = 0; j < WordUtf8Len; ++j) {
+                const char C = pOut[j];
+                if (' ' == C || 0 == C) {
+                    pOut[j] = '_';
+                }
+            }
+        }
+        m_OutSize += Delim + WordUtf8Len;
     }
 
-    delete (FAModelData*) ModelPtr;
-    return 1;
-}
+private:
+    const FAStemmerModelData * m_pModel;
+    char * m_pOut;
+    const int m_MaxOutSize;
+    int m_OutSize;
+    int m_WordCount;
+    int m_HitCount;
+    int m_MissCount;
+};
 
 
 //
-// Allows to change the "no-dummy-prefix" (NoDummyPrefix) without the recompilation of the models
-// Note: it is the best to use the mode the same way it was trained / compiled leave this value to what it was set via ldb.conf.small file
+// Returns the base forms of the words of a tokenized text, e.g. by TextToWordsWithOffsets.
+//
+// pStartOffsets is an array of WordCount integers, the first byte of each word
+// pEndOffsets is an array of WordCount integers, the last byte of each word
+//
+// The output is a ' ' delimited string of WordCount base forms in the order of the words, if a
+// word has more than one base form then the first one is used and if the word is unknown to the
+// stemmer then it is copied as is. Returns the size of the output in bytes, the output is written
+// only if the return value <= MaxOutUtf8StrByteCount, returns -1 in case of an error (e.g. invalid
+// offsets or a word which is not a valid UTF-8).
+//
+// The base forms of the frequent words are kept in a cache of the model, so this function can
+// be called by many threads at the same time with the same model.
 //
 extern "C"
-int SetNoDummyPrefix(void* ModelPtr, bool fNoDummyPrefix)
+const int WordsToBaseForms(void* ModelPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    const int * pStartOffsets, const int * pEndOffsets, const int WordCount,
+    char * pOutUtf8Str, const int MaxOutUtf8StrByteCount)
 {
-    if (NULL == ModelPtr) {
-        return 0;
+    if (NULL == ModelPtr || 0 > InUtf8StrByteCount || 0 > WordCount || 0 > MaxOutUtf8StrByteCount) {
+        return -1;
+    }
+    if (0 < WordCount && (NULL == pInUtf8Str || NULL == pStartOffsets || NULL == pEndOffsets)) {
+        return -1;
     }
 
-    FAModelData* pModel = (FAModelData*) ModelPtr;
-    pModel->m_DictConf.SetNoDummyPrefix(fNoDummyPrefix);
-    return 1;
+    FABaseFormWriter Writer((const FAStemmerModelData*) ModelPtr, pOutUtf8Str, MaxOutUtf8StrByteCount);
+
+    // one more character to see if the word is too long
+    int Word [FALimits::MaxWordLen + 1];
+
+    for (int i = 0; i < WordCount; ++i) {
+
+        const int From = pStartOffsets[i];
+        const int To = pEndOffsets[i];
+        if (0 > From || From > To || To >= InUtf8StrByteCount) {
+            return -1;
+        }
+
+        const int WordUtf8Len = To - From + 1;
+        const int WordLen = ::FAStrUtf8ToArray(pInUtf8Str + From, WordUtf8Len, Word, FALimits::MaxWordLen + 1);
+        if (0 > WordLen) {
+            return -1;
+        }
+
+        Writer.AddWord(Word, WordLen, pInUtf8Str + From, WordUtf8Len);
+    }
+
+    return Writer.Finish();
 }
 
 
 //
-// Returns text string given a sequence of Ids
-//  Note: the model file should contain [i2w] configuration or separate *.i2w model file should be used
-// 
-// return value is the actual string length
-// if the actual string length is more than MaxOutUtf8StrByteCount then pOutUtf8Str content is undefined
-// 
+// The same as TextToWordsWithOffsetsWithModel, but returns the base forms of the words instead
+//  of the words, see WordsToBaseForms. The offsets are of the words in the input text.
+//
+// The base forms are computed from the UTF-32 characters of the tokenizer, so the text is
+//  decoded only once.
+//
+// The hModel parameter allows to use a custom word breaking model loaded with LoadModel API,
+//  if NULL then the built in is used. The hStemmer is a model loaded with LoadStemmerModel.
+//
 extern "C"
-int IdsToText (void* ModelPtr, const int32_t * pIdsArr, const int IdsCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, bool SkipSpecialTokens)
+const int TextToWordsWithBaseForms(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, void * hStemmer)
 {
-    if (NULL == ModelPtr) {
-        return 0;
+    if (NULL == hStemmer || 0 > MaxOutUtf8StrByteCount) {
+        return -1;
     }
-    if (0 == IdsCount || NULL == pIdsArr) {
-        return 0;
+
+    // make sure there are no uninitialized offsets
+    if (0 < InUtf8StrByteCount && InUtf8StrByteCount <= FALimits::MaxArrSize && NULL != pInUtf8Str) {
+        if (pStartOffsets) {
+            memset(pStartOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
+        }
+        if (pEndOffsets) {
+            memset(pEndOffsets, 0, MaxOutUtf8StrByteCount * sizeof(int));
+        }
     }
 
-    const FAModelData* pModel = (FAModelData*) ModelPtr;
-    if (!pModel->m_hasI2w) {
-        return 0;
+    FATokWorkspace * pWs = FAGetThreadWorkspace();
+
+    const int * pSpans = NULL;
+    const int WordCount = FAGetWordSpans(pInUtf8Str, InUtf8StrByteCount, hModel, pWs, &pSpans);
+    // an error or an empty input
+    if (0 > WordCount || 0 == InUtf8StrByteCount) {
+        pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+        return WordCount;
     }
 
-    int ActualLength = 0;
+    // UTF-32 characters of the text and their offsets, as decoded by FAGetWordSpans
+    const int * pChars = pWs->m_Utf32.data();
+    const int * pCharOffsets = pWs->m_Offsets.data();
 
-    for (int i = 0; i < IdsCount; ++i) {
+    FABaseFormWriter Writer((const FAStemmerModelData*) hStemmer, pOutUtf8Str, MaxOutUtf8StrByteCount);
 
-        // get the next id
-        const int id = pIdsArr [i];
+    // the words go in the order of the text, so the first character of each word is found in one pass
+    int CharPos = 0;
 
-        // skip special tokens, if needed
-        if (SkipSpecialTokens && (id < pModel->m_min_token_id || id > pModel->m_max_token_id)) {
-            continue;
-        }
+    for (int i = 0; i < WordCount; ++i) {
 
-        // get token text
-        const unsigned char * pToken = NULL;
-        int TokenLength = pModel->m_i2w.GetAt (id, &pToken);
-        if (0 > TokenLength) {
-            return 0; // unknon id
-        }
+        const int From = pSpans[i * 2];
+        const int To = pSpans[(i * 2) + 1];
 
-        // don't output space in the leading position
-        if (0 == ActualLength && 0 < TokenLength && 0x20 == pToken[0]) {
-            pToken++;
-            TokenLength--;
+        if (pStartOffsets && i < MaxOutUtf8StrByteCount) {
+            pStartOffsets[i] = From;
+        }
+        if (pEndOffsets && i < MaxOutUtf8StrByteCount) {
+            pEndOffsets[i] = To;
         }
 
-        // copy token text into the output buffer
-        if (0 < TokenLength && MaxOutUtf8StrByteCount - ActualLength >= TokenLength) {
-            memcpy(pOutUtf8Str + ActualLength, pToken, TokenLength);
+        while (pCharOffsets[CharPos] < From) {
+            CharPos++;
         }
 
-        ActualLength += TokenLength;
-    }
+        // count the characters of the word
+        int WordLen = 0;
+        for (int j = From; j <= To; ++WordLen) {
+            const int CharSize = ::FAUtf8Size(pInUtf8Str + j);
+            j += 0 < CharSize ? CharSize : 1;
+        }
 
-    // add a terminating 0 for some interpreters
-    if (MaxOutUtf8StrByteCount > ActualLength) {
-        pOutUtf8Str [ActualLength] = 0;
+        Writer.AddWord(pChars + CharPos, WordLen, pInUtf8Str + From, To - From + 1);
     }
-    ActualLength++;
 
-    // return the actual length of the output (the minimum length needed to keep entire output)
-    return ActualLength;
+    pWs->Trim(MAX_THREAD_WORKSPACE_SIZE);
+    return Writer.Finish();
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <sstream>
 #include <mutex>
+#include <atomic>
 #include <assert.h>
 
 namespace BlingFire 
@@ -38,12 +39,29 @@ const int TextToWordsWithOffsets(const char * pInUtf8Str, int InUtf8StrByteCount
 const int TextToWordsWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
     char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, void * hModel);
 const int TextToWords(const char * pInUtf8Str, int InUtf8StrByteCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount);
+const int TextToWordSpansWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel);
+const int TextToSentenceSpansWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel);
+const int TextToWordsWithOffsetsParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, const int ThreadCount);
+const int TextToSentencesWithOffsetsParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, const int ThreadCount);
+const int TextToWordSpansParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel, const int ThreadCount);
+const int TextToSentenceSpansParallel(const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pStartOffsets, int * pEndOffsets, const int MaxSpanCount, void * hModel, const int ThreadCount);
 const int NormalizeSpaces(const char * pInUtf8Str, int InUtf8StrByteCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, const int uSpace = __FASpDelimiter__);
 const int TextToHashes(const char * pInUtf8Str, int InUtf8StrByteCount, int32_t * pHashArr, const int MaxHashArrLength, int wordNgrams, int bucketSize = 2000000);
+const int TextToHashesWithModel(const char * pInUtf8Str, int InUtf8StrByteCount, int32_t * pHashArr, const int MaxHashArrLength,
+    int wordNgrams, int bucketSize, void * hModel);
 const int WordHyphenationWithModel(const char * pInUtf8Str, int InUtf8StrByteCount,
     char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, void * hModel, const int uHy = __FADefaultHyphen__);
 void* SetModel(const unsigned char * pImgBytes, int ModelByteCount);
 void* LoadModel(const char * pszLdbFileName);
+void* LoadModelMapped(const char * pszLdbFileName, bool fPrefetch);
 const int TextToIdsWithOffsets_wp(
         void* ModelPtr,
         const char * pInUtf8Str,
@@ -100,6 +118,99 @@ const int TextToIds(
 );
 int FreeModel(void* ModelPtr);
 int SetNoDummyPrefix(void* ModelPtr, bool fNoDummyPrefix);
+int SetDenseDfa(void* ModelPtr, int MaxMemoryBytes);
+int SetTokAlgo(void* ModelPtr, int TokAlgo);
+int SetWordCache(void* ModelPtr, int MaxMemoryBytes);
+int ClearWordCache(void* ModelPtr);
+int GetWordCacheStats(void* ModelPtr, int64_t * pHitCount, int64_t * pMissCount);
 int IdsToText (void* ModelPtr, const int32_t * pIdsArr, const int IdsCount, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount, bool SkipSpecialTokens);
+const int IdsToTextBatch(void* ModelPtr, const int32_t * pIdsArr, const int * pIdsCounts, const int SeqCount,
+    char * pOutUtf8Str, int * pOutSizes, const int MaxOutUtf8StrByteCount, bool SkipSpecialTokens, const int ThreadCount);
+int TokenToId(void* ModelPtr, const char * pInUtf8Str, int InUtf8StrByteCount);
+const int TokensToIds(void* ModelPtr, const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts,
+    const int TokenCount, int32_t * pIdsArr, const int UnkId);
+void* DecoderBegin(void* ModelPtr, bool SkipSpecialTokens);
+const int DecoderPush(void* DecoderPtr, const int32_t Id, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount);
+const int DecoderFlush(void* DecoderPtr, char * pOutUtf8Str, const int MaxOutUtf8StrByteCount);
+int DecoderFree(void* DecoderPtr);
+const int TextToIdsBatch(
+        void* ModelPtr,
+        const char ** ppInUtf8Strs,
+        const int * pInUtf8StrByteCounts,
+        const int TextCount,
+        int32_t * pIdsArr,
+        int * pIdsCounts,
+        const int MaxIdsArrLength,
+        const int ThreadCount,
+        const int UnkId = 0
+);
+const int TextToWordsBatchWithModel(const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts, const int TextCount,
+    char * pOutUtf8Str, int * pOutUtf8StrByteCounts, const int MaxOutUtf8StrByteCount, const int ThreadCount, void * hModel);
+const int TextToSentencesBatchWithModel(const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts, const int TextCount,
+    char * pOutUtf8Str, int * pOutUtf8StrByteCounts, const int MaxOutUtf8StrByteCount, const int ThreadCount, void * hModel);
+void* CreateTokenizerWorkspace();
+int FreeTokenizerWorkspace(void* WorkspacePtr);
+const int TextToIdsWithOffsetsWithWorkspace(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        int * pStartOffsets,
+        int * pEndOffsets,
+        const int MaxIdsArrLength,
+        const int UnkId,
+        void* WorkspacePtr
+);
+const int TextToIdsWithWorkspace(
+        void* ModelPtr,
+        const char * pInUtf8Str,
+        int InUtf8StrByteCount,
+        int32_t * pIdsArr,
+        const int MaxIdsArrLength,
+        const int UnkId,
+        void* WorkspacePtr
+);
+const int TextToWordsWithOffsetsWithWorkspace(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, void* WorkspacePtr);
+const int TextToSentencesWithOffsetsWithWorkspace(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, void* WorkspacePtr);
+void* LoadLadModel(const char * pszLdbFileName);
+int FreeLadModel(void* ModelPtr);
+const int DetectLanguage(void* ModelPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    int * pLangs, float * pScores, const int MaxCount);
+const int DetectLanguageBatch(void* ModelPtr, const char ** ppInUtf8Strs, const int * pInUtf8StrByteCounts,
+    const int TextCount, int * pLangs, float * pScores, int * pCounts, const int MaxCount, const int ThreadCount);
+void* LoadModelShared(const char * pszLdbFileName);
+int GetSharedDumpStats(int64_t * pDumpCount, int64_t * pByteCount);
+int GetModelStats(void* ModelPtr, int64_t * pStats, const int MaxCount);
+int ResetModelStats(void* ModelPtr);
+const int GetModelStatsNames(char * pOutUtf8Str, const int MaxOutUtf8StrByteCount);
+void* CreateModelSlot(const char * pszLdbFileName);
+int SwapModelSlot(void* SlotPtr, const char * pszLdbFileName);
+void* AcquireModel(void* SlotPtr);
+int FreeModelSlot(void* SlotPtr);
+void* SbdBegin(void * hModel);
+const int SbdFeed(void* StreamPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxSpanCount);
+const int SbdFlush(void* StreamPtr, int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxSpanCount);
+int SbdFree(void* StreamPtr);
+void* WbdBegin(void * hModel);
+void* WbdBeginIds(void * hModel, const int UnkId);
+const int WbdFeed(void* StreamPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    int32_t * pTags, int64_t * pStartOffsets, int64_t * pEndOffsets, const int MaxTokenCount);
+const int WbdFlush(void* StreamPtr, int32_t * pTags, int64_t * pStartOffsets, int64_t * pEndOffsets,
+    const int MaxTokenCount);
+int WbdFree(void* StreamPtr);
+void* LoadStemmerModel(const char * pszLdbFileName);
+int FreeStemmerModel(void* ModelPtr);
+int GetStemmerCacheStats(void* ModelPtr, int64_t * pHitCount, int64_t * pMissCount);
+const int WordsToBaseForms(void* ModelPtr, const char * pInUtf8Str, int InUtf8StrByteCount,
+    const int * pStartOffsets, const int * pEndOffsets, const int WordCount,
+    char * pOutUtf8Str, const int MaxOutUtf8StrByteCount);
+const int TextToWordsWithBaseForms(const char * pInUtf8Str, int InUtf8StrByteCount,
+    char * pOutUtf8Str, int * pStartOffsets, int * pEndOffsets, const int MaxOutUtf8StrByteCount,
+    void * hModel, void * hStemmer);
 }
 }
\ No newline at end of file
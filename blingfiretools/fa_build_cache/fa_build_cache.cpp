@@ -0,0 +1,602 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FAUtils.h"
+#include "FABuildCache.h"
+#include "FAThreadPool.h"
+#include "FAException.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <atomic>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+const char * g_pCacheDir = NULL;
+const char * g_pAddJobFile = NULL;
+const char * g_pJobsFile = NULL;
+bool g_use_stdin = false;
+bool g_key_includes = false;
+std::vector < std::string > g_key_files;
+bool g_verbose = false;
+int g_thread_count = 0;
+
+// serializes the messages of the concurrent jobs
+std::mutex g_msg_lock;
+
+
+void usage ()
+{
+    std::cerr << "\
+Usage: fa_build_cache [OPTIONS] [--] COMMAND [ARGS]\n\
+       fa_build_cache [OPTIONS] --jobs=<file>\n\
+\n\
+This program runs a build stage through a content-addressed cache. The key\n\
+of the stage is the hash of the command line, of the program executable and\n\
+of the contents of its input files. If the cache has an entry for the key,\n\
+the outputs are copied from the cache and the command is not run.\n\
+\n\
+The inputs and outputs are taken from the command arguments: a --out*=<file>\n\
+argument is an output, any other --name=<file> or <file> argument which\n\
+names an existing file is an input. The commands without outputs are\n\
+always run.\n\
+\n\
+  --cache-dir=<dir> - the cache directory, should exist, required\n\
+\n\
+  --stdin - the command reads its stdin, the stdin data is a part of the key\n\
+\n\
+  --key-file=<file> - adds the contents of the <file> to the key, a name\n\
+    without a path is looked up in the PATH if there is no such file, e.g.\n\
+    the programs a script runs, can be used several times\n\
+\n\
+  --key-includes - adds the files included into the inputs with the\n\
+    \"_include <file>\" lines to the key, the <file> is relative to the\n\
+    --dict-root=<path> of the command or to the DICTS_ROOT directory (the\n\
+    current one if neither is set), see fa_build_lex\n\
+\n\
+  --add-job=<file> - appends the command to the <file> instead of running it,\n\
+    the arguments should not contain spaces\n\
+\n\
+  --jobs=<file> - runs the commands from the <file>, one per line, concurrently\n\
+    (the same command is run once), a missing <file> has no commands\n\
+\n\
+  --threads=N - the number of concurrent jobs,\n\
+    the number of hardware threads is used by default\n\
+\n\
+  --verbose - prints whether the stages are taken from the cache\n\
+\n\
+Notes:\n\
+\n\
+  The key does not cover the programs the command runs itself unless they\n\
+  are given with --key-file, e.g. the tools a script calls.\n\
+\n\
+";
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+    for (; argc--; ++argv) {
+
+        if (0 == strcmp ("--help", *argv)) {
+            usage ();
+            exit (0);
+        }
+        if (0 == strncmp ("--cache-dir=", *argv, 12)) {
+            g_pCacheDir = &((*argv) [12]);
+            continue;
+        }
+        if (0 == strcmp ("--stdin", *argv)) {
+            g_use_stdin = true;
+            continue;
+        }
+        if (0 == strncmp ("--key-file=", *argv, 11)) {
+            g_key_files.push_back (&((*argv) [11]));
+            continue;
+        }
+        if (0 == strcmp ("--key-includes", *argv)) {
+            g_key_includes = true;
+            continue;
+        }
+        if (0 == strncmp ("--add-job=", *argv, 10)) {
+            g_pAddJobFile = &((*argv) [10]);
+            continue;
+        }
+        if (0 == strncmp ("--jobs=", *argv, 7)) {
+            g_pJobsFile = &((*argv) [7]);
+            continue;
+        }
+        if (0 == strncmp ("--threads=", *argv, 10)) {
+            g_thread_count = atoi (&((*argv) [10]));
+            continue;
+        }
+        if (0 == strcmp ("--verbose", *argv)) {
+            g_verbose = true;
+            continue;
+        }
+        if (0 == strcmp ("--", *argv)) {
+            --argc, ++argv;
+            break;
+        }
+        if ('-' != **argv) {
+            break;
+        }
+
+        std::cerr << "ERROR: Unknown option \"" << *argv << "\""
+                  << " in program " << __PROG__ << '\n';
+        exit (1);
+    }
+}
+
+
+// returns true if the regular file exists
+const bool FileExists (const char * pFileName)
+{
+    struct stat st;
+
+    if (0 != stat (pFileName, &st)) {
+        return false;
+    }
+
+    return S_IFREG == (st.st_mode & S_IFMT);
+}
+
+
+// returns the executable file the program name refers to, or an empty string
+const std::string GetExecutable (const std::string & Prog)
+{
+#ifdef _WIN32
+    const char PathDelim = ';';
+    const char * pExts [] = { "", ".exe", ".bat", ".cmd" };
+#else
+    const char PathDelim = ':';
+    const char * pExts [] = { "" };
+#endif
+    const int ExtCount = sizeof (pExts) / sizeof (pExts [0]);
+
+    if (std::string::npos != Prog.find_first_of ("/\\")) {
+        return FileExists (Prog.c_str ()) ? Prog : std::string ();
+    }
+
+    const char * pPath = getenv ("PATH");
+    if (NULL == pPath) {
+        return std::string ();
+    }
+
+    std::stringstream path (pPath);
+    std::string dir;
+
+    while (std::getline (path, dir, PathDelim)) {
+
+        if (dir.empty ()) {
+            dir = ".";
+        }
+        for (int i = 0; i < ExtCount; ++i) {
+            const std::string Exe = dir + "/" + Prog + pExts [i];
+            if (FileExists (Exe.c_str ())) {
+                return Exe;
+            }
+        }
+    }
+
+    return std::string ();
+}
+
+
+// returns the argument as a single shell word
+const std::string Quote (const std::string & Arg)
+{
+#ifdef _WIN32
+    return "\"" + Arg + "\"";
+#else
+    std::string Out ("'");
+
+    for (size_t i = 0; i < Arg.size (); ++i) {
+        if ('\'' == Arg [i]) {
+            Out += "'\\''";
+        } else {
+            Out += Arg [i];
+        }
+    }
+
+    return Out + "'";
+#endif
+}
+
+
+// returns the directory the included files are relative to, the same as
+// fa_build_lex: the --dict-root=<path> argument or the DICTS_ROOT variable
+const std::string GetDictRoot (const std::vector < std::string > & Args)
+{
+    for (size_t i = 1; i < Args.size (); ++i) {
+        if (0 == strncmp ("--dict-root=", Args [i].c_str (), 12)) {
+            return Args [i].substr (12);
+        }
+    }
+
+    const char * pRoot = getenv ("DICTS_ROOT");
+    return NULL != pRoot && 0 != *pRoot ? pRoot : ".";
+}
+
+
+// adds the files of the "_include <file>" lines of the input to the key
+void AddIncludes (
+        FABuildCache * pCache,
+        const char * pFileName,
+        const std::string & Root
+    )
+{
+    DebugLogAssert (pCache && pFileName);
+
+    std::ifstream ifs (pFileName, std::ios::in);
+    FAAssertStream (&ifs, pFileName);
+
+    std::string Line;
+
+    while (std::getline (ifs, Line)) {
+
+        std::stringstream line (Line);
+        std::string Cmd;
+        std::string Include;
+
+        if (!(line >> Cmd >> Include) || "_include" != Cmd) {
+            continue;
+        }
+
+        // the included files should exist, AddKeyFile fails otherwise
+        const std::string IncludeFile = Root + "/" + Include;
+
+        pCache->AddKey (Include.c_str (), Include.size ());
+        pCache->AddKeyFile (IncludeFile.c_str ());
+    }
+}
+
+
+void PrintMsg (const char * pMsg, const std::vector < std::string > & Args)
+{
+    std::lock_guard < std::mutex > guard (g_msg_lock);
+
+    std::cerr << pMsg;
+    for (size_t i = 0; i < Args.size (); ++i) {
+        std::cerr << ' ' << Args [i];
+    }
+    std::cerr << '\n';
+}
+
+
+// runs the command through the cache, returns the command's exit code
+const int RunCached (
+        const std::vector < std::string > & Args,
+        const std::vector < std::string > & KeyFiles,
+        const bool fKeyIncludes,
+        const std::string * pStdin
+    )
+{
+    LogAssert (!Args.empty ());
+    LogAssert (g_pCacheDir);
+
+    FABuildCache cache;
+    cache.SetCacheDir (g_pCacheDir);
+
+    // the command line
+    for (size_t i = 0; i < Args.size (); ++i) {
+        cache.AddKey (Args [i].c_str (), Args [i].size ());
+    }
+
+    // the program
+    const std::string Exe = GetExecutable (Args [0]);
+    if (!Exe.empty ()) {
+        cache.AddKeyFile (Exe.c_str ());
+    }
+
+    // the extra files, a missing program only adds its name, the command
+    // fails anyway if it is needed
+    for (size_t i = 0; i < KeyFiles.size (); ++i) {
+
+        const std::string & KeyFile = KeyFiles [i];
+        cache.AddKey (KeyFile.c_str (), KeyFile.size ());
+
+        // a file name with a path should exist, AddKeyFile fails otherwise
+        if (FileExists (KeyFile.c_str ()) ||
+            std::string::npos != KeyFile.find_first_of ("/\\")) {
+            cache.AddKeyFile (KeyFile.c_str ());
+            continue;
+        }
+
+        const std::string KeyExe = GetExecutable (KeyFile);
+        if (!KeyExe.empty ()) {
+            cache.AddKeyFile (KeyExe.c_str ());
+        }
+    }
+
+    // the inputs and outputs
+    int OutputCount = 0;
+    const std::string DictRoot = fKeyIncludes ? GetDictRoot (Args) : std::string ();
+
+    for (size_t i = 1; i < Args.size (); ++i) {
+
+        const std::string & Arg = Args [i];
+        const char * pFileName = Arg.c_str ();
+
+        if (0 == strncmp ("--", pFileName, 2)) {
+            const char * pEq = strchr (pFileName, '=');
+            if (NULL == pEq) {
+                continue;
+            }
+            if (0 == strncmp ("--out", pFileName, 5)) {
+                cache.AddOutput (pEq + 1);
+                OutputCount++;
+                continue;
+            }
+            pFileName = pEq + 1;
+        }
+
+        if (FileExists (pFileName)) {
+            cache.AddKey (pFileName, strlen (pFileName));
+            cache.AddKeyFile (pFileName);
+            if (fKeyIncludes) {
+                AddIncludes (&cache, pFileName, DictRoot);
+            }
+        }
+    }
+
+    // stdin data
+    if (pStdin) {
+        cache.AddKey (pStdin->c_str (), pStdin->size ());
+    }
+
+    if (0 < OutputCount && cache.Restore ()) {
+        if (g_verbose) {
+            PrintMsg ("cached:", Args);
+        }
+        return 0;
+    }
+
+    if (g_verbose) {
+        PrintMsg ("running:", Args);
+    }
+
+    std::string Cmd;
+    for (size_t i = 0; i < Args.size (); ++i) {
+        if (0 < i) {
+            Cmd += ' ';
+        }
+        Cmd += Quote (Args [i]);
+    }
+
+    // the stdin data is passed in a temporary file
+    std::string StdinFile;
+    if (pStdin) {
+
+        char Buff [64];
+        snprintf (Buff, sizeof (Buff), "%016llx.stdin", cache.GetKey ());
+        StdinFile = std::string (g_pCacheDir) + "/" + Buff;
+
+        std::ofstream ofs (StdinFile.c_str (), std::ios::out | std::ios::binary);
+        FAAssertStream (&ofs, StdinFile.c_str ());
+        ofs.write (pStdin->c_str (), pStdin->size ());
+        ofs.close ();
+
+        Cmd += " < " + Quote (StdinFile);
+    }
+
+    const int Res = system (Cmd.c_str ());
+
+    if (pStdin) {
+        remove (StdinFile.c_str ());
+    }
+
+    if (0 == Res && 0 < OutputCount) {
+        cache.Store ();
+    }
+
+    return Res;
+}
+
+
+// splits the line at the spaces
+void SplitLine (const std::string & Line, std::vector < std::string > * pArgs)
+{
+    DebugLogAssert (pArgs);
+
+    pArgs->clear ();
+
+    std::stringstream line (Line);
+    std::string Arg;
+
+    while (line >> Arg) {
+        pArgs->push_back (Arg);
+    }
+}
+
+
+void AddJob (const std::vector < std::string > & Args)
+{
+    DebugLogAssert (g_pAddJobFile);
+
+    // the key options go first, see RunJobs
+    std::vector < std::string > JobArgs;
+
+    for (size_t i = 0; i < g_key_files.size (); ++i) {
+        JobArgs.push_back ("--key-file=" + g_key_files [i]);
+    }
+    if (g_key_includes) {
+        JobArgs.push_back ("--key-includes");
+    }
+    JobArgs.insert (JobArgs.end (), Args.begin (), Args.end ());
+
+    std::string Line;
+
+    for (size_t i = 0; i < JobArgs.size (); ++i) {
+
+        if (std::string::npos != JobArgs [i].find_first_of (" \t\r\n")) {
+            std::cerr << "ERROR: \"Job arguments cannot contain spaces\""
+                      << " in program " << __PROG__ << '\n';
+            exit (1);
+        }
+        if (0 < i) {
+            Line += ' ';
+        }
+        Line += JobArgs [i];
+    }
+
+    std::ofstream ofs (g_pAddJobFile, std::ios::out | std::ios::app);
+    FAAssertStream (&ofs, g_pAddJobFile);
+    ofs << Line << '\n';
+}
+
+
+const int RunJobs ()
+{
+    DebugLogAssert (g_pJobsFile);
+
+    std::vector < std::string > jobs;
+
+    std::ifstream ifs (g_pJobsFile, std::ios::in);
+    if (!ifs.is_open ()) {
+        return 0;
+    }
+
+    // read the jobs, the same job is run once
+    std::string Line;
+    while (std::getline (ifs, Line)) {
+
+        if (!Line.empty () && '\r' == Line [Line.size () - 1]) {
+            Line.resize (Line.size () - 1);
+        }
+        if (Line.empty ()) {
+            continue;
+        }
+
+        bool fFound = false;
+        for (size_t i = 0; i < jobs.size () && !fFound; ++i) {
+            fFound = jobs [i] == Line;
+        }
+        if (!fFound) {
+            jobs.push_back (Line);
+        }
+    }
+
+    std::atomic < int > FailedCount (0);
+
+    FAThreadPool pool;
+    pool.ParallelFor ((int) jobs.size (), g_thread_count,
+        [&] (const int i)
+        {
+            std::vector < std::string > JobArgs;
+            SplitLine (jobs [i], &JobArgs);
+
+            // take the key options added by AddJob
+            std::vector < std::string > KeyFiles;
+            bool fKeyIncludes = false;
+            size_t j = 0;
+
+            for (; j < JobArgs.size (); ++j) {
+                if (0 == strncmp ("--key-file=", JobArgs [j].c_str (), 11)) {
+                    KeyFiles.push_back (JobArgs [j].substr (11));
+                } else if ("--key-includes" == JobArgs [j]) {
+                    fKeyIncludes = true;
+                } else {
+                    break;
+                }
+            }
+
+            const std::vector < std::string > Args (JobArgs.begin () + j, JobArgs.end ());
+
+            if (Args.empty () || 0 != RunCached (Args, KeyFiles, fKeyIncludes, NULL)) {
+                PrintMsg ("ERROR: failed:", Args);
+                FailedCount++;
+            }
+        });
+
+    return 0 == FailedCount ? 0 : 2;
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    ::FAIOSetup ();
+
+    // parse a command line
+    process_args (argc, argv);
+
+    if (NULL == g_pCacheDir) {
+        std::cerr << "ERROR: \"The --cache-dir is not specified\""
+                  << " in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    std::vector < std::string > Args;
+    for (; 0 <= argc; --argc, ++argv) {
+        Args.push_back (*argv);
+    }
+
+    if (Args.empty () == (NULL == g_pJobsFile)) {
+        std::cerr << "ERROR: \"Either a command or the --jobs should be specified\""
+                  << " in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    try {
+
+        if (g_pJobsFile) {
+            return RunJobs ();
+        }
+        if (g_pAddJobFile) {
+            AddJob (Args);
+            return 0;
+        }
+
+        std::string StdinData;
+        if (g_use_stdin) {
+            std::vector < char > buff (65536);
+            size_t Size;
+            while (0 < (Size = fread (buff.data (), 1, buff.size (), stdin))) {
+                StdinData.append (buff.data (), Size);
+            }
+        }
+
+        const int Res = RunCached (Args, g_key_files, g_key_includes,
+            g_use_stdin ? &StdinData : NULL);
+
+        if (0 != Res) {
+            PrintMsg ("ERROR: failed:", Args);
+            return 2;
+        }
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
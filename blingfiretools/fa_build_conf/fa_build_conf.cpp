@@ -271,6 +271,10 @@ void SetupConfParams ()
                           "bpe-opt", FAFsmConst::TOKENIZE_BPE_OPT);
     g_parser.AddStrParam ("tokalgo", FAFsmConst::PARAM_TOKENIZATION_TYPE,
                           "bpe-opt-with-merges", FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES);
+    g_parser.AddStrParam ("tokalgo", FAFsmConst::PARAM_TOKENIZATION_TYPE,
+                          "bpe-opt-local", FAFsmConst::TOKENIZE_BPE_OPT_LOCAL);
+    g_parser.AddStrParam ("tokalgo", FAFsmConst::PARAM_TOKENIZATION_TYPE,
+                          "bpe-opt-with-merges-local", FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL);
 
 }
 
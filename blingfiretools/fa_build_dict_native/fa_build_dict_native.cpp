@@ -0,0 +1,1146 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FAAllocator.h"
+#include "FAUtils.h"
+#include "FAStr2Utf16.h"
+#include "FAUtf32Utils.h"
+#include "FAAutIOTools.h"
+#include "FAMapIOTools.h"
+#include "FATagSet.h"
+#include "FAFsmConst.h"
+#include "FATransform_hyph_redup_t.h"
+#include "FATransform_hyph_redup_rev_t.h"
+#include "FATransform_prefix_t.h"
+#include "FATransform_prefix_rev_t.h"
+#include "FATransform_capital_t.h"
+#include "FATransform_capital_rev_t.h"
+#include "FATransform_cascade_t.h"
+#include "FARSDfa_pack_triv.h"
+#include "FAImageDump.h"
+#include "FAStringTokenizer.h"
+#include "FAArray_cont_t.h"
+#include "FAMultiMap_pack_fixed.h"
+#include "FAMultiMap_ar.h"
+#include "FAMap_judy.h"
+#include "FADictSplit.h"
+#include "FAChains2MinDfa_sort.h"
+#include "FARSDfa_ro.h"
+#include "FARSDfa_renum.h"
+#include "FARSDfaRenum_remove_gaps.h"
+#include "FARSDfa2PerfHash.h"
+#include "FARSDfa2MooreDfa.h"
+#include "FAMealyDfa_ro.h"
+#include "FAState2Ow.h"
+#include "FAState2Ows_ar_uniq.h"
+#include "FASortMultiMap.h"
+#include "FAThreadPool.h"
+#include "FAException.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+FAAllocator g_alloc;
+FAAutIOTools g_io (&g_alloc);
+FAMapIOTools g_map_io (&g_alloc);
+
+const char * g_pInFile = NULL;
+const char * g_pOutFsmFile = NULL;
+const char * g_pOutK2IFile = NULL;
+const char * g_pOutI2InfoFile = NULL;
+const char * g_pInTagSetFile = NULL;
+const char * g_pCharMapFile = NULL;
+const char * g_pInPrefFsmFile = NULL;
+
+const char * g_pInEnc = "UTF-8";
+bool g_fDecEnc = false;
+bool g_fHexEnc = false;
+bool g_fUInt8Enc = false;
+
+int g_type = FAFsmConst::TYPE_MEALY_DFA;
+int g_mode = FAFsmConst::DM_TAGS;
+int g_dir = FAFsmConst::DIR_L2R;
+bool g_ignore_case = false;
+bool g_float_nums = false;
+bool g_sort_info = false;
+int g_thread_count = 0;
+
+// the chains are ordered as their "%0<NumSize>x" texts would be
+int g_num_size = 6;
+unsigned int g_max_fixed = 0x1000000;
+
+FATagSet g_tagset (&g_alloc);
+
+// transformations
+FATransform_hyph_redup_t < int > g_tr_hyph_redup;
+FATransform_hyph_redup_rev_t < int > g_tr_hyph_redup_rev;
+FATransform_prefix_t < int > g_tr_pref;
+FATransform_prefix_rev_t < int > g_tr_pref_rev;
+FATransform_capital_t < int > g_tr_ucf;
+FATransform_capital_rev_t < int > g_tr_ucf_rev;
+FATransform_cascade_t < int > g_in_tr_cascade;
+
+int g_redup_delim = -1;
+int g_pref_delim = -1;
+int g_ucf_delim = -1;
+
+FAImageDump g_pref_dfa_image;
+FARSDfa_pack_triv g_pref_fsm_dump;
+
+FAImageDump g_charmap_image;
+FAMultiMap_pack_fixed g_charmap;
+
+const FATransformCA_t < int > * g_pInTr = NULL;
+
+const int MaxChainSize = 4096;
+int g_Chain [MaxChainSize];
+int g_Out [(2 * MaxChainSize) + 1];
+
+unsigned int LineNum;
+std::string line;
+
+// digitized input, chains of the [N, a_1, ..., a_N] format
+FAArray_cont_t < int > g_chains;
+// the keys from g_dict_split, chains of the same format
+FAArray_cont_t < int > g_keys;
+
+FADictSplit g_dict_split (&g_alloc);
+
+FAThreadPool g_pool;
+
+
+void usage ()
+{
+    std::cerr << "\
+Usage: fa_build_dict_native [OPTIONS]\n\
+\n\
+From the input stream of \"W\\tT[\\tT[...]]\\n\" lines, this program creates\n\
+a dictionary consisting of three structures: MPH W -> Id, Array Id -> InfoId\n\
+and Multi Map InfoId -> Info. Where W is a word, T is a tag, \\t is a tab\n\
+symbol and Info is a set of tags associated with the word W.\n\
+\n\
+This program makes the same output as the fa_build_dict script (with the\n\
+LC_ALL=C sort) but runs all the stages in one process over binary chains.\n\
+\n\
+  --in=<input> - input file name, stdin is used if omited\n\
+\n\
+  --out-fsm=<output-file> - writes W -> Id MPH to the <output-file>,\n\
+    if omited stdout is used\n\
+\n\
+  --out-k2i=<output-file> - writes Id -> InfoId array to the <output-file>,\n\
+    if omited stdout is used\n\
+\n\
+  --out-i2info=<output-file> - writes InfoId -> Info map to the <output-file>,\n\
+    if omited stdout is used\n\
+\n\
+  --tagset=<input-file> - reads input tagset from the <input-file>,\n\
+    no tagset is used by default\n\
+\n\
+  --input-enc=<enc> - input encoding, \"UTF-8\" - is used by default,\n\
+    DEC, HEX and UInt8 are the same as for fa_line2chain_unicode\n\
+\n\
+  --type=<type> - selects dictionary algorithm type:\n\
+    mph - Mealy automaton based MPH (is used by default)\n\
+    moore - Moore automaton based\n\
+\n\
+  --ignore-case - converts input symbols to the lower case,\n\
+    uses simple case folding algorithm due to Unicode 4.1.0\n\
+\n\
+  --charmap=<mmap-dump> - applies a custom character normalization procedure\n\
+    according to the <mmap-dump>, the dump should be in \"fixed\" format\n\
+\n\
+  --dir=<direction> - specifies word reading direction:\n\
+    l2r - left to right (the dafault value)\n\
+    r2l - right to left\n\
+    aff - affix first, e.g. last, first, last - 1, first + 1, ...\n\
+\n\
+";
+
+    std::cerr << "\
+  --in-tr=<trs> - specifies input transformation type\n\
+    <trs> is comma-separated array of the following:\n\
+      hyph-redup - hyphenated reduplication\n\
+      hyph-redup-rev - reverse hyphenated reduplication\n\
+      pref - prefix transformation: represents special prefixes as suffixes\n\
+      pref-rev - reversed prefix transformation\n\
+      ucf - encodes upper-case-first symbol in a suffix\n\
+      ucf-rev - reversed UCF transformation\n\
+\n\
+  --redup-delim=N - reduplication delimiter\n\
+\n\
+  --pref-delim=N - prefix transformation delimiter\n\
+\n\
+  --pref-fsm=<fsm> - keeps dictionary of prefixes to be treated as suffix,\n\
+    used only with --in-tr=pref\n\
+\n\
+  --ucf-delim=N - UCF transformation delimiter\n\
+\n\
+  --raw - stores info data as-is, in this mode the input data should not\n\
+    contain duplicate keys (this mode is not used by default)\n\
+\n\
+  --tag-prob - Tag Prob mode, every input line should contain KEY TAG PROB\n\
+    values (not used by default)\n\
+\n\
+  --hyph - Hyph mode, every input line should contain KEY FREQ OWS values\n\
+    (not used by default)\n\
+\n\
+  --sort-info - applies lexicographical sorting to the InfoId -> Info map\n\
+\n\
+  --float-nums - if specified, allows floating point numbers to be\n\
+    inter-mixed with tags\n\
+\n\
+  --threads=N - the number of threads to sort the chains with,\n\
+    the number of hardware threads is used by default\n\
+\n\
+";
+}
+
+
+void InitTrCascade (const char * pTrsStr, const int TrsStrLen)
+{
+  FAStringTokenizer tokenizer;
+  tokenizer.SetSpaces (",");
+  tokenizer.SetString (pTrsStr, TrsStrLen);
+
+  const char * pTrType = NULL;
+  int TrTypeLen = 0;
+
+  while (tokenizer.GetNextStr (&pTrType, &TrTypeLen)) {
+
+    if (0 == strncmp ("hyph-redup-rev", pTrType, 14)) {
+      g_in_tr_cascade.AddTransformation (&g_tr_hyph_redup_rev);
+    } else if (0 == strncmp ("hyph-redup", pTrType, 10)) {
+      g_in_tr_cascade.AddTransformation (&g_tr_hyph_redup);
+    } else if (0 == strncmp ("pref-rev", pTrType, 8)) {
+      g_in_tr_cascade.AddTransformation (&g_tr_pref_rev);
+    } else if (0 == strncmp ("pref", pTrType, 4)) {
+      g_in_tr_cascade.AddTransformation (&g_tr_pref);
+    } else if (0 == strncmp ("ucf-rev", pTrType, 7)) {
+      g_in_tr_cascade.AddTransformation (&g_tr_ucf_rev);
+    } else if (0 == strncmp ("ucf", pTrType, 3)) {
+      g_in_tr_cascade.AddTransformation (&g_tr_ucf);
+    } else {
+      std::string s (pTrsStr, TrsStrLen);
+      std::cerr << "ERROR: \"Unknown transformation name " << s << '"'
+                << " in program " << __PROG__ << '\n';
+      exit (1);
+    }
+  }
+
+  g_pInTr = &g_in_tr_cascade;
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+  for (; argc--; ++argv) {
+
+    if (0 == strcmp ("--help", *argv)) {
+      usage ();
+      exit (0);
+    }
+    if (0 == strncmp ("--in=", *argv, 5)) {
+      g_pInFile = &((*argv) [5]);
+      continue;
+    }
+    if (0 == strncmp ("--out-fsm=", *argv, 10)) {
+      g_pOutFsmFile = &((*argv) [10]);
+      continue;
+    }
+    if (0 == strncmp ("--out-k2i=", *argv, 10)) {
+      g_pOutK2IFile = &((*argv) [10]);
+      continue;
+    }
+    if (0 == strncmp ("--out-i2info=", *argv, 13)) {
+      g_pOutI2InfoFile = &((*argv) [13]);
+      continue;
+    }
+    if (0 == strncmp ("--tagset=", *argv, 9)) {
+      g_pInTagSetFile = &((*argv) [9]);
+      continue;
+    }
+    if (0 == strncmp ("--input-enc=", *argv, 12)) {
+      g_pInEnc = &((*argv) [12]);
+      g_fDecEnc = (0 == strcmp ("DEC", g_pInEnc));
+      g_fHexEnc = (0 == strcmp ("HEX", g_pInEnc));
+      g_fUInt8Enc = (0 == strcmp ("UInt8", g_pInEnc));
+      continue;
+    }
+    if (0 == strcmp ("--type=mph", *argv)) {
+      g_type = FAFsmConst::TYPE_MEALY_DFA;
+      continue;
+    }
+    if (0 == strcmp ("--type=moore", *argv)) {
+      g_type = FAFsmConst::TYPE_MOORE_DFA;
+      continue;
+    }
+    if (0 == strcmp ("--ignore-case", *argv)) {
+      g_ignore_case = true;
+      continue;
+    }
+    if (0 == strncmp ("--charmap=", *argv, 10)) {
+      g_pCharMapFile = &((*argv) [10]);
+      continue;
+    }
+    if (0 == strcmp ("--dir=l2r", *argv)) {
+      g_dir = FAFsmConst::DIR_L2R;
+      continue;
+    }
+    if (0 == strcmp ("--dir=r2l", *argv)) {
+      g_dir = FAFsmConst::DIR_R2L;
+      continue;
+    }
+    if (0 == strcmp ("--dir=aff", *argv)) {
+      g_dir = FAFsmConst::DIR_AFF;
+      continue;
+    }
+    if (0 == strncmp ("--redup-delim=", *argv, 14)) {
+      g_redup_delim = atoi (&((*argv) [14]));
+      continue;
+    }
+    if (0 == strncmp ("--pref-fsm=", *argv, 11)) {
+      g_pInPrefFsmFile = &((*argv) [11]);
+      continue;
+    }
+    if (0 == strncmp ("--pref-delim=", *argv, 13)) {
+      g_pref_delim = atoi (&((*argv) [13]));
+      continue;
+    }
+    if (0 == strncmp ("--ucf-delim=", *argv, 12)) {
+      g_ucf_delim = atoi (&((*argv) [12]));
+      continue;
+    }
+    if (0 == strncmp ("--in-tr=", *argv, 8)) {
+      const char * pTrsStr = &((*argv) [8]);
+      InitTrCascade (pTrsStr, (int) strlen (pTrsStr));
+      continue;
+    }
+    if (0 == strcmp ("--raw", *argv)) {
+      g_mode = FAFsmConst::DM_RAW;
+      continue;
+    }
+    if (0 == strcmp ("--tag-prob", *argv)) {
+      g_mode = FAFsmConst::DM_TAG_PROB;
+      continue;
+    }
+    if (0 == strcmp ("--hyph", *argv)) {
+      g_mode = FAFsmConst::DM_HYPH;
+      continue;
+    }
+    if (0 == strcmp ("--sort-info", *argv)) {
+      g_sort_info = true;
+      continue;
+    }
+    if (0 == strcmp ("--float-nums", *argv)) {
+      g_float_nums = true;
+      continue;
+    }
+    if (0 == strncmp ("--threads=", *argv, 10)) {
+      g_thread_count = atoi (&((*argv) [10]));
+      continue;
+    }
+    if (0 == strncmp ("-", *argv, 1)) {
+      std::cerr << "ERROR: Unknown parameter " << *argv \
+                << ", see " << __PROG__ << " --help\n";
+      exit (1);
+    }
+  }
+}
+
+
+///
+/// Digitizing, the same as "fa_line2chain_unicode --use-keys --key-delim"
+///
+
+// appends the characters in the reading order, returns the new size
+const int PutWord (const int * pChain, const int ChainSize, int * pOut)
+{
+    int OutSize = 0;
+
+    if (FAFsmConst::DIR_L2R == g_dir) {
+
+        for (int i = 0; i < ChainSize; ++i) {
+            pOut [OutSize++] = pChain [i];
+        }
+
+    } else if (FAFsmConst::DIR_R2L == g_dir) {
+
+        for (int i = ChainSize - 1; i >= 0; --i) {
+            pOut [OutSize++] = pChain [i];
+        }
+
+    } else {
+
+        DebugLogAssert (FAFsmConst::DIR_AFF == g_dir);
+
+        int Right = ChainSize - 1;
+        int Left = 0;
+
+        while (Right > Left) {
+            pOut [OutSize++] = pChain [Right--];
+            pOut [OutSize++] = pChain [Left++];
+        }
+        if (Left == Right) {
+            pOut [OutSize++] = pChain [Left];
+        }
+    }
+
+    return OutSize;
+}
+
+
+// appends the 0-delimiter and the keys, returns the new size
+const int PutKeys (const char * pKey, const int KeyLen, int * pOut, int OutSize)
+{
+    pOut [OutSize++] = 0;
+
+    FAStringTokenizer tokenizer;
+    tokenizer.SetSpaces ("\t");
+    tokenizer.SetString (pKey, KeyLen);
+
+    bool NoKeys = true;
+    const char * pTagStr = NULL;
+    int TagStrLen = 0;
+
+    while (tokenizer.GetNextStr (&pTagStr, &TagStrLen)) {
+
+        int Key;
+
+        if (g_pInTagSetFile) {
+
+            Key = g_tagset.Str2Tag (pTagStr, TagStrLen);
+
+            if (0 >= Key) {
+                if (false == g_float_nums) {
+                    Key = atoi (pTagStr);
+                } else {
+                    double dKey = atof(pTagStr);
+                    if (0.0 == dKey) {
+                      std::cerr << "ERROR: 0.0 weights are not allowed. Read from tag \"" \
+                          << std::string (pTagStr, TagStrLen) << "\" in line #" << LineNum \
+                          << " in program " << __PROG__ << std::endl;
+                      exit (1);
+                    }
+                    const float flKey = (float) dKey;
+                    memcpy (&Key, &flKey, sizeof (Key));
+                }
+            }
+            if (0 == Key) {
+                std::cerr << "ERROR: Unknown tag \"" << std::string (pTagStr, TagStrLen) \
+                    << "\" in line #" << LineNum << " in program " << __PROG__ << std::endl;
+                exit (1);
+            }
+
+        } else {
+
+            Key = atoi (pTagStr);
+        }
+
+        FAAssert (OutSize < (2 * MaxChainSize) + 1, FAMsg::LimitIsExceeded);
+        pOut [OutSize++] = Key;
+
+        NoKeys = false;
+    }
+
+    if (NoKeys) {
+        std::cerr << "ERROR: \"Line contains no keys.\" in line #" << LineNum \
+            << " in program " << __PROG__ << '\n';
+        exit (1);
+    }
+
+    return OutSize;
+}
+
+
+void Digitize (std::istream * pIs)
+{
+    DebugLogAssert (pIs);
+
+    FAStr2Utf16 cp2utf16 (&g_alloc);
+    if (!g_fDecEnc && !g_fHexEnc && !g_fUInt8Enc) {
+        cp2utf16.SetEncodingName (g_pInEnc);
+    }
+
+    LineNum = 0;
+
+    while (!pIs->eof ()) {
+
+        if (!std::getline (*pIs, line))
+            break;
+
+        LineNum++;
+
+        std::string::size_type EndOfLine = line.find_last_not_of("\r\n");
+        if (EndOfLine != std::string::npos) {
+            line.erase(EndOfLine + 1);
+        }
+        if (line.empty ()) {
+            continue;
+        }
+
+        const char * pLine = line.c_str ();
+        const int LineLen = (const int) line.length ();
+
+        if (MaxChainSize < LineLen) {
+            std::cerr << "ERROR: Line is too long, #" << LineNum \
+                      << " in program " << __PROG__ << '\n';
+            exit (1);
+        }
+
+        const char * pDelim = strchr (pLine, '\t');
+        const int DataLen = pDelim ? int (pDelim - pLine) : LineLen;
+
+        int Count = 0;
+
+        if (g_fDecEnc) {
+            Count = ::FAReadIntegerChain \
+                (pLine, DataLen, 10, g_Chain, MaxChainSize);
+        } else if (g_fHexEnc) {
+            Count = ::FAReadHexChain \
+                (pLine, DataLen, g_Chain, MaxChainSize);
+        } else if (g_fUInt8Enc) {
+            for (int i = 0; i < DataLen; ++i) {
+                g_Chain [i] = (unsigned char) pLine [i];
+            }
+            Count = DataLen;
+        } else {
+            Count = cp2utf16.Process \
+                (pLine, DataLen, g_Chain, MaxChainSize);
+        }
+
+        if (-1 == Count) {
+            std::cerr << "ERROR: Conversion is not possible in line #" \
+                      << LineNum << " in program " << __PROG__ << '\n';
+            exit (1);
+        }
+        FAAssert (Count <= MaxChainSize, FAMsg::InternalError);
+
+        if (g_ignore_case) {
+            ::FAUtf32StrLower (g_Chain, Count);
+        }
+        if (g_pCharMapFile) {
+            Count = ::FANormalizeWord (g_Chain, Count, \
+                g_Chain, MaxChainSize, &g_charmap);
+        }
+        if (g_pInTr) {
+            const int NewCount = \
+                g_pInTr->Process (g_Chain, Count, g_Chain, MaxChainSize);
+            if (-1 != NewCount) {
+                DebugLogAssert (NewCount <= MaxChainSize);
+                Count = NewCount;
+            }
+        }
+
+        int OutSize = PutWord (g_Chain, Count, g_Out);
+
+        if (pDelim) {
+            const char * pKey = pDelim + 1;
+            const int KeyLen = LineLen - DataLen - 1;
+            OutSize = PutKeys (pKey, KeyLen, g_Out, OutSize);
+        }
+
+        const int Offset = g_chains.size ();
+        g_chains.resize (Offset + OutSize + 1);
+        int * pDst = g_chains.begin () + Offset;
+        *pDst = OutSize;
+        memcpy (pDst + 1, g_Out, sizeof (int) * OutSize);
+
+    } // of while (!pIs->eof ()) ...
+}
+
+
+///
+/// Sorting, the same as "LC_ALL=C sort" of the hex text of the chains
+///
+
+// compares two different values as their hex texts
+inline const bool TextLess (const int Val1, const int Val2)
+{
+    const unsigned int U1 = (unsigned int) Val1;
+    const unsigned int U2 = (unsigned int) Val2;
+
+    // the texts of the same length are ordered as the numbers
+    if (U1 < g_max_fixed && U2 < g_max_fixed) {
+        return U1 < U2;
+    }
+
+    char Text1 [16];
+    char Text2 [16];
+    snprintf (Text1, sizeof (Text1), "%0*x", g_num_size, U1);
+    snprintf (Text2, sizeof (Text2), "%0*x", g_num_size, U2);
+
+    return 0 > strcmp (Text1, Text2);
+}
+
+
+// compares [N, a_1, ..., a_N] chains as their texts, the "a_i a_j" text
+// is smaller than the "a_i" text only if a_j is smaller than ' '
+class _TChainLess {
+public:
+    _TChainLess (const int * pChains) : m_pChains (pChains) {}
+
+    inline const bool operator () (const int Offset1, const int Offset2) const
+    {
+        const int * pChain1 = m_pChains + Offset1;
+        const int * pChain2 = m_pChains + Offset2;
+
+        const int Size1 = *pChain1++;
+        const int Size2 = *pChain2++;
+        const int Size = Size1 < Size2 ? Size1 : Size2;
+
+        for (int i = 0; i < Size; ++i) {
+            if (pChain1 [i] != pChain2 [i]) {
+                return TextLess (pChain1 [i], pChain2 [i]);
+            }
+        }
+
+        return Size1 < Size2;
+    }
+
+private:
+    const int * m_pChains;
+};
+
+
+// returns offsets of the chains in the text order, removes duplicates
+// if fUniq is true
+void SortChains (
+        const FAArray_cont_t < int > & chains,
+        const bool fUniq,
+        std::vector < int > * pOffsets
+    )
+{
+    DebugLogAssert (pOffsets);
+
+    const int * pChains = chains.begin ();
+    const int ChainsSize = chains.size ();
+
+    // get the offsets and the largest leading value
+    std::vector < int > offsets;
+    unsigned int MaxFirst = 0;
+    bool fFixedFirst = true;
+
+    for (int Offset = 0; Offset < ChainsSize; Offset += 1 + pChains [Offset]) {
+
+        offsets.push_back (Offset);
+
+        if (0 < pChains [Offset]) {
+            const unsigned int First = (unsigned int) pChains [Offset + 1];
+            fFixedFirst = fFixedFirst && First < g_max_fixed;
+            if (MaxFirst < First) {
+                MaxFirst = First;
+            }
+        }
+    }
+
+    const int Count = (int) offsets.size ();
+    pOffsets->resize (Count);
+
+    // ranges of the pOffsets to be sorted independently
+    std::vector < int > ranges;
+
+    if (fFixedFirst && 1 < Count) {
+
+        // distribute the chains by the leading value (the empty chains go
+        // first), all the leading values are printed with the same width
+        int Shift = 0;
+        while ((MaxFirst >> Shift) >= (1 << 21)) {
+            Shift++;
+        }
+
+        const int BucketCount = (MaxFirst >> Shift) + 2;
+        std::vector < int > buckets (BucketCount + 1, 0);
+
+        int i;
+        for (i = 0; i < Count; ++i) {
+            const int * pChain = pChains + offsets [i];
+            const int Bucket = 0 < *pChain ? 1 + (pChain [1] >> Shift) : 0;
+            buckets [Bucket + 1]++;
+        }
+        for (i = 0; i < BucketCount; ++i) {
+            buckets [i + 1] += buckets [i];
+            if (1 < buckets [i + 1] - buckets [i]) {
+                ranges.push_back (buckets [i]);
+                ranges.push_back (buckets [i + 1]);
+            }
+        }
+        for (i = 0; i < Count; ++i) {
+            const int * pChain = pChains + offsets [i];
+            const int Bucket = 0 < *pChain ? 1 + (pChain [1] >> Shift) : 0;
+            (*pOffsets) [buckets [Bucket]++] = offsets [i];
+        }
+
+    } else {
+
+        pOffsets->swap (offsets);
+        ranges.push_back (0);
+        ranges.push_back (Count);
+    }
+
+    // sort the ranges, biggest first
+    const int RangeCount = (int) ranges.size () / 2;
+    std::vector < int > order (RangeCount);
+    for (int i = 0; i < RangeCount; ++i) {
+        order [i] = i;
+    }
+    std::sort (order.begin (), order.end (), [&ranges] (const int i, const int j) {
+        return ranges [2 * i + 1] - ranges [2 * i] > ranges [2 * j + 1] - ranges [2 * j];
+    });
+
+    int * pBegin = pOffsets->data ();
+    const _TChainLess Less (pChains);
+
+    g_pool.ParallelFor (RangeCount, g_thread_count, [&] (const int i) {
+        const int Range = order [i];
+        std::sort (pBegin + ranges [2 * Range], pBegin + ranges [2 * Range + 1], Less);
+    });
+
+    // remove duplicates, if needed
+    if (fUniq && 0 < Count) {
+
+        int NewCount = 1;
+
+        for (int i = 1; i < Count; ++i) {
+
+            const int * pPrev = pChains + pBegin [NewCount - 1];
+            const int * pCurr = pChains + pBegin [i];
+
+            if (*pPrev != *pCurr || \
+                0 != memcmp (pPrev + 1, pCurr + 1, sizeof (int) * *pCurr)) {
+                pBegin [NewCount++] = pBegin [i];
+            }
+        }
+
+        pOffsets->resize (NewCount);
+    }
+}
+
+
+///
+/// Building
+///
+
+void SetNumSize (const int NumSize)
+{
+    g_num_size = NumSize;
+    g_max_fixed = 1U << (4 * NumSize);
+}
+
+
+void SplitChains ()
+{
+    // sort | uniq
+    std::vector < int > offsets;
+    SortChains (g_chains, true, &offsets);
+
+    // fa_dict_split
+    const int * pChains = g_chains.begin ();
+    const int Count = (int) offsets.size ();
+
+    for (int i = 0; i < Count; ++i) {
+        const int * pChain = pChains + offsets [i];
+        g_dict_split.AddChain (pChain + 1, *pChain);
+    }
+
+    g_dict_split.Process ();
+}
+
+
+// fa_chains2mindfa, the dfa is in the form as it was read from the text
+void BuildMinDfa (
+        const FAArray_cont_t < int > & keys,
+        const std::vector < int > & offsets,
+        FARSDfa_ro * pDfa
+    )
+{
+    DebugLogAssert (pDfa);
+
+    FAChains2MinDfa_sort chains2mdfa (&g_alloc);
+
+    const int * pKeys = keys.begin ();
+    const int Count = (int) offsets.size ();
+
+    for (int i = 0; i < Count; ++i) {
+        const int * pKey = pKeys + offsets [i];
+        chains2mdfa.AddChain (pKey + 1, *pKey);
+    }
+
+    chains2mdfa.Prepare ();
+
+    ::FACopyDfa (pDfa, &chains2mdfa);
+}
+
+
+// returns offsets of the chains in the array as they go
+void GetOffsets (
+        const FAArray_cont_t < int > & chains,
+        std::vector < int > * pOffsets
+    )
+{
+    DebugLogAssert (pOffsets);
+
+    const int * pChains = chains.begin ();
+    const int ChainsSize = chains.size ();
+
+    pOffsets->clear ();
+
+    for (int Offset = 0; Offset < ChainsSize; Offset += 1 + pChains [Offset]) {
+        pOffsets->push_back (Offset);
+    }
+}
+
+
+// calculates lexicographical InfoId order, fills in the sorted map
+void SortInfo (FAMap_judy * pOld2New, FAMultiMap_ar * pOutMMap)
+{
+    DebugLogAssert (pOld2New && pOutMMap);
+
+    const FAMultiMapA * pMMap = g_dict_split.GetI2Info ();
+    DebugLogAssert (pMMap);
+
+    FASortMultiMap mmap_sort (&g_alloc);
+    mmap_sort.SetDirection (FAFsmConst::DIR_L2R);
+    mmap_sort.SetMultiMap (pMMap);
+    mmap_sort.Process ();
+
+    const int * pKeys;
+    const int KeyCount = mmap_sort.GetKeyOrder (&pKeys);
+
+    for (int NewKey = 0; NewKey < KeyCount; ++NewKey) {
+
+        const int Key = pKeys [NewKey];
+        pOld2New->Set (Key, NewKey);
+
+        const int * pVals;
+        const int ValCount = pMMap->Get (Key, &pVals);
+        DebugLogAssert (0 <= ValCount && pVals);
+
+        pOutMMap->Set (NewKey, pVals, ValCount);
+    }
+}
+
+
+void BuildMph (std::ostream * pOsFsm, std::ostream * pOsK2I, std::ostream * pOsI2Info)
+{
+    SetNumSize (6);
+
+    g_dict_split.SetMode (g_mode);
+    g_dict_split.SetKeyArray (&g_keys);
+
+    SplitChains ();
+
+    // fa_chains2mindfa, the keys are already sorted
+    std::vector < int > offsets;
+    GetOffsets (g_keys, &offsets);
+
+    FARSDfa_ro min_dfa (&g_alloc);
+    BuildMinDfa (g_keys, offsets, &min_dfa);
+
+    // fa_fsm_renum --alg=remove-gaps
+    FARSDfaRenum_remove_gaps renum (&g_alloc);
+    renum.SetDfa (&min_dfa);
+    renum.Process ();
+
+    FARSDfa_renum renum_dfa (&g_alloc);
+    renum_dfa.SetOldDfa (&min_dfa);
+    renum_dfa.SetOld2New (renum.GetOld2NewMap ());
+    renum_dfa.Prepare ();
+
+    FARSDfa_ro dfa (&g_alloc);
+    ::FACopyDfa (&dfa, &renum_dfa);
+
+    // fa_dfa2mph --type=mealy-dfa
+    FAState2Ows_ar_uniq state2ows (&g_alloc);
+
+    FARSDfa2PerfHash dfa2mph (&g_alloc);
+    dfa2mph.SetRsDfa (&dfa);
+    dfa2mph.SetState2Ows (&state2ows);
+    dfa2mph.Process ();
+
+    FAMealyDfa_ro mealy_ows (&g_alloc);
+
+    FAArray_cont_t < int > tmp_iws;
+    tmp_iws.SetAllocator (&g_alloc);
+    tmp_iws.Create ();
+
+    const int MaxState = dfa.GetMaxState ();
+
+    for (int State = 0; State <= MaxState; ++State) {
+
+        int i;
+        tmp_iws.resize (0);
+
+        const int * pIws;
+        const int Iws = ::FAGetStateIws (&dfa, State, &pIws);
+
+        for (i = 0; i < Iws; ++i) {
+            const int Iw = pIws [i];
+            if (-1 != dfa.GetDest (State, Iw)) {
+                tmp_iws.push_back (Iw);
+            }
+        }
+
+        const int * pOws;
+        const int Count = state2ows.GetOws (State, &pOws);
+
+        FAAssert ((-1 == Count && 0 == tmp_iws.size ()) || \
+            (0 <= Count && (unsigned int) Count == tmp_iws.size ()),
+            FAMsg::InternalError);
+
+        for (i = 0; i < Count; ++i) {
+            mealy_ows.SetOw (State, tmp_iws [i], pOws [i]);
+        }
+    }
+
+    mealy_ows.Prepare ();
+
+    g_io.Print (*pOsFsm, &dfa, &mealy_ows);
+
+    const int * pK2I = NULL;
+    const int K2ICount = g_dict_split.GetK2I (&pK2I);
+    DebugLogAssert (pK2I && 0 < K2ICount);
+
+    if (false == g_sort_info) {
+
+        g_map_io.Print (*pOsK2I, pK2I, K2ICount);
+        g_map_io.Print (*pOsI2Info, g_dict_split.GetI2Info ());
+
+    } else {
+
+        // fa_fsm_renum --alg=mmap-sort --fsm-type=arr
+        FAMap_judy old2new;
+        FAMultiMap_ar out_mmap;
+        out_mmap.SetAllocator (&g_alloc);
+        SortInfo (&old2new, &out_mmap);
+
+        FAArray_cont_t < int > k2i;
+        k2i.SetAllocator (&g_alloc);
+        k2i.Create ();
+        k2i.resize (K2ICount);
+
+        for (int i = 0; i < K2ICount; ++i) {
+            const int * pNewOw = old2new.Get (pK2I [i]);
+            DebugLogAssert (pNewOw);
+            k2i [i] = *pNewOw;
+        }
+
+        g_map_io.Print (*pOsK2I, k2i.begin (), k2i.size ());
+        g_map_io.Print (*pOsI2Info, &out_mmap);
+    }
+}
+
+
+void BuildMoore (std::ostream * pOsFsm, std::ostream * pOsI2Info)
+{
+    SetNumSize (5);
+
+    g_dict_split.SetMode (g_mode);
+    g_dict_split.SetNoK2I (true);
+    g_dict_split.SetInfoIdBase (65536);
+    g_dict_split.SetKeyArray (&g_keys);
+
+    SplitChains ();
+
+    // sort | fa_chains2mindfa, the InfoId-s may change the order
+    std::vector < int > offsets;
+    SortChains (g_keys, false, &offsets);
+
+    FARSDfa_ro min_dfa (&g_alloc);
+    BuildMinDfa (g_keys, offsets, &min_dfa);
+
+    // fa_fsm2fsm --in-type=rs-dfa --out-type=moore-dfa
+    FARSDfa_ro moore_dfa (&g_alloc);
+    FAState2Ow moore_ows (&g_alloc);
+
+    FARSDfa2MooreDfa rs2moore (&g_alloc);
+    rs2moore.SetRSDfa (&min_dfa);
+    rs2moore.SetMooreDfa (&moore_dfa);
+    rs2moore.SetState2Ow (&moore_ows);
+    rs2moore.SetOwsRange (65536, 2000000);
+    rs2moore.Process ();
+
+    FARSDfa_ro dfa (&g_alloc);
+    ::FACopyDfa (&dfa, &moore_dfa);
+
+    // fa_fsm_renum --fsm-type=moore-dfa --alg=remove-gaps
+    FARSDfaRenum_remove_gaps renum (&g_alloc);
+    renum.SetDfa (&dfa);
+    renum.Process ();
+
+    const int * pOld2New = renum.GetOld2NewMap ();
+    DebugLogAssert (pOld2New);
+
+    FARSDfa_renum renum_dfa (&g_alloc);
+    renum_dfa.SetOldDfa (&dfa);
+    renum_dfa.SetOld2New (pOld2New);
+    renum_dfa.Prepare ();
+
+    FAState2Ow renum_ows (&g_alloc);
+
+    const int MaxOldState = dfa.GetMaxState ();
+
+    for (int State = 0; State <= MaxOldState; ++State) {
+        const int Ow = moore_ows.GetOw (State);
+        if (-1 != Ow) {
+            renum_ows.SetOw (pOld2New [State], Ow);
+        }
+    }
+
+    if (false == g_sort_info) {
+
+        g_io.Print (*pOsFsm, &renum_dfa, &renum_ows);
+        g_map_io.Print (*pOsI2Info, g_dict_split.GetI2Info ());
+
+    } else {
+
+        // fa_fsm_renum --alg=mmap-sort --fsm-type=moore-dfa
+        FARSDfa_ro out_dfa (&g_alloc);
+        ::FACopyDfa (&out_dfa, &renum_dfa);
+
+        FAMap_judy old2new;
+        FAMultiMap_ar out_mmap;
+        out_mmap.SetAllocator (&g_alloc);
+        SortInfo (&old2new, &out_mmap);
+
+        FAState2Ow out_ows (&g_alloc);
+
+        const int MaxState = out_dfa.GetMaxState ();
+
+        for (int State = 0; State <= MaxState; ++State) {
+            const int Ow = renum_ows.GetOw (State);
+            if (-1 != Ow) {
+                const int * pNewOw = old2new.Get (Ow);
+                DebugLogAssert (pNewOw);
+                out_ows.SetOw (State, *pNewOw);
+            }
+        }
+
+        g_io.Print (*pOsFsm, &out_dfa, &out_ows);
+        g_map_io.Print (*pOsI2Info, &out_mmap);
+    }
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    ::FAIOSetup ();
+
+    // parse a command line
+    process_args (argc, argv);
+
+    try {
+
+        g_chains.SetAllocator (&g_alloc);
+        g_chains.Create ();
+        g_keys.SetAllocator (&g_alloc);
+        g_keys.Create ();
+
+        // load tagset, if needed
+        if (NULL != g_pInTagSetFile) {
+            std::ifstream tagset_ifs (g_pInTagSetFile, std::ios::in);
+            FAAssertStream (&tagset_ifs, g_pInTagSetFile);
+            g_map_io.Read (tagset_ifs, &g_tagset);
+        }
+        // load prefix automaton, if needed
+        if (g_pInPrefFsmFile) {
+            g_pref_dfa_image.Load (g_pInPrefFsmFile);
+            const unsigned char * pImg = g_pref_dfa_image.GetImageDump ();
+            DebugLogAssert (pImg);
+            g_pref_fsm_dump.SetImage (pImg);
+            g_tr_pref.SetRsDfa (&g_pref_fsm_dump);
+        }
+        // load normalization map, if needed
+        if (g_pCharMapFile) {
+            g_charmap_image.Load (g_pCharMapFile);
+            const unsigned char * pImg = g_charmap_image.GetImageDump ();
+            DebugLogAssert (pImg);
+            g_charmap.SetImage (pImg);
+        }
+        // specify delimiters, if needed
+        if (-1 != g_pref_delim) {
+            g_tr_pref.SetDelim (g_pref_delim);
+            g_tr_pref_rev.SetDelim (g_pref_delim);
+        }
+        if (-1 != g_redup_delim) {
+            g_tr_hyph_redup.SetDelim (g_redup_delim);
+            g_tr_hyph_redup_rev.SetDelim (g_redup_delim);
+        }
+        if (-1 != g_ucf_delim) {
+            g_tr_ucf.SetDelim (g_ucf_delim);
+            g_tr_ucf_rev.SetDelim (g_ucf_delim);
+        }
+
+        // read the input
+        if (NULL != g_pInFile) {
+            std::ifstream ifs (g_pInFile, std::ios::in);
+            FAAssertStream (&ifs, g_pInFile);
+            Digitize (&ifs);
+        } else {
+            if (g_fUInt8Enc) {
+                ::FAInputIOSetup ();
+            }
+            Digitize (&std::cin);
+        }
+
+        // select output streams
+        std::ostream * pOsFsm = &std::cout;
+        std::ofstream ofs_fsm;
+        std::ostream * pOsK2I = &std::cout;
+        std::ofstream ofs_k2i;
+        std::ostream * pOsI2Info = &std::cout;
+        std::ofstream ofs_i2info;
+
+        if (NULL != g_pOutFsmFile) {
+            ofs_fsm.open (g_pOutFsmFile, std::ios::out);
+            pOsFsm = &ofs_fsm;
+        }
+        if (NULL != g_pOutK2IFile && FAFsmConst::TYPE_MEALY_DFA == g_type) {
+            ofs_k2i.open (g_pOutK2IFile, std::ios::out);
+            pOsK2I = &ofs_k2i;
+        }
+        if (NULL != g_pOutI2InfoFile) {
+            ofs_i2info.open (g_pOutI2InfoFile, std::ios::out);
+            pOsI2Info = &ofs_i2info;
+        }
+
+        if (FAFsmConst::TYPE_MEALY_DFA == g_type) {
+            BuildMph (pOsFsm, pOsK2I, pOsI2Info);
+        } else {
+            DebugLogAssert (FAFsmConst::TYPE_MOORE_DFA == g_type);
+            BuildMoore (pOsFsm, pOsI2Info);
+        }
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
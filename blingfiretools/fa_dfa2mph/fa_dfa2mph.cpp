@@ -148,10 +148,6 @@ int __cdecl main (int argc, char ** argv)
             tmp_iws.SetAllocator (&g_alloc);
             tmp_iws.Create ();
 
-            const int * pIws;
-            const int Iws = input_dfa.GetIWs (&pIws);
-            DebugLogAssert (0 < Iws && ::FAIsSortUniqed (pIws, Iws));
-
             const int MaxState = input_dfa.GetMaxState ();
 
             for (int State = 0; State <= MaxState; ++State) {
@@ -159,6 +155,9 @@ int __cdecl main (int argc, char ** argv)
                 int i;
                 tmp_iws.resize (0);
 
+                const int * pIws;
+                const int Iws = ::FAGetStateIws (&input_dfa, State, &pIws);
+
                 for (i = 0; i < Iws; ++i) {
                     const int Iw = pIws [i];
                     if (-1 != input_dfa.GetDest (State, Iw)) {
@@ -21,10 +21,12 @@
 #include "FATs2PTable.h"
 #include "FAHmmTagger_l1.h"
 #include "FAArray_cont_t.h"
+#include "FAThreadPool.h"
 
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 
 using namespace BlingFire;
 
@@ -44,6 +46,8 @@ std::ofstream g_ofs;
 
 bool g_no_output = false;
 bool g_no_process = false;
+int g_batch_size = 1;
+int g_thread_count = 0;
 
 // allocator
 FAAllocator g_alloc;
@@ -77,6 +81,11 @@ specified. Each input line should contain one sentence.\n\
   --no-output - does not do any output\n\
 \n\
   --no-process - does not do any processing, I/O only\n\
+\n\
+  --batch=N - tags N sentences at a time in parallel, 1 is used by default\n\
+\n\
+  --threads=N - the number of threads used with --batch,\n\
+    the number of hardware threads is used by default\n\
 ";
 
 }
@@ -118,6 +127,14 @@ void process_args (int& argc, char**& argv)
         g_no_process= true;
         continue;
     }
+    if (0 == strncmp ("--batch=", *argv, 8)) {
+        g_batch_size = atoi (&((*argv) [8]));
+        continue;
+    }
+    if (0 == strncmp ("--threads=", *argv, 10)) {
+        g_thread_count = atoi (&((*argv) [10]));
+        continue;
+    }
   }
 }
 
@@ -163,6 +180,12 @@ int __cdecl main (int argc, char ** argv)
         FATs2PTable g_tt2p;
         // HMM tagger
         FAHmmTagger_l1 g_tagger;
+        // sentences, words and threads of the --batch mode
+        std::vector < FATaggedText * > g_batch;
+        std::vector < const int * > g_words;
+        std::vector < int > g_word_lens;
+        std::vector < int > g_sent_ends;
+        FAThreadPool g_thread_pool;
 
         ///
         /// initialize
@@ -228,6 +251,72 @@ int __cdecl main (int argc, char ** argv)
         /// process input
         ///
 
+        while (1 < g_batch_size && !g_pIs->eof ()) {
+
+            // read upto g_batch_size sentences
+            while (g_batch.size () < (size_t) g_batch_size) {
+                g_batch.push_back (NEW FATaggedText (&g_alloc));
+            }
+
+            int SentCount = 0;
+            g_words.clear ();
+            g_word_lens.clear ();
+            g_sent_ends.clear ();
+
+            for (; SentCount < g_batch_size && !g_pIs->eof (); ++SentCount) {
+
+                g_InputLineNum++;
+
+                FATaggedText * pText = g_batch [SentCount];
+                g_txt_io_in.Read (*g_pIs, pText);
+
+                const int WordCount = pText->GetWordCount ();
+
+                for (int i = 0; i < WordCount; ++i) {
+
+                    const int * pWord = NULL;
+                    const int WordLen = pText->GetWord (i, &pWord);
+
+                    g_words.push_back (pWord);
+                    g_word_lens.push_back (WordLen);
+                }
+
+                g_sent_ends.push_back ((int) g_words.size ());
+            }
+
+            if (g_no_process)
+                continue;
+
+            g_tags.resize ((unsigned int) g_words.size ());
+
+            g_tagger.TagSentences (g_words.data (), g_word_lens.data (),
+                g_sent_ends.data (), SentCount, g_tags.begin (),
+                &g_thread_pool, g_thread_count);
+
+            if (g_no_output)
+                continue;
+
+            // print the tagged text
+            int From = 0;
+
+            for (int i = 0; i < SentCount; ++i) {
+
+                FATaggedText * pText = g_batch [i];
+                const int WordCount = pText->GetWordCount ();
+
+                pText->SetTags (g_tags.begin () + From, WordCount);
+                g_txt_io_out.Print (*g_pOs, pText);
+
+                From += WordCount;
+            }
+
+        } // of while (1 < g_batch_size && !g_pIs->eof ()) ...
+
+        for (size_t i = 0; i < g_batch.size (); ++i) {
+            delete g_batch [i];
+        }
+        g_batch.clear ();
+
         while (!g_pIs->eof ()) {
 
             g_InputLineNum++;
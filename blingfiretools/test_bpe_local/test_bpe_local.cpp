@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FAUtils.h"
+#include "FAUtf8Utils.h"
+#include "FAException.h"
+#include "FAImageDump.h"
+#include "FALDB.h"
+#include "FADictConfKeeper.h"
+#include "FATokenSegmentationTools_1best_bpe_t.h"
+#include "FATokenSegmentationTools_1best_bpe_with_merges_t.h"
+#include "FATokenSegmentationTools_1best_bpe_local_t.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+const char * g_pLdbFile = NULL;
+const char * g_pInFile = NULL;
+int g_iterations = 5;
+int g_length = 100000;
+
+
+void usage () {
+
+  std::cout << "\n\
+Usage: test_bpe_local [OPTIONS]\n\
+\n\
+This program checks that the BPE runtime which merges the groups of the\n\
+overlapping matches separately (bpe-opt-local, bpe-opt-with-merges-local)\n\
+returns the same results as the runtime which sorts all the matches\n\
+(bpe-opt, bpe-opt-with-merges) and compares their speed.\n\
+\n\
+  --ldb=<ldb> - reads the compiled BPE model from the <ldb> file,\n\
+    e.g. gpt2.bin or roberta.bin, required\n\
+\n\
+  --in=<input> - reads additional input text from the <input> file,\n\
+    each line is checked separately and the whole file is benchmarked\n\
+\n\
+  --iterations=N - processes each input N times, 5 is used by default\n\
+\n\
+  --length=N - the length of the generated inputs in bytes,\n\
+    100000 is used by default\n\
+";
+
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+  for (; argc--; ++argv){
+
+    if (!strcmp ("--help", *argv)) {
+        usage ();
+        exit (0);
+    }
+    if (0 == strncmp ("--ldb=", *argv, 6)) {
+        g_pLdbFile = &((*argv) [6]);
+        continue;
+    }
+    if (0 == strncmp ("--in=", *argv, 5)) {
+        g_pInFile = &((*argv) [5]);
+        continue;
+    }
+    if (0 == strncmp ("--iterations=", *argv, 13)) {
+        g_iterations = atoi (&((*argv) [13]));
+        continue;
+    }
+    if (0 == strncmp ("--length=", *argv, 9)) {
+        g_length = atoi (&((*argv) [9]));
+        continue;
+    }
+  }
+}
+
+
+// returns the Pattern repeated upto the Length bytes
+const std::string Repeat (const char * pPattern, const int Length)
+{
+    std::string Text;
+    while ((int) Text.length () < Length) {
+        Text += pPattern;
+    }
+    return Text;
+}
+
+
+// returns pseudo-random CJK text of about Length bytes
+const std::string Cjk (const int Length)
+{
+    std::string Text;
+    unsigned int Seed = 12345;
+
+    while ((int) Text.length () < Length) {
+        Seed = Seed * 1103515245 + 12345;
+        const int C = 0x4E00 + ((Seed >> 16) % 2000);
+        Text.push_back ((char) (0xE0 | (C >> 12)));
+        Text.push_back ((char) (0x80 | ((C >> 6) & 0x3F)));
+        Text.push_back ((char) (0x80 | (C & 0x3F)));
+    }
+    return Text;
+}
+
+
+// converts the text into the input of the segmentation algorithm,
+// spaces are replaced with U+2581 and one is added at the beginning
+void Prepare (const std::string & Utf8, const bool fUseBytes, std::vector < int > * pIn)
+{
+    std::string Str ("\xE2\x96\x81");
+    for (size_t i = 0; i < Utf8.length (); ++i) {
+        if (' ' == Utf8 [i]) {
+            Str += "\xE2\x96\x81";
+        } else {
+            Str.push_back (Utf8 [i]);
+        }
+    }
+
+    pIn->resize (Str.length () + 1);
+
+    const int Len = fUseBytes ?
+        ::FAStrUtf8AsBytesToArray (Str.c_str (), (int) Str.length (), pIn->data (), (int) pIn->size ()) :
+        ::FAStrUtf8ToArray (Str.c_str (), (int) Str.length (), pIn->data (), (int) pIn->size ());
+
+    pIn->resize (0 < Len ? Len : 0);
+}
+
+
+// returns the time in milliseconds to process the input g_iterations times
+const double Measure (
+        const FATokenSegmentationToolsCA_t < int > * pAlgo,
+        const std::vector < int > & In,
+        const int Iterations,
+        std::vector < int > * pResults
+    )
+{
+    const int MaxOutSize = (int) (3 * In.size ()) + 3;
+    pResults->resize (MaxOutSize);
+
+    FATokenSegmentationScratchA * pScratch = NULL;
+    int OutSize = 0;
+
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now ();
+
+    for (int k = 0; k < Iterations; ++k) {
+        OutSize = pAlgo->Process (In.data (), (int) In.size (), pResults->data (), MaxOutSize, -1, &pScratch);
+    }
+
+    const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now ();
+
+    delete pScratch;
+
+    pResults->resize (0 < OutSize ? OutSize : 0);
+    pResults->push_back (OutSize);
+
+    return std::chrono::duration < double, std::milli > (End - Start).count () / Iterations;
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    ::FAIOSetup ();
+
+    process_args (argc, argv);
+
+    try {
+
+        LogAssert (g_pLdbFile, "The --ldb parameter is required");
+
+        ///
+        /// load the model, set up both algorithms
+        ///
+
+        FAImageDump Img;
+        Img.Load (g_pLdbFile);
+        const unsigned char * pImgBytes = Img.GetImageDump ();
+        LogAssert (pImgBytes, "Cannot load %s", g_pLdbFile);
+
+        FALDB Ldb;
+        Ldb.SetImage (pImgBytes);
+
+        const int * pValues = NULL;
+        const int Size = Ldb.GetHeader ()->Get (FAFsmConst::FUNC_POS_DICT, &pValues);
+        LogAssert (-1 != Size, "No [pos-dict] section in %s", g_pLdbFile);
+
+        FADictConfKeeper Conf;
+        Conf.SetLDB (&Ldb);
+        Conf.Init (pValues, Size);
+
+        const int TokAlgo = Conf.GetTokAlgo ();
+        const bool fUseBytes = Conf.GetUseByteEncoding ();
+
+        FATokenSegmentationTools_1best_bpe_t < int > Bpe;
+        FATokenSegmentationTools_1best_bpe_with_merges_t < int > BpeWithMerges;
+        FATokenSegmentationTools_1best_bpe_local_t < int > BpeLocal;
+
+        const FATokenSegmentationToolsCA_t < int > * pSortAlgo = NULL;
+
+        if (FAFsmConst::TOKENIZE_BPE_OPT == TokAlgo) {
+            Bpe.SetConf (&Conf);
+            pSortAlgo = &Bpe;
+            Conf.SetTokAlgo (FAFsmConst::TOKENIZE_BPE_OPT_LOCAL);
+        } else if (FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES == TokAlgo) {
+            BpeWithMerges.SetConf (&Conf);
+            pSortAlgo = &BpeWithMerges;
+            Conf.SetTokAlgo (FAFsmConst::TOKENIZE_BPE_OPT_WITH_MERGES_LOCAL);
+        } else {
+            LogAssert (false, "The model should use bpe-opt or bpe-opt-with-merges");
+        }
+
+        BpeLocal.SetConf (&Conf);
+
+        ///
+        /// make the inputs
+        ///
+
+        std::vector < std::pair < std::string, std::string > > Inputs;
+
+        Inputs.push_back (std::make_pair ("text", Repeat ("The quick brown fox jumps over the lazy dog. ", g_length)));
+        Inputs.push_back (std::make_pair ("cjk", Cjk (g_length)));
+        Inputs.push_back (std::make_pair ("urls", Repeat ("https://www.example.com/path/to/resource?id=12345&token=abcdef0123456789#frag", g_length)));
+        Inputs.push_back (std::make_pair ("minified js", Repeat ("function(a,b){return a.b(c[d]+e)===f?g:h;};var x=y.z||{};", g_length)));
+
+        if (g_pInFile) {
+            std::ifstream ifs (g_pInFile, std::ios::in | std::ios::binary);
+            FAAssertStream (&ifs, g_pInFile);
+            const std::string Text ((std::istreambuf_iterator < char > (ifs)), std::istreambuf_iterator < char > ());
+            Inputs.push_back (std::make_pair (g_pInFile, Text));
+
+            // check each line separately
+            size_t LineCount = 0;
+            size_t From = 0;
+            std::vector < int > In;
+            std::vector < int > SortResults;
+            std::vector < int > LocalResults;
+
+            while (From < Text.length ()) {
+                size_t To = Text.find ('\n', From);
+                if (std::string::npos == To) {
+                    To = Text.length ();
+                }
+                Prepare (Text.substr (From, To - From), fUseBytes, &In);
+                Measure (pSortAlgo, In, 1, &SortResults);
+                Measure (&BpeLocal, In, 1, &LocalResults);
+                LogAssert (SortResults == LocalResults, "Results are different for line %d", (int) LineCount + 1);
+                LineCount++;
+                From = To + 1;
+            }
+
+            std::cout << "lines: " << LineCount << " checked\n";
+        }
+
+        ///
+        /// check the results are the same and compare the speed
+        ///
+
+        for (size_t i = 0; i < Inputs.size (); ++i) {
+
+            std::vector < int > In;
+            Prepare (Inputs [i].second, fUseBytes, &In);
+
+            std::vector < int > SortResults;
+            std::vector < int > LocalResults;
+
+            const double SortMs = Measure (pSortAlgo, In, g_iterations, &SortResults);
+            const double LocalMs = Measure (&BpeLocal, In, g_iterations, &LocalResults);
+
+            LogAssert (SortResults == LocalResults, "Results are different for %s", Inputs [i].first.c_str ());
+
+            std::cout << Inputs [i].first << ": " << In.size () << " symbols, "
+                << "sort " << SortMs << " ms, local " << LocalMs << " ms, "
+                << "speedup " << SortMs / LocalMs << "x\n";
+        }
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
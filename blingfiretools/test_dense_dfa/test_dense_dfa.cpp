@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FAUtils.h"
+#include "FAUtf8Utils.h"
+#include "FAException.h"
+#include "FAImageDump.h"
+#include "FALDB.h"
+#include "FAWbdConfKeeper.h"
+#include "FALexTools_t.h"
+#include "FARSDfa_dense.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+const char * g_pLdbFile = NULL;
+const char * g_pInFile = NULL;
+int g_iterations = 10;
+int g_max_memory = 4 * 1024 * 1024;
+
+
+void usage () {
+
+  std::cout << "\n\
+Usage: test_dense_dfa [OPTIONS]\n\
+\n\
+This program checks that the lexer returns the same results with and without\n\
+the dense transition table (FARSDfa_dense) and compares its speed.\n\
+\n\
+  --ldb=<ldb> - reads the compiled model with the [wbd] section from the\n\
+    <ldb> file, e.g. wbd.bin or sbd.bin, required\n\
+\n\
+  --in=<input> - reads input text from the <input> file, if omited a mostly\n\
+    ASCII text with some multi-byte characters is generated\n\
+\n\
+  --iterations=N - processes the input N times in each benchmark,\n\
+    10 is used by default\n\
+\n\
+  --max-memory=N - the memory budget of the table in bytes,\n\
+    4194304 is used by default\n\
+";
+
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+  for (; argc--; ++argv){
+
+    if (!strcmp ("--help", *argv)) {
+        usage ();
+        exit (0);
+    }
+    if (0 == strncmp ("--ldb=", *argv, 6)) {
+        g_pLdbFile = &((*argv) [6]);
+        continue;
+    }
+    if (0 == strncmp ("--in=", *argv, 5)) {
+        g_pInFile = &((*argv) [5]);
+        continue;
+    }
+    if (0 == strncmp ("--iterations=", *argv, 13)) {
+        g_iterations = atoi (&((*argv) [13]));
+        continue;
+    }
+    if (0 == strncmp ("--max-memory=", *argv, 13)) {
+        g_max_memory = atoi (&((*argv) [13]));
+        continue;
+    }
+  }
+}
+
+
+// returns lines of a mostly ASCII text with some multi-byte characters
+void GenerateLines (std::vector < std::string > * pLines)
+{
+    const char * pWords [] = {
+        "The ", "quick ", "brown ", "fox ", "jumps ", "over ", "the ",
+        "lazy ", "dog. ", "http://www.example.com/index.html ", "Mr. ",
+        "Smith's ", "e-mail: ", "john.smith@example.com, ", "(3.14) ",
+        "U.S.A. ", "don't! ", "$100,000.00? ", "caf\xC3\xA9 ", "na\xC3\xAFve ",
+        "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 ", "\xE4\xB8\xAD\xE6\x96\x87 ",
+    };
+    const int WordCount = sizeof (pWords) / sizeof (pWords [0]);
+
+    unsigned int Seed = 12345;
+
+    for (int i = 0; i < 20000; ++i) {
+
+        Seed = Seed * 1103515245 + 12345;
+        const int Len = 1 + (Seed >> 16) % 40;
+
+        std::string Line;
+        for (int j = 0; j < Len; ++j) {
+            Seed = Seed * 1103515245 + 12345;
+            Line += pWords [(Seed >> 16) % WordCount];
+        }
+        pLines->push_back (Line);
+    }
+}
+
+
+// returns the time in milliseconds to process all lines g_iterations times
+const double Measure (
+        const FALexTools_t < int > & Engine,
+        const std::vector < std::vector < int > > & Lines,
+        std::vector < int > * pResults
+    )
+{
+    std::vector < int > Out;
+
+    pResults->clear ();
+
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now ();
+
+    for (int k = 0; k < g_iterations; ++k) {
+        for (size_t i = 0; i < Lines.size (); ++i) {
+
+            const std::vector < int > & Line = Lines [i];
+            const int MaxOutSize = (int) (3 * Line.size ()) + 3;
+            if ((int) Out.size () < MaxOutSize) {
+                Out.resize (MaxOutSize);
+            }
+
+            const int OutSize = Engine.Process (Line.data (), (int) Line.size (), Out.data (), MaxOutSize);
+
+            // keep the results of the first iteration only
+            if (0 == k) {
+                pResults->push_back (OutSize);
+                if (0 < OutSize) {
+                    pResults->insert (pResults->end (), Out.begin (), Out.begin () + OutSize);
+                }
+            }
+        }
+    }
+
+    const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now ();
+
+    return std::chrono::duration < double, std::milli > (End - Start).count ();
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    ::FAIOSetup ();
+
+    process_args (argc, argv);
+
+    try {
+
+        LogAssert (g_pLdbFile, "The --ldb parameter is required");
+
+        ///
+        /// load the model
+        ///
+
+        FAImageDump Img;
+        Img.Load (g_pLdbFile);
+        const unsigned char * pImgBytes = Img.GetImageDump ();
+        LogAssert (pImgBytes, "Cannot load %s", g_pLdbFile);
+
+        FALDB Ldb;
+        Ldb.SetImage (pImgBytes);
+
+        const int * pValues = NULL;
+        const int Size = Ldb.GetHeader ()->Get (FAFsmConst::FUNC_WBD, &pValues);
+        LogAssert (-1 != Size, "No [wbd] section in %s", g_pLdbFile);
+
+        FAWbdConfKeeper Conf;
+        Conf.Initialize (&Ldb, pValues, Size);
+
+        FALexTools_t < int > Packed;
+        Packed.SetConf (&Conf);
+
+        FARSDfa_dense Dense;
+        const int StateCount = Dense.Build (Conf.GetRsDfa (), (size_t) g_max_memory);
+
+        FAWbdConfKeeper DenseConf;
+        DenseConf.Initialize (&Ldb, pValues, Size);
+        DenseConf.SetRsDfa (&Dense);
+
+        FALexTools_t < int > Flat;
+        Flat.SetConf (&DenseConf);
+
+        std::cout << "states in the table: " << StateCount << ", memory: "
+            << Dense.GetMemorySize () << " bytes\n";
+
+        ///
+        /// read the input
+        ///
+
+        std::vector < std::string > Text;
+
+        if (g_pInFile) {
+            std::ifstream ifs (g_pInFile, std::ios::in);
+            FAAssertStream (&ifs, g_pInFile);
+            std::string Line;
+            while (std::getline (ifs, Line)) {
+                if (!Line.empty ()) {
+                    Text.push_back (Line);
+                }
+            }
+        } else {
+            GenerateLines (&Text);
+        }
+
+        std::vector < std::vector < int > > Lines;
+        size_t CharCount = 0;
+
+        for (size_t i = 0; i < Text.size (); ++i) {
+
+            std::vector < int > Line (Text [i].length () + 1);
+            const int Len = ::FAStrUtf8ToArray (Text [i].c_str (), (int) Text [i].length (), Line.data (), (int) Line.size ());
+            if (0 < Len) {
+                Line.resize (Len);
+                Lines.push_back (Line);
+                CharCount += Len;
+            }
+        }
+
+        ///
+        /// check the results are the same and compare the speed
+        ///
+
+        std::vector < int > PackedResults;
+        std::vector < int > DenseResults;
+
+        const double PackedMs = Measure (Packed, Lines, &PackedResults);
+        const double DenseMs = Measure (Flat, Lines, &DenseResults);
+
+        LogAssert (PackedResults == DenseResults, "Results are different");
+
+        const double MChars = double (CharCount) * g_iterations / 1000000.0;
+
+        std::cout << "lines: " << Lines.size () << ", characters: " << CharCount
+            << ", iterations: " << g_iterations << '\n'
+            << "packed " << PackedMs << " ms (" << MChars * 1000.0 / PackedMs << " M chars/s), "
+            << "dense " << DenseMs << " ms (" << MChars * 1000.0 / DenseMs << " M chars/s), "
+            << "speedup " << PackedMs / DenseMs << "x\n";
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
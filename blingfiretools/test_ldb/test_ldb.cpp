@@ -1512,7 +1512,18 @@ void Process (const char * pLineStr, const int LineLen)
 
                 bool fPrinted = false;
 
-                for (int Tag = 1; Tag < Size; ++Tag) {
+                // no scores, if the language is known by the script only
+                if (NULL == pScores || NULL == pCounts) {
+
+                    const char * pStr;
+                    const int StrLen = p_tagset->Tag2Str (Lang, &pStr);
+
+                    if (-1 != StrLen) {
+                        std::cout << std::string (pStr, StrLen);
+                    }
+                }
+
+                for (int Tag = 1; Tag < Size && pScores && pCounts; ++Tag) {
 
                     const char * pStr;
                     const int StrLen = p_tagset->Tag2Str (Tag, &pStr);
@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FAUtils.h"
+#include "FAUtf8Utils.h"
+#include "FAException.h"
+#include "FAImageDump.h"
+#include "FALDB.h"
+#include "FAWbdConfKeeper.h"
+#include "FALexTools_t.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+const char * g_pLdbFile = NULL;
+const char * g_pInFile = NULL;
+int g_iterations = 3;
+int g_length = 100000;
+
+
+void usage () {
+
+  std::cout << "\n\
+Usage: test_lex_scan [OPTIONS]\n\
+\n\
+This program checks that the lexer returns the same results with and without\n\
+the memoization of the long scans and compares the speed on adversarial\n\
+inputs, such as long runs of punctuation, base64 blobs or minified JS.\n\
+\n\
+  --ldb=<ldb> - reads the compiled model with the [wbd] section from the\n\
+    <ldb> file, e.g. wbd.bin or sbd.bin, required\n\
+\n\
+  --in=<input> - reads additional input text from the <input> file,\n\
+    the whole file is processed as one text\n\
+\n\
+  --iterations=N - processes each input N times, 3 is used by default\n\
+\n\
+  --length=N - the length of the generated inputs in characters,\n\
+    100000 is used by default\n\
+";
+
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+  for (; argc--; ++argv){
+
+    if (!strcmp ("--help", *argv)) {
+        usage ();
+        exit (0);
+    }
+    if (0 == strncmp ("--ldb=", *argv, 6)) {
+        g_pLdbFile = &((*argv) [6]);
+        continue;
+    }
+    if (0 == strncmp ("--in=", *argv, 5)) {
+        g_pInFile = &((*argv) [5]);
+        continue;
+    }
+    if (0 == strncmp ("--iterations=", *argv, 13)) {
+        g_iterations = atoi (&((*argv) [13]));
+        continue;
+    }
+    if (0 == strncmp ("--length=", *argv, 9)) {
+        g_length = atoi (&((*argv) [9]));
+        continue;
+    }
+  }
+}
+
+
+// returns the Pattern repeated upto the Length bytes
+const std::string Repeat (const char * pPattern, const int Length)
+{
+    std::string Text;
+    while ((int) Text.length () < Length) {
+        Text += pPattern;
+    }
+    return Text;
+}
+
+
+// returns pseudo-random base64 text of the Length bytes
+const std::string Base64 (const int Length)
+{
+    const char * pAlphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string Text;
+    unsigned int Seed = 12345;
+
+    while ((int) Text.length () < Length) {
+        Seed = Seed * 1103515245 + 12345;
+        Text.push_back (pAlphabet [(Seed >> 16) % 64]);
+    }
+    return Text;
+}
+
+
+// returns the time in milliseconds to process the text g_iterations times
+const double Measure (
+        const FALexTools_t < int > & Engine,
+        const std::vector < int > & Text,
+        std::vector < int > * pResults
+    )
+{
+    const int MaxOutSize = (int) (3 * Text.size ()) + 3;
+    pResults->resize (MaxOutSize);
+
+    int OutSize = 0;
+
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now ();
+
+    for (int k = 0; k < g_iterations; ++k) {
+        OutSize = Engine.Process (Text.data (), (int) Text.size (), pResults->data (), MaxOutSize);
+    }
+
+    const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now ();
+
+    pResults->resize (0 < OutSize ? OutSize : 0);
+    pResults->push_back (OutSize);
+
+    return std::chrono::duration < double, std::milli > (End - Start).count () / g_iterations;
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    ::FAIOSetup ();
+
+    process_args (argc, argv);
+
+    try {
+
+        LogAssert (g_pLdbFile, "The --ldb parameter is required");
+
+        ///
+        /// load the model
+        ///
+
+        FAImageDump Img;
+        Img.Load (g_pLdbFile);
+        const unsigned char * pImgBytes = Img.GetImageDump ();
+        LogAssert (pImgBytes, "Cannot load %s", g_pLdbFile);
+
+        FALDB Ldb;
+        Ldb.SetImage (pImgBytes);
+
+        const int * pValues = NULL;
+        const int Size = Ldb.GetHeader ()->Get (FAFsmConst::FUNC_WBD, &pValues);
+        LogAssert (-1 != Size, "No [wbd] section in %s", g_pLdbFile);
+
+        FAWbdConfKeeper Conf;
+        Conf.Initialize (&Ldb, pValues, Size);
+
+        FALexTools_t < int > Linear;
+        Linear.SetConf (&Conf);
+
+        FALexTools_t < int > Plain;
+        Plain.SetConf (&Conf);
+        Plain.SetLinearScan (false);
+
+        ///
+        /// make the inputs
+        ///
+
+        std::vector < std::pair < std::string, std::string > > Inputs;
+
+        Inputs.push_back (std::make_pair ("text", Repeat ("The quick brown fox jumps over the lazy dog. ", g_length)));
+        Inputs.push_back (std::make_pair ("!!!", Repeat ("!", g_length)));
+        Inputs.push_back (std::make_pair ("---", Repeat ("-", g_length)));
+        Inputs.push_back (std::make_pair ("...", Repeat (".", g_length)));
+        Inputs.push_back (std::make_pair ("(((", Repeat ("(", g_length)));
+        Inputs.push_back (std::make_pair ("'''", Repeat ("'", g_length)));
+        Inputs.push_back (std::make_pair ("a.a.", Repeat ("a.", g_length)));
+        Inputs.push_back (std::make_pair ("A.A.", Repeat ("A.", g_length)));
+        Inputs.push_back (std::make_pair ("1.1.", Repeat ("1.", g_length)));
+        Inputs.push_back (std::make_pair ("a@b.", Repeat ("a@b.", g_length)));
+        Inputs.push_back (std::make_pair ("a1!", Repeat ("a1!", g_length)));
+        Inputs.push_back (std::make_pair ("base64", Base64 (g_length)));
+        Inputs.push_back (std::make_pair ("minified js", Repeat ("function(a,b){return a.b(c[d]+e)===f?g:h;};var x=y.z||{};", g_length)));
+        Inputs.push_back (std::make_pair ("urls", Repeat ("http://a.b/c?d=e&f=", g_length)));
+
+        if (g_pInFile) {
+            std::ifstream ifs (g_pInFile, std::ios::in | std::ios::binary);
+            FAAssertStream (&ifs, g_pInFile);
+            const std::string Text ((std::istreambuf_iterator < char > (ifs)), std::istreambuf_iterator < char > ());
+            Inputs.push_back (std::make_pair (g_pInFile, Text));
+        }
+
+        ///
+        /// check the results are the same and compare the speed
+        ///
+
+        for (size_t i = 0; i < Inputs.size (); ++i) {
+
+            const std::string & Utf8 = Inputs [i].second;
+
+            std::vector < int > Text (Utf8.length () + 1);
+            const int Len = ::FAStrUtf8ToArray (Utf8.c_str (), (int) Utf8.length (), Text.data (), (int) Text.size ());
+            LogAssert (0 <= Len, "Invalid UTF-8 in %s", Inputs [i].first.c_str ());
+            Text.resize (Len);
+
+            std::vector < int > PlainResults;
+            std::vector < int > LinearResults;
+
+            const double PlainMs = Measure (Plain, Text, &PlainResults);
+            const double LinearMs = Measure (Linear, Text, &LinearResults);
+
+            LogAssert (PlainResults == LinearResults, "Results are different for %s", Inputs [i].first.c_str ());
+
+            std::cout << Inputs [i].first << ": " << Len << " characters, "
+                << "plain " << PlainMs << " ms (" << PlainMs * 1000000.0 / Len << " ns/char), "
+                << "linear " << LinearMs << " ms (" << LinearMs * 1000000.0 / Len << " ns/char), "
+                << "speedup " << PlainMs / LinearMs << "x\n";
+        }
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
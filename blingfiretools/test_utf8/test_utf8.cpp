@@ -0,0 +1,429 @@
+/**
+ * Copyright (c) Microsoft Corporation. All rights reserved.
+ * Licensed under the MIT License.
+ */
+
+
+#include "FAConfig.h"
+#include "FAUtils.h"
+#include "FAUtf8Utils.h"
+#include "FAException.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace BlingFire;
+
+const char * __PROG__ = "";
+
+const char * g_pInFile = NULL;
+int g_iterations = 100;
+int g_random_tests = 100000;
+
+
+void usage () {
+
+  std::cout << "\n\
+Usage: test_utf8 [OPTIONS]\n\
+\n\
+This program checks that the UTF-8 to UTF-32 conversion functions return\n\
+the same results as the character by character decoding with FAUtf8ToInt\n\
+and compares their speed.\n\
+\n\
+  --in=<input> - reads input text from the <input> file, if omited a mostly\n\
+    ASCII text with some multi-byte characters is generated\n\
+\n\
+  --iterations=N - converts the input N times in each benchmark,\n\
+    100 is used by default\n\
+\n\
+  --random-tests=N - compares the results on N random byte sequences,\n\
+    100000 is used by default\n\
+";
+
+}
+
+
+void process_args (int& argc, char**& argv)
+{
+  for (; argc--; ++argv){
+
+    if (!strcmp ("--help", *argv)) {
+        usage ();
+        exit (0);
+    }
+    if (0 == strncmp ("--in=", *argv, 5)) {
+        g_pInFile = &((*argv) [5]);
+        continue;
+    }
+    if (0 == strncmp ("--iterations=", *argv, 13)) {
+        g_iterations = atoi (&((*argv) [13]));
+        continue;
+    }
+    if (0 == strncmp ("--random-tests=", *argv, 15)) {
+        g_random_tests = atoi (&((*argv) [15]));
+        continue;
+    }
+  }
+}
+
+
+// the character by character conversion, as the library used to do it
+const int RefUtf8ToArray (
+        const char * pStr,
+        const int Len,
+        int * pArray,
+        int * pOffsets,
+        const int MaxSize
+    )
+{
+    const char * pBegin = pStr;
+    const char * pEnd = pStr + Len;
+    const int * pArrayEnd = pArray + MaxSize;
+
+    if (3 <= Len) {
+        if (0xEF == (unsigned char) pStr [0] &&
+            0xBB == (unsigned char) pStr [1] &&
+            0xBF == (unsigned char) pStr [2])
+            pStr += 3;
+    }
+
+    int i = 0;
+    while (pStr < pEnd && pArray < pArrayEnd) {
+
+        const int Offset = (int) (pStr - pBegin);
+        pStr = FAUtf8ToInt (pStr, pEnd, pArray);
+
+        if (NULL == pStr) {
+            return -1;
+        }
+
+        pArray++;
+        if (pOffsets) {
+            pOffsets [i] = Offset;
+        }
+        i++;
+    }
+
+    return i;
+}
+
+
+// the byte by byte conversion, as the library used to do it
+const int RefUtf8AsBytesToArray (
+        const char * pStr,
+        const int Len,
+        int * pArray,
+        int * pOffsets,
+        const int MaxSize
+    )
+{
+    const char * pBegin = pStr;
+    const char * pEnd = pStr + Len;
+    const int * pArrayEnd = pArray + MaxSize;
+
+    if (3 <= Len) {
+        if (0xEF == (unsigned char) pStr [0] &&
+            0xBB == (unsigned char) pStr [1] &&
+            0xBF == (unsigned char) pStr [2])
+            pStr += 3;
+    }
+
+    int i = 0;
+    while (pStr < pEnd && pArray < pArrayEnd) {
+
+        const int Offset = (int) (pStr - pBegin);
+        *pArray++ = (unsigned char) *pStr++;
+        if (pOffsets) {
+            pOffsets [i] = Offset;
+        }
+        i++;
+    }
+
+    return i;
+}
+
+
+// returns a mostly ASCII text with some 2, 3 and 4 byte characters
+const std::string GenerateText ()
+{
+    const char * pWords [] = {
+        "The ", "quick ", "brown ", "fox ", "jumps ", "over ", "the ",
+        "lazy ", "dog. ", "http://www.example.com/index.html ",
+        "caf\xC3\xA9 ", "na\xC3\xAFve ", "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 ",
+        "\xE4\xB8\xAD\xE6\x96\x87 ", "\xF0\x9F\x98\x80 ", "1234567890, ",
+    };
+    const int WordCount = sizeof (pWords) / sizeof (pWords [0]);
+
+    std::string Text;
+    unsigned int Seed = 12345;
+
+    while (1000000 > Text.length ()) {
+        Seed = Seed * 1103515245 + 12345;
+        const int i = (Seed >> 16) % (WordCount * 4);
+        // make 3 of 4 words ASCII
+        Text += pWords [i < WordCount ? i : i % 10];
+    }
+
+    return Text;
+}
+
+
+// fills in the buffer with random bytes which are likely to be a valid UTF-8
+void GenerateRandom (std::string * pStr, unsigned int * pSeed)
+{
+    const unsigned char Bytes [] = {
+        'a', ' ', '\n', 0, 0x7F, 0x80, 0xBF, 0xC0, 0xC2, 0xDF, 0xE0, 0xED,
+        0xEF, 0xBB, 0xF0, 0xF4, 0xF5, 0xFF, 0x9F, 0xA0, 0x90, 0x8F,
+    };
+    const int ByteCount = sizeof (Bytes);
+
+    *pSeed = *pSeed * 1103515245 + 12345;
+    const int Len = (*pSeed >> 16) % 80;
+
+    pStr->clear ();
+
+    for (int i = 0; i < Len; ++i) {
+        *pSeed = *pSeed * 1103515245 + 12345;
+        const int r = (*pSeed >> 16) % (ByteCount * 3);
+        // the rest are ASCII letters
+        pStr->push_back ((char) (r < ByteCount ? Bytes [r] : 'a' + r % 26));
+    }
+}
+
+
+// runs both conversions and makes sure results are the same
+const bool Compare (const std::string & Str, const int MaxSize, const bool fAsBytes)
+{
+    const int Len = (int) Str.length ();
+    const char * pStr = Str.c_str ();
+
+    std::vector < int > Arr1 (MaxSize + 1, -2);
+    std::vector < int > Arr2 (MaxSize + 1, -2);
+    std::vector < int > Offsets1 (MaxSize + 1, -2);
+    std::vector < int > Offsets2 (MaxSize + 1, -2);
+
+    for (int k = 0; k < 2; ++k) {
+
+        const bool fOffsets = 1 == k;
+        int Res1;
+        int Res2;
+
+        if (fAsBytes) {
+            Res1 = RefUtf8AsBytesToArray (pStr, Len, Arr1.data (), fOffsets ? Offsets1.data () : NULL, MaxSize);
+            Res2 = fOffsets ?
+                ::FAStrUtf8AsBytesToArray (pStr, Len, Arr2.data (), Offsets2.data (), MaxSize) :
+                ::FAStrUtf8AsBytesToArray (pStr, Len, Arr2.data (), MaxSize);
+        } else {
+            Res1 = RefUtf8ToArray (pStr, Len, Arr1.data (), fOffsets ? Offsets1.data () : NULL, MaxSize);
+            Res2 = fOffsets ?
+                ::FAStrUtf8ToArray (pStr, Len, Arr2.data (), Offsets2.data (), MaxSize) :
+                ::FAStrUtf8ToArray (pStr, Len, Arr2.data (), MaxSize);
+        }
+
+        if (Res1 != Res2) {
+            return false;
+        }
+        // the content of the output is not defined for invalid input
+        if (0 < Res1 && (0 != memcmp (Arr1.data (), Arr2.data (), sizeof (int) * Res1) ||
+            (fOffsets && 0 != memcmp (Offsets1.data (), Offsets2.data (), sizeof (int) * Res1)))) {
+            return false;
+        }
+        // the output should not go beyond the MaxSize
+        if (-2 != Arr2 [MaxSize] || -2 != Offsets2 [MaxSize]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+typedef const int (*_TConvert) (const char * pStr, const int Len, int * pArray, int * pOffsets, const int MaxSize);
+
+const int LibUtf8ToArray (const char * pStr, const int Len, int * pArray, int * pOffsets, const int MaxSize)
+{
+    return pOffsets ?
+        ::FAStrUtf8ToArray (pStr, Len, pArray, pOffsets, MaxSize) :
+        ::FAStrUtf8ToArray (pStr, Len, pArray, MaxSize);
+}
+
+const int LibUtf8AsBytesToArray (const char * pStr, const int Len, int * pArray, int * pOffsets, const int MaxSize)
+{
+    return pOffsets ?
+        ::FAStrUtf8AsBytesToArray (pStr, Len, pArray, pOffsets, MaxSize) :
+        ::FAStrUtf8AsBytesToArray (pStr, Len, pArray, MaxSize);
+}
+
+
+// returns the time in milliseconds to convert all lines g_iterations times
+const double Measure (
+        _TConvert pConvert,
+        const std::vector < std::string > & Lines,
+        const bool fOffsets,
+        long long * pCheckSum
+    )
+{
+    size_t MaxLen = 0;
+    for (size_t i = 0; i < Lines.size (); ++i) {
+        MaxLen = std::max (MaxLen, Lines [i].length ());
+    }
+
+    std::vector < int > Arr (MaxLen + 1);
+    std::vector < int > Offsets (MaxLen + 1);
+
+    long long CheckSum = 0;
+
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now ();
+
+    for (int k = 0; k < g_iterations; ++k) {
+        for (size_t i = 0; i < Lines.size (); ++i) {
+
+            const std::string & Line = Lines [i];
+            const int Res = (*pConvert) (Line.c_str (), (int) Line.length (), Arr.data (),
+                fOffsets ? Offsets.data () : NULL, (int) MaxLen);
+
+            CheckSum += Res;
+            if (0 < Res) {
+                CheckSum += Arr [Res - 1];
+            }
+        }
+    }
+
+    const std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now ();
+
+    *pCheckSum = CheckSum;
+    return std::chrono::duration < double, std::milli > (End - Start).count ();
+}
+
+
+void Benchmark (const std::vector < std::string > & Lines)
+{
+    size_t ByteCount = 0;
+    for (size_t i = 0; i < Lines.size (); ++i) {
+        ByteCount += Lines [i].length ();
+    }
+
+    const double MBytes = double (ByteCount) * g_iterations / (1024.0 * 1024.0);
+
+    struct {
+        const char * m_pName;
+        _TConvert m_pRef;
+        _TConvert m_pLib;
+        bool m_fOffsets;
+    } Tests [] = {
+        { "FAStrUtf8ToArray", RefUtf8ToArray, LibUtf8ToArray, false },
+        { "FAStrUtf8ToArray with offsets", RefUtf8ToArray, LibUtf8ToArray, true },
+        { "FAStrUtf8AsBytesToArray", RefUtf8AsBytesToArray, LibUtf8AsBytesToArray, false },
+        { "FAStrUtf8AsBytesToArray with offsets", RefUtf8AsBytesToArray, LibUtf8AsBytesToArray, true },
+    };
+
+    std::cout << "lines: " << Lines.size () << ", bytes: " << ByteCount
+        << ", iterations: " << g_iterations << '\n';
+
+    for (size_t i = 0; i < sizeof (Tests) / sizeof (Tests [0]); ++i) {
+
+        long long RefSum = 0;
+        long long LibSum = 0;
+
+        const double RefMs = Measure (Tests [i].m_pRef, Lines, Tests [i].m_fOffsets, &RefSum);
+        const double LibMs = Measure (Tests [i].m_pLib, Lines, Tests [i].m_fOffsets, &LibSum);
+
+        LogAssert (RefSum == LibSum, "Results are different for %s", Tests [i].m_pName);
+
+        std::cout << Tests [i].m_pName << ": "
+            << "reference " << RefMs << " ms (" << MBytes * 1000.0 / RefMs << " MB/s), "
+            << "library " << LibMs << " ms (" << MBytes * 1000.0 / LibMs << " MB/s), "
+            << "speedup " << RefMs / LibMs << "x\n";
+    }
+}
+
+
+int __cdecl main (int argc, char ** argv)
+{
+    __PROG__ = argv [0];
+
+    --argc, ++argv;
+
+    ::FAIOSetup ();
+
+    process_args (argc, argv);
+
+    try {
+
+        ///
+        /// check the results are the same
+        ///
+
+        unsigned int Seed = 1;
+        std::string Str;
+
+        for (int i = 0; i < g_random_tests; ++i) {
+
+            GenerateRandom (&Str, &Seed);
+
+            // use different output sizes, including smaller than needed
+            const int MaxSize = 0 == i % 3 ? (int) Str.length () / 2 : (int) Str.length () + 1;
+
+            LogAssert (Compare (Str, MaxSize, false), "FAStrUtf8ToArray is different");
+            LogAssert (Compare (Str, MaxSize, true), "FAStrUtf8AsBytesToArray is different");
+        }
+
+        std::cout << "random tests: " << g_random_tests << " passed\n";
+
+        ///
+        /// compare the speed
+        ///
+
+        std::vector < std::string > Lines;
+
+        if (g_pInFile) {
+            std::ifstream ifs (g_pInFile, std::ios::in);
+            FAAssertStream (&ifs, g_pInFile);
+            std::string Line;
+            while (std::getline (ifs, Line)) {
+                if (!Line.empty ()) {
+                    Lines.push_back (Line);
+                }
+            }
+        } else {
+            // split the generated text into lines of various length
+            const std::string Text = GenerateText ();
+            size_t Pos = 0;
+            size_t Len = 8;
+            while (Pos < Text.length ()) {
+                // don't cut multi-byte characters
+                size_t End = std::min (Pos + Len, Text.length ());
+                while (End < Text.length () && 0x80 == (0xC0 & (unsigned char) Text [End])) {
+                    End++;
+                }
+                Lines.push_back (Text.substr (Pos, End - Pos));
+                Pos = End;
+                Len = 4096 <= Len ? 8 : Len * 2;
+            }
+        }
+
+        Benchmark (Lines);
+
+    } catch (const FAException & e) {
+
+        const char * const pErrMsg = e.GetErrMsg ();
+        const char * const pFile = e.GetSourceName ();
+        const int Line = e.GetSourceLine ();
+
+        std::cerr << "ERROR: " << pErrMsg << " in " << pFile \
+            << " at line " << Line << " in program " << __PROG__ << '\n';
+
+        return 2;
+
+    } catch (...) {
+
+        std::cerr << "ERROR: Unknown error in program " << __PROG__ << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 import os
 from ctypes import *
 import inspect
+import itertools
 import os.path
 import numpy as np
 import platform
@@ -167,6 +168,25 @@ def text_to_hashes(s, word_n_grams, bucketSize):
     return np.frombuffer(o_bytes, dtype=c_int32, count=o_len)
 
 
+# the same as text_to_hashes(text_to_words_with_model(h, s), ...) but does not make the intermediate string
+def text_to_hashes_with_model(s, word_n_grams, bucketSize, h = None):
+    # get the UTF-8 bytes
+    s_bytes = s.encode("utf-8")
+
+    # allocate the output buffer, there is at most one word per byte
+    o_bytes = (c_int32 * (word_n_grams * len(s_bytes) + 1))()
+    o_bytes_count = len(o_bytes)
+
+    o_len = blingfire.TextToHashesWithModel(c_char_p(s_bytes), c_int(len(s_bytes)), byref(o_bytes), c_int(o_bytes_count), c_int(word_n_grams), c_int(bucketSize), c_void_p(h))
+
+    # check if no error has happened
+    if -1 == o_len or o_len > o_bytes_count:
+        return None
+
+    # return numpy array without copying
+    return np.frombuffer(o_bytes, dtype=c_int32, count=o_len)
+
+
 def text_to_token_with_offsets(s, text_to_token_f, split_byte):    
     # get the UTF-8 bytes
     s_bytes = s.encode("utf-8")
@@ -234,12 +254,76 @@ def load_model(file_name):
     return h
 
 
+def load_model_mapped(file_name, prefetch = False):
+    s_bytes = file_name.encode("utf-8")
+    load_model_fn = blingfire.LoadModelMapped
+    load_model_fn.restype = c_void_p
+    h = load_model_fn(c_char_p(s_bytes), c_bool(prefetch))
+    return h
+
+
 def free_model(h):
     free_model_fn = blingfire.FreeModel
     free_model_fn.argtypes = [c_void_p]
     free_model_fn(c_void_p(h))
 
 
+# same as load_model, but the identical parts of the models loaded this way are kept once
+def load_model_shared(file_name):
+    s_bytes = file_name.encode("utf-8")
+    load_model_fn = blingfire.LoadModelShared
+    load_model_fn.restype = c_void_p
+    h = load_model_fn(c_char_p(s_bytes))
+    return h
+
+
+# returns the number of the unique parts of the shared models and their size in bytes
+def get_shared_dump_stats():
+    dumps = c_int64(0)
+    size = c_int64(0)
+    blingfire.GetSharedDumpStats(byref(dumps), byref(size))
+    return (dumps.value, size.value)
+
+
+# returns the hot path counters of the model as a dictionary, the dictionary is empty
+# if the library is built without BLING_FIRE_STATS
+def get_model_stats(h):
+    o_bytes = create_string_buffer(256)
+    o_len = blingfire.GetModelStatsNames(o_bytes, c_int(256))
+    names = o_bytes.value.decode("utf-8").split(' ') if 0 < o_len <= 256 else []
+    stats = (c_int64 * max(1, len(names)))()
+    count = blingfire.GetModelStats(c_void_p(h), stats, c_int(len(names)))
+    return dict(zip(names, stats[:max(0, count)]))
+
+
+def reset_model_stats(h):
+    return 1 == blingfire.ResetModelStats(c_void_p(h))
+
+
+# a slot keeps a model which can be replaced with swap_model_slot while it is used,
+# use acquire_model to get the current model and free_model to release it
+def create_model_slot(file_name):
+    s_bytes = file_name.encode("utf-8")
+    create_slot_fn = blingfire.CreateModelSlot
+    create_slot_fn.restype = c_void_p
+    return create_slot_fn(c_char_p(s_bytes))
+
+
+def swap_model_slot(slot, file_name):
+    s_bytes = file_name.encode("utf-8")
+    return 1 == blingfire.SwapModelSlot(c_void_p(slot), c_char_p(s_bytes))
+
+
+def acquire_model(slot):
+    acquire_model_fn = blingfire.AcquireModel
+    acquire_model_fn.restype = c_void_p
+    return acquire_model_fn(c_void_p(slot))
+
+
+def free_model_slot(slot):
+    blingfire.FreeModelSlot(c_void_p(slot))
+
+
 def text_to_ids(h, s, max_len, unk = 0, no_padding = False):
     # get the UTF-8 bytes
     s_bytes = s.encode("utf-8")
@@ -253,6 +337,24 @@ def text_to_ids(h, s, max_len, unk = 0, no_padding = False):
     return np.frombuffer(o_bytes, dtype=c_uint32, count = out_count)
 
 
+def text_to_ids_batch(h, texts, max_len, unk = 0, num_threads = 0):
+    # get the UTF-8 bytes of all texts
+    s_bytes = [s.encode("utf-8") for s in texts]
+    n = len(s_bytes)
+    # allocate the input arrays
+    i_strs = (c_char_p * n)(*s_bytes)
+    i_lens = (c_int * n)(*[len(b) for b in s_bytes])
+    # allocate the output buffers, rows are padded with 0's
+    o_ids = np.zeros((n, max_len), dtype=np.int32)
+    o_counts = np.zeros(n, dtype=np.int32)
+    # fill in the ids
+    blingfire.TextToIdsBatch(c_void_p(h), i_strs, i_lens, c_int(n), \
+        c_void_p(o_ids.__array_interface__['data'][0]), c_void_p(o_counts.__array_interface__['data'][0]), \
+        c_int(max_len), c_int(num_threads), c_int(unk))
+    # return the ids matrix and the number of ids in each row
+    return o_ids, np.minimum(o_counts, max_len)
+
+
 def ids_to_text(h, ids, skip_special_tokens = True, output_buffer_size = None):
     # allocate the output buffer
     if output_buffer_size is None:
@@ -269,6 +371,92 @@ def ids_to_text(h, ids, skip_special_tokens = True, output_buffer_size = None):
     return o_bytes.value.decode('utf-8')
 
 
+# the same as ids_to_text for a list of id sequences, the sequences are decoded with upto num_threads
+# threads, num_threads = 0 means to use all hardware threads, unknown ids are skipped
+def ids_to_text_batch(h, ids_list, skip_special_tokens = True, num_threads = 0):
+    n = len(ids_list)
+    if 0 == n:
+        return []
+    # put all the ids into one array
+    i_counts = (c_int * n)(*[len(ids) for ids in ids_list])
+    i_ids = (c_int32 * max(1, sum(i_counts)))(*[int(i) for ids in ids_list for i in ids])
+    o_sizes = (c_int * n)()
+    # compute the sizes of the texts
+    o_len = blingfire.IdsToTextBatch(c_void_p(h), i_ids, i_counts, c_int(n), None, o_sizes, c_int(0), c_bool(skip_special_tokens), c_int(num_threads))
+    if -1 == o_len:
+        return None
+    # write the texts
+    o_bytes = create_string_buffer(o_len)
+    blingfire.IdsToTextBatch(c_void_p(h), i_ids, i_counts, c_int(n), o_bytes, o_sizes, c_int(o_len), c_bool(skip_special_tokens), c_int(num_threads))
+    # split the output, each text is followed by 0
+    texts = []
+    offset = 0
+    for size in o_sizes:
+        texts.append(o_bytes.raw[offset:offset + size - 1].decode('utf-8'))
+        offset += size
+    return texts
+
+
+# returns the id of the token or -1 if the model does not have it
+def token_to_id(h, token):
+    b = token.encode('utf-8')
+    return blingfire.TokenToId(c_void_p(h), c_char_p(b), c_int(len(b)))
+
+
+# returns the ids of the tokens, unk is used for the tokens the model does not have
+def tokens_to_ids(h, tokens, unk = 0):
+    n = len(tokens)
+    if 0 == n:
+        return np.zeros(0, dtype=np.int32)
+    s_bytes = [t.encode('utf-8') for t in tokens]
+    i_strs = (c_char_p * n)(*s_bytes)
+    i_lens = (c_int * n)(*[len(b) for b in s_bytes])
+    o_ids = (c_int32 * n)()
+    blingfire.TokensToIds(c_void_p(h), i_strs, i_lens, c_int(n), o_ids, c_int(unk))
+    return np.frombuffer(o_ids, dtype=c_int32, count = n)
+
+
+# creates a decoder of ids which come one at a time, e.g. generated by a model, returns None if the
+# model does not have [i2w] configuration, the decoder should be freed with decoder_free
+def decoder_begin(h, skip_special_tokens = True):
+    decoder_begin_fn = blingfire.DecoderBegin
+    decoder_begin_fn.restype = c_void_p
+    return decoder_begin_fn(c_void_p(h), c_bool(skip_special_tokens))
+
+
+# reads the bytes returned by the decoder until there are no more, read_f(o_bytes, i) is called
+# with i = 0, 1, ... for the first and the next reads
+def decoder_read(read_f, max_len = 256):
+    o_bytes = create_string_buffer(max_len)
+    out = b''
+    i = 0
+    while True:
+        o_len = read_f(o_bytes, i)
+        if 0 > o_len:
+            raise ValueError("unknown id")
+        out += o_bytes.raw[:o_len]
+        if o_len < max_len:
+            return out
+        i += 1
+
+
+# adds the next id, returns the UTF-8 bytes of the text added, the bytes of an incomplete
+# UTF-8 character are returned when the character is complete
+def decoder_push(d, id):
+    # a negative id gets the bytes which did not fit
+    return decoder_read(lambda o_bytes, i: blingfire.DecoderPush(c_void_p(d), c_int32(id if 0 == i else -1), \
+        o_bytes, c_int(len(o_bytes))))
+
+
+# ends the sequence, returns the remaining UTF-8 bytes
+def decoder_flush(d):
+    return decoder_read(lambda o_bytes, i: blingfire.DecoderFlush(c_void_p(d), o_bytes, c_int(len(o_bytes))))
+
+
+def decoder_free(d):
+    blingfire.DecoderFree(c_void_p(d))
+
+
 def utf8text_to_ids_with_offsets(h, s_bytes, max_len, unk = 0, no_padding = False):
     # allocate the output buffers
     o_bytes = (c_int32 * max_len)()
@@ -286,3 +474,225 @@ def utf8text_to_ids_with_offsets(h, s_bytes, max_len, unk = 0, no_padding = Fals
 
 def change_settings_dummy_prefix(h, add_prefix):
     blingfire.SetNoDummyPrefix(c_void_p(h), c_int(not add_prefix))
+
+
+# builds a flat transition table of upto max_memory bytes to speed up text_to_words / text_to_sentences
+# with the model h, the table is freed if max_memory is 0, returns the number of states in the table
+def set_dense_dfa(h, max_memory = 4 * 1024 * 1024):
+    return blingfire.SetDenseDfa(c_void_p(h), c_int(max_memory))
+
+
+def set_tok_algo(h, tok_algo):
+    return blingfire.SetTokAlgo(c_void_p(h), c_int(tok_algo))
+
+
+# enables the cache of the tokenization results of the words of upto max_memory bytes for text_to_ids
+# with the model h, the cache is freed if max_memory is 0, returns the number of words the cache can keep
+def set_word_cache(h, max_memory = 4 * 1024 * 1024):
+    return blingfire.SetWordCache(c_void_p(h), c_int(max_memory))
+
+
+def clear_word_cache(h):
+    return blingfire.ClearWordCache(c_void_p(h))
+
+
+# returns the number of the words found and not found in the cache as a tuple (hits, misses)
+def get_word_cache_stats(h):
+    hits = c_int64(0)
+    misses = c_int64(0)
+    blingfire.GetWordCacheStats(c_void_p(h), byref(hits), byref(misses))
+    return (hits.value, misses.value)
+
+
+def utf8text_to_spans(text_to_spans_f, s_bytes, h, *args):
+    # at most one word / sentence per byte
+    max_len = len(s_bytes)
+    o_starts = (c_int32 * max_len)()
+    o_ends = (c_int32 * max_len)()
+    # get the [start, end] byte offsets of the words / sentences
+    o_len = text_to_spans_f(c_char_p(s_bytes), c_int(len(s_bytes)), byref(o_starts), byref(o_ends), c_int(max_len), c_void_p(h), *args)
+    if 0 >= o_len:
+        return ( np.zeros(0, dtype=c_int32), np.zeros(0, dtype=c_int32) )
+    # return numpy arrays without copying
+    return ( np.frombuffer(o_starts, dtype=c_int32, count = o_len), 
+             np.frombuffer(o_ends, dtype=c_int32, count = o_len) )
+
+
+def utf8text_to_word_spans(s_bytes, h = None):
+    return utf8text_to_spans(blingfire.TextToWordSpansWithModel, s_bytes, h)
+
+
+def utf8text_to_sentence_spans(s_bytes, h = None):
+    return utf8text_to_spans(blingfire.TextToSentenceSpansWithModel, s_bytes, h)
+
+
+# the same as utf8text_to_word_spans, but a big text is processed with upto num_threads threads,
+# num_threads = 0 means to use all hardware threads
+def utf8text_to_word_spans_parallel(s_bytes, h = None, num_threads = 0):
+    return utf8text_to_spans(blingfire.TextToWordSpansParallel, s_bytes, h, c_int(num_threads))
+
+
+# the same as utf8text_to_sentence_spans, but a big text is processed with upto num_threads threads,
+# num_threads = 0 means to use all hardware threads
+def utf8text_to_sentence_spans_parallel(s_bytes, h = None, num_threads = 0):
+    return utf8text_to_spans(blingfire.TextToSentenceSpansParallel, s_bytes, h, c_int(num_threads))
+
+
+def load_lad_model(file_name):
+    s_bytes = file_name.encode("utf-8")
+    load_model_fn = blingfire.LoadLadModel
+    load_model_fn.restype = c_void_p
+    h = load_model_fn(c_char_p(s_bytes))
+    return h
+
+
+def free_lad_model(h):
+    free_model_fn = blingfire.FreeLadModel
+    free_model_fn.argtypes = [c_void_p]
+    free_model_fn(c_void_p(h))
+
+
+# returns a list of (language, score) tuples, the best language goes first
+def detect_language(h, s, max_count = 1):
+    s_bytes = s.encode("utf-8")
+    o_langs = (c_int * max_count)()
+    o_scores = (c_float * max_count)()
+    o_len = blingfire.DetectLanguage(c_void_p(h), c_char_p(s_bytes), c_int(len(s_bytes)), byref(o_langs), byref(o_scores), c_int(max_count))
+    return [(o_langs[i], o_scores[i]) for i in range(max(o_len, 0))]
+
+
+# returns [n x max_count] matrices of languages and scores and the number of languages in each row
+def detect_language_batch(h, texts, max_count = 1, num_threads = 0):
+    s_bytes = [s.encode("utf-8") for s in texts]
+    n = len(s_bytes)
+    i_strs = (c_char_p * n)(*s_bytes)
+    i_lens = (c_int * n)(*[len(b) for b in s_bytes])
+    o_langs = np.zeros((n, max_count), dtype=np.int32)
+    o_scores = np.zeros((n, max_count), dtype=np.float32)
+    o_counts = np.zeros(n, dtype=np.int32)
+    blingfire.DetectLanguageBatch(c_void_p(h), i_strs, i_lens, c_int(n), \
+        c_void_p(o_langs.__array_interface__['data'][0]), c_void_p(o_scores.__array_interface__['data'][0]), \
+        c_void_p(o_counts.__array_interface__['data'][0]), c_int(max_count), c_int(num_threads))
+    return o_langs, o_scores, np.maximum(o_counts, 0)
+
+
+def load_stemmer_model(file_name):
+    s_bytes = file_name.encode("utf-8")
+    load_model_fn = blingfire.LoadStemmerModel
+    load_model_fn.restype = c_void_p
+    h = load_model_fn(c_char_p(s_bytes))
+    return h
+
+
+def free_stemmer_model(h):
+    free_model_fn = blingfire.FreeStemmerModel
+    free_model_fn.argtypes = [c_void_p]
+    free_model_fn(c_void_p(h))
+
+
+# returns (hits, misses) of the base forms cache of the stemmer model
+def get_stemmer_cache_stats(h):
+    hits = c_int64(0)
+    misses = c_int64(0)
+    blingfire.GetStemmerCacheStats(c_void_p(h), byref(hits), byref(misses))
+    return (hits.value, misses.value)
+
+
+# calls the function with a bigger output buffer if the output does not fit
+def call_with_output_buffer(f, size):
+    o_bytes = create_string_buffer(size)
+    o_len = f(o_bytes)
+    if o_len > size:
+        o_bytes = create_string_buffer(o_len)
+        o_len = f(o_bytes)
+    if 0 >= o_len or o_len > len(o_bytes):
+        return ''
+    return o_bytes.value.decode('utf-8')
+
+
+# returns a list of the base forms of the words given by the [start, end] byte offsets in s_bytes,
+# e.g. from utf8text_to_word_spans, the unknown words are returned as is, raises ValueError if the
+# offsets are invalid or the words are not valid UTF-8
+def utf8words_to_base_forms(h_stemmer, s_bytes, starts, ends):
+    n = len(starts)
+    i_starts = (c_int32 * n)(*starts)
+    i_ends = (c_int32 * n)(*ends)
+    o_len = []
+    def words_to_base_forms(o_bytes):
+        o_len.append(blingfire.WordsToBaseForms(c_void_p(h_stemmer), c_char_p(s_bytes), c_int(len(s_bytes)), \
+            i_starts, i_ends, c_int(n), o_bytes, c_int(len(o_bytes))))
+        return o_len[-1]
+    out = call_with_output_buffer(words_to_base_forms, len(s_bytes) * 2 + 1)
+    if 0 > o_len[-1]:
+        raise ValueError("invalid word offsets, UTF-8 input or stemmer model")
+    return out.split(' ') if 0 < n else []
+
+
+# splits the text into words and returns a string of their ' ' delimited base forms,
+# h is an optional word breaking model
+def text_to_base_forms(h_stemmer, s, h = None):
+    s_bytes = s.encode("utf-8")
+    return call_with_output_buffer(lambda o_bytes: blingfire.TextToWordsWithBaseForms(c_char_p(s_bytes), \
+        c_int(len(s_bytes)), o_bytes, None, None, c_int(len(o_bytes)), c_void_p(h), c_void_p(h_stemmer)), \
+        len(s_bytes) * 2 + 1)
+
+
+
+# creates the stream with begin_f, feeds the chunks of UTF-8 bytes into it and yields the tuples
+# of the results, the stream is created on the first iteration so an unused generator leaks nothing,
+# raises ValueError on the first iteration if the stream cannot be created for the model
+def stream_results(begin_f, chunks, feed_f, flush_f, free_f, o_arrays):
+    stream = begin_f()
+    if not stream:
+        raise ValueError("cannot create a stream for this model")
+    max_count = len(o_arrays[0])
+    o_refs = [byref(a) for a in o_arrays]
+    try:
+        # None marks the end of the text
+        for chunk in itertools.chain(chunks, [None]):
+            if chunk is None:
+                o_len = flush_f(c_void_p(stream), *o_refs, c_int(max_count))
+            else:
+                o_len = feed_f(c_void_p(stream), c_char_p(chunk), c_int(len(chunk)), *o_refs, c_int(max_count))
+            while True:
+                if 0 > o_len:
+                    raise ValueError("invalid UTF-8 input")
+                for i in range(o_len):
+                    yield tuple(a[i] for a in o_arrays)
+                if o_len < max_count:
+                    break
+                # get the results which did not fit
+                if chunk is None:
+                    o_len = flush_f(c_void_p(stream), *o_refs, c_int(max_count))
+                else:
+                    o_len = feed_f(c_void_p(stream), None, c_int(0), *o_refs, c_int(max_count))
+    finally:
+        free_f(c_void_p(stream))
+
+
+# splits a text coming in chunks of UTF-8 bytes into sentences, yields (start, end) byte offsets
+# of the sentences as soon as they are found, the offsets are from the beginning of the text
+def utf8chunks_to_sentence_spans(chunks, h = None, max_count = 1024):
+    sbd_begin_fn = blingfire.SbdBegin
+    sbd_begin_fn.restype = c_void_p
+    return stream_results(lambda: sbd_begin_fn(c_void_p(h)), chunks, blingfire.SbdFeed, blingfire.SbdFlush, blingfire.SbdFree,
+        [(c_int64 * max_count)(), (c_int64 * max_count)()])
+
+
+# splits a text coming in chunks of UTF-8 bytes into words, yields (tag, start, end) of the words
+# as soon as they are found, start and end are byte offsets from the beginning of the text
+def utf8chunks_to_word_spans(chunks, h = None, max_count = 1024):
+    wbd_begin_fn = blingfire.WbdBegin
+    wbd_begin_fn.restype = c_void_p
+    return stream_results(lambda: wbd_begin_fn(c_void_p(h)), chunks, blingfire.WbdFeed, blingfire.WbdFlush, blingfire.WbdFree,
+        [(c_int32 * max_count)(), (c_int64 * max_count)(), (c_int64 * max_count)()])
+
+
+# tokenizes a text coming in chunks of UTF-8 bytes with a word-piece model, yields (id, start, end)
+# of the tokens as soon as they are found, start and end are byte offsets from the beginning of the text,
+# segmentation (sentence piece / BPE) models are not supported by WbdBeginIds and raise ValueError
+def utf8chunks_to_ids_with_offsets(chunks, h, unk = 0, max_count = 1024):
+    wbd_begin_fn = blingfire.WbdBeginIds
+    wbd_begin_fn.restype = c_void_p
+    return stream_results(lambda: wbd_begin_fn(c_void_p(h), c_int(unk)), chunks, blingfire.WbdFeed, blingfire.WbdFlush, blingfire.WbdFree,
+        [(c_int32 * max_count)(), (c_int64 * max_count)(), (c_int64 * max_count)()])
@@ -37,6 +37,48 @@ endif
 
 build_first = $(built_prefix) $(built_charmap)
 
+#
+# Build cache (optional):
+#
+#   BUILD_CACHE=<dir> - the stages with the same inputs and options are
+#     taken from the <dir>, see fa_build_cache, the keys of the script
+#     stages also cover the programs the scripts run and the files the
+#     lexer rules include
+#   JOBS=N - the dumps are packed with N concurrent jobs right before the
+#     merge, requires BUILD_CACHE
+#
+
+ifneq ($(BUILD_CACHE),)
+  cached = fa_build_cache --cache-dir=$(BUILD_CACHE) --
+  # $(call cached_with,<programs>,<options>) also keys the <programs>
+  cached_with = fa_build_cache --cache-dir=$(BUILD_CACHE) $(2) $(addprefix --key-file=,$(sort $(1))) --
+  ifneq ($(JOBS),)
+    pack_jobs = $(tmpdir)/pack.$(mode).jobs
+    pack = fa_build_cache --cache-dir=$(BUILD_CACHE) --add-job=$(pack_jobs) -- fa_fsm2fsm_pack
+  endif
+endif
+
+ifeq ($(pack),)
+  pack = $(cached) fa_fsm2fsm_pack
+endif
+
+# the programs the build scripts run
+tools_nfa2mindfa = fa_nfa2mindfa fa_nfa2dfa fa_nfa2revnfa fa_dfa2mindfa fa_fsm_renum
+tools_guesser = fa_build_word_guesser fa_line2chain_unicode fa_chains2mindfa \
+  fa_dict2classifier fa_nfalist2nfa fa_fsm2fsm fa_fsm_renum $(tools_nfa2mindfa)
+tools_suff = fa_suff2chains fa_chains2mindfa fa_dict2classifier fa_nfalist2nfa \
+  fa_fsm2fsm fa_fsm_renum $(tools_nfa2mindfa)
+tools_dict = fa_line2chain_unicode fa_chains2mindfa fa_dict_split fa_dfa2mph \
+  fa_fsm2fsm fa_fsm_renum
+tools_pats = fa_build_dict fa_hyph2chains fa_iwowsuff2pats fa_pats_select \
+  fa_fsm2fsm_pack $(tools_dict)
+tools_ngrams = fa_count2prob fa_merge_stat fa_sortbytes fa_num2int fa_line_format \
+  fa_fsm_renum $(tools_guesser)
+tools_w2t_prob = fa_cutoff fa_extend_cxp fa_line2chain_unicode $(tools_ngrams)
+tools_lex = fa_preproc fa_pr2wre fa_re2re_simplify fa_re2nfa fa_nfalist2nfa \
+  fa_fsm2fsm_iwec fa_nfa2dfa fa_fsm_renum fa_dfa2mindfa fa_fsm2fsm \
+  fa_fsm2fsm_pack fa_merge_dumps
+
 ifeq ($(USE_TEST_WTBT_DICT), 1)
   WTBT_DICT = $(tmpdir)/wtbt.dict.utf8
   TEST_WTBT_DICT = $(tmpdir)/test.wtbt.dict.utf8
@@ -86,6 +128,10 @@ clean:
 	cd $(tmpdir) && rm *
 
 $(OUTPUT): $(tmpdir)/ldb.conf.$(mode).dump $(resources)
+ifneq ($(pack_jobs),)
+	fa_build_cache --cache-dir=$(BUILD_CACHE) --threads=$(JOBS) --jobs=$(pack_jobs)
+	rm -f $(pack_jobs)
+endif
 	fa_merge_dumps --out=$(OUTPUT) $(tmpdir)/ldb.conf.$(mode).dump $(resources)
 
 all: dirs $(OUTPUT)
@@ -101,145 +147,145 @@ dist:
 #
 
 $(tmpdir)/wt2bt.suff.fsa.$(mode).dump: $(tmpdir)/wt2bt.suff.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/wt2bt.suff.acts.$(mode).dump: $(tmpdir)/wt2bt.suff.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/wt2b.suff.fsa.$(mode).dump: $(tmpdir)/wt2b.suff.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/wt2b.suff.acts.$(mode).dump: $(tmpdir)/wt2b.suff.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/bt2wt.suff.fsa.$(mode).dump: $(tmpdir)/bt2wt.suff.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/bt2wt.suff.acts.$(mode).dump: $(tmpdir)/bt2wt.suff.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/b2wt.suff.fsa.$(mode).dump: $(tmpdir)/b2wt.suff.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/b2wt.suff.acts.$(mode).dump: $(tmpdir)/b2wt.suff.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2b.suff.fsa.$(mode).dump: $(tmpdir)/w2b.suff.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2b.suff.acts.$(mode).dump: $(tmpdir)/w2b.suff.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/b2w.suff.fsa.$(mode).dump: $(tmpdir)/b2w.suff.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_fsa) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/b2w.suff.acts.$(mode).dump: $(tmpdir)/b2w.suff.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_suff_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2t.fsa.$(mode).dump: $(tmpdir)/w2t.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_word_guesser) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_word_guesser) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/prefixes.fsa.$(mode).dump: $(tmpdir)/prefixes.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_prefixes) --in=$< --out=$@ --auto-test
+	$(cached) fa_fsm2fsm_pack $(opt_pack_prefixes) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/segs.fsa.$(mode).dump: $(tmpdir)/segs.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_segs) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_segs) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/tag.dict.fsm.$(mode).dump: $(tmpdir)/tag.dict.fsm.txt
-	fa_fsm2fsm_pack $(opt_pack_dict_fsm) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dict_fsm) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/tag.dict.k2i.$(mode).dump: $(tmpdir)/tag.dict.k2i.txt
-	fa_fsm2fsm_pack $(opt_pack_dict_k2i) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dict_k2i) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/tag.dict.i2t.$(mode).dump: $(tmpdir)/tag.dict.i2t.txt
-	fa_fsm2fsm_pack $(opt_pack_dict_i2t) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dict_i2t) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/pos.dict.fsm.$(mode).dump: $(tmpdir)/pos.dict.fsm.txt
-	fa_fsm2fsm_pack $(opt_pack_dict_fsm)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dict_fsm)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/pos.dict.k2i.$(mode).dump: $(tmpdir)/pos.dict.k2i.txt
-	fa_fsm2fsm_pack $(opt_pack_dict_k2i)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dict_k2i)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/pos.dict.i2t.$(mode).dump: $(tmpdir)/pos.dict.i2t.txt
-	fa_fsm2fsm_pack $(opt_pack_dict_i2t)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dict_i2t)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2h.fsm.$(mode).dump: $(tmpdir)/w2h.fsm.txt
-	fa_fsm2fsm_pack $(opt_pack_w2h_fsm) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2h_fsm) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2h.i2h.$(mode).dump: $(tmpdir)/w2h.i2h.txt
-	fa_fsm2fsm_pack $(opt_pack_w2h_i2h) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2h_i2h) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2h.acts.$(mode).dump: $(tmpdir)/w2h.acts.txt
-	fa_fsm2fsm_pack $(opt_pack_w2h_acts) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2h_acts) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tp.fsa.$(mode).dump: $(tmpdir)/w2tp.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_w2tp) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2tp) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tpl.fsa.$(mode).dump: $(tmpdir)/w2tpl.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_w2tpl) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2tpl) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tpr.fsa.$(mode).dump: $(tmpdir)/w2tpr.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_w2tpr) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2tpr) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tp.dict.fsa.$(mode).dump: $(tmpdir)/w2tp.dict.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_w2tp_dict) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2tp_dict) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tp.raw.dict.fsa.$(mode).dump: $(tmpdir)/w2tp.raw.dict.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_w2tp_raw_dict)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_w2tp_raw_dict)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tp.dict.minmax.$(mode).dump: $(tmpdir)/w2tp.dict.minmax.txt
-	fa_fsm2fsm_pack $(opt_pack_minmax) $(opt_pack_w2tp_dict_minmax)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_minmax) $(opt_pack_w2tp_dict_minmax)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/w2tp.raw.dict.minmax.$(mode).dump: $(tmpdir)/w2tp.raw.dict.minmax.txt
-	fa_fsm2fsm_pack $(opt_pack_minmax) $(opt_pack_w2tp_raw_dict_minmax)   --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_minmax) $(opt_pack_w2tp_raw_dict_minmax)   --in=$< --out=$@ --auto-test
 
 $(tmpdir)/num.arr.$(mode).dump: $(srcdir)/num.arr.txt
-	fa_fsm2fsm_pack --type=arr $(opt_pack_num_arr) --in=$< --out=$@ --auto-test
+	$(pack) --type=arr $(opt_pack_num_arr) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/t2p.num.arr.$(mode).dump: $(tmpdir)/t2p.num.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_t2p)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_t2p)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/tt2p.num.arr.$(mode).dump: $(tmpdir)/tt2p.num.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_tt2p) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_tt2p) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/ttt2p.num.arr.$(mode).dump: $(tmpdir)/ttt2p.num.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_ttt2p) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_ttt2p) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/t2p.raw.arr.$(mode).dump: $(tmpdir)/t2p.raw.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_t2p)  --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_t2p)  --in=$< --out=$@ --auto-test
 
 $(tmpdir)/t2p.prob.arr.$(mode).dump: $(tmpdir)/t2p.prob.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_t2p) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_t2p) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/tt2p.prob.arr.$(mode).dump: $(tmpdir)/tt2p.prob.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_tt2p) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_tt2p) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/ttt2p.prob.arr.$(mode).dump: $(tmpdir)/ttt2p.prob.arr.txt
-	fa_fsm2fsm_pack $(opt_pack_ttt2p) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_ttt2p) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/t2p.minmax.$(mode).dump: $(tmpdir)/t2p.minmax.txt
-	fa_fsm2fsm_pack $(opt_pack_minmax) $(opt_pack_t2p_minmax) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_minmax) $(opt_pack_t2p_minmax) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/tt2p.minmax.$(mode).dump: $(tmpdir)/tt2p.minmax.txt
-	fa_fsm2fsm_pack $(opt_pack_minmax) $(opt_pack_tt2p_minmax) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_minmax) $(opt_pack_tt2p_minmax) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/ttt2p.minmax.$(mode).dump: $(tmpdir)/ttt2p.minmax.txt
-	fa_fsm2fsm_pack $(opt_pack_minmax) $(opt_pack_ttt2p_minmax) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_minmax) $(opt_pack_ttt2p_minmax) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/dom.fsa.$(mode).dump: $(tmpdir)/dom.fsa.txt
-	fa_fsm2fsm_pack $(opt_pack_dom) --in=$< --out=$@ --auto-test
+	$(pack) $(opt_pack_dom) --in=$< --out=$@ --auto-test
 
 $(tmpdir)/wbd.fsa.$(mode).dump: $(tmpdir)/wbd.rules.fsa.txt $(tmpdir)/wbd.rules.fsa.iwmap.txt
-	fa_fsm2fsm_pack $(opt_pack_wbd_fsa) --in=$(tmpdir)/wbd.rules.fsa.txt --iw-map=$(tmpdir)/wbd.rules.fsa.iwmap.txt --out=$(tmpdir)/wbd.fsa.$(mode).dump
+	$(pack) $(opt_pack_wbd_fsa) --in=$(tmpdir)/wbd.rules.fsa.txt --iw-map=$(tmpdir)/wbd.rules.fsa.iwmap.txt --out=$(tmpdir)/wbd.fsa.$(mode).dump
 
 $(tmpdir)/wbd.mmap.$(mode).dump: $(tmpdir)/wbd.rules.map.txt
-	fa_fsm2fsm_pack $(opt_pack_wbd_mmap) --in=$(tmpdir)/wbd.rules.map.txt --out=$(tmpdir)/wbd.mmap.$(mode).dump --auto-test
+	$(pack) $(opt_pack_wbd_mmap) --in=$(tmpdir)/wbd.rules.map.txt --out=$(tmpdir)/wbd.mmap.$(mode).dump --auto-test
 
 $(tmpdir)/charmap.mmap.$(mode).dump: $(tmpdir)/charmap.mmap.txt
-	fa_fsm2fsm_pack $(opt_pack_charmap) --in=$(tmpdir)/charmap.mmap.txt --out=$(tmpdir)/charmap.mmap.$(mode).dump --auto-test
+	$(cached) fa_fsm2fsm_pack $(opt_pack_charmap) --in=$(tmpdir)/charmap.mmap.txt --out=$(tmpdir)/charmap.mmap.$(mode).dump --auto-test
 
 $(tmpdir)/id2word.arr.$(mode).dump: $(tmpdir)/id2word.utf8
-	fa_fsm2fsm_pack $(opt_pack_id2word) --in=$(tmpdir)/id2word.utf8 --out=$(tmpdir)/id2word.arr.$(mode).dump --auto-test
+	$(pack) $(opt_pack_id2word) --in=$(tmpdir)/id2word.utf8 --out=$(tmpdir)/id2word.arr.$(mode).dump --auto-test
 
 
 
@@ -248,12 +294,12 @@ $(tmpdir)/id2word.arr.$(mode).dump: $(tmpdir)/id2word.utf8
 #
 
 $(tmpdir)/ldb.mmap.$(mode).txt: $(srcdir)/ldb.conf.$(mode)
-	fa_build_conf \
+	$(cached) fa_build_conf \
 	  --in=$(srcdir)/ldb.conf.$(mode) \
 	  --out=$(tmpdir)/ldb.mmap.$(mode).txt
 
 $(tmpdir)/ldb.conf.$(mode).dump: $(tmpdir)/ldb.mmap.$(mode).txt
-	fa_fsm2fsm_pack --type=mmap \
+	$(pack) --type=mmap \
 	  --in=$(tmpdir)/ldb.mmap.$(mode).txt \
 	  --out=$(tmpdir)/ldb.conf.$(mode).dump \
 	  --auto-test
@@ -335,7 +381,7 @@ $(tmpdir)/wt2b.suffs.utf8: $(WTBT_DICT) $(srcdir)/tagset.txt $(built_prefix)
 $(tmpdir)/wt2b.suff.fsa.txt \
 $(tmpdir)/wt2b.suff.acts.txt: $(tmpdir)/wt2b.suffs.utf8 \
                                $(srcdir)/tagset.txt
-	fa_build_suff $(opt_build_suff) $(opt_build_suff_wt2b) \
+	$(call cached_with,$(tools_suff)) fa_build_suff $(opt_build_suff) $(opt_build_suff_wt2b) \
 	  --in=$(tmpdir)/wt2b.suffs.utf8 \
 	  --tagset=$(srcdir)/tagset.txt \
 	  --out1=$(tmpdir)/wt2b.suff.fsa.txt \
@@ -350,7 +396,7 @@ $(tmpdir)/b2wt.suffs.utf8: $(WTBT_DICT) $(srcdir)/tagset.txt $(built_prefix)
 $(tmpdir)/b2wt.suff.fsa.txt \
 $(tmpdir)/b2wt.suff.acts.txt: $(tmpdir)/b2wt.suffs.utf8 \
                                $(srcdir)/tagset.txt
-	fa_build_suff $(opt_build_suff) $(opt_build_suff_b2wt) \
+	$(call cached_with,$(tools_suff)) fa_build_suff $(opt_build_suff) $(opt_build_suff_b2wt) \
 	  --in=$(tmpdir)/b2wt.suffs.utf8 \
 	  --tagset=$(srcdir)/tagset.txt \
 	  --out1=$(tmpdir)/b2wt.suff.fsa.txt \
@@ -365,7 +411,7 @@ $(tmpdir)/wt2bt.suffs.utf8: $(WTBT_DICT) $(srcdir)/tagset.txt $(built_prefix)
 $(tmpdir)/wt2bt.suff.fsa.txt \
 $(tmpdir)/wt2bt.suff.acts.txt: $(tmpdir)/wt2bt.suffs.utf8 \
                                $(srcdir)/tagset.txt
-	fa_build_suff $(opt_build_suff) $(opt_build_suff_wt2bt) \
+	$(call cached_with,$(tools_suff)) fa_build_suff $(opt_build_suff) $(opt_build_suff_wt2bt) \
 	  --in=$(tmpdir)/wt2bt.suffs.utf8 \
 	  --tagset=$(srcdir)/tagset.txt \
 	  --out1=$(tmpdir)/wt2bt.suff.fsa.txt \
@@ -380,7 +426,7 @@ $(tmpdir)/bt2wt.suffs.utf8: $(WTBT_DICT) $(srcdir)/tagset.txt $(built_prefix)
 $(tmpdir)/bt2wt.suff.fsa.txt \
 $(tmpdir)/bt2wt.suff.acts.txt: $(tmpdir)/bt2wt.suffs.utf8 \
                                $(srcdir)/tagset.txt
-	fa_build_suff $(opt_build_suff) $(opt_build_suff_bt2wt) \
+	$(call cached_with,$(tools_suff)) fa_build_suff $(opt_build_suff) $(opt_build_suff_bt2wt) \
 	  --in=$(tmpdir)/bt2wt.suffs.utf8 \
 	  --tagset=$(srcdir)/tagset.txt \
 	  --out1=$(tmpdir)/bt2wt.suff.fsa.txt \
@@ -394,7 +440,7 @@ $(tmpdir)/w2b.suffs.utf8: $(WTBT_DICT) $(built_prefix)
 
 $(tmpdir)/w2b.suff.fsa.txt \
 $(tmpdir)/w2b.suff.acts.txt: $(tmpdir)/w2b.suffs.utf8
-	fa_build_suff $(opt_build_suff) $(opt_build_suff_w2b) \
+	$(call cached_with,$(tools_suff)) fa_build_suff $(opt_build_suff) $(opt_build_suff_w2b) \
 	  --in=$(tmpdir)/w2b.suffs.utf8 \
 	  --out1=$(tmpdir)/w2b.suff.fsa.txt \
 	  --out2=$(tmpdir)/w2b.suff.acts.txt
@@ -407,7 +453,7 @@ $(tmpdir)/b2w.suffs.utf8: $(WTBT_DICT) $(built_prefix)
 
 $(tmpdir)/b2w.suff.fsa.txt \
 $(tmpdir)/b2w.suff.acts.txt: $(tmpdir)/b2w.suffs.utf8
-	fa_build_suff $(opt_build_suff) $(opt_build_suff_b2w) \
+	$(call cached_with,$(tools_suff)) fa_build_suff $(opt_build_suff) $(opt_build_suff_b2w) \
 	  --in=$(tmpdir)/b2w.suffs.utf8 \
 	  --out1=$(tmpdir)/b2w.suff.fsa.txt \
 	  --out2=$(tmpdir)/b2w.suff.acts.txt
@@ -435,7 +481,7 @@ $(tmpdir)/tag.dict.k2i.txt \
 $(tmpdir)/tag.dict.i2t.txt: $(srcdir)/tag.dict.tagset.txt \
                              $(srcdir)/tag.dict.utf8.zip $(build_first)
 	unzip -p $(srcdir)/tag.dict.utf8.zip | \
-	fa_build_dict $(opt_build_dict) $(opt_build_tag_dict) \
+	$(call cached_with,$(tools_dict),--stdin) fa_build_dict $(opt_build_dict) $(opt_build_tag_dict) \
 	  --tagset=$(srcdir)/tag.dict.tagset.txt \
 	  --out-fsm=$(tmpdir)/tag.dict.fsm.txt \
 	  --out-k2i=$(tmpdir)/tag.dict.k2i.txt \
@@ -445,7 +491,7 @@ $(tmpdir)/pos.dict.fsm.txt \
 $(tmpdir)/pos.dict.k2i.txt \
 $(tmpdir)/pos.dict.i2t.txt: $(srcdir)/tagset.txt $(srcdir)/pos.dict.utf8.zip $(build_first)
 	unzip -p $(srcdir)/pos.dict.utf8.zip | \
-	fa_build_dict $(opt_build_dict) $(opt_build_pos_dict) \
+	$(call cached_with,$(tools_dict),--stdin) fa_build_dict $(opt_build_dict) $(opt_build_pos_dict) \
 	  --out-fsm=$(tmpdir)/pos.dict.fsm.txt \
 	  --out-k2i=$(tmpdir)/pos.dict.k2i.txt \
 	  --out-i2info=$(tmpdir)/pos.dict.i2t.txt
@@ -454,7 +500,7 @@ $(tmpdir)/w2h.file.utf8: $(W2H_DICT)
 	$(cat_w2h_dict) > $(tmpdir)/w2h.file.utf8
 
 $(tmpdir)/w2h.pats.utf8: $(tmpdir)/w2h.file.utf8 $(extra_w2h_file) $(build_first)
-	fa_build_pats $(opt_dict2pats) $(opt_dict2pats_w2h) \
+	$(call cached_with,$(tools_pats)) fa_build_pats $(opt_dict2pats) $(opt_dict2pats_w2h) \
 	  --in=$(tmpdir)/w2h.file.utf8  \
 	  --out=$(tmpdir)/w2h.pats1.utf8 \
 	  --out-unsolved=$(tmpdir)/w2h.unsolved.utf8
@@ -462,7 +508,7 @@ $(tmpdir)/w2h.pats.utf8: $(tmpdir)/w2h.file.utf8 $(extra_w2h_file) $(build_first
 
 $(tmpdir)/w2h.fsm.txt \
 $(tmpdir)/w2h.i2h.txt: $(tmpdir)/w2h.pats.utf8
-	fa_build_dict --type=moore --raw \
+	$(call cached_with,$(tools_dict)) fa_build_dict --type=moore --raw \
 	  --in=$(tmpdir)/w2h.pats.utf8 \
 	  --out-fsm=$(tmpdir)/w2h.fsm.txt \
 	  --out-i2info=$(tmpdir)/w2h.i2h.txt
@@ -485,15 +531,15 @@ $(tmpdir)/w2tpr.file.utf8: $(srcdir)/wrtc.utf8.zip
 	unzip -p $(srcdir)/wrtc.utf8.zip > $(tmpdir)/w2tpr.file.utf8
 
 $(tmpdir)/w2tp.fsa.txt: $(tmpdir)/w2tp.file.utf8 $(srcdir)/tagset.txt $(build_first)
-	fa_build_w2t_prob $(opt_build_w2tp) --in=$(tmpdir)/w2tp.file.utf8 \
+	$(call cached_with,$(tools_w2t_prob)) fa_build_w2t_prob $(opt_build_w2tp) --in=$(tmpdir)/w2tp.file.utf8 \
 	  --tagset=$(srcdir)/tagset.txt --out=$(tmpdir)/w2tp.fsa.txt
 
 $(tmpdir)/w2tpl.fsa.txt: $(tmpdir)/w2tpl.file.utf8 $(srcdir)/tagset.txt $(build_first)
-	fa_build_w2t_prob $(opt_build_w2tpl) --in=$(tmpdir)/w2tpl.file.utf8 \
+	$(call cached_with,$(tools_w2t_prob)) fa_build_w2t_prob $(opt_build_w2tpl) --in=$(tmpdir)/w2tpl.file.utf8 \
 	  --tagset=$(srcdir)/tagset.txt --out=$(tmpdir)/w2tpl.fsa.txt
 
 $(tmpdir)/w2tpr.fsa.txt: $(tmpdir)/w2tpr.file.utf8 $(srcdir)/tagset.txt $(build_first)
-	fa_build_w2t_prob $(opt_build_w2tpr) --in=$(tmpdir)/w2tpr.file.utf8 \
+	$(call cached_with,$(tools_w2t_prob)) fa_build_w2t_prob $(opt_build_w2tpr) --in=$(tmpdir)/w2tpr.file.utf8 \
 	  --tagset=$(srcdir)/tagset.txt --out=$(tmpdir)/w2tpr.fsa.txt
 
 
@@ -502,7 +548,7 @@ $(tmpdir)/w2tp.raw.dict.utf8: $(srcdir)/w2tp.raw.dict.utf8.zip $(build_first)
 
 $(tmpdir)/w2tp.raw.dict.fsa.txt \
 $(tmpdir)/w2tp.raw.dict.minmax.txt: $(tmpdir)/w2tp.raw.dict.utf8 $(srcdir)/tagset.txt $(build_first)
-	fa_build_ngrams --raw --no-key-delim --no-rescale $(opt_build_w2tp_raw_dict) \
+	$(call cached_with,$(tools_ngrams)) fa_build_ngrams --raw --no-key-delim --no-rescale $(opt_build_w2tp_raw_dict) \
 	  --in=$(tmpdir)/w2tp.raw.dict.utf8 \
 	  --tagset=$(srcdir)/tagset.txt \
 	  --out=$(tmpdir)/w2tp.raw.dict.fsa.txt
@@ -516,7 +562,7 @@ $(tmpdir)/w2tp.dict.utf8: $(srcdir)/w2tp.dict.utf8.zip $(build_first)
 
 $(tmpdir)/w2tp.dict.fsa.txt \
 $(tmpdir)/w2tp.dict.minmax.txt: $(tmpdir)/w2tp.dict.utf8 $(srcdir)/tagset.txt $(build_first)
-	fa_build_ngrams --raw $(opt_build_w2tp_dict) \
+	$(call cached_with,$(tools_ngrams)) fa_build_ngrams --raw $(opt_build_w2tp_dict) \
 	  --in=$(tmpdir)/w2tp.dict.utf8 \
 	  --tagset=$(srcdir)/tagset.txt \
 	  --out-minmax=$(tmpdir)/w2tp.dict.minmax.txt \
@@ -526,7 +572,7 @@ $(tmpdir)/w2tp.dict.minmax.txt: $(tmpdir)/w2tp.dict.utf8 $(srcdir)/tagset.txt $(
 $(tmpdir)/wbd.rules.fsa.txt \
 $(tmpdir)/wbd.rules.fsa.iwmap.txt \
 $(tmpdir)/wbd.rules.map.txt: $(srcdir)/wbd.lex.utf8 $(srcdir)/wbd.tagset.txt
-	fa_build_lex $(opt_build_wbd) --in=$(srcdir)/wbd.lex.utf8 \
+	$(call cached_with,$(tools_lex),--key-includes) fa_build_lex $(opt_build_wbd) --in=$(srcdir)/wbd.lex.utf8 \
 	  --tagset=$(srcdir)/wbd.tagset.txt --out-fsa=$(tmpdir)/wbd.rules.fsa.txt \
 	  --out-fsa-iwmap=$(tmpdir)/wbd.rules.fsa.iwmap.txt \
 	  --out-map=$(tmpdir)/wbd.rules.map.txt